@@ -0,0 +1,212 @@
+#include "batch_runner.h"
+#include "result_writer.h"
+#include "safe_reader.h"
+#include "thread_pool.h"
+#include "trace_recorder.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace mirrors_lasers {
+
+namespace {
+
+/// @brief Mixes the value into the hash state, the finalizer of SplitMix64 is used
+std::uint64_t mix_hash(std::uint64_t state, std::uint64_t value)
+{
+  state = (state ^ value) + 0x9E3779B97F4A7C15ULL;
+  state = (state ^ (state >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  state = (state ^ (state >> 27U)) * 0x94D049BB133111EBULL;
+  return state ^ (state >> 31U);
+}
+
+void mix_fingerprint(SafeFingerprint& fingerprint, std::uint64_t value)
+{
+  fingerprint.first = mix_hash(fingerprint.first, value);
+  fingerprint.second = mix_hash(fingerprint.second, value ^ 0xD6E8FEB86659FD93ULL);
+}
+
+/// @brief Mixes the set of the mirrors. The hashes of the mirrors are combined by sums and xors, which don't
+/// depend on the order, so the list is neither copied nor sorted
+void mix_mirrors(SafeFingerprint& fingerprint, const std::vector<Point>& mirrors)
+{
+  std::uint64_t first_sum{0U};
+  std::uint64_t first_xor{0U};
+  std::uint64_t second_sum{0U};
+  std::uint64_t second_xor{0U};
+  for (const Point& mirror : mirrors) {
+    const std::uint64_t position = (static_cast<std::uint64_t>(mirror.row) << 32U) | mirror.col;
+    const std::uint64_t first_hash = mix_hash(0x2545F4914F6CDD1DULL, position);
+    const std::uint64_t second_hash = mix_hash(0x9FB21C651E98DF25ULL, position);
+    first_sum += first_hash;
+    first_xor ^= first_hash;
+    second_sum += second_hash;
+    second_xor ^= second_hash;
+  }
+  mix_fingerprint(fingerprint, mirrors.size());
+  mix_fingerprint(fingerprint, first_sum);
+  mix_fingerprint(fingerprint, first_xor);
+  mix_fingerprint(fingerprint, second_sum);
+  mix_fingerprint(fingerprint, second_xor);
+}
+
+LimitedCheckResult check_safe_with_limits(const SafeDescription& safe, std::size_t index, const BatchOptions& options)
+{
+  const TraceCase trace_case{std::to_string(index + 1U),
+                             safe.left_to_up_mirrors.size() + safe.left_to_down_mirrors.size()};
+  // The deadline and the elapsed time include the construction of the checker
+  const auto start_time = std::chrono::steady_clock::now();
+  CheckLimits limits{};
+  limits.cancellation = options.cancellation;
+  if (options.check_timeout.count() > 0) {
+    limits.deadline = start_time + options.check_timeout;
+  }
+  LimitedCheckResult result{};
+  try {
+    SafeChecker checker{safe.rows, safe.columns, safe.left_to_up_mirrors, safe.left_to_down_mirrors, 1U,
+                        options.index_layout, options.checker_memory_budget};
+    checker.set_tracing_mode(options.tracing_mode);
+    result = checker.check_safe(limits);
+  } catch (const MemoryBudgetError&) {
+    result.status = CheckStatus::MemoryBudgetExceeded;
+  }
+  result.elapsed = std::chrono::steady_clock::now() - start_time;
+  return result;
+}
+
+}  // namespace
+
+SafeFingerprint fingerprint_safe(const SafeDescription& safe)
+{
+  SafeFingerprint fingerprint{};
+  mix_fingerprint(fingerprint, (static_cast<std::uint64_t>(safe.rows) << 32U) | safe.columns);
+  mix_mirrors(fingerprint, safe.left_to_up_mirrors);
+  mix_mirrors(fingerprint, safe.left_to_down_mirrors);
+  return fingerprint;
+}
+
+ResultCache::ResultCache(std::size_t capacity)
+  : capacity_{capacity}
+{
+}
+
+bool ResultCache::find(const SafeFingerprint& fingerprint, SafeCheckResult& result)
+{
+  const std::lock_guard<std::mutex> lock{mutex_};
+  const auto entry_iter = entries_.find(fingerprint);
+  if (entry_iter == entries_.end()) {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  lru_.splice(lru_.begin(), lru_, entry_iter->second.lru_position);
+  result = entry_iter->second.result;
+  return true;
+}
+
+void ResultCache::insert(const SafeFingerprint& fingerprint, const SafeCheckResult& result)
+{
+  const std::lock_guard<std::mutex> lock{mutex_};
+  const auto entry_iter = entries_.find(fingerprint);
+  if (entry_iter != entries_.end()) {
+    entry_iter->second.result = result;
+    lru_.splice(lru_.begin(), lru_, entry_iter->second.lru_position);
+    return;
+  }
+  if (capacity_ == 0U) {
+    return;
+  }
+  if (entries_.size() == capacity_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(fingerprint);
+  entries_.emplace(fingerprint, CacheEntry{result, lru_.begin()});
+}
+
+ResultCacheStats ResultCache::stats() const
+{
+  const std::lock_guard<std::mutex> lock{mutex_};
+  ResultCacheStats result{};
+  result.hits = hits_;
+  result.misses = misses_;
+  result.entries = entries_.size();
+  return result;
+}
+
+std::vector<LimitedCheckResult> check_safes(const std::vector<SafeDescription>& safes,
+                                            const BatchOptions& options)
+{
+  std::vector<LimitedCheckResult> results(safes.size());
+  const std::shared_ptr<ResultCache>& cache = options.result_cache;
+  if (!cache) {
+    ThreadPool::shared().run_parts(safes.size(), [&] (std::size_t index) {
+      results[index] = check_safe_with_limits(safes[index], index, options);
+    }, options.threads_count);
+    return results;
+  }
+
+  std::vector<SafeFingerprint> fingerprints(safes.size());
+  ThreadPool::shared().run_parts(safes.size(), [&] (std::size_t index) {
+    fingerprints[index] = fingerprint_safe(safes[index]);
+  }, options.threads_count);
+
+  // Only the first copy of each safe is checked, the following ones are answered after it
+  std::unordered_map<SafeFingerprint, std::size_t, SafeFingerprintHash> first_copies{};
+  std::vector<std::size_t> unique_indexes{};
+  std::vector<std::pair<std::size_t, std::size_t>> duplicates{};
+  for (std::size_t index = 0U; index < safes.size(); ++index) {
+    const auto inserted = first_copies.emplace(fingerprints[index], index);
+    if (inserted.second) {
+      unique_indexes.push_back(index);
+    } else {
+      duplicates.emplace_back(index, inserted.first->second);
+    }
+  }
+
+  ThreadPool::shared().run_parts(unique_indexes.size(), [&] (std::size_t unique_index) {
+    const std::size_t index = unique_indexes[unique_index];
+    LimitedCheckResult& result = results[index];
+    if (cache->find(fingerprints[index], result.result)) {
+      return;
+    }
+    result = check_safe_with_limits(safes[index], index, options);
+    if (result.status == CheckStatus::Completed) {
+      cache->insert(fingerprints[index], result.result);
+    }
+  }, options.threads_count);
+
+  for (const auto& duplicate : duplicates) {
+    LimitedCheckResult& result = results[duplicate.first];
+    // A stopped check of the first copy is not cached, its status is reported for the copies too
+    if (!cache->find(fingerprints[duplicate.first], result.result)) {
+      result = results[duplicate.second];
+    }
+  }
+  return results;
+}
+
+std::size_t run_batch(std::istream& input, std::ostream& output, const BatchOptions& options)
+{
+  std::vector<SafeDescription> safes;
+  while (input >> std::ws && !input.eof()) {
+    const std::string case_id = std::to_string(safes.size() + 1U);
+    const TraceCase trace_case{case_id, 0U};
+    try {
+      safes.push_back(read_safe(input));
+    } catch (const std::invalid_argument& exception) {
+      throw std::invalid_argument{"Safe " + case_id + ": " + exception.what()};
+    }
+  }
+
+  const std::vector<LimitedCheckResult> results = check_safes(safes, options);
+  ResultWriter writer{output, options.output};
+  for (std::size_t index = 0U; index < results.size(); ++index) {
+    writer.write(std::to_string(index + 1U), results[index]);
+  }
+  writer.flush();
+  return results.size();
+}
+
+}  // namespace mirrors_lasers
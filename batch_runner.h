@@ -0,0 +1,158 @@
+#ifndef BATCH_RUNNER
+#define BATCH_RUNNER
+
+#include "result_writer.h"
+#include "safe_checker.h"
+#include "safe_reader.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace mirrors_lasers {
+
+/// @brief Canonical fingerprint of a safe, independent of the order of its mirrors
+///
+/// @details Two independent 64-bit hashes are combined, so the probability of a collision is negligible
+struct SafeFingerprint final {
+  std::uint64_t first{0U};
+  std::uint64_t second{0U};
+
+  bool operator==(const SafeFingerprint& other) const
+  {
+    return first == other.first && second == other.second;
+  }
+};
+
+/// @brief Hash of the fingerprint for the unordered containers
+struct SafeFingerprintHash final {
+  std::size_t operator()(const SafeFingerprint& fingerprint) const
+  {
+    return static_cast<std::size_t>(fingerprint.first);
+  }
+};
+
+/// @brief Computes the fingerprint of the number of rows and columns and the sets of the mirrors
+///
+/// @param safe Description of the safe
+///
+/// @return The fingerprint
+SafeFingerprint fingerprint_safe(const SafeDescription& safe);
+
+/// @brief Statistics of the cache of the results
+struct ResultCacheStats final {
+  std::uint64_t hits{0U};
+  std::uint64_t misses{0U};
+  std::size_t entries{0U};
+
+  /// @brief Returns the fraction of the lookups answered from the cache, 0 if there were no lookups
+  double hit_rate() const
+  {
+    const std::uint64_t lookups = hits + misses;
+    return lookups == 0U ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+  }
+};
+
+/// @brief LRU cache of the results of the completed checks by the fingerprints of the safes. Thread-safe
+class ResultCache final {
+public:
+  /// @brief Constructs the cache
+  ///
+  /// @param capacity Maximal number of the kept results, the least recently used ones are evicted
+  explicit ResultCache(std::size_t capacity);
+
+  /// @brief Looks up the result of the safe and counts a hit or a miss
+  ///
+  /// @param fingerprint Fingerprint of the safe
+  /// @param result Receives the result if it is found
+  ///
+  /// @return True if the result is found
+  bool find(const SafeFingerprint& fingerprint, SafeCheckResult& result);
+
+  /// @brief Puts the result of the safe into the cache
+  ///
+  /// @param fingerprint Fingerprint of the safe
+  /// @param result Result of the completed check
+  void insert(const SafeFingerprint& fingerprint, const SafeCheckResult& result);
+
+  /// @brief Returns the current statistics of the cache
+  ResultCacheStats stats() const;
+
+private:
+  /// @brief Cached result
+  struct CacheEntry final {
+    SafeCheckResult result;
+    std::list<SafeFingerprint>::iterator lru_position;
+  };
+
+  const std::size_t capacity_;
+  /// @brief Protects the entries and the counters
+  mutable std::mutex mutex_;
+  std::unordered_map<SafeFingerprint, CacheEntry, SafeFingerprintHash> entries_;
+  /// @brief Fingerprints of the cached results, the most recently used first
+  std::list<SafeFingerprint> lru_;
+  std::uint64_t hits_{0U};
+  std::uint64_t misses_{0U};
+};
+
+/// @brief Parameters of processing a batch of safes
+struct BatchOptions final {
+  /// @brief Maximum number of the threads checking the safes, including the calling one. The threads are taken
+  /// from the shared thread pool
+  std::size_t threads_count{1U};
+  /// @brief Maximal duration of the check of a single safe, zero means unlimited
+  std::chrono::milliseconds check_timeout{0};
+  /// @brief Cancels the checks, which are not finished yet
+  CancellationToken cancellation{};
+  /// @brief Representation of the index of the mirrors of the checkers
+  MirrorsIndexLayout index_layout{MirrorsIndexLayout::Hashed};
+  /// @brief Memory budget of a single checker in bytes, zero means unlimited. The safes, which don't fit into it
+  /// with any index layout, are not checked and have the status CheckStatus::MemoryBudgetExceeded
+  std::size_t checker_memory_budget{0U};
+  /// @brief Order of tracing the beams by the checkers
+  BeamTracingMode tracing_mode{BeamTracingMode::Sequential};
+  /// @brief Results of the previous checks, can be shared between batches. The duplicates are checked
+  /// independently if nullptr
+  std::shared_ptr<ResultCache> result_cache{};
+  /// @brief Format of the results written by run_batch()
+  OutputOptions output{};
+};
+
+/// @brief Checks the safes in parallel
+///
+/// @param safes Descriptions of the safes
+/// @param options Parameters of processing
+///
+/// @return Results of the checks in the order of the safes. The checks exceeding the timeout or cancelled
+/// have the corresponding status. The elapsed time includes the construction of the checker and is zero
+/// for the results taken from the cache
+///
+/// @details The events of each safe are traced with the case ID equal to its 1-based number.
+/// If the options contain a result cache, the safes are identified by their fingerprints. The checker is built
+/// only for the first copy of a safe missing in the cache, the other copies take its result. Only the completed
+/// checks are cached
+std::vector<LimitedCheckResult> check_safes(const std::vector<SafeDescription>& safes, const BatchOptions& options);
+
+/// @brief Reads the safes in the text format from the input until its end, checks them and writes the results
+/// to the output in the input order, one line per safe, in the format of the options. The case ID of a safe
+/// is its 1-based number
+///
+/// @param input Stream of the safe descriptions
+/// @param output Stream of the results
+/// @param options Parameters of processing
+///
+/// @return Number of the processed safes
+///
+/// @throw std::invalid_argument if a safe description is incorrect, the message contains the number of the safe
+std::size_t run_batch(std::istream& input, std::ostream& output, const BatchOptions& options);
+
+}  // namespace mirrors_lasers
+
+#endif  // BATCH_RUNNER
@@ -0,0 +1,151 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(__linux__)
+#define MIRRORS_LASERS_HAS_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define MIRRORS_LASERS_HAS_PERF_EVENTS 0
+#endif
+
+namespace mirrors_lasers {
+
+namespace {
+
+#if MIRRORS_LASERS_HAS_PERF_EVENTS
+constexpr std::array<std::uint64_t, PERF_EVENTS_COUNT> PERF_EVENT_CONFIGS{
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+int open_perf_event(std::uint64_t config, int group_leader)
+{
+  perf_event_attr attributes{};
+  attributes.size = sizeof(attributes);
+  attributes.type = PERF_TYPE_HARDWARE;
+  attributes.config = config;
+  attributes.disabled = group_leader == -1 ? 1U : 0U;
+  attributes.exclude_kernel = 1U;
+  attributes.exclude_hv = 1U;
+  attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(::syscall(SYS_perf_event_open, &attributes, 0, -1, group_leader, 0UL));
+}
+
+std::string read_paranoid_level()
+{
+  std::ifstream file{"/proc/sys/kernel/perf_event_paranoid"};
+  std::string level;
+  file >> level;
+  return level.empty() ? "unknown" : level;
+}
+#endif
+
+}  // namespace
+
+const char* perf_event_name(PerfEvent event)
+{
+  switch (event) {
+    case PerfEvent::Cycles:
+      return "cycles";
+    case PerfEvent::Instructions:
+      return "instructions";
+    case PerfEvent::CacheMisses:
+      return "cache-misses";
+    case PerfEvent::BranchMisses:
+      return "branch-misses";
+  }
+  return "unknown";
+}
+
+PerfCounters::PerfCounters()
+{
+  descriptors_.fill(-1);
+#if MIRRORS_LASERS_HAS_PERF_EVENTS
+  for (std::size_t index = 0U; index < PERF_EVENTS_COUNT; ++index) {
+    descriptors_[index] = open_perf_event(PERF_EVENT_CONFIGS[index], group_leader_);
+    if (descriptors_[index] == -1) {
+      if (unavailable_reason_.empty()) {
+        unavailable_reason_ = std::string{"perf_event_open failed for "} +
+            perf_event_name(static_cast<PerfEvent>(index)) + ": " + std::strerror(errno) +
+            " (perf_event_paranoid is " + read_paranoid_level() + ")";
+      }
+    } else if (group_leader_ == -1) {
+      group_leader_ = descriptors_[index];
+    }
+  }
+#else
+  unavailable_reason_ = "perf_event_open is available on Linux only";
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#if MIRRORS_LASERS_HAS_PERF_EVENTS
+  for (const int descriptor : descriptors_) {
+    if (descriptor != -1) {
+      ::close(descriptor);
+    }
+  }
+#endif
+}
+
+bool PerfCounters::is_available() const
+{
+  return group_leader_ != -1;
+}
+
+const std::string& PerfCounters::unavailable_reason() const
+{
+  return unavailable_reason_;
+}
+
+void PerfCounters::start()
+{
+#if MIRRORS_LASERS_HAS_PERF_EVENTS
+  if (is_available()) {
+    ::ioctl(group_leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(group_leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+}
+
+PerfCounterValues PerfCounters::stop()
+{
+  PerfCounterValues result{};
+#if MIRRORS_LASERS_HAS_PERF_EVENTS
+  if (!is_available()) {
+    return result;
+  }
+  ::ioctl(group_leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  // Layout of PERF_FORMAT_GROUP: number of values, time enabled, time running, values in the order of opening
+  std::vector<std::uint64_t> buffer(3U + PERF_EVENTS_COUNT);
+  const ssize_t bytes_read = ::read(group_leader_, buffer.data(), buffer.size() * sizeof(std::uint64_t));
+  if (bytes_read < static_cast<ssize_t>(3U * sizeof(std::uint64_t))) {
+    return result;
+  }
+  const std::uint64_t time_enabled = buffer[1];
+  const std::uint64_t time_running = buffer[2];
+  // The group was scheduled only a part of the time, if the counters were multiplexed
+  const double scale = time_running == 0U ? 0.0 : static_cast<double>(time_enabled) / static_cast<double>(time_running);
+  std::size_t value_index{3U};
+  for (std::size_t index = 0U; index < PERF_EVENTS_COUNT; ++index) {
+    if (descriptors_[index] != -1 && value_index < buffer.size()) {
+      result.is_available[index] = time_running != 0U;
+      result.values[index] = static_cast<std::uint64_t>(static_cast<double>(buffer[value_index]) * scale);
+      ++value_index;
+    }
+  }
+#endif
+  return result;
+}
+
+}  // namespace mirrors_lasers
@@ -0,0 +1,78 @@
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mirrors_lasers {
+
+/// @brief Hardware events counted by PerfCounters
+enum class PerfEvent : std::size_t {
+  Cycles,
+  Instructions,
+  CacheMisses,
+  BranchMisses
+};
+
+/// @brief Number of the values of PerfEvent
+constexpr std::size_t PERF_EVENTS_COUNT{4U};
+
+/// @brief Returns the name of the event
+const char* perf_event_name(PerfEvent event);
+
+/// @brief Values of the counters between PerfCounters::start() and PerfCounters::stop()
+struct PerfCounterValues final {
+  /// @brief True for the events, which could be counted
+  std::array<bool, PERF_EVENTS_COUNT> is_available{};
+  /// @brief Counted values. If the counters were multiplexed with other events, the values are extrapolated
+  std::array<std::uint64_t, PERF_EVENTS_COUNT> values{};
+
+  bool is_available_for(PerfEvent event) const
+  {
+    return is_available[static_cast<std::size_t>(event)];
+  }
+
+  std::uint64_t value_of(PerfEvent event) const
+  {
+    return values[static_cast<std::size_t>(event)];
+  }
+};
+
+/// @brief Group of hardware performance counters of the current thread, opened with perf_event_open
+///
+/// @details Only the user space of the calling thread is counted, so no privileges are required if
+/// perf_event_paranoid is not above 2. The work of other threads is not included, even if they are started later.
+/// If the counters can't be opened (another OS, restrictive perf_event_paranoid, no PMU in a virtual machine),
+/// the object is still usable and reports the counters as unavailable
+class PerfCounters final {
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  /// @brief Returns true if at least one counter is available
+  bool is_available() const;
+
+  /// @brief Returns the reason why the counters are unavailable, empty if all of them are available
+  const std::string& unavailable_reason() const;
+
+  /// @brief Resets and starts the counters
+  void start();
+
+  /// @brief Stops the counters and returns their values
+  PerfCounterValues stop();
+
+private:
+  /// @brief File descriptors of the counters, -1 if a counter is unavailable. The first available one leads the group
+  std::array<int, PERF_EVENTS_COUNT> descriptors_;
+  int group_leader_{-1};
+  std::string unavailable_reason_;
+};
+
+}  // namespace mirrors_lasers
+
+#endif  // PERF_COUNTERS
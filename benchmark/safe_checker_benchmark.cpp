@@ -0,0 +1,275 @@
+#include "perf_counters.h"
+
+#include <memory_arena.h>
+#include <safe_checker.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+/// @brief Placement of the generated mirrors
+enum class Layout {
+  /// @brief Mirrors are placed randomly, the beams are usually short
+  Random,
+  /// @brief Mirrors turn the beam from the laser along every row, so it passes all of them
+  Serpentine
+};
+
+/// @brief Parameters of the benchmark
+struct BenchmarkOptions final {
+  std::vector<std::size_t> mirrors_counts{1000U, 10000U, 100000U};
+  Layout layout{Layout::Random};
+  /// @brief Fraction of the grid cells occupied by mirrors, defines the grid side. Denser grids make longer beams
+  double fill{0.25};
+  std::size_t repetitions{5U};
+  /// @brief Number of threads building the index and searching the intersections
+  std::size_t threads_count{1U};
+  std::uint64_t seed{1U};
+  /// @brief Allocation policy of the indexes of the mirrors
+  mirrors_lasers::MemoryPolicy memory_policy{};
+  mirrors_lasers::MirrorsIndexLayout index_layout{mirrors_lasers::MirrorsIndexLayout::Hashed};
+  mirrors_lasers::BeamTracingMode tracing_mode{mirrors_lasers::BeamTracingMode::Sequential};
+};
+
+/// @brief Randomly generated safe
+struct GeneratedSafe final {
+  std::uint32_t side{0U};
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors;
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors;
+};
+
+/// @brief Measurements of a phase summed over the repetitions
+struct PhaseMeasurement final {
+  std::chrono::nanoseconds time{0};
+  mirrors_lasers::PerfCounterValues counters{};
+};
+
+std::vector<std::size_t> parse_counts(const std::string& text)
+{
+  std::vector<std::size_t> counts;
+  std::istringstream input{text};
+  std::string item;
+  while (std::getline(input, item, ',')) {
+    counts.push_back(static_cast<std::size_t>(std::stoul(item)));
+  }
+  if (counts.empty()) {
+    throw std::invalid_argument{"Incorrect mirrors counts: " + text};
+  }
+  return counts;
+}
+
+BenchmarkOptions parse_arguments(int argc, char* argv[])
+{
+  BenchmarkOptions options{};
+  for (int index = 1; index < argc; ++index) {
+    const std::string argument{argv[index]};
+    if (argument == "--numa-local") {
+      options.memory_policy.is_numa_local = true;
+      continue;
+    }
+    if (index + 1 >= argc) {
+      throw std::invalid_argument{"Unknown argument: " + argument};
+    }
+    const std::string value{argv[++index]};
+    if (argument == "--mirrors") {
+      options.mirrors_counts = parse_counts(value);
+    } else if (argument == "--fill") {
+      options.fill = std::stod(value);
+      if (options.fill <= 0.0 || options.fill > 1.0) {
+        throw std::invalid_argument{"Fill must be in (0, 1]: " + value};
+      }
+    } else if (argument == "--layout" && (value == "random" || value == "serpentine")) {
+      options.layout = value == "random" ? Layout::Random : Layout::Serpentine;
+    } else if (argument == "--repetitions") {
+      options.repetitions = std::max<std::size_t>(std::stoul(value), 1U);
+    } else if (argument == "--threads") {
+      options.threads_count = std::max<std::size_t>(std::stoul(value), 1U);
+    } else if (argument == "--seed") {
+      options.seed = std::stoull(value);
+    } else if (argument == "--index" && (value == "hashed" || value == "flat")) {
+      options.index_layout = value == "hashed" ? mirrors_lasers::MirrorsIndexLayout::Hashed
+                                               : mirrors_lasers::MirrorsIndexLayout::Flat;
+    } else if (argument == "--tracing" && (value == "sequential" || value == "interleaved")) {
+      options.tracing_mode = value == "sequential" ? mirrors_lasers::BeamTracingMode::Sequential
+                                                   : mirrors_lasers::BeamTracingMode::Interleaved;
+    } else if (argument == "--huge-pages" && (value == "none" || value == "thp" || value == "hugetlb")) {
+      options.memory_policy.huge_pages = value == "none" ? mirrors_lasers::HugePagesMode::None
+          : value == "thp" ? mirrors_lasers::HugePagesMode::Transparent
+          : mirrors_lasers::HugePagesMode::Explicit;
+    } else {
+      throw std::invalid_argument{"Unknown argument: " + argument};
+    }
+  }
+  return options;
+}
+
+GeneratedSafe generate_serpentine_safe(std::size_t mirrors_count)
+{
+  GeneratedSafe safe{};
+  safe.side = static_cast<std::uint32_t>(std::max<std::size_t>(mirrors_count / 2U, 2U));
+  // The beam goes right along the odd rows and left along the even rows
+  for (std::uint32_t row = 1U; row < safe.side; ++row) {
+    const bool is_right_to_left = row % 2U == 0U;
+    const mirrors_lasers::Point turn_down{row, is_right_to_left ? 1U : safe.side};
+    const mirrors_lasers::Point turn_along{row + 1U, is_right_to_left ? 1U : safe.side};
+    (is_right_to_left ? safe.left_to_up_mirrors : safe.left_to_down_mirrors).push_back(turn_down);
+    (is_right_to_left ? safe.left_to_down_mirrors : safe.left_to_up_mirrors).push_back(turn_along);
+  }
+  return safe;
+}
+
+GeneratedSafe generate_random_safe(std::size_t mirrors_count, double fill, std::mt19937_64& generator)
+{
+  GeneratedSafe safe{};
+  const double side = std::ceil(std::sqrt(static_cast<double>(mirrors_count) / fill));
+  safe.side = static_cast<std::uint32_t>(std::max(side, 2.0));
+  const std::uint64_t cells = static_cast<std::uint64_t>(safe.side) * safe.side;
+  mirrors_count = static_cast<std::size_t>(std::min<std::uint64_t>(mirrors_count, cells - 2U));
+  std::uniform_int_distribution<std::uint32_t> coordinate_distribution{1U, safe.side};
+  std::bernoulli_distribution orientation_distribution{0.5};
+  std::unordered_set<std::uint64_t> occupied;
+  while (occupied.size() < mirrors_count) {
+    const mirrors_lasers::Point point{coordinate_distribution(generator), coordinate_distribution(generator)};
+    const bool is_laser_or_detector_cell = (point.row == 1U && point.col == 1U) ||
+                                           (point.row == safe.side && point.col == safe.side);
+    if (is_laser_or_detector_cell ||
+        !occupied.insert((static_cast<std::uint64_t>(point.row) << 32U) | point.col).second) {
+      continue;
+    }
+    (orientation_distribution(generator) ? safe.left_to_up_mirrors : safe.left_to_down_mirrors).push_back(point);
+  }
+  return safe;
+}
+
+void add_measurement(PhaseMeasurement& total, std::chrono::nanoseconds time,
+                     const mirrors_lasers::PerfCounterValues& counters)
+{
+  total.time += time;
+  for (std::size_t index = 0U; index < mirrors_lasers::PERF_EVENTS_COUNT; ++index) {
+    total.counters.is_available[index] = counters.is_available[index];
+    total.counters.values[index] += counters.values[index];
+  }
+}
+
+void print_normalized(const char* name, double value, double divisor)
+{
+  std::cout << " " << name << "=";
+  if (divisor > 0.0) {
+    std::cout << value / divisor;
+  } else {
+    std::cout << "-";
+  }
+}
+
+/// @brief Prints the counters of a phase per repetition and normalized by the work done
+void print_phase(const char* phase, const PhaseMeasurement& measurement, std::size_t repetitions,
+                 double mirrors, double segments, double candidates)
+{
+  const double repetitions_count = static_cast<double>(repetitions);
+  std::cout << "  " << phase << ": time_us="
+            << static_cast<double>(measurement.time.count()) / 1000.0 / repetitions_count << std::endl;
+  for (std::size_t index = 0U; index < mirrors_lasers::PERF_EVENTS_COUNT; ++index) {
+    const auto event = static_cast<mirrors_lasers::PerfEvent>(index);
+    std::cout << "    " << std::setw(14) << std::left << mirrors_lasers::perf_event_name(event) << std::right;
+    if (!measurement.counters.is_available_for(event)) {
+      std::cout << " n/a" << std::endl;
+      continue;
+    }
+    const double value = static_cast<double>(measurement.counters.value_of(event)) / repetitions_count;
+    std::cout << " total=" << value;
+    print_normalized("per_mirror", value, mirrors);
+    print_normalized("per_segment", value, segments);
+    print_normalized("per_candidate", value, candidates);
+    std::cout << std::endl;
+  }
+}
+
+void run_benchmark(const BenchmarkOptions& options)
+{
+  mirrors_lasers::set_memory_policy(options.memory_policy);
+  mirrors_lasers::PerfCounters counters{};
+  // The counters of the calling thread would miss the parts run by the thread pool
+  const bool is_counting = options.threads_count == 1U;
+  if (!is_counting) {
+    std::cout << "Hardware counters: disabled with --threads above 1, only the calling thread can be counted"
+              << std::endl;
+  } else if (!counters.unavailable_reason().empty()) {
+    std::cout << "Hardware counters: " << counters.unavailable_reason() << std::endl;
+  }
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::mt19937_64 generator{options.seed};
+  for (const std::size_t requested_mirrors_count : options.mirrors_counts) {
+    const GeneratedSafe safe = options.layout == Layout::Random
+        ? generate_random_safe(requested_mirrors_count, options.fill, generator)
+        : generate_serpentine_safe(requested_mirrors_count);
+    const std::size_t mirrors_count = safe.left_to_up_mirrors.size() + safe.left_to_down_mirrors.size();
+
+    PhaseMeasurement build_measurement{};
+    PhaseMeasurement check_measurement{};
+    mirrors_lasers::SafeCheckStatistics statistics{};
+    mirrors_lasers::SafeCheckResult result{};
+    mirrors_lasers::MemoryFootprint footprint{};
+    for (std::size_t repetition = 0U; repetition < options.repetitions; ++repetition) {
+      auto start_time = std::chrono::steady_clock::now();
+      if (is_counting) {
+        counters.start();
+      }
+      mirrors_lasers::SafeChecker checker{safe.side, safe.side, safe.left_to_up_mirrors,
+                                          safe.left_to_down_mirrors, options.threads_count,
+                                          options.index_layout};
+      mirrors_lasers::PerfCounterValues values = is_counting ? counters.stop() : mirrors_lasers::PerfCounterValues{};
+      checker.set_tracing_mode(options.tracing_mode);
+      footprint = checker.memory_footprint();
+      add_measurement(build_measurement, std::chrono::steady_clock::now() - start_time, values);
+
+      start_time = std::chrono::steady_clock::now();
+      if (is_counting) {
+        counters.start();
+      }
+      result = checker.check_safe(statistics);
+      values = is_counting ? counters.stop() : mirrors_lasers::PerfCounterValues{};
+      add_measurement(check_measurement, std::chrono::steady_clock::now() - start_time, values);
+    }
+
+    std::cout << "mirrors=" << mirrors_count << " side=" << safe.side
+              << " segments=" << statistics.traced_segments
+              << " candidates=" << statistics.intersection_candidates
+              << " positions=" << result.positions << std::endl;
+    const auto mirrors = static_cast<double>(mirrors_count);
+    print_phase("build", build_measurement, options.repetitions, mirrors, 0.0, 0.0);
+    print_phase("check", check_measurement, options.repetitions, mirrors,
+                static_cast<double>(statistics.traced_segments),
+                static_cast<double>(statistics.intersection_candidates));
+    const std::size_t index_bytes = footprint.row_wise_index_bytes + footprint.col_wise_index_bytes;
+    std::cout << "  memory: index_bytes=" << index_bytes
+              << " per_mirror=" << static_cast<double>(index_bytes) / std::max(mirrors, 1.0)
+              << " arena_bytes=" << footprint.arena_reserved_bytes
+              << " peak_scratch_bytes=" << statistics.peak_scratch_bytes << std::endl;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  try {
+    run_benchmark(parse_arguments(argc, argv));
+  } catch (const std::exception& exception) {
+    std::cerr << exception.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
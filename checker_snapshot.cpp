@@ -0,0 +1,535 @@
+#include "checker_snapshot.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MIRRORS_LASERS_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define MIRRORS_LASERS_HAS_MMAP 0
+#include <iterator>
+#endif
+
+namespace mirrors_lasers {
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8]{'M', 'L', 'S', 'N', 'A', 'P', 'S', 'H'};
+/// @brief Written in the native byte order, allows rejecting snapshots created on machines with another one
+constexpr std::uint32_t BYTE_ORDER_MARK{0x01020304U};
+constexpr std::uint32_t HAS_TRAJECTORIES_FLAG{1U};
+constexpr std::size_t SECTION_ALIGNMENT{8U};
+
+/// @brief Arrays stored in the snapshot file
+enum Section : std::size_t {
+  ROW_LINES,
+  ROW_OFFSETS,
+  ROW_POSITIONS,
+  ROW_ORIENTATIONS,
+  COL_LINES,
+  COL_OFFSETS,
+  COL_POSITIONS,
+  COL_ORIENTATIONS,
+  FORWARD_HORIZONTAL_SEGMENTS,
+  FORWARD_VERTICAL_SEGMENTS,
+  BACKWARD_HORIZONTAL_SEGMENTS,
+  BACKWARD_VERTICAL_SEGMENTS,
+  SECTIONS_COUNT
+};
+
+struct SnapshotSection final {
+  /// @brief Offset of the array from the beginning of the file
+  std::uint64_t offset;
+  /// @brief Number of elements in the array
+  std::uint64_t count;
+};
+
+struct SnapshotHeader final {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t coordinate_width;
+  std::uint32_t flags;
+  std::uint64_t rows;
+  std::uint64_t columns;
+  std::uint64_t forward_end_row;
+  std::uint64_t forward_end_col;
+  std::uint32_t forward_end_is_positive;
+  std::uint32_t forward_end_is_horizontal;
+  SnapshotSection sections[SECTIONS_COUNT];
+  /// @brief Size of the file after the header
+  std::uint64_t payload_size;
+  /// @brief Checksum of the file after the header
+  std::uint64_t checksum;
+};
+
+static_assert(sizeof(SnapshotHeader) % SECTION_ALIGNMENT == 0U, "Snapshot header must keep the sections aligned");
+static_assert(sizeof(MirrorOrientation) == 1U, "Orientations are stored as single bytes");
+
+template <typename Coordinate>
+std::size_t section_element_size(std::size_t section)
+{
+  switch (section) {
+  case ROW_OFFSETS:
+  case COL_OFFSETS:
+    return sizeof(std::uint64_t);
+  case ROW_ORIENTATIONS:
+  case COL_ORIENTATIONS:
+    return sizeof(MirrorOrientation);
+  case FORWARD_HORIZONTAL_SEGMENTS:
+  case FORWARD_VERTICAL_SEGMENTS:
+  case BACKWARD_HORIZONTAL_SEGMENTS:
+  case BACKWARD_VERTICAL_SEGMENTS:
+    return sizeof(Coordinate) * 3U;
+  default:
+    return sizeof(Coordinate);
+  }
+}
+
+/// @brief Computes the checksum of the data processing it by 64-bit words (FNV-1a with an additional shift)
+std::uint64_t compute_checksum(const unsigned char* data, std::size_t size)
+{
+  constexpr std::uint64_t FNV_OFFSET_BASIS{14695981039346656037ULL};
+  constexpr std::uint64_t FNV_PRIME{1099511628211ULL};
+  std::uint64_t hash{FNV_OFFSET_BASIS};
+  std::size_t index{0U};
+  for (; index + sizeof(std::uint64_t) <= size; index += sizeof(std::uint64_t)) {
+    std::uint64_t word{};
+    std::memcpy(&word, data + index, sizeof(word));
+    hash = (hash ^ word) * FNV_PRIME;
+    hash ^= hash >> 32U;
+  }
+  for (; index < size; ++index) {
+    hash = (hash ^ data[index]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+/// @brief Checks the fields of the header which don't depend on the coordinate width
+void validate_header(const SnapshotHeader& header, const std::string& path)
+{
+  if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+    throw std::runtime_error{"Not a snapshot file: " + path};
+  }
+  if (header.version != SNAPSHOT_FORMAT_VERSION) {
+    throw std::runtime_error{"Unsupported snapshot version " + std::to_string(header.version) + ": " + path};
+  }
+  if (header.byte_order != BYTE_ORDER_MARK) {
+    throw std::runtime_error{"Snapshot was created on a machine with another byte order: " + path};
+  }
+}
+
+template <typename Coordinate>
+void append_segments(std::vector<Coordinate>& coordinates, const BasicBeamSegments<Coordinate>& segments)
+{
+  coordinates.clear();
+  coordinates.reserve(segments.size() * 3U);
+  for (const auto& segment : segments) {
+    coordinates.push_back(segment.first_coordinate);
+    coordinates.push_back(segment.second_coordinate_start);
+    coordinates.push_back(segment.second_coordinate_end);
+  }
+}
+
+#if MIRRORS_LASERS_HAS_MMAP
+/// @brief Writes all the bytes into the file, returns false on an error
+bool write_all(int descriptor, const void* data, std::size_t size)
+{
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  while (size > 0U) {
+    const ::ssize_t written = ::write(descriptor, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+/// @brief Makes the rename of a file in the directory durable. The errors are ignored, since the snapshot
+/// is already in place
+void sync_parent_directory(const std::string& path)
+{
+  const std::string::size_type separator = path.rfind('/');
+  const std::string directory = separator == std::string::npos ? "." : path.substr(0U, separator + 1U);
+  const int descriptor = ::open(directory.c_str(), O_RDONLY);
+  if (descriptor >= 0) {
+    ::fsync(descriptor);
+    ::close(descriptor);
+  }
+}
+#endif
+
+}  // namespace
+
+class MappedFile final {
+public:
+  explicit MappedFile(const std::string& path)
+  {
+#if MIRRORS_LASERS_HAS_MMAP
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+      throw std::runtime_error{"Can not open the snapshot file: " + path};
+    }
+    struct stat file_stat{};
+    if (::fstat(descriptor, &file_stat) != 0) {
+      ::close(descriptor);
+      throw std::runtime_error{"Can not read the snapshot file: " + path};
+    }
+    size_ = static_cast<std::size_t>(file_stat.st_size);
+    if (size_ > 0U) {
+      void* const address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (address == MAP_FAILED) {
+        ::close(descriptor);
+        throw std::runtime_error{"Can not map the snapshot file: " + path};
+      }
+      data_ = static_cast<const unsigned char*>(address);
+    }
+    ::close(descriptor);
+#else
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+      throw std::runtime_error{"Can not open the snapshot file: " + path};
+    }
+    buffer_.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    data_ = reinterpret_cast<const unsigned char*>(buffer_.data());
+    size_ = buffer_.size();
+#endif
+  }
+
+  ~MappedFile()
+  {
+#if MIRRORS_LASERS_HAS_MMAP
+    if (data_ != nullptr) {
+      ::munmap(const_cast<unsigned char*>(data_), size_);
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const unsigned char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+private:
+  const unsigned char* data_{nullptr};
+  std::size_t size_{0U};
+#if !MIRRORS_LASERS_HAS_MMAP
+  std::vector<char> buffer_;
+#endif
+};
+
+template <typename Coordinate>
+void write_snapshot(const std::string& path, Coordinate rows, Coordinate columns,
+                    const BasicMirrorsIndexView<Coordinate>& row_wise_mirrors,
+                    const BasicMirrorsIndexView<Coordinate>& col_wise_mirrors,
+                    const BasicSnapshotTrajectories<Coordinate>* trajectories)
+{
+  SnapshotHeader header{};
+  std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.version = SNAPSHOT_FORMAT_VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.coordinate_width = static_cast<std::uint32_t>(sizeof(Coordinate));
+  header.rows = rows;
+  header.columns = columns;
+
+  std::vector<unsigned char> payload;
+  auto add_section = [&header, &payload] (Section section, const void* data, std::size_t count) {
+    payload.resize((payload.size() + SECTION_ALIGNMENT - 1U) / SECTION_ALIGNMENT * SECTION_ALIGNMENT, 0U);
+    header.sections[section].offset = sizeof(SnapshotHeader) + payload.size();
+    header.sections[section].count = count;
+    if (count > 0U) {
+      const auto* const bytes = static_cast<const unsigned char*>(data);
+      payload.insert(payload.end(), bytes, bytes + count * section_element_size<Coordinate>(section));
+    }
+  };
+
+  const std::uint64_t empty_offsets[1]{0U};
+  auto add_index = [&add_section, &empty_offsets] (const BasicMirrorsIndexView<Coordinate>& mirrors,
+                                                   Section first_section) {
+    const std::size_t lines_count = mirrors.lines_count();
+    add_section(first_section, mirrors.lines(), lines_count);
+    add_section(static_cast<Section>(first_section + 1U),
+                lines_count == 0U ? empty_offsets : mirrors.offsets(), lines_count + 1U);
+    add_section(static_cast<Section>(first_section + 2U), mirrors.positions(), mirrors.mirrors_count());
+    add_section(static_cast<Section>(first_section + 3U), mirrors.orientations(), mirrors.mirrors_count());
+  };
+  add_index(row_wise_mirrors, ROW_LINES);
+  add_index(col_wise_mirrors, COL_LINES);
+
+  std::vector<Coordinate> coordinates;
+  auto add_segments = [&add_section, &coordinates] (Section section, const BasicBeamSegments<Coordinate>& segments) {
+    append_segments(coordinates, segments);
+    add_section(section, coordinates.data(), segments.size());
+  };
+  if (trajectories != nullptr) {
+    header.flags |= HAS_TRAJECTORIES_FLAG;
+    header.forward_end_row = trajectories->forward_end_state.position.row;
+    header.forward_end_col = trajectories->forward_end_state.position.col;
+    header.forward_end_is_positive = trajectories->forward_end_state.is_positive ? 1U : 0U;
+    header.forward_end_is_horizontal = trajectories->forward_end_state.is_horizontal ? 1U : 0U;
+    add_segments(FORWARD_HORIZONTAL_SEGMENTS, trajectories->forward_horizontal_segments);
+    add_segments(FORWARD_VERTICAL_SEGMENTS, trajectories->forward_vertical_segments);
+    add_segments(BACKWARD_HORIZONTAL_SEGMENTS, trajectories->backward_horizontal_segments);
+    add_segments(BACKWARD_VERTICAL_SEGMENTS, trajectories->backward_vertical_segments);
+  } else {
+    add_segments(FORWARD_HORIZONTAL_SEGMENTS, BasicBeamSegments<Coordinate>{});
+    add_segments(FORWARD_VERTICAL_SEGMENTS, BasicBeamSegments<Coordinate>{});
+    add_segments(BACKWARD_HORIZONTAL_SEGMENTS, BasicBeamSegments<Coordinate>{});
+    add_segments(BACKWARD_VERTICAL_SEGMENTS, BasicBeamSegments<Coordinate>{});
+  }
+  header.payload_size = payload.size();
+  header.checksum = compute_checksum(payload.data(), payload.size());
+
+  // Readers never see a partially written snapshot. The temporary file has a unique name in the directory
+  // of the snapshot, so concurrent writers don't share it and the rename doesn't cross file systems
+#if MIRRORS_LASERS_HAS_MMAP
+  std::vector<char> temporary_path(path.begin(), path.end());
+  const char TEMPLATE_SUFFIX[]{".XXXXXX"};
+  temporary_path.insert(temporary_path.end(), TEMPLATE_SUFFIX, TEMPLATE_SUFFIX + sizeof(TEMPLATE_SUFFIX));
+  const int descriptor = ::mkstemp(temporary_path.data());
+  if (descriptor < 0) {
+    throw std::runtime_error{"Can not create the snapshot file: " + path};
+  }
+  // The file is synchronized before the rename, so after a crash the path holds either the old or the new snapshot
+  const bool is_written = ::fchmod(descriptor, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0 &&
+                          write_all(descriptor, &header, sizeof(header)) &&
+                          write_all(descriptor, payload.data(), payload.size()) && ::fsync(descriptor) == 0;
+  if (::close(descriptor) != 0 || !is_written || std::rename(temporary_path.data(), path.c_str()) != 0) {
+    std::remove(temporary_path.data());
+    throw std::runtime_error{"Can not write the snapshot file: " + path};
+  }
+  sync_parent_directory(path);
+#else
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+    if (!file) {
+      throw std::runtime_error{"Can not create the snapshot file: " + temporary_path};
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    if (!file) {
+      throw std::runtime_error{"Can not write the snapshot file: " + temporary_path};
+    }
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    std::remove(temporary_path.c_str());
+    throw std::runtime_error{"Can not write the snapshot file: " + path};
+  }
+#endif
+}
+
+bool is_snapshot_file(const std::string& path)
+{
+  std::ifstream file{path, std::ios::binary};
+  char magic[sizeof(SNAPSHOT_MAGIC)]{};
+  if (!file.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+}
+
+std::size_t read_snapshot_coordinate_width(const std::string& path)
+{
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error{"Can not open the snapshot file: " + path};
+  }
+  SnapshotHeader header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    throw std::runtime_error{"Snapshot file is truncated: " + path};
+  }
+  validate_header(header, path);
+  return header.coordinate_width;
+}
+
+template <typename Coordinate>
+BasicMappedSnapshot<Coordinate>::BasicMappedSnapshot(const std::string& path)
+  : file_{new MappedFile{path}}
+{
+  static_assert(SECTIONS_COUNT == Section::SECTIONS_COUNT, "Sections count mismatch");
+
+  const unsigned char* const data = file_->data();
+  const std::size_t size = file_->size();
+  SnapshotHeader header{};
+  if (size < sizeof(header)) {
+    throw std::runtime_error{"Snapshot file is truncated: " + path};
+  }
+  std::memcpy(&header, data, sizeof(header));
+  validate_header(header, path);
+  if (header.coordinate_width != sizeof(Coordinate)) {
+    throw std::runtime_error{"Snapshot was created for " + std::to_string(header.coordinate_width) +
+                             "-byte coordinates: " + path};
+  }
+  if (header.payload_size != size - sizeof(header)) {
+    throw std::runtime_error{"Snapshot file is truncated: " + path};
+  }
+  if (compute_checksum(data + sizeof(header), size - sizeof(header)) != header.checksum) {
+    throw std::runtime_error{"Snapshot checksum mismatch: " + path};
+  }
+  if (header.rows == 0U || header.rows > std::numeric_limits<Coordinate>::max() ||
+      header.columns == 0U || header.columns > std::numeric_limits<Coordinate>::max()) {
+    throw std::runtime_error{"Snapshot contains incorrect grid size: " + path};
+  }
+  rows_ = static_cast<Coordinate>(header.rows);
+  columns_ = static_cast<Coordinate>(header.columns);
+
+  for (std::size_t section = 0U; section < SECTIONS_COUNT; ++section) {
+    const SnapshotSection& section_info = header.sections[section];
+    const std::size_t element_size = section_element_size<Coordinate>(section);
+    if (section_info.offset % SECTION_ALIGNMENT != 0U || section_info.offset < sizeof(header) ||
+        section_info.offset > size || section_info.count > (size - section_info.offset) / element_size) {
+      throw std::runtime_error{"Snapshot contains incorrect section bounds: " + path};
+    }
+    sections_[section] = data + section_info.offset;
+    section_sizes_[section] = static_cast<std::size_t>(section_info.count);
+  }
+
+  // The searches of the index rely on the sorted lines and positions, so they are validated in a single pass
+  auto make_index = [this, &path] (Section first_section, Coordinate max_line, Coordinate max_position) {
+    const std::size_t lines_count = section_sizes_[first_section];
+    const std::size_t mirrors_count = section_sizes_[first_section + 2U];
+    const auto* const lines = reinterpret_cast<const Coordinate*>(sections_[first_section]);
+    const auto* const offsets = reinterpret_cast<const std::uint64_t*>(sections_[first_section + 1U]);
+    const auto* const positions = reinterpret_cast<const Coordinate*>(sections_[first_section + 2U]);
+    const auto* const orientations = reinterpret_cast<const MirrorOrientation*>(sections_[first_section + 3U]);
+    bool is_correct = section_sizes_[first_section + 1U] == lines_count + 1U &&
+        section_sizes_[first_section + 3U] == mirrors_count &&
+        offsets[0] == 0U && offsets[lines_count] == mirrors_count;
+    for (std::size_t line = 0U; is_correct && line < lines_count; ++line) {
+      is_correct = offsets[line] <= offsets[line + 1U] && offsets[line + 1U] <= mirrors_count &&
+          lines[line] >= 1U && lines[line] <= max_line &&
+          (line == 0U || lines[line - 1U] < lines[line]);
+      for (std::uint64_t mirror = offsets[line]; is_correct && mirror < offsets[line + 1U]; ++mirror) {
+        is_correct = positions[mirror] >= 1U && positions[mirror] <= max_position &&
+            (mirror == offsets[line] || positions[mirror - 1U] < positions[mirror]) &&
+            (orientations[mirror] == MirrorOrientation::LeftToUp ||
+             orientations[mirror] == MirrorOrientation::LeftToDown);
+      }
+    }
+    if (!is_correct) {
+      throw std::runtime_error{"Snapshot contains an incorrect index of the mirrors: " + path};
+    }
+    return BasicMirrorsIndexView<Coordinate>{lines, offsets, lines_count, positions, orientations};
+  };
+  row_wise_mirrors_ = make_index(ROW_LINES, rows_, columns_);
+  col_wise_mirrors_ = make_index(COL_LINES, columns_, rows_);
+
+  has_trajectories_ = (header.flags & HAS_TRAJECTORIES_FLAG) != 0U;
+  if (!has_trajectories_) {
+    return;
+  }
+  // The intersection search relies on the segments lying on the grid, and the check of the forward beam
+  // on its end state, so they are validated in a single pass too
+  auto are_segments_correct = [this] (Section section, Coordinate max_line, Coordinate max_position) {
+    const auto* const coordinates = reinterpret_cast<const Coordinate*>(sections_[section]);
+    for (std::size_t index = 0U; index < section_sizes_[section]; ++index) {
+      const Coordinate line = coordinates[index * 3U];
+      const Coordinate start = coordinates[index * 3U + 1U];
+      const Coordinate end = coordinates[index * 3U + 2U];
+      if (line < 1U || line > max_line || start < 1U || start > end || end > max_position) {
+        return false;
+      }
+    }
+    return true;
+  };
+  bool is_correct = are_segments_correct(FORWARD_HORIZONTAL_SEGMENTS, rows_, columns_) &&
+                    are_segments_correct(FORWARD_VERTICAL_SEGMENTS, columns_, rows_) &&
+                    are_segments_correct(BACKWARD_HORIZONTAL_SEGMENTS, rows_, columns_) &&
+                    are_segments_correct(BACKWARD_VERTICAL_SEGMENTS, columns_, rows_);
+  // The forward beam leaves the grid at the border it goes to, at the end of its last segment
+  if (is_correct) {
+    is_correct = header.forward_end_is_positive <= 1U && header.forward_end_is_horizontal <= 1U &&
+                 header.forward_end_row >= 1U && header.forward_end_row <= rows_ &&
+                 header.forward_end_col >= 1U && header.forward_end_col <= columns_;
+  }
+  if (is_correct) {
+    forward_end_state_.position.row = static_cast<Coordinate>(header.forward_end_row);
+    forward_end_state_.position.col = static_cast<Coordinate>(header.forward_end_col);
+    forward_end_state_.is_positive = header.forward_end_is_positive != 0U;
+    forward_end_state_.is_horizontal = header.forward_end_is_horizontal != 0U;
+    const bool is_horizontal = forward_end_state_.is_horizontal;
+    const Section last_section = is_horizontal ? FORWARD_HORIZONTAL_SEGMENTS : FORWARD_VERTICAL_SEGMENTS;
+    const Coordinate line = is_horizontal ? forward_end_state_.position.row : forward_end_state_.position.col;
+    const Coordinate position = is_horizontal ? forward_end_state_.position.col : forward_end_state_.position.row;
+    const Coordinate border = forward_end_state_.is_positive ? (is_horizontal ? columns_ : rows_) : Coordinate{1U};
+    const std::size_t segments_count = section_sizes_[last_section];
+    is_correct = segments_count > 0U && position == border;
+    if (is_correct) {
+      const auto* const last_segment =
+          reinterpret_cast<const Coordinate*>(sections_[last_section]) + (segments_count - 1U) * 3U;
+      is_correct = last_segment[0] == line && (last_segment[1] == position || last_segment[2] == position);
+    }
+  }
+  if (!is_correct) {
+    throw std::runtime_error{"Snapshot contains incorrect beam trajectories: " + path};
+  }
+}
+
+template <typename Coordinate>
+BasicMappedSnapshot<Coordinate>::~BasicMappedSnapshot() = default;
+
+template <typename Coordinate>
+void BasicMappedSnapshot<Coordinate>::read_forward_trajectory(BasicBeamState<Coordinate>& end_state,
+                                                              BasicBeamSegments<Coordinate>& horizontal_segments,
+                                                              BasicBeamSegments<Coordinate>& vertical_segments) const
+{
+  end_state = forward_end_state_;
+  read_segments_(FORWARD_HORIZONTAL_SEGMENTS, horizontal_segments);
+  read_segments_(FORWARD_VERTICAL_SEGMENTS, vertical_segments);
+}
+
+template <typename Coordinate>
+void BasicMappedSnapshot<Coordinate>::read_backward_trajectory(BasicBeamSegments<Coordinate>& horizontal_segments,
+                                                               BasicBeamSegments<Coordinate>& vertical_segments) const
+{
+  read_segments_(BACKWARD_HORIZONTAL_SEGMENTS, horizontal_segments);
+  read_segments_(BACKWARD_VERTICAL_SEGMENTS, vertical_segments);
+}
+
+template <typename Coordinate>
+void BasicMappedSnapshot<Coordinate>::read_segments_(std::size_t section,
+                                                     BasicBeamSegments<Coordinate>& segments) const
+{
+  const auto* const coordinates = reinterpret_cast<const Coordinate*>(sections_[section]);
+  segments.resize(section_sizes_[section]);
+  for (std::size_t index = 0U; index < segments.size(); ++index) {
+    segments[index].first_coordinate = coordinates[index * 3U];
+    segments[index].second_coordinate_start = coordinates[index * 3U + 1U];
+    segments[index].second_coordinate_end = coordinates[index * 3U + 2U];
+  }
+}
+
+template <typename Coordinate>
+constexpr std::size_t BasicMappedSnapshot<Coordinate>::SECTIONS_COUNT;
+
+template void write_snapshot(const std::string&, std::uint16_t, std::uint16_t,
+                             const BasicMirrorsIndexView<std::uint16_t>&, const BasicMirrorsIndexView<std::uint16_t>&,
+                             const BasicSnapshotTrajectories<std::uint16_t>*);
+template void write_snapshot(const std::string&, std::uint32_t, std::uint32_t,
+                             const BasicMirrorsIndexView<std::uint32_t>&, const BasicMirrorsIndexView<std::uint32_t>&,
+                             const BasicSnapshotTrajectories<std::uint32_t>*);
+template void write_snapshot(const std::string&, std::uint64_t, std::uint64_t,
+                             const BasicMirrorsIndexView<std::uint64_t>&, const BasicMirrorsIndexView<std::uint64_t>&,
+                             const BasicSnapshotTrajectories<std::uint64_t>*);
+
+template class BasicMappedSnapshot<std::uint16_t>;
+template class BasicMappedSnapshot<std::uint32_t>;
+template class BasicMappedSnapshot<std::uint64_t>;
+
+}  // namespace mirrors_lasers
@@ -0,0 +1,153 @@
+#ifndef CHECKER_SNAPSHOT
+#define CHECKER_SNAPSHOT
+
+#include "mirrors_index.h"
+#include "safe_checker.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace mirrors_lasers {
+
+/// @brief Version of the snapshot file format. Snapshots of other versions are rejected
+constexpr std::uint32_t SNAPSHOT_FORMAT_VERSION{1U};
+
+/// @brief Memory of a file mapped into memory
+class MappedFile;
+
+/// @brief Beam trajectories traced by a checker, which can be stored in a snapshot
+template <typename Coordinate>
+struct BasicSnapshotTrajectories final {
+  /// @brief Final state of the beam from the laser
+  BasicBeamState<Coordinate> forward_end_state;
+  BasicBeamSegments<Coordinate> forward_horizontal_segments;
+  BasicBeamSegments<Coordinate> forward_vertical_segments;
+  BasicBeamSegments<Coordinate> backward_horizontal_segments;
+  BasicBeamSegments<Coordinate> backward_vertical_segments;
+};
+
+/// @brief Writes the index of the mirrors and optionally the beam trajectories into a snapshot file
+///
+/// @details The file contains a header with the format version, coordinate width, byte order and checksum,
+/// followed by the flat arrays of the index. All references inside the file are offsets from its beginning,
+/// so the file can be mapped at any address. The file is written under a unique temporary name in the same directory,
+/// synchronized to the storage and renamed afterwards
+///
+/// @param path Path of the snapshot file
+/// @param rows Number of rows in the mechanism grid
+/// @param columns Number of columns in the mechanism grid
+/// @param row_wise_mirrors Index of the mirrors, the lines are rows
+/// @param col_wise_mirrors Index of the mirrors, the lines are columns
+/// @param trajectories Beam trajectories to store, nullptr if the trajectories should not be stored
+///
+/// @throw std::runtime_error if the file can't be written
+template <typename Coordinate>
+void write_snapshot(const std::string& path, Coordinate rows, Coordinate columns,
+                    const BasicMirrorsIndexView<Coordinate>& row_wise_mirrors,
+                    const BasicMirrorsIndexView<Coordinate>& col_wise_mirrors,
+                    const BasicSnapshotTrajectories<Coordinate>* trajectories);
+
+/// @brief Checks whether the file starts with the snapshot signature
+///
+/// @param path Path of the file
+///
+/// @return true if the file looks like a snapshot, false if it is not or can't be read
+bool is_snapshot_file(const std::string& path);
+
+/// @brief Reads the size in bytes of the coordinates used in a snapshot file
+///
+/// @param path Path of the snapshot file
+///
+/// @return The coordinate width
+///
+/// @throw std::runtime_error if the file can't be read or is not a snapshot of a compatible version
+std::size_t read_snapshot_coordinate_width(const std::string& path);
+
+/// @brief Snapshot file mapped into memory
+///
+/// @details The index of the mirrors is used directly from the mapped memory, without reconstruction
+template <typename Coordinate>
+class BasicMappedSnapshot final {
+public:
+  /// @brief Maps the snapshot file into memory and validates it
+  ///
+  /// @param path Path of the snapshot file
+  ///
+  /// @throw std::runtime_error if the file can't be read, was created by an incompatible version,
+  /// for another coordinate width or is corrupted, including the index or the trajectories outside of the grid
+  explicit BasicMappedSnapshot(const std::string& path);
+
+  ~BasicMappedSnapshot();
+
+  BasicMappedSnapshot(const BasicMappedSnapshot&) = delete;
+  BasicMappedSnapshot& operator=(const BasicMappedSnapshot&) = delete;
+
+  Coordinate rows() const { return rows_; }
+  Coordinate columns() const { return columns_; }
+
+  /// @brief Index of the mirrors, the lines are rows
+  const BasicMirrorsIndexView<Coordinate>& row_wise_mirrors() const { return row_wise_mirrors_; }
+  /// @brief Index of the mirrors, the lines are columns
+  const BasicMirrorsIndexView<Coordinate>& col_wise_mirrors() const { return col_wise_mirrors_; }
+
+  /// @brief Returns true if the snapshot contains the beam trajectories
+  bool has_trajectories() const { return has_trajectories_; }
+
+  /// @brief Reads the trajectory of the beam from the laser. Valid only if the snapshot contains the trajectories
+  ///
+  /// @param end_state Output parameter. Final beam state, after which it exits the grid
+  /// @param horizontal_segments Output parameter. List of all horizontal beam segments
+  /// @param vertical_segments Output parameter. List of all vertical beam segments
+  void read_forward_trajectory(BasicBeamState<Coordinate>& end_state,
+                               BasicBeamSegments<Coordinate>& horizontal_segments,
+                               BasicBeamSegments<Coordinate>& vertical_segments) const;
+
+  /// @brief Reads the trajectory of the beam from the detector. Valid only if the snapshot contains the trajectories
+  ///
+  /// @param horizontal_segments Output parameter. List of all horizontal beam segments
+  /// @param vertical_segments Output parameter. List of all vertical beam segments
+  void read_backward_trajectory(BasicBeamSegments<Coordinate>& horizontal_segments,
+                                BasicBeamSegments<Coordinate>& vertical_segments) const;
+
+private:
+  /// @brief Number of the arrays stored in the snapshot file
+  static constexpr std::size_t SECTIONS_COUNT{12U};
+
+  /// @brief Copies segments stored as triples of coordinates
+  void read_segments_(std::size_t section, BasicBeamSegments<Coordinate>& segments) const;
+
+  std::unique_ptr<MappedFile> file_;
+  Coordinate rows_{0U};
+  Coordinate columns_{0U};
+  BasicMirrorsIndexView<Coordinate> row_wise_mirrors_;
+  BasicMirrorsIndexView<Coordinate> col_wise_mirrors_;
+  bool has_trajectories_{false};
+  BasicBeamState<Coordinate> forward_end_state_;
+  /// @brief Pointers to the sections of the file
+  const unsigned char* sections_[SECTIONS_COUNT]{};
+  /// @brief Numbers of elements in the sections of the file
+  std::size_t section_sizes_[SECTIONS_COUNT]{};
+};
+
+extern template void write_snapshot(const std::string&, std::uint16_t, std::uint16_t,
+                                    const BasicMirrorsIndexView<std::uint16_t>&,
+                                    const BasicMirrorsIndexView<std::uint16_t>&,
+                                    const BasicSnapshotTrajectories<std::uint16_t>*);
+extern template void write_snapshot(const std::string&, std::uint32_t, std::uint32_t,
+                                    const BasicMirrorsIndexView<std::uint32_t>&,
+                                    const BasicMirrorsIndexView<std::uint32_t>&,
+                                    const BasicSnapshotTrajectories<std::uint32_t>*);
+extern template void write_snapshot(const std::string&, std::uint64_t, std::uint64_t,
+                                    const BasicMirrorsIndexView<std::uint64_t>&,
+                                    const BasicMirrorsIndexView<std::uint64_t>&,
+                                    const BasicSnapshotTrajectories<std::uint64_t>*);
+
+extern template class BasicMappedSnapshot<std::uint16_t>;
+extern template class BasicMappedSnapshot<std::uint32_t>;
+extern template class BasicMappedSnapshot<std::uint64_t>;
+
+}  // namespace mirrors_lasers
+
+#endif  // CHECKER_SNAPSHOT
@@ -4,20 +4,81 @@
 
 namespace mirrors_lasers {
 
-void IntersectionSearchHelper::add_segment(std::uint32_t start, std::uint32_t end)
+namespace {
+
+/// @brief Returns the index of the first element which is not less than the value. The loop doesn't branch
+/// on the comparisons, so the compiler turns it into conditional moves
+///
+/// @param values Sorted values
+/// @param count Number of the values
+/// @param value The searched value
+template <typename Coordinate>
+std::size_t branchless_lower_bound(const Coordinate* values, std::size_t count, Coordinate value)
+{
+  if (count == 0U) {
+    return 0U;
+  }
+  const Coordinate* base = values;
+  while (count > 1U) {
+    const std::size_t half = count / 2U;
+    base = base[half] < value ? base + half : base;
+    count -= half;
+  }
+  return static_cast<std::size_t>(base - values) + (*base < value ? 1U : 0U);
+}
+
+}  // namespace
+
+template <typename Coordinate>
+bool BasicIntersectionSearchHelper<Coordinate>::has_intersection(Coordinate orthogonal_line_position) const
 {
-  const auto min_max_pair = std::minmax(start, end);
-  segments_map_[min_max_pair.second] = min_max_pair.first;
+  const std::size_t segment_index = branchless_lower_bound(ends_, count_, orthogonal_line_position);
+  return segment_index < count_ && starts_[segment_index] <= orthogonal_line_position;
 }
 
-bool IntersectionSearchHelper::has_intersection(std::uint32_t orthogonal_line_position) const
+template <typename Coordinate>
+BasicIntersectionSearchHelperMap<Coordinate>::BasicIntersectionSearchHelperMap(
+    const BasicBeamSegments<Coordinate>& segments)
 {
-  const auto segment_iter = segments_map_.lower_bound(orthogonal_line_position);
-  if (segment_iter == segments_map_.end()) {
-    return false;
+  // The stable sort keeps the order of the segments sharing the end, so the last one of them can be kept
+  BasicBeamSegments<Coordinate> sorted_segments = segments;
+  std::stable_sort(sorted_segments.begin(), sorted_segments.end(),
+                   [] (const BasicBeamSegment<Coordinate>& first, const BasicBeamSegment<Coordinate>& second) {
+                     return first.first_coordinate != second.first_coordinate
+                         ? first.first_coordinate < second.first_coordinate
+                         : first.second_coordinate_end < second.second_coordinate_end;
+                   });
+
+  starts_.reserve(sorted_segments.size());
+  ends_.reserve(sorted_segments.size());
+  for (std::size_t index = 0U; index < sorted_segments.size(); ++index) {
+    const BasicBeamSegment<Coordinate>& segment = sorted_segments[index];
+    const bool is_new_line = lines_.empty() || lines_.back() != segment.first_coordinate;
+    if (is_new_line) {
+      lines_.push_back(segment.first_coordinate);
+      offsets_.push_back(ends_.size());
+    } else if (ends_.back() == segment.second_coordinate_end) {
+      starts_.back() = segment.second_coordinate_start;
+      continue;
+    }
+    starts_.push_back(segment.second_coordinate_start);
+    ends_.push_back(segment.second_coordinate_end);
   }
-  const std::uint32_t segment_begin = segment_iter->second;
-  return segment_begin <= orthogonal_line_position;
+  offsets_.push_back(ends_.size());
+}
+
+template <typename Coordinate>
+std::size_t BasicIntersectionSearchHelperMap<Coordinate>::lower_bound(Coordinate line) const
+{
+  return branchless_lower_bound(lines_.data(), lines_.size(), line);
 }
 
+template class BasicIntersectionSearchHelper<std::uint16_t>;
+template class BasicIntersectionSearchHelper<std::uint32_t>;
+template class BasicIntersectionSearchHelper<std::uint64_t>;
+
+template class BasicIntersectionSearchHelperMap<std::uint16_t>;
+template class BasicIntersectionSearchHelperMap<std::uint32_t>;
+template class BasicIntersectionSearchHelperMap<std::uint64_t>;
+
 }  // namespace mirrors_lasers
@@ -1,40 +1,115 @@
 #ifndef INTERSECTION_SEARCH_HELPER
 #define INTERSECTION_SEARCH_HELPER
 
+#include "safe_checker.h"
+
+#include <cstddef>
 #include <cstdint>
-#include <map>
+#include <vector>
 
 namespace mirrors_lasers {
 
 /// @brief Class determines with logarithmic complexity whether there is an intersection at
 /// a certain point of a row/column
-class IntersectionSearchHelper final {
+///
+/// @details Doesn't own the memory, it is a view of the segments of a line stored in
+/// BasicIntersectionSearchHelperMap
+///
+/// @tparam Coordinate Unsigned integer type used to store coordinates on the grid
+template <typename Coordinate>
+class BasicIntersectionSearchHelper final {
 public:
-  /// @brief Adds a beam segment to the row/column
+  /// @brief Constructs the view over the segments of a row/column
   ///
-  /// @param start Coordinate of the segment start
-  /// @param end Coordinate of the segment end
-  void add_segment(std::uint32_t start, std::uint32_t end);
+  /// @param starts Beginnings of the segments
+  /// @param ends Ends of the segments, sorted
+  /// @param count Number of the segments
+  BasicIntersectionSearchHelper(const Coordinate* starts, const Coordinate* ends, std::size_t count)
+    : starts_{starts}
+    , ends_{ends}
+    , count_{count}
+  {
+  }
 
   /// @brief Checks whether there is a beam segment in a certain coordinate of the row/column
   ///
+  /// @details The search of the closest segment end is a binary search without branches in the loop,
+  /// its number of steps depends only on the number of the segments
+  ///
   /// @param orthogonal_line_position Coordinate for which the check should be performed
   ///
   /// @return true if there is an intersection with some segment in the requested position
-  bool has_intersection(std::uint32_t orthogonal_line_position) const;
+  bool has_intersection(Coordinate orthogonal_line_position) const;
 
 private:
-  /// @brief Container, containing information about the line segments
-  ///
-  /// @details Ends of the trajectory segments in a given row/column are used as keys, and their beginnings as values
-  std::map<std::uint32_t, std::uint32_t> segments_map_;
+  const Coordinate* starts_;
+  const Coordinate* ends_;
+  std::size_t count_;
 };
 
 /// @brief Data structure used to simplify the complexity of the search of beam segments intersections in the grid
 ///
-/// @details where the key is the number of the row or column, and the values are IntersectionSearchHelper objects
-/// for that row/column
-using IntersectionSearchHelperMap = std::map<std::uint32_t, IntersectionSearchHelper>;
+/// @details Built once from the segments of a trajectory. The segments are sorted by the rows/columns and by their
+/// ends and stored in contiguous arrays: the numbers of the lines, the offsets of the segments of each line,
+/// the beginnings and the ends of the segments. If several segments of a line share the end, the last one is kept
+template <typename Coordinate>
+class BasicIntersectionSearchHelperMap final {
+public:
+  /// @brief Builds the structure
+  ///
+  /// @param segments Segments of a trajectory lying in the rows or in the columns
+  explicit BasicIntersectionSearchHelperMap(const BasicBeamSegments<Coordinate>& segments);
+
+  /// @brief Returns the number of the rows/columns containing segments
+  std::size_t size() const { return lines_.size(); }
+
+  /// @brief Returns the index of the first row/column which is not less than the given one, size() if there is none
+  ///
+  /// @param line Number of the row/column
+  std::size_t lower_bound(Coordinate line) const;
+
+  /// @brief Returns the number of the row/column by its index
+  Coordinate line(std::size_t index) const { return lines_[index]; }
+
+  /// @brief Returns the number of bytes held by the arrays of the structure
+  std::size_t memory_bytes() const
+  {
+    return (lines_.capacity() + starts_.capacity() + ends_.capacity()) * sizeof(Coordinate) +
+           offsets_.capacity() * sizeof(std::size_t);
+  }
+
+  /// @brief Returns the helper of the row/column by its index
+  BasicIntersectionSearchHelper<Coordinate> helper(std::size_t index) const
+  {
+    const std::size_t first = offsets_[index];
+    return BasicIntersectionSearchHelper<Coordinate>{starts_.data() + first, ends_.data() + first,
+                                                     offsets_[index + 1U] - first};
+  }
+
+private:
+  /// @brief Sorted numbers of the rows/columns containing segments
+  std::vector<Coordinate> lines_;
+  /// @brief Segments of the line i are stored in the range [offsets_[i], offsets_[i + 1]) of starts_ and ends_
+  std::vector<std::size_t> offsets_;
+  /// @brief Beginnings of the segments
+  std::vector<Coordinate> starts_;
+  /// @brief Ends of the segments, sorted in each line
+  std::vector<Coordinate> ends_;
+};
+
+/// @brief Intersection search helper for the default 32-bit coordinates
+using IntersectionSearchHelper = BasicIntersectionSearchHelper<std::uint32_t>;
+
+/// @brief Intersection search helper map for the default 32-bit coordinates
+using IntersectionSearchHelperMap = BasicIntersectionSearchHelperMap<std::uint32_t>;
+
+extern template class BasicIntersectionSearchHelper<std::uint16_t>;
+extern template class BasicIntersectionSearchHelper<std::uint32_t>;
+extern template class BasicIntersectionSearchHelper<std::uint64_t>;
+
+extern template class BasicIntersectionSearchHelperMap<std::uint16_t>;
+extern template class BasicIntersectionSearchHelperMap<std::uint32_t>;
+extern template class BasicIntersectionSearchHelperMap<std::uint64_t>;
 
 }  // namespace mirrors_lasers
 
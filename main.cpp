@@ -1,16 +1,22 @@
+#include "batch_runner.h"
+#include "memory_arena.h"
+#include "query_server.h"
+#include "result_writer.h"
 #include "safe_checker.h"
+#include "safe_reader.h"
+#include "trace_recorder.h"
 
-#include <cstdint>
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
-#include <vector>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <thread>
 
 namespace {
 
-constexpr std::int32_t MAX_SIDE{1000000};
-constexpr std::int32_t MAX_MIRRORS{200000};
-
 void print_info()
 {
   std::cout << "First enter number of rows, columns, / mirrors and \\ mirrors (r c m n)" << std::endl;
@@ -26,70 +32,234 @@ void print_info()
                "and (r, c) is the lexicographically smallest such row, column position." << std::endl;
 }
 
-std::vector<mirrors_lasers::Point> input_mirrors(std::int32_t count, std::int32_t r, std::int32_t c)
+/// @brief Mode of the program
+enum class RunMode {
+  /// @brief Single safe is read from the standard input
+  Single,
+  /// @brief Safes are read from the standard input until its end
+  Batch,
+  /// @brief Requests are answered by the query server
+  Server
+};
+
+/// @brief Command line parameters
+struct ProgramOptions final {
+  RunMode mode{RunMode::Single};
+  /// @brief Path of the Unix domain socket of the server, the standard input and output are used if empty
+  std::string socket_path;
+  std::size_t threads_count{std::max(std::thread::hardware_concurrency(), 1U)};
+  std::size_t cache_megabytes{256U};
+  /// @brief Path of the Chrome trace written at exit, tracing is disabled if empty
+  std::string trace_path;
+  std::size_t trace_events_per_thread{1U << 16U};
+  /// @brief Allocation policy of the indexes of the mirrors
+  mirrors_lasers::MemoryPolicy memory_policy{};
+  /// @brief Time limit of the check of a single safe in the batch mode, unlimited if zero
+  std::chrono::milliseconds check_timeout{0};
+  /// @brief Representation of the index of the mirrors in the single and the batch modes
+  mirrors_lasers::MirrorsIndexLayout index_layout{mirrors_lasers::MirrorsIndexLayout::Hashed};
+  /// @brief Memory budget of a checker in the single and the batch modes, unlimited if zero
+  std::size_t checker_memory_megabytes{0U};
+  /// @brief Order of tracing the beams in the single and the batch modes
+  mirrors_lasers::BeamTracingMode tracing_mode{mirrors_lasers::BeamTracingMode::Sequential};
+  /// @brief Maximal number of the cached results of the batch mode, duplicates are not detected if zero
+  std::size_t result_cache_entries{4096U};
+  /// @brief Format of the results in the single and the batch modes
+  mirrors_lasers::OutputOptions output{};
+};
+
+/// @brief Parses the value of the --huge-pages argument
+///
+/// @throw std::invalid_argument if the value is unknown
+mirrors_lasers::HugePagesMode parse_huge_pages_mode(const std::string& value)
 {
-  std::vector<mirrors_lasers::Point> mirrors;
-  mirrors.reserve(static_cast<std::size_t>(count));
-  std::int32_t ri{};
-  std::int32_t ci{};
-  for (std::int32_t i = 0; i < count; ++i) {
-    std::cin >> ri >> ci;
-    if (ri < 1 || ri > r) {
-      throw std::invalid_argument("Incorrect ri value");
-    }
-    if (ci < 1 || ci > c) {
-      throw std::invalid_argument("Incorrect ci value");
-    }
-    mirrors_lasers::Point mirror{static_cast<std::uint32_t>(ri), static_cast<std::uint32_t>(ci)};
-    mirrors.push_back(mirror);
+  if (value == "none") {
+    return mirrors_lasers::HugePagesMode::None;
+  }
+  if (value == "thp") {
+    return mirrors_lasers::HugePagesMode::Transparent;
   }
-  return mirrors;
+  if (value == "hugetlb") {
+    return mirrors_lasers::HugePagesMode::Explicit;
+  }
+  throw std::invalid_argument{"Unknown huge pages mode: " + value};
 }
 
-}  // namespace
+/// @brief Parses the value of the --index argument
+///
+/// @throw std::invalid_argument if the value is unknown
+mirrors_lasers::MirrorsIndexLayout parse_index_layout(const std::string& value)
+{
+  if (value == "hashed") {
+    return mirrors_lasers::MirrorsIndexLayout::Hashed;
+  }
+  if (value == "flat") {
+    return mirrors_lasers::MirrorsIndexLayout::Flat;
+  }
+  throw std::invalid_argument{"Unknown index layout: " + value};
+}
 
-int main()
+/// @brief Parses the value of the --tracing argument
+///
+/// @throw std::invalid_argument if the value is unknown
+mirrors_lasers::BeamTracingMode parse_tracing_mode(const std::string& value)
 {
-  print_info();
-
-  std::int32_t r{};
-  std::int32_t c{};
-  std::int32_t m{};
-  std::int32_t n{};
-  std::cin >> r >> c >> m >> n;
-  if (r < 1 || r > MAX_SIDE) {
-    std::cerr << "Incorrect r value" << std::endl;
-    return EXIT_FAILURE;
+  if (value == "sequential") {
+    return mirrors_lasers::BeamTracingMode::Sequential;
   }
-  if (c < 1 || c > MAX_SIDE) {
-    std::cerr << "Incorrect c value" << std::endl;
-    return EXIT_FAILURE;
+  if (value == "interleaved") {
+    return mirrors_lasers::BeamTracingMode::Interleaved;
   }
-  if (m < 0 || m > MAX_MIRRORS) {
-    std::cerr << "Incorrect m value" << std::endl;
-    return EXIT_FAILURE;
+  throw std::invalid_argument{"Unknown tracing mode: " + value};
+}
+
+/// @brief Parses the value of the --format argument
+///
+/// @throw std::invalid_argument if the value is unknown
+mirrors_lasers::OutputFormat parse_output_format(const std::string& value)
+{
+  if (value == "plain") {
+    return mirrors_lasers::OutputFormat::Plain;
   }
-  if (n < 0 || n > MAX_MIRRORS) {
-    std::cerr << "Incorrect n value" << std::endl;
-    return EXIT_FAILURE;
+  if (value == "csv") {
+    return mirrors_lasers::OutputFormat::Csv;
+  }
+  if (value == "jsonl") {
+    return mirrors_lasers::OutputFormat::JsonLines;
+  }
+  throw std::invalid_argument{"Unknown output format: " + value};
+}
+
+/// @brief Parses the command line arguments
+///
+/// @throw std::invalid_argument if the arguments are incorrect
+ProgramOptions parse_arguments(int argc, char* argv[])
+{
+  ProgramOptions options{};
+  for (int index = 1; index < argc; ++index) {
+    const std::string argument{argv[index]};
+    const bool has_value = index + 1 < argc;
+    if (argument == "--server") {
+      options.mode = RunMode::Server;
+    } else if (argument == "--batch") {
+      options.mode = RunMode::Batch;
+    } else if (argument == "--socket" && has_value) {
+      options.socket_path = argv[++index];
+    } else if (argument == "--threads" && has_value) {
+      options.threads_count = static_cast<std::size_t>(std::stoul(argv[++index]));
+    } else if (argument == "--cache-mb" && has_value) {
+      options.cache_megabytes = static_cast<std::size_t>(std::stoul(argv[++index]));
+    } else if (argument == "--trace" && has_value) {
+      options.trace_path = argv[++index];
+    } else if (argument == "--trace-events" && has_value) {
+      options.trace_events_per_thread = static_cast<std::size_t>(std::stoul(argv[++index]));
+    } else if (argument == "--huge-pages" && has_value) {
+      options.memory_policy.huge_pages = parse_huge_pages_mode(argv[++index]);
+    } else if (argument == "--numa-local") {
+      options.memory_policy.is_numa_local = true;
+    } else if (argument == "--timeout-ms" && has_value) {
+      options.check_timeout = std::chrono::milliseconds{std::stoul(argv[++index])};
+    } else if (argument == "--memory-mb" && has_value) {
+      options.checker_memory_megabytes = static_cast<std::size_t>(std::stoul(argv[++index]));
+    } else if (argument == "--index" && has_value) {
+      options.index_layout = parse_index_layout(argv[++index]);
+    } else if (argument == "--tracing" && has_value) {
+      options.tracing_mode = parse_tracing_mode(argv[++index]);
+    } else if (argument == "--result-cache" && has_value) {
+      options.result_cache_entries = static_cast<std::size_t>(std::stoul(argv[++index]));
+    } else if (argument == "--format" && has_value) {
+      options.output.format = parse_output_format(argv[++index]);
+    } else if (argument == "--case-id") {
+      options.output.with_case_id = true;
+    } else if (argument == "--timing") {
+      options.output.with_timing = true;
+    } else {
+      throw std::invalid_argument{"Unknown argument: " + argument};
+    }
+  }
+  return options;
+}
+
+void run_server_mode(const ProgramOptions& options)
+{
+  mirrors_lasers::QueryServer server{options.cache_megabytes * 1024U * 1024U};
+  if (options.socket_path.empty()) {
+    server.serve_stream(std::cin, std::cout, options.threads_count);
+  } else {
+    server.serve_unix_socket(options.socket_path);
+  }
+}
+
+void run_batch_mode(const ProgramOptions& options)
+{
+  mirrors_lasers::BatchOptions batch_options{};
+  batch_options.threads_count = options.threads_count;
+  batch_options.check_timeout = options.check_timeout;
+  batch_options.index_layout = options.index_layout;
+  batch_options.checker_memory_budget = options.checker_memory_megabytes * 1024U * 1024U;
+  batch_options.tracing_mode = options.tracing_mode;
+  batch_options.output = options.output;
+  if (options.result_cache_entries > 0U) {
+    batch_options.result_cache = std::make_shared<mirrors_lasers::ResultCache>(options.result_cache_entries);
+  }
+  mirrors_lasers::run_batch(std::cin, std::cout, batch_options);
+  if (batch_options.result_cache) {
+    const mirrors_lasers::ResultCacheStats cache_stats = batch_options.result_cache->stats();
+    std::cerr << "Result cache: hits=" << cache_stats.hits << " misses=" << cache_stats.misses
+              << " hit_rate=" << cache_stats.hit_rate() << std::endl;
+  }
+}
+
+void run_single_mode(const ProgramOptions& options)
+{
+  // The hints would break the machine-readable formats
+  if (options.output.format == mirrors_lasers::OutputFormat::Plain) {
+    print_info();
   }
 
-  std::vector<mirrors_lasers::Point> left_to_up_mirrors = input_mirrors(m, r, c);
-  std::vector<mirrors_lasers::Point> left_to_down_mirrors = input_mirrors(n, r, c);
+  const mirrors_lasers::SafeDescription safe = mirrors_lasers::read_safe(std::cin);
+  const std::size_t mirrors_count = safe.left_to_up_mirrors.size() + safe.left_to_down_mirrors.size();
+  const mirrors_lasers::TraceCase trace_case{"1", mirrors_count};
+  const auto start_time = std::chrono::steady_clock::now();
+  mirrors_lasers::SafeChecker checker{safe.rows, safe.columns, safe.left_to_up_mirrors,
+                                      safe.left_to_down_mirrors, options.threads_count,
+                                      options.index_layout, options.checker_memory_megabytes * 1024U * 1024U};
+  checker.set_tracing_mode(options.tracing_mode);
+
+  mirrors_lasers::LimitedCheckResult check_result = checker.check_safe(mirrors_lasers::CheckLimits{});
+  check_result.elapsed = std::chrono::steady_clock::now() - start_time;
+
+  mirrors_lasers::ResultWriter writer{std::cout, options.output};
+  writer.write("1", check_result);
+  writer.flush();
+}
+
+}  // namespace
 
-  const mirrors_lasers::SafeChecker checker{static_cast<std::uint32_t>(r),
-                                            static_cast<std::uint32_t>(c),
-                                            left_to_up_mirrors,
-                                            left_to_down_mirrors};
+int main(int argc, char* argv[])
+{
+  try {
+    const ProgramOptions options = parse_arguments(argc, argv);
+    mirrors_lasers::set_memory_policy(options.memory_policy);
+    if (!options.trace_path.empty()) {
+      mirrors_lasers::TraceRecorder::start(options.trace_events_per_thread);
+    }
 
-  const mirrors_lasers::SafeCheckResult check_result = checker.check_safe();
+    if (options.mode == RunMode::Server) {
+      run_server_mode(options);
+    } else if (options.mode == RunMode::Batch) {
+      run_batch_mode(options);
+    } else {
+      run_single_mode(options);
+    }
 
-  if (check_result.result_type == mirrors_lasers::SafeCheckResultType::OpensWithoutInserting) {
-    std::cout << 0 << std::endl;
-  } else if (check_result.result_type == mirrors_lasers::SafeCheckResultType::CanNotBeOpened) {
-    std::cout << -1 << std::endl;
-  } else if (check_result.result_type == mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion) {
-    std::cout << check_result.positions << " " << check_result.mirror_row << " " << check_result.mirror_col << std::endl;
+    if (!options.trace_path.empty()) {
+      mirrors_lasers::TraceRecorder::stop();
+      mirrors_lasers::TraceRecorder::write_chrome_trace(options.trace_path);
+    }
+  } catch (const std::exception& exception) {
+    std::cerr << exception.what() << std::endl;
+    return EXIT_FAILURE;
   }
 
   return EXIT_SUCCESS;
@@ -0,0 +1,209 @@
+#include "memory_arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#if defined(__linux__)
+#define MIRRORS_LASERS_HAS_MMAP 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define MIRRORS_LASERS_HAS_MMAP 0
+#endif
+
+namespace mirrors_lasers {
+
+namespace {
+
+/// @brief Size of a huge page on x86-64 and of the smallest chunk
+constexpr std::size_t HUGE_PAGE_SIZE{std::size_t{1U} << 21U};
+/// @brief Chunks grow geometrically up to this size, so large indexes don't consist of many small mappings
+constexpr std::size_t MAX_CHUNK_SIZE{std::size_t{1U} << 26U};
+/// @brief Value of MPOL_PREFERRED from linux/mempolicy.h, defined here to avoid the dependency on libnuma
+constexpr int NUMA_POLICY_PREFERRED{1};
+
+std::atomic<HugePagesMode> policy_huge_pages{HugePagesMode::None};
+std::atomic<bool> policy_is_numa_local{false};
+/// @brief Innermost allocation counter of the thread
+thread_local AllocationCounter* current_allocation_counter{nullptr};
+
+std::size_t round_up(std::size_t value, std::size_t alignment)
+{
+  return (value + alignment - 1U) / alignment * alignment;
+}
+
+#if MIRRORS_LASERS_HAS_MMAP
+/// @brief Maps anonymous memory aligned to the huge page size, returns nullptr on failure
+void* map_aligned(std::size_t size)
+{
+  const std::size_t mapped_size = size + HUGE_PAGE_SIZE;
+  void* mapped = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+  // Only aligned huge pages can back the memory, so the unaligned head and the tail are returned
+  const auto address = reinterpret_cast<std::uintptr_t>(mapped);
+  const std::uintptr_t aligned_address = round_up(address, HUGE_PAGE_SIZE);
+  const std::size_t head_size = aligned_address - address;
+  if (head_size != 0U) {
+    ::munmap(mapped, head_size);
+  }
+  const std::size_t tail_size = mapped_size - head_size - size;
+  if (tail_size != 0U) {
+    ::munmap(reinterpret_cast<void*>(aligned_address + size), tail_size);
+  }
+  return reinterpret_cast<void*>(aligned_address);
+}
+
+/// @brief Prefers the NUMA node of the CPU running the current thread for the memory.
+/// Returns false if the node can't be determined or NUMA policies are not supported
+bool bind_to_current_node(void* data, std::size_t size)
+{
+  unsigned cpu{0U};
+  unsigned node{0U};
+  if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return false;
+  }
+  constexpr std::size_t MASK_BITS{sizeof(unsigned long) * 8U};
+  std::vector<unsigned long> node_mask(node / MASK_BITS + 1U, 0UL);
+  node_mask[node / MASK_BITS] = 1UL << (node % MASK_BITS);
+  return ::syscall(SYS_mbind, data, size, NUMA_POLICY_PREFERRED, node_mask.data(),
+                   node_mask.size() * MASK_BITS + 1U, 0U) == 0;
+}
+#endif
+
+}  // namespace
+
+void set_memory_policy(const MemoryPolicy& policy)
+{
+  policy_huge_pages.store(policy.huge_pages, std::memory_order_relaxed);
+  policy_is_numa_local.store(policy.is_numa_local, std::memory_order_relaxed);
+}
+
+MemoryPolicy memory_policy()
+{
+  MemoryPolicy policy{};
+  policy.huge_pages = policy_huge_pages.load(std::memory_order_relaxed);
+  policy.is_numa_local = policy_is_numa_local.load(std::memory_order_relaxed);
+  return policy;
+}
+
+MemoryArena::MemoryArena(const MemoryPolicy& policy)
+  : policy_{policy}
+  , next_chunk_size_{HUGE_PAGE_SIZE}
+{
+}
+
+MemoryArena::~MemoryArena()
+{
+  for (const Chunk& chunk : chunks_) {
+#if MIRRORS_LASERS_HAS_MMAP
+    if (chunk.is_mapped) {
+      ::munmap(chunk.data, chunk.size);
+      continue;
+    }
+#endif
+    ::operator delete(chunk.data);
+  }
+}
+
+void* MemoryArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+  auto address = round_up(reinterpret_cast<std::uintptr_t>(cursor_), alignment);
+  if (cursor_ == nullptr || address + bytes > reinterpret_cast<std::uintptr_t>(end_)) {
+    add_chunk_(bytes + alignment);
+    address = round_up(reinterpret_cast<std::uintptr_t>(cursor_), alignment);
+  }
+  cursor_ = reinterpret_cast<unsigned char*>(address + bytes);
+  return reinterpret_cast<void*>(address);
+}
+
+std::size_t MemoryArena::reserved_bytes() const
+{
+  return reserved_bytes_;
+}
+
+std::size_t MemoryArena::huge_page_bytes() const
+{
+  return huge_page_bytes_;
+}
+
+std::size_t MemoryArena::numa_bound_bytes() const
+{
+  return numa_bound_bytes_;
+}
+
+std::size_t MemoryArena::max_reserved_bytes(std::size_t allocated_bytes, std::size_t arenas_count)
+{
+  if (allocated_bytes == 0U) {
+    return 0U;
+  }
+  // The last chunk of an arena is not larger than a huge page plus either its first allocation or the sum
+  // of the previous chunks. The unused tail of a previous chunk is smaller than the allocation, which didn't fit
+  return 2U * allocated_bytes + 2U * HUGE_PAGE_SIZE * std::max<std::size_t>(arenas_count, 1U);
+}
+
+void MemoryArena::add_chunk_(std::size_t min_size)
+{
+  Chunk chunk{};
+  chunk.size = round_up(std::max(min_size, next_chunk_size_), HUGE_PAGE_SIZE);
+  next_chunk_size_ = std::min(next_chunk_size_ * 2U, MAX_CHUNK_SIZE);
+  chunks_.reserve(chunks_.size() + 1U);
+
+  bool is_huge{false};
+#if MIRRORS_LASERS_HAS_MMAP
+  if (policy_.huge_pages == HugePagesMode::Explicit) {
+    chunk.data = ::mmap(nullptr, chunk.size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (chunk.data == MAP_FAILED) {
+      chunk.data = nullptr;
+    } else {
+      is_huge = true;
+    }
+  }
+  if (chunk.data == nullptr) {
+    chunk.data = map_aligned(chunk.size);
+    if (chunk.data != nullptr && policy_.huge_pages != HugePagesMode::None) {
+      is_huge = ::madvise(chunk.data, chunk.size, MADV_HUGEPAGE) == 0;
+    }
+  }
+  chunk.is_mapped = chunk.data != nullptr;
+  // The policy must be set before the pages are touched, otherwise they are already placed
+  if (chunk.is_mapped && policy_.is_numa_local && bind_to_current_node(chunk.data, chunk.size)) {
+    numa_bound_bytes_ += chunk.size;
+  }
+#endif
+  if (chunk.data == nullptr) {
+    chunk.data = ::operator new(chunk.size);
+  }
+
+  chunks_.push_back(chunk);
+  reserved_bytes_ += chunk.size;
+  if (is_huge) {
+    huge_page_bytes_ += chunk.size;
+  }
+  cursor_ = static_cast<unsigned char*>(chunk.data);
+  end_ = cursor_ + chunk.size;
+}
+
+AllocationCounter::AllocationCounter() noexcept
+  : previous_{current_allocation_counter}
+{
+  current_allocation_counter = this;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+  current_allocation_counter = previous_;
+}
+
+void AllocationCounter::add(std::ptrdiff_t bytes) noexcept
+{
+  if (current_allocation_counter != nullptr) {
+    current_allocation_counter->bytes_ += bytes;
+  }
+}
+
+}  // namespace mirrors_lasers
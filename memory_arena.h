@@ -0,0 +1,210 @@
+#ifndef MEMORY_ARENA
+#define MEMORY_ARENA
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace mirrors_lasers {
+
+/// @brief Kind of the huge pages requested for the memory of the mirror indexes
+enum class HugePagesMode : std::int8_t {
+  /// @brief Regular pages
+  None,
+  /// @brief Transparent huge pages requested with madvise(MADV_HUGEPAGE)
+  Transparent,
+  /// @brief Explicit huge pages from the hugetlbfs pool (MAP_HUGETLB). Transparent ones are used if the pool is empty
+  Explicit
+};
+
+/// @brief Policy of allocation of the memory of the mirror indexes
+struct MemoryPolicy final {
+  HugePagesMode huge_pages{HugePagesMode::None};
+  /// @brief If true, the memory is bound to the NUMA node of the thread building the index
+  bool is_numa_local{false};
+
+  /// @brief Returns true if the indexes are allocated from MemoryArena, false if from the global heap
+  bool uses_arena() const
+  {
+    return huge_pages != HugePagesMode::None || is_numa_local;
+  }
+};
+
+/// @brief Sets the policy used by the checkers constructed after the call
+void set_memory_policy(const MemoryPolicy& policy);
+
+/// @brief Returns the policy used by the newly constructed checkers
+MemoryPolicy memory_policy();
+
+/// @brief Monotonic memory arena allocating from large chunks, which can be backed by huge pages
+/// and bound to a NUMA node
+///
+/// @details The memory is released only when the arena is destroyed. The arena is not thread-safe,
+/// so each thread building an index uses its own arena. If huge pages or NUMA binding are not supported,
+/// regular memory is used
+class MemoryArena final {
+public:
+  /// @brief Constructs the arena. No memory is allocated until the first allocation
+  ///
+  /// @param policy Allocation policy of the chunks
+  explicit MemoryArena(const MemoryPolicy& policy);
+  ~MemoryArena();
+
+  MemoryArena(const MemoryArena&) = delete;
+  MemoryArena& operator=(const MemoryArena&) = delete;
+
+  /// @brief Allocates a block of memory
+  ///
+  /// @param bytes Size of the block
+  /// @param alignment Alignment of the block, a power of two not greater than alignof(std::max_align_t)
+  ///
+  /// @return Pointer to the block
+  ///
+  /// @throw std::bad_alloc if the memory can't be allocated
+  void* allocate(std::size_t bytes, std::size_t alignment);
+
+  /// @brief Returns the total size of the allocated chunks
+  std::size_t reserved_bytes() const;
+
+  /// @brief Returns the total size of the chunks backed by huge pages or advised to be backed by them
+  std::size_t huge_page_bytes() const;
+
+  /// @brief Returns the total size of the chunks bound to a NUMA node
+  std::size_t numa_bound_bytes() const;
+
+  /// @brief Returns an upper bound of the total size of the chunks of new arenas, however the allocations
+  /// are distributed between them
+  ///
+  /// @details The chunks are at least a huge page and double in size up to the largest chunk, and a larger
+  /// allocation takes a chunk of its own. So the chunks of an arena exceed its allocations at most twice,
+  /// plus a huge page for the rounding and the alignment. The sizes of the allocations are assumed to be
+  /// multiples of their alignments
+  ///
+  /// @param allocated_bytes Total size of the allocations from all the arenas
+  /// @param arenas_count Number of the arenas
+  ///
+  /// @return The bytes, 0 if nothing is allocated
+  static std::size_t max_reserved_bytes(std::size_t allocated_bytes, std::size_t arenas_count);
+
+private:
+  /// @brief Block of memory, from which the allocations are made
+  struct Chunk final {
+    void* data{nullptr};
+    std::size_t size{0U};
+    /// @brief True if the chunk is allocated with mmap, false if with operator new
+    bool is_mapped{false};
+  };
+
+  /// @brief Allocates a new chunk not smaller than the given size and makes it current
+  void add_chunk_(std::size_t min_size);
+
+  const MemoryPolicy policy_;
+  std::vector<Chunk> chunks_;
+  unsigned char* cursor_{nullptr};
+  unsigned char* end_{nullptr};
+  std::size_t next_chunk_size_;
+  std::size_t reserved_bytes_{0U};
+  std::size_t huge_page_bytes_{0U};
+  std::size_t numa_bound_bytes_{0U};
+};
+
+/// @brief Counts the bytes allocated and deallocated by ArenaAllocator in the current thread until the end of the scope
+///
+/// @details The counters of a thread are nested, the bytes are added only to the innermost one. The bytes are the sizes
+/// requested by the containers, without the overhead of the heap or the unused space of the arena chunks
+class AllocationCounter final {
+public:
+  AllocationCounter() noexcept;
+  ~AllocationCounter();
+
+  AllocationCounter(const AllocationCounter&) = delete;
+  AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+  /// @brief Returns the allocated bytes minus the deallocated ones. Negative if the memory allocated
+  /// before the scope was released
+  std::ptrdiff_t bytes() const noexcept { return bytes_; }
+
+  /// @brief Adds the bytes to the innermost counter of the current thread, if there is one
+  ///
+  /// @param bytes Allocated bytes, negative for deallocated ones
+  static void add(std::ptrdiff_t bytes) noexcept;
+
+private:
+  AllocationCounter* const previous_;
+  std::ptrdiff_t bytes_{0};
+};
+
+/// @brief Allocator of the containers of the mirror indexes
+///
+/// @details Allocates from a MemoryArena if it is set, otherwise from the global heap.
+/// The arena memory is released only together with the arenas, so the allocators of all arenas are interchangeable:
+/// the nodes of a container can be moved into a container using another arena.
+/// Not final, because std::scoped_allocator_adaptor derives from it
+template <typename T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() noexcept = default;
+
+  /// @brief Constructs the allocator using the arena
+  ///
+  /// @param arena The arena, nullptr to use the global heap
+  explicit ArenaAllocator(MemoryArena* arena) noexcept
+    : arena_{arena}
+  {
+  }
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+    : arena_{other.arena()}
+  {
+  }
+
+  T* allocate(std::size_t count)
+  {
+    AllocationCounter::add(static_cast<std::ptrdiff_t>(count * sizeof(T)));
+    if (arena_ == nullptr) {
+      return std::allocator<T>{}.allocate(count);
+    }
+    return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* pointer, std::size_t count) noexcept
+  {
+    AllocationCounter::add(-static_cast<std::ptrdiff_t>(count * sizeof(T)));
+    if (arena_ == nullptr) {
+      std::allocator<T>{}.deallocate(pointer, count);
+    }
+  }
+
+  /// @brief Returns the arena, nullptr if the global heap is used
+  MemoryArena* arena() const noexcept
+  {
+    return arena_;
+  }
+
+private:
+  MemoryArena* arena_{nullptr};
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& first, const ArenaAllocator<U>& second) noexcept
+{
+  return (first.arena() == nullptr) == (second.arena() == nullptr);
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& first, const ArenaAllocator<U>& second) noexcept
+{
+  return !(first == second);
+}
+
+}  // namespace mirrors_lasers
+
+#endif  // MEMORY_ARENA
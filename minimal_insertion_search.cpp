@@ -0,0 +1,695 @@
+#include "minimal_insertion_search.h"
+#include "mirrors_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace mirrors_lasers {
+
+namespace {
+
+constexpr std::uint32_t NO_INDEX{std::numeric_limits<std::uint32_t>::max()};
+
+/// @brief Index of the runs of all rows or all columns containing mirrors.
+/// Allows extracting all runs crossing a certain position of an orthogonal run, each run is extracted only once
+///
+/// @details Segment tree over the positions along the lines. Each run is placed into the lowest node covering it,
+/// so it crosses the middle of the node. Thus a run of a node on the path to the requested position contains it,
+/// if the run starts before the position (for positions in the left half of the node) or ends after it (for positions
+/// in the right half). Runs of each node are sorted by the line number and are covered by a tree of minimal starts
+/// and maximal ends, which allows finding the matching runs in a range of lines
+template <typename Coordinate>
+class RunStabbingTree final {
+public:
+  /// @brief Adds a run to the index. Must be called before build() in order of the lines
+  ///
+  /// @param line Number of the row/column containing the run
+  /// @param start First cell of the run
+  /// @param end Last cell of the run
+  /// @param run_id Identifier of the run
+  void add_run(Coordinate line, Coordinate start, Coordinate end, std::uint32_t run_id)
+  {
+    pending_runs_.push_back(PendingRun{line, start, end, run_id, 0U});
+  }
+
+  /// @brief Builds the index from the added runs
+  void build()
+  {
+    bounds_.reserve(pending_runs_.size() * 2U);
+    for (const auto& run : pending_runs_) {
+      bounds_.push_back(run.start);
+      bounds_.push_back(run.end);
+    }
+    std::sort(bounds_.begin(), bounds_.end());
+    bounds_.erase(std::unique(bounds_.begin(), bounds_.end()), bounds_.end());
+
+    leaves_count_ = 1U;
+    while (leaves_count_ < bounds_.size()) {
+      leaves_count_ *= 2U;
+    }
+
+    // Find the lowest node covering each run
+    std::vector<std::uint32_t> node_sizes(leaves_count_ * 2U, 0U);
+    for (auto& run : pending_runs_) {
+      std::size_t first_node = to_leaf_(run.start) + leaves_count_;
+      std::size_t last_node = to_leaf_(run.end) + leaves_count_;
+      while (first_node != last_node) {
+        first_node /= 2U;
+        last_node /= 2U;
+      }
+      run.node = first_node;
+      ++node_sizes[first_node];
+    }
+
+    // Nodes without runs are not stored
+    node_indices_.assign(leaves_count_ * 2U, NO_INDEX);
+    std::size_t entries_count{0U};
+    std::size_t tree_size{0U};
+    for (std::size_t node = 1U; node < node_sizes.size(); ++node) {
+      if (node_sizes[node] == 0U) {
+        continue;
+      }
+      node_indices_[node] = static_cast<std::uint32_t>(nodes_.size());
+      NodeRuns node_runs{};
+      node_runs.first_entry = entries_count;
+      node_runs.entries_count = node_sizes[node];
+      node_runs.alive_count = node_sizes[node];
+      node_runs.tree_leaves = 1U;
+      while (node_runs.tree_leaves < node_runs.entries_count) {
+        node_runs.tree_leaves *= 2U;
+      }
+      node_runs.first_tree_node = tree_size;
+      nodes_.push_back(node_runs);
+      entries_count += node_runs.entries_count;
+      tree_size += node_runs.tree_leaves * 2U;
+    }
+
+    entry_lines_.resize(entries_count);
+    entry_runs_.resize(entries_count);
+    min_starts_.assign(tree_size, std::numeric_limits<Coordinate>::max());
+    max_ends_.assign(tree_size, Coordinate{0U});
+    std::vector<std::size_t> fill_positions(nodes_.size(), 0U);
+    for (const auto& run : pending_runs_) {
+      const std::uint32_t node_index = node_indices_[run.node];
+      const NodeRuns& node_runs = nodes_[node_index];
+      const std::size_t position = fill_positions[node_index]++;
+      entry_lines_[node_runs.first_entry + position] = run.line;
+      entry_runs_[node_runs.first_entry + position] = run.run_id;
+      min_starts_[node_runs.first_tree_node + node_runs.tree_leaves + position] = run.start;
+      max_ends_[node_runs.first_tree_node + node_runs.tree_leaves + position] = run.end;
+    }
+    for (const auto& node_runs : nodes_) {
+      for (std::size_t tree_node = node_runs.tree_leaves - 1U; tree_node > 0U; --tree_node) {
+        update_tree_node_(node_runs.first_tree_node, tree_node);
+      }
+    }
+    pending_runs_.clear();
+    pending_runs_.shrink_to_fit();
+  }
+
+  /// @brief Extracts all runs containing the position, which lines are in the given range
+  ///
+  /// @param position Position along the lines
+  /// @param first_line First line of the range
+  /// @param last_line Last line of the range
+  /// @param visitor Function called with identifiers of the extracted runs
+  template <typename Visitor>
+  void extract(Coordinate position, Coordinate first_line, Coordinate last_line, Visitor&& visitor)
+  {
+    if (bounds_.empty() || position < bounds_.front()) {
+      return;
+    }
+    std::size_t child{0U};
+    for (std::size_t node = to_leaf_(position) + leaves_count_; node > 0U; child = node, node /= 2U) {
+      const std::uint32_t node_index = node_indices_[node];
+      if (node_index == NO_INDEX || nodes_[node_index].alive_count == 0U) {
+        continue;
+      }
+      NodeRuns& node_runs = nodes_[node_index];
+      const auto node_lines_begin = entry_lines_.begin() + static_cast<std::ptrdiff_t>(node_runs.first_entry);
+      const auto node_lines_end = node_lines_begin + static_cast<std::ptrdiff_t>(node_runs.entries_count);
+      const auto first_entry = static_cast<std::size_t>(
+          std::lower_bound(node_lines_begin, node_lines_end, first_line) - node_lines_begin);
+      const auto last_entry = static_cast<std::size_t>(
+          std::upper_bound(node_lines_begin, node_lines_end, last_line) - node_lines_begin);
+      // A leaf corresponds to a bound and to the gap after it, so only the end of its runs is checked
+      const bool check_start = child != 0U && child == node * 2U;
+      collect_(node_runs, 1U, 0U, node_runs.tree_leaves, first_entry, last_entry, position, check_start, visitor);
+    }
+  }
+
+  /// @brief Returns sorted unique bounds of all the runs. Positions between two adjacent bounds are contained
+  /// in the same runs
+  const std::vector<Coordinate>& bounds() const { return bounds_; }
+
+private:
+  /// @brief Run waiting for the index construction
+  struct PendingRun final {
+    Coordinate line;
+    Coordinate start;
+    Coordinate end;
+    std::uint32_t run_id;
+    /// @brief Lowest node covering the run
+    std::size_t node;
+  };
+
+  /// @brief Runs placed into a segment tree node
+  struct NodeRuns final {
+    std::size_t first_entry;
+    std::size_t entries_count;
+    std::size_t alive_count;
+    /// @brief Offset of the tree of minimal starts and maximal ends of the node runs
+    std::size_t first_tree_node;
+    std::size_t tree_leaves;
+  };
+
+  /// @brief Converts a position into the index of a leaf: the last bound not greater than the position
+  std::size_t to_leaf_(Coordinate position) const
+  {
+    const auto bound_iter = std::upper_bound(bounds_.begin(), bounds_.end(), position);
+    return static_cast<std::size_t>(bound_iter - bounds_.begin()) - 1U;
+  }
+
+  void update_tree_node_(std::size_t first_tree_node, std::size_t tree_node)
+  {
+    const std::size_t index = first_tree_node + tree_node;
+    const std::size_t left = first_tree_node + tree_node * 2U;
+    min_starts_[index] = std::min(min_starts_[left], min_starts_[left + 1U]);
+    max_ends_[index] = std::max(max_ends_[left], max_ends_[left + 1U]);
+  }
+
+  template <typename Visitor>
+  void collect_(NodeRuns& node_runs, std::size_t tree_node, std::size_t range_begin, std::size_t range_end,
+                std::size_t first_entry, std::size_t last_entry, Coordinate position, bool check_start,
+                Visitor& visitor)
+  {
+    if (range_end <= first_entry || last_entry <= range_begin) {
+      return;
+    }
+    const std::size_t index = node_runs.first_tree_node + tree_node;
+    if (check_start ? min_starts_[index] > position : max_ends_[index] < position) {
+      return;
+    }
+    if (range_end - range_begin == 1U) {
+      const std::size_t entry = node_runs.first_entry + range_begin;
+      if (entry_runs_[entry] == NO_INDEX) {
+        return;
+      }
+      visitor(entry_runs_[entry]);
+      entry_runs_[entry] = NO_INDEX;
+      --node_runs.alive_count;
+      min_starts_[index] = std::numeric_limits<Coordinate>::max();
+      max_ends_[index] = Coordinate{0U};
+      for (std::size_t parent = tree_node / 2U; parent > 0U; parent /= 2U) {
+        update_tree_node_(node_runs.first_tree_node, parent);
+      }
+      return;
+    }
+    const std::size_t middle = (range_begin + range_end) / 2U;
+    collect_(node_runs, tree_node * 2U, range_begin, middle, first_entry, last_entry, position, check_start, visitor);
+    collect_(node_runs, tree_node * 2U + 1U, middle, range_end, first_entry, last_entry, position, check_start,
+             visitor);
+  }
+
+  std::vector<PendingRun> pending_runs_;
+  /// @brief Sorted unique bounds of all the runs
+  std::vector<Coordinate> bounds_;
+  /// @brief Number of leaves of the segment tree, a power of two
+  std::size_t leaves_count_{0U};
+  /// @brief Index in nodes_ of each segment tree node, NO_INDEX for nodes without runs
+  std::vector<std::uint32_t> node_indices_;
+  std::vector<NodeRuns> nodes_;
+  /// @brief Line numbers of the runs of all nodes
+  std::vector<Coordinate> entry_lines_;
+  /// @brief Identifiers of the runs of all nodes, NO_INDEX for extracted runs
+  std::vector<std::uint32_t> entry_runs_;
+  /// @brief Trees of minimal starts of the runs of all nodes
+  std::vector<Coordinate> min_starts_;
+  /// @brief Trees of maximal ends of the runs of all nodes
+  std::vector<Coordinate> max_ends_;
+};
+
+/// @brief Implementation of the 0-1 breadth-first search over runs
+template <typename Coordinate>
+class MinimalInsertionSearch final {
+public:
+  template <typename MirrorsIndex>
+  MinimalInsertionSearch(Coordinate rows, Coordinate columns,
+                         const MirrorsIndex& row_wise_mirrors, const MirrorsIndex& col_wise_mirrors)
+    : rows_{rows}
+  {
+    init_lines_(rows_index_, true, rows, columns, row_wise_mirrors);
+    init_lines_(cols_index_, false, columns, rows, col_wise_mirrors);
+  }
+
+  BasicMinimalInsertionResult<Coordinate> run()
+  {
+    BasicMinimalInsertionResult<Coordinate> result{};
+
+    // The beam enters the first cell of the first row from the left
+    std::uint32_t start_run{NO_INDEX};
+    const auto line_iter = rows_index_.line_indices.find(START_POSITION);
+    if (line_iter != rows_index_.line_indices.end()) {
+      start_run = rows_index_.first_runs[line_iter->second];
+    } else {
+      take_free_lines_(rows_index_, START_POSITION, START_POSITION,
+                       [&start_run] (std::uint32_t run) { start_run = run; });
+    }
+    relax_(state_id_(start_run, true), 0U, NO_INDEX, false, Coordinate{0U});
+
+    while (!queue_.empty()) {
+      const std::uint32_t state = queue_.front();
+      queue_.pop_front();
+      if (states_[state].is_settled) {
+        continue;
+      }
+      // States are taken in order of their distances, so no shorter path to the exit can appear
+      if (goal_state_ != NO_INDEX && states_[state].distance >= states_[goal_state_].distance) {
+        break;
+      }
+      states_[state].is_settled = true;
+      follow_the_beam_(state);
+      turn_the_beam_(state);
+    }
+
+    if (goal_state_ != NO_INDEX) {
+      const std::uint32_t insertions = states_[goal_state_].distance;
+      result.result_type = insertions == 0U ? SafeCheckResultType::OpensWithoutInserting
+                                            : SafeCheckResultType::RequiresMirrorInsertion;
+      result.insertions = insertions;
+      result.placements = restore_placements_(goal_state_);
+      return result;
+    }
+
+    result.result_type = SafeCheckResultType::CanNotBeOpened;
+    return result;
+  }
+
+private:
+  static constexpr Coordinate START_POSITION{1U};
+
+  /// @brief Maximal segment of a row or column without mirrors. Can contain no cells if two mirrors are adjacent
+  struct Run final {
+    /// @brief Row number if the run is horizontal or column number if the run is vertical
+    Coordinate line;
+    /// @brief First cell of the run. Valid if the run has cells
+    Coordinate start;
+    /// @brief Last cell of the run. Valid if the run has cells
+    Coordinate end;
+    /// @brief Index of the line in the LinesIndex, NO_INDEX for lines without mirrors
+    std::uint32_t line_index;
+    /// @brief Index of the run in the line. Run with index i lies between mirrors i - 1 and i
+    std::uint32_t index_in_line;
+    bool is_horizontal;
+    bool has_cells;
+    /// @brief The run was already taken as a target of turns
+    bool is_extracted;
+    /// @brief Turns from the run were already processed
+    bool is_turned_from;
+  };
+
+  /// @brief State of the search: a run passed by the beam in a certain direction
+  struct State final {
+    std::uint32_t distance{NO_INDEX};
+    /// @brief Previous state on the shortest path
+    std::uint32_t parent{NO_INDEX};
+    /// @brief Position along the line of the run, where the beam entered it, if a mirror was inserted there
+    Coordinate entry{0U};
+    /// @brief True if a mirror was inserted to get from the parent state
+    bool is_inserted{false};
+    bool is_settled{false};
+  };
+
+  /// @brief All rows or all columns of the grid
+  struct LinesIndex final {
+    /// @brief Number of cells in each line
+    Coordinate length{0U};
+    bool is_horizontal{false};
+    /// @brief Index of each line containing mirrors
+    std::unordered_map<Coordinate, std::uint32_t> line_indices;
+    /// @brief Offsets of the mirrors of each line containing mirrors
+    std::vector<std::size_t> mirror_offsets;
+    /// @brief Positions of the mirrors in their lines
+    std::vector<Coordinate> mirror_positions;
+    /// @brief Orientations of the mirrors
+    std::vector<MirrorOrientation> mirror_orientations;
+    /// @brief Identifier of the first run of each line containing mirrors
+    std::vector<std::uint32_t> first_runs;
+    /// @brief Ranges of lines without mirrors which were not taken as a target of turns yet
+    std::map<Coordinate, Coordinate> free_empty_lines;
+    /// @brief Index of the runs of lines with mirrors which have cells
+    RunStabbingTree<Coordinate> runs_tree;
+  };
+
+  template <typename MirrorsIndex>
+  void init_lines_(LinesIndex& lines, bool is_horizontal, Coordinate lines_count, Coordinate length,
+                   const MirrorsIndex& mirrors)
+  {
+    lines.length = length;
+    lines.is_horizontal = is_horizontal;
+
+    std::vector<Coordinate> keys;
+    lines.mirror_offsets.push_back(0U);
+    for_each_mirror(mirrors, [&lines, &keys] (Coordinate line, Coordinate position, MirrorOrientation orientation) {
+      if (keys.empty() || keys.back() != line) {
+        if (!keys.empty()) {
+          lines.mirror_offsets.push_back(lines.mirror_positions.size());
+        }
+        keys.push_back(line);
+      }
+      lines.mirror_positions.push_back(position);
+      lines.mirror_orientations.push_back(orientation);
+    });
+    if (!keys.empty()) {
+      lines.mirror_offsets.push_back(lines.mirror_positions.size());
+    }
+
+    lines.line_indices.reserve(keys.size());
+    lines.first_runs.reserve(keys.size());
+    for (std::size_t line_index = 0U; line_index < keys.size(); ++line_index) {
+      const Coordinate key = keys[line_index];
+      lines.line_indices.emplace(key, static_cast<std::uint32_t>(line_index));
+      lines.first_runs.push_back(static_cast<std::uint32_t>(runs_.size()));
+      const std::size_t first_mirror = lines.mirror_offsets[line_index];
+
+      // Line with k mirrors has k + 1 runs
+      const std::size_t mirrors_count = lines.mirror_offsets[line_index + 1U] - first_mirror;
+      for (std::size_t index = 0U; index <= mirrors_count; ++index) {
+        Run run{};
+        run.line = key;
+        run.line_index = static_cast<std::uint32_t>(line_index);
+        run.index_in_line = static_cast<std::uint32_t>(index);
+        run.is_horizontal = is_horizontal;
+        const bool has_previous = index > 0U;
+        const bool has_next = index < mirrors_count;
+        const Coordinate previous = has_previous ? lines.mirror_positions[first_mirror + index - 1U] : Coordinate{0U};
+        const Coordinate next = has_next ? lines.mirror_positions[first_mirror + index] : length;
+        if (!has_previous) {
+          run.has_cells = has_next ? next > START_POSITION : true;
+          run.start = START_POSITION;
+        } else {
+          run.has_cells = has_next ? static_cast<Coordinate>(next - previous) > 1U : previous < length;
+          run.start = static_cast<Coordinate>(previous + (run.has_cells ? 1U : 0U));
+        }
+        run.end = has_next && run.has_cells ? static_cast<Coordinate>(next - 1U) : next;
+        add_run_(run);
+        if (run.has_cells) {
+          lines.runs_tree.add_run(run.line, run.start, run.end, static_cast<std::uint32_t>(runs_.size() - 1U));
+        }
+      }
+    }
+    lines.runs_tree.build();
+
+    // Ranges of lines without mirrors
+    Coordinate next_free{START_POSITION};
+    bool has_free{true};
+    for (const Coordinate key : keys) {
+      if (key > next_free) {
+        lines.free_empty_lines.emplace(next_free, static_cast<Coordinate>(key - 1U));
+      }
+      if (key == std::numeric_limits<Coordinate>::max()) {
+        has_free = false;
+      } else {
+        next_free = static_cast<Coordinate>(key + 1U);
+      }
+    }
+    if (has_free && next_free <= lines_count) {
+      lines.free_empty_lines.emplace(next_free, lines_count);
+    }
+  }
+
+  void add_run_(const Run& run)
+  {
+    if (runs_.size() >= NO_INDEX / 2U) {
+      throw std::length_error{"Too many mirror-free segments in the grid"};
+    }
+    runs_.push_back(run);
+    states_.emplace_back();
+    states_.emplace_back();
+  }
+
+  static std::uint32_t state_id_(std::uint32_t run, bool is_positive)
+  {
+    return run * 2U + (is_positive ? 1U : 0U);
+  }
+
+  /// @brief Takes the lines without mirrors from the range, which were not reached yet, and creates runs for them
+  ///
+  /// @details Empty lines are grouped, so that all lines of a group cross the same orthogonal runs with mirrors.
+  /// Each group is represented by a single run of one of its lines. Thus the number of created runs depends only
+  /// on the number of mirrors
+  template <typename Visitor>
+  void take_free_lines_(LinesIndex& lines, Coordinate first_line, Coordinate last_line, Visitor&& visitor)
+  {
+    const LinesIndex& orthogonal_lines = lines.is_horizontal ? cols_index_ : rows_index_;
+    const std::vector<Coordinate>& bounds = orthogonal_lines.runs_tree.bounds();
+
+    auto& free_lines = lines.free_empty_lines;
+    auto range_iter = free_lines.upper_bound(first_line);
+    if (range_iter != free_lines.begin() && std::prev(range_iter)->second >= first_line) {
+      --range_iter;
+    }
+    while (range_iter != free_lines.end() && range_iter->first <= last_line) {
+      const Coordinate range_first = range_iter->first;
+      const Coordinate range_last = range_iter->second;
+      range_iter = free_lines.erase(range_iter);
+      if (range_first < first_line) {
+        free_lines.emplace(range_first, static_cast<Coordinate>(first_line - 1U));
+      }
+      if (range_last > last_line) {
+        range_iter = free_lines.emplace(static_cast<Coordinate>(last_line + 1U), range_last).first;
+      }
+
+      // Each bound forms a group, and the lines between two adjacent bounds form another one
+      Coordinate group_first = std::max(range_first, first_line);
+      const Coordinate group_limit = std::min(range_last, last_line);
+      while (true) {
+        const auto bound_iter = std::lower_bound(bounds.begin(), bounds.end(), group_first);
+        Coordinate group_last = group_limit;
+        if (bound_iter != bounds.end() && *bound_iter == group_first) {
+          group_last = group_first;
+        } else if (bound_iter != bounds.end() && *bound_iter <= group_limit) {
+          group_last = static_cast<Coordinate>(*bound_iter - 1U);
+        }
+        visitor(add_empty_lines_run_(lines, group_first, group_last));
+        if (group_last == group_limit) {
+          break;
+        }
+        group_first = static_cast<Coordinate>(group_last + 1U);
+      }
+    }
+  }
+
+  /// @brief Creates a run representing a group of lines without mirrors
+  std::uint32_t add_empty_lines_run_(const LinesIndex& lines, Coordinate first_line, Coordinate last_line)
+  {
+    Run run{};
+    // The last row is preferred, since the beam can leave the grid through the detector only by it
+    const bool has_last_row = lines.is_horizontal && first_line <= rows_ && rows_ <= last_line;
+    run.line = has_last_row ? rows_ : first_line;
+    run.start = START_POSITION;
+    run.end = lines.length;
+    run.line_index = NO_INDEX;
+    run.index_in_line = 0U;
+    run.is_horizontal = lines.is_horizontal;
+    run.has_cells = true;
+    add_run_(run);
+    return static_cast<std::uint32_t>(runs_.size() - 1U);
+  }
+
+  void relax_(std::uint32_t state, std::uint32_t distance, std::uint32_t parent, bool is_inserted, Coordinate entry)
+  {
+    State& target = states_[state];
+    if (target.is_settled || target.distance <= distance) {
+      return;
+    }
+    target.distance = distance;
+    target.parent = parent;
+    target.is_inserted = is_inserted;
+    target.entry = entry;
+    if (is_goal_(state)) {
+      goal_state_ = state;
+    }
+    if (is_inserted) {
+      queue_.push_back(state);
+    } else {
+      queue_.push_front(state);
+    }
+  }
+
+  bool is_goal_(std::uint32_t state) const
+  {
+    const Run& run = runs_[state / 2U];
+    const bool is_positive = state % 2U == 1U;
+    return run.is_horizontal && is_positive && run.line == rows_ && is_last_run_(run);
+  }
+
+  bool is_last_run_(const Run& run) const
+  {
+    if (run.line_index == NO_INDEX) {
+      return true;
+    }
+    const LinesIndex& lines = run.is_horizontal ? rows_index_ : cols_index_;
+    const std::size_t mirrors_count =
+        lines.mirror_offsets[run.line_index + 1U] - lines.mirror_offsets[run.line_index];
+    return run.index_in_line == mirrors_count;
+  }
+
+  /// @brief Moves the beam along the run to the next mirror and reflects it
+  void follow_the_beam_(std::uint32_t state)
+  {
+    const Run run = runs_[state / 2U];
+    const bool is_positive = state % 2U == 1U;
+    if (run.line_index == NO_INDEX) {
+      return;  // The beam exits the grid
+    }
+    const LinesIndex& lines = run.is_horizontal ? rows_index_ : cols_index_;
+    const std::size_t first_mirror = lines.mirror_offsets[run.line_index];
+    const std::size_t mirrors_count = lines.mirror_offsets[run.line_index + 1U] - first_mirror;
+    std::size_t mirror_index{0U};
+    if (is_positive) {
+      if (run.index_in_line == mirrors_count) {
+        return;  // The beam exits the grid
+      }
+      mirror_index = first_mirror + run.index_in_line;
+    } else {
+      if (run.index_in_line == 0U) {
+        return;  // The beam exits the grid
+      }
+      mirror_index = first_mirror + run.index_in_line - 1U;
+    }
+
+    const Coordinate mirror_position = lines.mirror_positions[mirror_index];
+    const MirrorOrientation mirror = lines.mirror_orientations[mirror_index];
+    const bool next_is_positive = mirror == MirrorOrientation::LeftToDown ? is_positive : !is_positive;
+
+    const LinesIndex& orthogonal_lines = run.is_horizontal ? cols_index_ : rows_index_;
+    const std::uint32_t orthogonal_line_index = orthogonal_lines.line_indices.at(mirror_position);
+    const auto orthogonal_first = orthogonal_lines.mirror_positions.begin() +
+        static_cast<std::ptrdiff_t>(orthogonal_lines.mirror_offsets[orthogonal_line_index]);
+    const auto orthogonal_last = orthogonal_lines.mirror_positions.begin() +
+        static_cast<std::ptrdiff_t>(orthogonal_lines.mirror_offsets[orthogonal_line_index + 1U]);
+    const auto index_in_orthogonal_line =
+        static_cast<std::uint32_t>(std::lower_bound(orthogonal_first, orthogonal_last, run.line) - orthogonal_first);
+    const std::uint32_t next_run = orthogonal_lines.first_runs[orthogonal_line_index] + index_in_orthogonal_line +
+        (next_is_positive ? 1U : 0U);
+    relax_(state_id_(next_run, next_is_positive), states_[state].distance, state, false, Coordinate{0U});
+  }
+
+  /// @brief Inserts a mirror in a cell of the run, turning the beam to all orthogonal runs crossing it
+  void turn_the_beam_(std::uint32_t state)
+  {
+    const std::uint32_t run_id = state / 2U;
+    if (!runs_[run_id].has_cells || runs_[run_id].is_turned_from) {
+      return;
+    }
+    runs_[run_id].is_turned_from = true;
+    const Run run = runs_[run_id];
+    const std::uint32_t distance = states_[state].distance + 1U;
+    // Both directions of the target run are reached with the same number of insertions,
+    // so all its cells are reachable, not only the ones after the inserted mirror
+    auto turn_to = [this, state, distance, &run] (std::uint32_t target_run) {
+      if (runs_[target_run].is_extracted) {
+        return;
+      }
+      runs_[target_run].is_extracted = true;
+      relax_(state_id_(target_run, true), distance, state, true, run.line);
+      relax_(state_id_(target_run, false), distance, state, true, run.line);
+    };
+
+    LinesIndex& orthogonal_lines = run.is_horizontal ? cols_index_ : rows_index_;
+    orthogonal_lines.runs_tree.extract(run.line, run.start, run.end, turn_to);
+
+    take_free_lines_(orthogonal_lines, run.start, run.end, turn_to);
+  }
+
+  std::vector<BasicMirrorPlacement<Coordinate>> restore_placements_(std::uint32_t state) const
+  {
+    std::vector<BasicMirrorPlacement<Coordinate>> placements;
+    while (states_[state].parent != NO_INDEX) {
+      std::uint32_t parent = states_[state].parent;
+      if (states_[state].is_inserted) {
+        // If the parent run was entered through an inserted mirror, the beam passes only the cells after it.
+        // Otherwise the opposite direction of the parent run has the same distance and passes the required cell
+        const Coordinate turn_position = runs_[state / 2U].line;
+        const State& parent_state = states_[parent];
+        const bool is_parent_positive = parent % 2U == 1U;
+        if (parent_state.is_inserted &&
+            (is_parent_positive ? turn_position < parent_state.entry : turn_position > parent_state.entry)) {
+          parent ^= 1U;
+        }
+        const Run& run = runs_[state / 2U];
+        const Run& parent_run = runs_[parent / 2U];
+        BasicMirrorPlacement<Coordinate> placement{};
+        placement.position.row = parent_run.is_horizontal ? parent_run.line : run.line;
+        placement.position.col = parent_run.is_horizontal ? run.line : parent_run.line;
+        // Mirror "\\" keeps the sign of the direction, mirror "/" changes it
+        placement.orientation = (state % 2U) == (parent % 2U) ? MirrorOrientation::LeftToDown
+                                                              : MirrorOrientation::LeftToUp;
+        placements.push_back(placement);
+      }
+      state = parent;
+    }
+    std::reverse(placements.begin(), placements.end());
+    return placements;
+  }
+
+  Coordinate rows_;
+  LinesIndex rows_index_;
+  LinesIndex cols_index_;
+  std::vector<Run> runs_;
+  std::vector<State> states_;
+  std::deque<std::uint32_t> queue_;
+  /// @brief State leaving the grid through the detector with the minimal known distance
+  std::uint32_t goal_state_{NO_INDEX};
+};
+
+template <typename Coordinate>
+constexpr Coordinate MinimalInsertionSearch<Coordinate>::START_POSITION;
+
+}  // namespace
+
+template <typename Coordinate, typename MirrorsIndex>
+BasicMinimalInsertionResult<Coordinate> find_minimal_insertions(Coordinate rows, Coordinate columns,
+                                                                const MirrorsIndex& row_wise_mirrors,
+                                                                const MirrorsIndex& col_wise_mirrors)
+{
+  MinimalInsertionSearch<Coordinate> search{rows, columns, row_wise_mirrors, col_wise_mirrors};
+  return search.run();
+}
+
+template BasicMinimalInsertionResult<std::uint16_t>
+find_minimal_insertions(std::uint16_t, std::uint16_t,
+                        const BasicMirrorsField<std::uint16_t>&, const BasicMirrorsField<std::uint16_t>&);
+template BasicMinimalInsertionResult<std::uint32_t>
+find_minimal_insertions(std::uint32_t, std::uint32_t,
+                        const BasicMirrorsField<std::uint32_t>&, const BasicMirrorsField<std::uint32_t>&);
+template BasicMinimalInsertionResult<std::uint64_t>
+find_minimal_insertions(std::uint64_t, std::uint64_t,
+                        const BasicMirrorsField<std::uint64_t>&, const BasicMirrorsField<std::uint64_t>&);
+template BasicMinimalInsertionResult<std::uint16_t>
+find_minimal_insertions(std::uint16_t, std::uint16_t,
+                        const BasicMirrorsIndexView<std::uint16_t>&, const BasicMirrorsIndexView<std::uint16_t>&);
+template BasicMinimalInsertionResult<std::uint32_t>
+find_minimal_insertions(std::uint32_t, std::uint32_t,
+                        const BasicMirrorsIndexView<std::uint32_t>&, const BasicMirrorsIndexView<std::uint32_t>&);
+template BasicMinimalInsertionResult<std::uint64_t>
+find_minimal_insertions(std::uint64_t, std::uint64_t,
+                        const BasicMirrorsIndexView<std::uint64_t>&, const BasicMirrorsIndexView<std::uint64_t>&);
+template BasicMinimalInsertionResult<std::uint16_t>
+find_minimal_insertions(std::uint16_t, std::uint16_t,
+                        const BasicMirrorsOverlay<std::uint16_t>&, const BasicMirrorsOverlay<std::uint16_t>&);
+template BasicMinimalInsertionResult<std::uint32_t>
+find_minimal_insertions(std::uint32_t, std::uint32_t,
+                        const BasicMirrorsOverlay<std::uint32_t>&, const BasicMirrorsOverlay<std::uint32_t>&);
+template BasicMinimalInsertionResult<std::uint64_t>
+find_minimal_insertions(std::uint64_t, std::uint64_t,
+                        const BasicMirrorsOverlay<std::uint64_t>&, const BasicMirrorsOverlay<std::uint64_t>&);
+
+}  // namespace mirrors_lasers
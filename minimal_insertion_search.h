@@ -0,0 +1,62 @@
+#ifndef MINIMAL_INSERTION_SEARCH
+#define MINIMAL_INSERTION_SEARCH
+
+#include "mirrors_index.h"
+#include "safe_checker.h"
+
+#include <cstdint>
+
+namespace mirrors_lasers {
+
+/// @brief Finds the minimal number of mirrors which must be inserted to open the safe
+///
+/// @details Performs a 0-1 breadth-first search over the maximal mirror-free segments ("runs") of rows and columns.
+/// Moving along a run and reflecting from an existing mirror is free, turning at an empty cell of a run to any
+/// orthogonal run crossing it costs one insertion. The runs crossing a given one are extracted from a segment tree,
+/// so that each run is taken from it only once, and rows/columns without mirrors are grouped by the runs they cross.
+/// Thus the complexity depends on the number of mirrors, but not on the grid area.
+/// The witness placement assumes that the beam doesn't pass through a cell of an inserted mirror twice.
+///
+/// @param rows Number of rows in the mechanism grid
+/// @param columns Number of columns in the mechanism grid
+/// @param row_wise_mirrors Index of the mirrors, the lines are rows (BasicMirrorsField, BasicMirrorsIndexView
+/// or BasicMirrorsOverlay)
+/// @param col_wise_mirrors Index of the mirrors, the lines are columns
+///
+/// @return The minimal number of insertions and the positions and orientations of the inserted mirrors
+template <typename Coordinate, typename MirrorsIndex>
+BasicMinimalInsertionResult<Coordinate> find_minimal_insertions(Coordinate rows, Coordinate columns,
+                                                                const MirrorsIndex& row_wise_mirrors,
+                                                                const MirrorsIndex& col_wise_mirrors);
+
+extern template BasicMinimalInsertionResult<std::uint16_t>
+find_minimal_insertions(std::uint16_t, std::uint16_t,
+                        const BasicMirrorsField<std::uint16_t>&, const BasicMirrorsField<std::uint16_t>&);
+extern template BasicMinimalInsertionResult<std::uint32_t>
+find_minimal_insertions(std::uint32_t, std::uint32_t,
+                        const BasicMirrorsField<std::uint32_t>&, const BasicMirrorsField<std::uint32_t>&);
+extern template BasicMinimalInsertionResult<std::uint64_t>
+find_minimal_insertions(std::uint64_t, std::uint64_t,
+                        const BasicMirrorsField<std::uint64_t>&, const BasicMirrorsField<std::uint64_t>&);
+extern template BasicMinimalInsertionResult<std::uint16_t>
+find_minimal_insertions(std::uint16_t, std::uint16_t,
+                        const BasicMirrorsIndexView<std::uint16_t>&, const BasicMirrorsIndexView<std::uint16_t>&);
+extern template BasicMinimalInsertionResult<std::uint32_t>
+find_minimal_insertions(std::uint32_t, std::uint32_t,
+                        const BasicMirrorsIndexView<std::uint32_t>&, const BasicMirrorsIndexView<std::uint32_t>&);
+extern template BasicMinimalInsertionResult<std::uint64_t>
+find_minimal_insertions(std::uint64_t, std::uint64_t,
+                        const BasicMirrorsIndexView<std::uint64_t>&, const BasicMirrorsIndexView<std::uint64_t>&);
+extern template BasicMinimalInsertionResult<std::uint16_t>
+find_minimal_insertions(std::uint16_t, std::uint16_t,
+                        const BasicMirrorsOverlay<std::uint16_t>&, const BasicMirrorsOverlay<std::uint16_t>&);
+extern template BasicMinimalInsertionResult<std::uint32_t>
+find_minimal_insertions(std::uint32_t, std::uint32_t,
+                        const BasicMirrorsOverlay<std::uint32_t>&, const BasicMirrorsOverlay<std::uint32_t>&);
+extern template BasicMinimalInsertionResult<std::uint64_t>
+find_minimal_insertions(std::uint64_t, std::uint64_t,
+                        const BasicMirrorsOverlay<std::uint64_t>&, const BasicMirrorsOverlay<std::uint64_t>&);
+
+}  // namespace mirrors_lasers
+
+#endif  // MINIMAL_INSERTION_SEARCH
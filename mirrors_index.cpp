@@ -0,0 +1,301 @@
+#include "mirrors_index.h"
+
+#include <array>
+#include <numeric>
+
+namespace mirrors_lasers {
+
+namespace {
+
+/// @brief Stably sorts the indexes of the mirrors by the keys, one byte of the keys per pass
+///
+/// @param order Indexes of the mirrors, sorted on return
+/// @param keys Keys of the mirrors
+/// @param buffer Temporary storage of the size of order
+template <typename Coordinate>
+void radix_sort_indexes(std::vector<std::size_t>& order, const std::vector<Coordinate>& keys,
+                        std::vector<std::size_t>& buffer)
+{
+  constexpr std::size_t DIGIT_BITS{8U};
+  constexpr std::size_t DIGITS_COUNT{std::size_t{1U} << DIGIT_BITS};
+  const auto max_key = static_cast<std::uint64_t>(keys.empty() ? 0U : *std::max_element(keys.begin(), keys.end()));
+  for (std::size_t shift = 0U; shift < sizeof(Coordinate) * 8U && (max_key >> shift) != 0U; shift += DIGIT_BITS) {
+    std::array<std::size_t, DIGITS_COUNT + 1U> offsets{};
+    for (const std::size_t index : order) {
+      ++offsets[((static_cast<std::uint64_t>(keys[index]) >> shift) & (DIGITS_COUNT - 1U)) + 1U];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    for (const std::size_t index : order) {
+      buffer[offsets[(static_cast<std::uint64_t>(keys[index]) >> shift) & (DIGITS_COUNT - 1U)]++] = index;
+    }
+    order.swap(buffer);
+  }
+}
+
+}  // namespace
+
+template <typename Coordinate>
+bool find_mirror(const BasicMirrorsField<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                 MirrorOrientation& orientation)
+{
+  const auto line_iter = mirrors.find(line);
+  if (line_iter == mirrors.end()) {
+    return false;
+  }
+  const auto& mirrors_line = line_iter->second;
+  const auto mirror_iter = mirrors_line.find(position);
+  if (mirror_iter == mirrors_line.end()) {
+    return false;
+  }
+  orientation = mirror_iter->second;
+  return true;
+}
+
+template <typename Coordinate>
+bool find_mirror(const BasicMirrorsIndexView<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                 MirrorOrientation& orientation)
+{
+  const Coordinate* const lines_end = mirrors.lines() + mirrors.lines_count();
+  const Coordinate* const line_iter = std::lower_bound(mirrors.lines(), lines_end, line);
+  if (line_iter == lines_end || *line_iter != line) {
+    return false;
+  }
+  const auto line_index = static_cast<std::size_t>(line_iter - mirrors.lines());
+  const Coordinate* const first = mirrors.positions() + mirrors.offsets()[line_index];
+  const Coordinate* const last = mirrors.positions() + mirrors.offsets()[line_index + 1U];
+  const Coordinate* const mirror_iter = std::lower_bound(first, last, position);
+  if (mirror_iter == last || *mirror_iter != position) {
+    return false;
+  }
+  orientation = mirrors.orientations()[mirror_iter - mirrors.positions()];
+  return true;
+}
+
+template <typename Coordinate>
+bool find_next_mirror(const BasicMirrorsField<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                      bool is_positive, Coordinate& mirror_position, MirrorOrientation& orientation)
+{
+  const auto line_iter = mirrors.find(line);
+  if (line_iter == mirrors.end()) {
+    return false;
+  }
+  const auto& mirrors_line = line_iter->second;
+  auto closest_mirror_iter = mirrors_line.end();
+  if (is_positive) {
+    closest_mirror_iter = mirrors_line.upper_bound(position);
+  } else {
+    closest_mirror_iter = mirrors_line.lower_bound(position);
+    if (closest_mirror_iter == mirrors_line.begin()) {
+      return false;
+    }
+    --closest_mirror_iter;
+  }
+  if (closest_mirror_iter == mirrors_line.end()) {
+    return false;
+  }
+  mirror_position = closest_mirror_iter->first;
+  orientation = closest_mirror_iter->second;
+  return true;
+}
+
+template <typename Coordinate>
+bool find_next_mirror(const BasicMirrorsIndexView<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                      bool is_positive, Coordinate& mirror_position, MirrorOrientation& orientation)
+{
+  const Coordinate* const lines_end = mirrors.lines() + mirrors.lines_count();
+  const Coordinate* const line_iter = std::lower_bound(mirrors.lines(), lines_end, line);
+  if (line_iter == lines_end || *line_iter != line) {
+    return false;
+  }
+  const auto line_index = static_cast<std::size_t>(line_iter - mirrors.lines());
+  const Coordinate* const first = mirrors.positions() + mirrors.offsets()[line_index];
+  const Coordinate* const last = mirrors.positions() + mirrors.offsets()[line_index + 1U];
+  const Coordinate* closest_mirror_iter = nullptr;
+  if (is_positive) {
+    closest_mirror_iter = std::upper_bound(first, last, position);
+    if (closest_mirror_iter == last) {
+      return false;
+    }
+  } else {
+    closest_mirror_iter = std::lower_bound(first, last, position);
+    if (closest_mirror_iter == first) {
+      return false;
+    }
+    --closest_mirror_iter;
+  }
+  mirror_position = *closest_mirror_iter;
+  orientation = mirrors.orientations()[closest_mirror_iter - mirrors.positions()];
+  return true;
+}
+
+template <typename Coordinate>
+BasicFlatMirrors<Coordinate> build_flat_mirrors(const std::vector<Coordinate>& lines,
+                                                const std::vector<Coordinate>& positions,
+                                                const std::vector<MirrorOrientation>& orientations)
+{
+  // The least significant key is sorted first, the stable passes by the lines keep the order of the positions
+  std::vector<std::size_t> order(lines.size());
+  std::iota(order.begin(), order.end(), std::size_t{0U});
+  std::vector<std::size_t> buffer(lines.size());
+  radix_sort_indexes(order, positions, buffer);
+  radix_sort_indexes(order, lines, buffer);
+
+  BasicFlatMirrors<Coordinate> result;
+  result.positions.reserve(order.size());
+  result.orientations.reserve(order.size());
+  result.offsets.push_back(0U);
+  for (std::size_t sorted_index = 0U; sorted_index < order.size(); ++sorted_index) {
+    const std::size_t index = order[sorted_index];
+    // Of the mirrors in the same position, the last one in the input order is the last one after the stable sort
+    if (sorted_index + 1U < order.size() && lines[order[sorted_index + 1U]] == lines[index] &&
+        positions[order[sorted_index + 1U]] == positions[index]) {
+      continue;
+    }
+    if (result.lines.empty() || result.lines.back() != lines[index]) {
+      if (!result.lines.empty()) {
+        result.offsets.push_back(result.positions.size());
+      }
+      result.lines.push_back(lines[index]);
+    }
+    result.positions.push_back(positions[index]);
+    result.orientations.push_back(orientations[index]);
+  }
+  if (!result.lines.empty()) {
+    result.offsets.push_back(result.positions.size());
+  }
+  return result;
+}
+
+template <typename Coordinate>
+bool find_mirror(const BasicMirrorsOverlay<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                 MirrorOrientation& orientation)
+{
+  const auto changes_iter = mirrors.changes().find(line);
+  if (changes_iter != mirrors.changes().end()) {
+    const auto change_iter = changes_iter->second.find(position);
+    if (change_iter != changes_iter->second.end()) {
+      orientation = change_iter->second.orientation;
+      return change_iter->second.is_present;
+    }
+  }
+  if (mirrors.base_field() != nullptr) {
+    return find_mirror(*mirrors.base_field(), line, position, orientation);
+  }
+  return find_mirror(mirrors.base_view(), line, position, orientation);
+}
+
+template <typename Coordinate>
+bool find_next_mirror(const BasicMirrorsOverlay<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                      bool is_positive, Coordinate& mirror_position, MirrorOrientation& orientation)
+{
+  auto find_next_base_mirror = [&mirrors, line, is_positive] (Coordinate start_position, Coordinate& base_position,
+                                                               MirrorOrientation& base_orientation) {
+    if (mirrors.base_field() != nullptr) {
+      return find_next_mirror(*mirrors.base_field(), line, start_position, is_positive, base_position,
+                              base_orientation);
+    }
+    return find_next_mirror(mirrors.base_view(), line, start_position, is_positive, base_position, base_orientation);
+  };
+  const auto changes_iter = mirrors.changes().find(line);
+  if (changes_iter == mirrors.changes().end()) {
+    return find_next_base_mirror(position, mirror_position, orientation);
+  }
+  const std::map<Coordinate, MirrorOverride>& changes = changes_iter->second;
+
+  // The closest mirror added by the changes
+  auto changed_mirror_iter = changes.end();
+  if (is_positive) {
+    for (auto change_iter = changes.upper_bound(position); change_iter != changes.end(); ++change_iter) {
+      if (change_iter->second.is_present) {
+        changed_mirror_iter = change_iter;
+        break;
+      }
+    }
+  } else {
+    for (auto change_iter = changes.lower_bound(position); change_iter != changes.begin();) {
+      --change_iter;
+      if (change_iter->second.is_present) {
+        changed_mirror_iter = change_iter;
+        break;
+      }
+    }
+  }
+  const bool has_changed_mirror = changed_mirror_iter != changes.end();
+  auto is_before_changed_mirror = [&] (Coordinate base_position) {
+    return !has_changed_mirror ||
+           (is_positive ? base_position < changed_mirror_iter->first : base_position > changed_mirror_iter->first);
+  };
+
+  // The closest mirror of the base in an unchanged position, which is closer than the changed mirror
+  Coordinate base_position{position};
+  MirrorOrientation base_orientation{};
+  while (find_next_base_mirror(base_position, base_position, base_orientation) &&
+         is_before_changed_mirror(base_position)) {
+    if (changes.find(base_position) == changes.end()) {
+      mirror_position = base_position;
+      orientation = base_orientation;
+      return true;
+    }
+  }
+  if (has_changed_mirror) {
+    mirror_position = changed_mirror_iter->first;
+    orientation = changed_mirror_iter->second.orientation;
+  }
+  return has_changed_mirror;
+}
+
+template class BasicMirrorsIndexView<std::uint16_t>;
+template class BasicMirrorsIndexView<std::uint32_t>;
+template class BasicMirrorsIndexView<std::uint64_t>;
+
+template BasicFlatMirrors<std::uint16_t> build_flat_mirrors(const std::vector<std::uint16_t>&,
+                                                           const std::vector<std::uint16_t>&,
+                                                           const std::vector<MirrorOrientation>&);
+template BasicFlatMirrors<std::uint32_t> build_flat_mirrors(const std::vector<std::uint32_t>&,
+                                                           const std::vector<std::uint32_t>&,
+                                                           const std::vector<MirrorOrientation>&);
+template BasicFlatMirrors<std::uint64_t> build_flat_mirrors(const std::vector<std::uint64_t>&,
+                                                           const std::vector<std::uint64_t>&,
+                                                           const std::vector<MirrorOrientation>&);
+
+template class BasicMirrorsOverlay<std::uint16_t>;
+template class BasicMirrorsOverlay<std::uint32_t>;
+template class BasicMirrorsOverlay<std::uint64_t>;
+
+template bool find_mirror(const BasicMirrorsField<std::uint16_t>&, std::uint16_t, std::uint16_t, MirrorOrientation&);
+template bool find_mirror(const BasicMirrorsField<std::uint32_t>&, std::uint32_t, std::uint32_t, MirrorOrientation&);
+template bool find_mirror(const BasicMirrorsField<std::uint64_t>&, std::uint64_t, std::uint64_t, MirrorOrientation&);
+template bool find_mirror(const BasicMirrorsIndexView<std::uint16_t>&, std::uint16_t, std::uint16_t,
+                          MirrorOrientation&);
+template bool find_mirror(const BasicMirrorsIndexView<std::uint32_t>&, std::uint32_t, std::uint32_t,
+                          MirrorOrientation&);
+template bool find_mirror(const BasicMirrorsIndexView<std::uint64_t>&, std::uint64_t, std::uint64_t,
+                          MirrorOrientation&);
+
+template bool find_mirror(const BasicMirrorsOverlay<std::uint16_t>&, std::uint16_t, std::uint16_t,
+                          MirrorOrientation&);
+template bool find_mirror(const BasicMirrorsOverlay<std::uint32_t>&, std::uint32_t, std::uint32_t,
+                          MirrorOrientation&);
+template bool find_mirror(const BasicMirrorsOverlay<std::uint64_t>&, std::uint64_t, std::uint64_t,
+                          MirrorOrientation&);
+
+template bool find_next_mirror(const BasicMirrorsField<std::uint16_t>&, std::uint16_t, std::uint16_t, bool,
+                               std::uint16_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsField<std::uint32_t>&, std::uint32_t, std::uint32_t, bool,
+                               std::uint32_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsField<std::uint64_t>&, std::uint64_t, std::uint64_t, bool,
+                               std::uint64_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsIndexView<std::uint16_t>&, std::uint16_t, std::uint16_t, bool,
+                               std::uint16_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsIndexView<std::uint32_t>&, std::uint32_t, std::uint32_t, bool,
+                               std::uint32_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsIndexView<std::uint64_t>&, std::uint64_t, std::uint64_t, bool,
+                               std::uint64_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsOverlay<std::uint16_t>&, std::uint16_t, std::uint16_t, bool,
+                               std::uint16_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsOverlay<std::uint32_t>&, std::uint32_t, std::uint32_t, bool,
+                               std::uint32_t&, MirrorOrientation&);
+template bool find_next_mirror(const BasicMirrorsOverlay<std::uint64_t>&, std::uint64_t, std::uint64_t, bool,
+                               std::uint64_t&, MirrorOrientation&);
+
+}  // namespace mirrors_lasers
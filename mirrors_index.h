@@ -0,0 +1,423 @@
+#ifndef MIRRORS_INDEX
+#define MIRRORS_INDEX
+
+#include "safe_checker.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MIRRORS_LASERS_HAS_PREFETCH 1
+#else
+#define MIRRORS_LASERS_HAS_PREFETCH 0
+#endif
+
+namespace mirrors_lasers {
+
+/// @brief Read-only index of the mirrors grouped by rows or columns, stored in contiguous arrays
+///
+/// @details Doesn't own the memory, so it can be placed over a memory-mapped file. The lines are sorted,
+/// mirrors of the line i are stored in the range [offsets[i], offsets[i + 1]) of the positions and orientations
+/// arrays and are sorted by position
+template <typename Coordinate>
+class BasicMirrorsIndexView final {
+public:
+  BasicMirrorsIndexView() = default;
+
+  /// @brief Constructs the view over the arrays
+  ///
+  /// @param lines Sorted numbers of the lines containing mirrors
+  /// @param offsets Offsets of the mirrors of each line, contains lines_count + 1 elements
+  /// @param lines_count Number of the lines containing mirrors
+  /// @param positions Positions of the mirrors in their lines
+  /// @param orientations Orientations of the mirrors
+  BasicMirrorsIndexView(const Coordinate* lines, const std::uint64_t* offsets, std::size_t lines_count,
+                        const Coordinate* positions, const MirrorOrientation* orientations)
+    : lines_{lines}
+    , offsets_{offsets}
+    , lines_count_{lines_count}
+    , positions_{positions}
+    , orientations_{orientations}
+  {
+  }
+
+  /// @brief Returns the number of the lines containing mirrors
+  std::size_t lines_count() const { return lines_count_; }
+
+  /// @brief Returns the number of the mirrors
+  std::size_t mirrors_count() const
+  {
+    return lines_count_ == 0U ? 0U : static_cast<std::size_t>(offsets_[lines_count_]);
+  }
+
+  const Coordinate* lines() const { return lines_; }
+  const std::uint64_t* offsets() const { return offsets_; }
+  const Coordinate* positions() const { return positions_; }
+  const MirrorOrientation* orientations() const { return orientations_; }
+
+private:
+  const Coordinate* lines_{nullptr};
+  const std::uint64_t* offsets_{nullptr};
+  std::size_t lines_count_{0U};
+  const Coordinate* positions_{nullptr};
+  const MirrorOrientation* orientations_{nullptr};
+};
+
+/// @brief Flat index of the mirrors owning its arrays
+template <typename Coordinate>
+struct BasicFlatMirrors final {
+  std::vector<Coordinate> lines;
+  std::vector<std::uint64_t> offsets;
+  std::vector<Coordinate> positions;
+  std::vector<MirrorOrientation> orientations;
+
+  /// @brief Returns the read-only view over the arrays
+  BasicMirrorsIndexView<Coordinate> view() const
+  {
+    return BasicMirrorsIndexView<Coordinate>{lines.data(), offsets.data(), lines.size(),
+                                             positions.data(), orientations.data()};
+  }
+
+  /// @brief Returns the number of bytes held by the arrays
+  std::size_t memory_bytes() const
+  {
+    return (lines.capacity() + positions.capacity()) * sizeof(Coordinate) +
+           offsets.capacity() * sizeof(std::uint64_t) + orientations.capacity() * sizeof(MirrorOrientation);
+  }
+};
+
+/// @brief Builds the flat index of the mirrors by a stable radix sort of the mirrors by the lines and the positions
+///
+/// @details The sort takes a pass over the mirrors for each significant byte of the maximal line and position,
+/// so the time is linear in the number of the mirrors. If several mirrors share a position, the last one is kept
+///
+/// @param lines Line of each mirror
+/// @param positions Position of each mirror in its line
+/// @param orientations Orientation of each mirror
+///
+/// @return Flat index of the mirrors
+template <typename Coordinate>
+BasicFlatMirrors<Coordinate> build_flat_mirrors(const std::vector<Coordinate>& lines,
+                                                const std::vector<Coordinate>& positions,
+                                                const std::vector<MirrorOrientation>& orientations);
+
+/// @brief Index of the mirrors of a variant of a safe: the changes over a shared base index
+///
+/// @details Doesn't own the base index and the changes. The base is a BasicMirrorsField or a BasicMirrorsIndexView
+template <typename Coordinate>
+class BasicMirrorsOverlay final {
+public:
+  /// @brief Constructs the overlay over a field
+  ///
+  /// @param base Index of the mirrors of the base safe
+  /// @param changes Changes of the variant grouped by the same lines as the base
+  BasicMirrorsOverlay(const BasicMirrorsField<Coordinate>& base, const BasicMirrorsDelta<Coordinate>& changes)
+    : base_field_{&base}
+    , changes_{&changes}
+  {
+  }
+
+  /// @brief Constructs the overlay over a flat index
+  ///
+  /// @param base Index of the mirrors of the base safe
+  /// @param changes Changes of the variant grouped by the same lines as the base
+  BasicMirrorsOverlay(const BasicMirrorsIndexView<Coordinate>& base, const BasicMirrorsDelta<Coordinate>& changes)
+    : base_view_{base}
+    , changes_{&changes}
+  {
+  }
+
+  /// @brief Returns the base field, nullptr if the base is a flat index
+  const BasicMirrorsField<Coordinate>* base_field() const { return base_field_; }
+  /// @brief Returns the base flat index, valid if base_field() is nullptr
+  const BasicMirrorsIndexView<Coordinate>& base_view() const { return base_view_; }
+  const BasicMirrorsDelta<Coordinate>& changes() const { return *changes_; }
+
+private:
+  const BasicMirrorsField<Coordinate>* base_field_{nullptr};
+  BasicMirrorsIndexView<Coordinate> base_view_{};
+  const BasicMirrorsDelta<Coordinate>* changes_{nullptr};
+};
+
+/// @brief Looks for a mirror in a certain position of a line
+///
+/// @param mirrors Index of the mirrors
+/// @param line Number of the row/column
+/// @param position Position in the row/column
+/// @param orientation Output parameter. Orientation of the found mirror
+///
+/// @return true if there is a mirror in the position
+template <typename Coordinate>
+bool find_mirror(const BasicMirrorsField<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                 MirrorOrientation& orientation);
+
+/// @copydoc find_mirror(const BasicMirrorsField<Coordinate>&, Coordinate, Coordinate, MirrorOrientation&)
+template <typename Coordinate>
+bool find_mirror(const BasicMirrorsIndexView<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                 MirrorOrientation& orientation);
+
+/// @copydoc find_mirror(const BasicMirrorsField<Coordinate>&, Coordinate, Coordinate, MirrorOrientation&)
+template <typename Coordinate>
+bool find_mirror(const BasicMirrorsOverlay<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                 MirrorOrientation& orientation);
+
+/// @brief Looks for the closest mirror of a line in the given direction, not including the start position
+///
+/// @param mirrors Index of the mirrors
+/// @param line Number of the row/column
+/// @param position Position in the row/column from which the search starts
+/// @param is_positive Direction of the search. true means the direction of increasing positions
+/// @param mirror_position Output parameter. Position of the found mirror
+/// @param orientation Output parameter. Orientation of the found mirror
+///
+/// @return true if the mirror was found
+template <typename Coordinate>
+bool find_next_mirror(const BasicMirrorsField<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                      bool is_positive, Coordinate& mirror_position, MirrorOrientation& orientation);
+
+/// @brief Looks for the closest mirror of a line in the given direction in the flat index. See the overload
+/// for BasicMirrorsField
+template <typename Coordinate>
+bool find_next_mirror(const BasicMirrorsIndexView<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                      bool is_positive, Coordinate& mirror_position, MirrorOrientation& orientation);
+
+/// @brief Looks for the closest mirror of a line in the given direction in a variant. The mirrors of the base
+/// in the changed positions are skipped, so the search takes at most the number of the changes of the line
+/// additional lookups. See the overload for BasicMirrorsField
+template <typename Coordinate>
+bool find_next_mirror(const BasicMirrorsOverlay<Coordinate>& mirrors, Coordinate line, Coordinate position,
+                      bool is_positive, Coordinate& mirror_position, MirrorOrientation& orientation);
+
+/// @brief Hints the processor to load the memory at the address into the cache. Doesn't wait for the load
+inline void prefetch_address(const void* address)
+{
+#if MIRRORS_LASERS_HAS_PREFETCH
+  __builtin_prefetch(address);
+#else
+  static_cast<void>(address);
+#endif
+}
+
+/// @brief Starts loading the data of a line, which is going to be searched, into the cache
+///
+/// @details Only the first node of the bucket of the line is prefetched, the tree of the line is reached through it
+///
+/// @param mirrors Index of the mirrors
+/// @param line Number of the row/column
+template <typename Coordinate>
+void prefetch_line(const BasicMirrorsField<Coordinate>& mirrors, Coordinate line)
+{
+  const std::size_t bucket = mirrors.bucket(line);
+  const auto line_iter = mirrors.begin(bucket);
+  if (line_iter != mirrors.end(bucket)) {
+    prefetch_address(&*line_iter);
+  }
+}
+
+/// @brief Starts loading the data of a line, which is going to be searched, into the cache
+///
+/// @details The line is found in the array of the lines and the middle of its positions, where the search
+/// in the line starts, is prefetched
+///
+/// @param mirrors Index of the mirrors
+/// @param line Number of the row/column
+template <typename Coordinate>
+void prefetch_line(const BasicMirrorsIndexView<Coordinate>& mirrors, Coordinate line)
+{
+  const Coordinate* const lines_end = mirrors.lines() + mirrors.lines_count();
+  const Coordinate* const line_iter = std::lower_bound(mirrors.lines(), lines_end, line);
+  if (line_iter == lines_end || *line_iter != line) {
+    return;
+  }
+  const auto line_index = static_cast<std::size_t>(line_iter - mirrors.lines());
+  const std::uint64_t first = mirrors.offsets()[line_index];
+  const std::uint64_t last = mirrors.offsets()[line_index + 1U];
+  prefetch_address(mirrors.positions() + first + (last - first) / 2U);
+}
+
+/// @brief Starts loading the data of a line of the base index, which is going to be searched, into the cache.
+/// The changes are few and are not prefetched
+///
+/// @param mirrors Index of the mirrors
+/// @param line Number of the row/column
+template <typename Coordinate>
+void prefetch_line(const BasicMirrorsOverlay<Coordinate>& mirrors, Coordinate line)
+{
+  if (mirrors.base_field() != nullptr) {
+    prefetch_line(*mirrors.base_field(), line);
+  } else {
+    prefetch_line(mirrors.base_view(), line);
+  }
+}
+
+/// @brief Calls the visitor for each mirror in order of the lines and positions
+///
+/// @param mirrors Index of the mirrors
+/// @param visitor Function called with the line number, position and orientation of each mirror
+template <typename Coordinate, typename Visitor>
+void for_each_mirror(const BasicMirrorsField<Coordinate>& mirrors, Visitor&& visitor)
+{
+  std::vector<Coordinate> lines;
+  lines.reserve(mirrors.size());
+  for (const auto& mirrors_line : mirrors) {
+    lines.push_back(mirrors_line.first);
+  }
+  std::sort(lines.begin(), lines.end());
+  for (const Coordinate line : lines) {
+    for (const auto& mirror : mirrors.at(line)) {
+      visitor(line, mirror.first, mirror.second);
+    }
+  }
+}
+
+/// @copydoc for_each_mirror(const BasicMirrorsField<Coordinate>&, Visitor&&)
+template <typename Coordinate, typename Visitor>
+void for_each_mirror(const BasicMirrorsIndexView<Coordinate>& mirrors, Visitor&& visitor)
+{
+  for (std::size_t line_index = 0U; line_index < mirrors.lines_count(); ++line_index) {
+    const Coordinate line = mirrors.lines()[line_index];
+    const auto first_mirror = static_cast<std::size_t>(mirrors.offsets()[line_index]);
+    const auto last_mirror = static_cast<std::size_t>(mirrors.offsets()[line_index + 1U]);
+    for (std::size_t mirror = first_mirror; mirror < last_mirror; ++mirror) {
+      visitor(line, mirrors.positions()[mirror], mirrors.orientations()[mirror]);
+    }
+  }
+}
+
+/// @copydoc for_each_mirror(const BasicMirrorsField<Coordinate>&, Visitor&&)
+template <typename Coordinate, typename Visitor>
+void for_each_mirror(const BasicMirrorsOverlay<Coordinate>& mirrors, Visitor&& visitor)
+{
+  struct Change final {
+    Coordinate line;
+    Coordinate position;
+    MirrorOverride state;
+  };
+  std::vector<Change> changes;
+  for (const auto& changes_line : mirrors.changes()) {
+    for (const auto& change : changes_line.second) {
+      changes.push_back(Change{changes_line.first, change.first, change.second});
+    }
+  }
+  std::sort(changes.begin(), changes.end(), [] (const Change& first, const Change& second) {
+    return first.line != second.line ? first.line < second.line : first.position < second.position;
+  });
+
+  // The changes are merged into the ordered sequence of the mirrors of the base
+  auto change_iter = changes.cbegin();
+  auto visit_changes_before = [&changes, &change_iter, &visitor] (Coordinate line, Coordinate position) {
+    for (; change_iter != changes.cend() &&
+           (change_iter->line < line || (change_iter->line == line && change_iter->position < position));
+         ++change_iter) {
+      if (change_iter->state.is_present) {
+        visitor(change_iter->line, change_iter->position, change_iter->state.orientation);
+      }
+    }
+  };
+  auto visit_base_mirror = [&] (Coordinate line, Coordinate position, MirrorOrientation orientation) {
+    visit_changes_before(line, position);
+    // The changed mirror is visited with the following changes
+    if (change_iter == changes.cend() || change_iter->line != line || change_iter->position != position) {
+      visitor(line, position, orientation);
+    }
+  };
+  if (mirrors.base_field() != nullptr) {
+    for_each_mirror(*mirrors.base_field(), visit_base_mirror);
+  } else {
+    for_each_mirror(mirrors.base_view(), visit_base_mirror);
+  }
+  for (; change_iter != changes.cend(); ++change_iter) {
+    if (change_iter->state.is_present) {
+      visitor(change_iter->line, change_iter->position, change_iter->state.orientation);
+    }
+  }
+}
+
+/// @brief Copies the mirrors of an index into flat arrays
+///
+/// @param mirrors Index of the mirrors
+///
+/// @return Flat index containing the same mirrors
+template <typename Coordinate, typename MirrorsIndex>
+BasicFlatMirrors<Coordinate> flatten_mirrors(const MirrorsIndex& mirrors)
+{
+  BasicFlatMirrors<Coordinate> result;
+  result.offsets.push_back(0U);
+  for_each_mirror(mirrors, [&result] (Coordinate line, Coordinate position, MirrorOrientation orientation) {
+    if (result.lines.empty() || result.lines.back() != line) {
+      if (!result.lines.empty()) {
+        result.offsets.push_back(result.positions.size());
+      }
+      result.lines.push_back(line);
+    }
+    result.positions.push_back(position);
+    result.orientations.push_back(orientation);
+  });
+  if (!result.lines.empty()) {
+    result.offsets.push_back(result.positions.size());
+  }
+  return result;
+}
+
+extern template class BasicMirrorsIndexView<std::uint16_t>;
+extern template class BasicMirrorsIndexView<std::uint32_t>;
+extern template class BasicMirrorsIndexView<std::uint64_t>;
+
+extern template BasicFlatMirrors<std::uint16_t> build_flat_mirrors(const std::vector<std::uint16_t>&,
+                                                                  const std::vector<std::uint16_t>&,
+                                                                  const std::vector<MirrorOrientation>&);
+extern template BasicFlatMirrors<std::uint32_t> build_flat_mirrors(const std::vector<std::uint32_t>&,
+                                                                  const std::vector<std::uint32_t>&,
+                                                                  const std::vector<MirrorOrientation>&);
+extern template BasicFlatMirrors<std::uint64_t> build_flat_mirrors(const std::vector<std::uint64_t>&,
+                                                                  const std::vector<std::uint64_t>&,
+                                                                  const std::vector<MirrorOrientation>&);
+
+extern template class BasicMirrorsOverlay<std::uint16_t>;
+extern template class BasicMirrorsOverlay<std::uint32_t>;
+extern template class BasicMirrorsOverlay<std::uint64_t>;
+
+extern template bool find_mirror(const BasicMirrorsField<std::uint16_t>&, std::uint16_t, std::uint16_t,
+                                 MirrorOrientation&);
+extern template bool find_mirror(const BasicMirrorsField<std::uint32_t>&, std::uint32_t, std::uint32_t,
+                                 MirrorOrientation&);
+extern template bool find_mirror(const BasicMirrorsField<std::uint64_t>&, std::uint64_t, std::uint64_t,
+                                 MirrorOrientation&);
+extern template bool find_mirror(const BasicMirrorsIndexView<std::uint16_t>&, std::uint16_t, std::uint16_t,
+                                 MirrorOrientation&);
+extern template bool find_mirror(const BasicMirrorsIndexView<std::uint32_t>&, std::uint32_t, std::uint32_t,
+                                 MirrorOrientation&);
+extern template bool find_mirror(const BasicMirrorsIndexView<std::uint64_t>&, std::uint64_t, std::uint64_t,
+                                 MirrorOrientation&);
+
+extern template bool find_mirror(const BasicMirrorsOverlay<std::uint16_t>&, std::uint16_t, std::uint16_t,
+                                 MirrorOrientation&);
+extern template bool find_mirror(const BasicMirrorsOverlay<std::uint32_t>&, std::uint32_t, std::uint32_t,
+                                 MirrorOrientation&);
+extern template bool find_mirror(const BasicMirrorsOverlay<std::uint64_t>&, std::uint64_t, std::uint64_t,
+                                 MirrorOrientation&);
+
+extern template bool find_next_mirror(const BasicMirrorsField<std::uint16_t>&, std::uint16_t, std::uint16_t, bool,
+                                      std::uint16_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsField<std::uint32_t>&, std::uint32_t, std::uint32_t, bool,
+                                      std::uint32_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsField<std::uint64_t>&, std::uint64_t, std::uint64_t, bool,
+                                      std::uint64_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsIndexView<std::uint16_t>&, std::uint16_t, std::uint16_t, bool,
+                                      std::uint16_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsIndexView<std::uint32_t>&, std::uint32_t, std::uint32_t, bool,
+                                      std::uint32_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsIndexView<std::uint64_t>&, std::uint64_t, std::uint64_t, bool,
+                                      std::uint64_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsOverlay<std::uint16_t>&, std::uint16_t, std::uint16_t, bool,
+                                      std::uint16_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsOverlay<std::uint32_t>&, std::uint32_t, std::uint32_t, bool,
+                                      std::uint32_t&, MirrorOrientation&);
+extern template bool find_next_mirror(const BasicMirrorsOverlay<std::uint64_t>&, std::uint64_t, std::uint64_t, bool,
+                                      std::uint64_t&, MirrorOrientation&);
+
+}  // namespace mirrors_lasers
+
+#endif  // MIRRORS_INDEX
@@ -0,0 +1,563 @@
+#include "query_server.h"
+#include "checker_snapshot.h"
+#include "trace_recorder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MIRRORS_LASERS_HAS_UNIX_SOCKETS 1
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define MIRRORS_LASERS_HAS_UNIX_SOCKETS 0
+#endif
+
+namespace mirrors_lasers {
+
+namespace {
+
+std::string format_check_result(const std::string& id, const SafeCheckResult& result)
+{
+  std::ostringstream response;
+  response << "check " << id << " ";
+  if (result.result_type == SafeCheckResultType::OpensWithoutInserting) {
+    response << 0;
+  } else if (result.result_type == SafeCheckResultType::CanNotBeOpened) {
+    response << -1;
+  } else {
+    response << result.positions << " " << result.mirror_row << " " << result.mirror_col;
+  }
+  return response.str();
+}
+
+std::string format_insertion_result(const std::string& id, const MinimalInsertionResult& result)
+{
+  std::ostringstream response;
+  response << "insertions " << id << " ";
+  if (result.result_type == SafeCheckResultType::CanNotBeOpened) {
+    response << -1;
+    return response.str();
+  }
+  response << result.insertions;
+  for (const auto& placement : result.placements) {
+    response << " " << placement.position.row << " " << placement.position.col << " "
+             << (placement.orientation == MirrorOrientation::LeftToUp ? "/" : "\\");
+  }
+  return response.str();
+}
+
+std::string format_changes_result(const std::string& id, const MirrorChangesResult& result)
+{
+  std::ostringstream response;
+  response << "changes " << id << " ";
+  if (result.opens_without_changes) {
+    response << "open";
+    return response.str();
+  }
+  response << result.removals << " " << result.flips;
+  for (const auto& change : result.changes) {
+    response << " " << change.position.row << " " << change.position.col << " "
+             << (change.change_type == MirrorChangeType::Removal ? "remove" : "flip");
+  }
+  return response.str();
+}
+
+#if MIRRORS_LASERS_HAS_UNIX_SOCKETS
+bool send_all(int descriptor, const std::string& data)
+{
+  std::size_t sent{0U};
+  while (sent < data.size()) {
+    const ssize_t result = ::send(descriptor, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (result <= 0) {
+      return false;
+    }
+    sent += static_cast<std::size_t>(result);
+  }
+  return true;
+}
+#endif
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram()
+{
+  for (auto& bucket : buckets_) {
+    bucket.store(0U, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency)
+{
+  const auto value = static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(latency.count(), 0));
+  buckets_[bucket_index_(value)].fetch_add(1U, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::count() const
+{
+  std::uint64_t result{0U};
+  for (const auto& bucket : buckets_) {
+    result += bucket.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double fraction) const
+{
+  const std::uint64_t total = count();
+  if (total == 0U) {
+    return std::chrono::nanoseconds{0};
+  }
+  const auto rank = std::max<std::uint64_t>(1U, static_cast<std::uint64_t>(fraction * static_cast<double>(total)));
+  std::uint64_t accumulated{0U};
+  for (std::size_t index = 0U; index < BUCKETS_COUNT; ++index) {
+    accumulated += buckets_[index].load(std::memory_order_relaxed);
+    if (accumulated >= rank) {
+      return std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(bucket_upper_bound_(index))};
+    }
+  }
+  const std::uint64_t max_value = bucket_upper_bound_(BUCKETS_COUNT - 1U);
+  return std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(max_value)};
+}
+
+std::size_t LatencyHistogram::bucket_index_(std::uint64_t value)
+{
+  if (value < SUB_BUCKETS_COUNT) {
+    return static_cast<std::size_t>(value);
+  }
+  std::size_t exponent{0U};
+  for (std::uint64_t rest = value; rest > 1U; rest >>= 1U) {
+    ++exponent;
+  }
+  const auto sub_bucket =
+      static_cast<std::size_t>((value >> (exponent - SUB_BUCKETS_BITS)) & (SUB_BUCKETS_COUNT - 1U));
+  return (exponent - SUB_BUCKETS_BITS + 1U) * SUB_BUCKETS_COUNT + sub_bucket;
+}
+
+std::uint64_t LatencyHistogram::bucket_upper_bound_(std::size_t index)
+{
+  if (index < SUB_BUCKETS_COUNT) {
+    return index;
+  }
+  const std::size_t exponent = index / SUB_BUCKETS_COUNT + SUB_BUCKETS_BITS - 1U;
+  const std::uint64_t sub_bucket = index % SUB_BUCKETS_COUNT;
+  const std::size_t shift = exponent - SUB_BUCKETS_BITS;
+  return ((SUB_BUCKETS_COUNT + sub_bucket + 1U) << shift) - 1U;
+}
+
+constexpr std::size_t LatencyHistogram::SUB_BUCKETS_BITS;
+constexpr std::size_t LatencyHistogram::SUB_BUCKETS_COUNT;
+constexpr std::size_t LatencyHistogram::BUCKETS_COUNT;
+
+QueryServer::QueryServer(std::size_t cache_budget_bytes)
+  : cache_budget_bytes_{cache_budget_bytes}
+{
+}
+
+std::string QueryServer::handle_request(const std::string& request)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  std::string response;
+  try {
+    response = handle_request_(request);
+  } catch (const std::exception& exception) {
+    response = std::string{"error "} + exception.what();
+  }
+  const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                            start_time);
+  latencies_.record(latency);
+  const auto latency_ns = static_cast<std::uint64_t>(latency.count());
+  std::uint64_t max_latency_ns = max_latency_ns_.load(std::memory_order_relaxed);
+  while (latency_ns > max_latency_ns &&
+         !max_latency_ns_.compare_exchange_weak(max_latency_ns, latency_ns, std::memory_order_relaxed)) {
+  }
+  return response;
+}
+
+std::string QueryServer::handle_request_(const std::string& request)
+{
+  std::istringstream input{request};
+  std::string command;
+  std::string id;
+  input >> command;
+  if (command == "stats") {
+    const QueryServerStats server_stats = stats();
+    std::ostringstream response;
+    response << "stats requests=" << server_stats.requests
+             << " p50_us=" << server_stats.p50_latency.count() / 1000
+             << " p90_us=" << server_stats.p90_latency.count() / 1000
+             << " p99_us=" << server_stats.p99_latency.count() / 1000
+             << " max_us=" << server_stats.max_latency.count() / 1000
+             << " safes=" << server_stats.registered_safes
+             << " cached=" << server_stats.cached_checkers
+             << " cached_bytes=" << server_stats.cached_bytes
+             << " hits=" << server_stats.cache_hits
+             << " misses=" << server_stats.cache_misses;
+    return response.str();
+  }
+
+  if (!(input >> id)) {
+    throw std::invalid_argument{"Incorrect request: " + request};
+  }
+  const TraceCase trace_case{id, TraceRecorder::is_enabled() ? registered_mirrors_count_(id) : 0U};
+  const TraceScope trace_scope{"handle_request"};
+  if (command == "put") {
+    SafeSource source{};
+    source.description = std::make_shared<const SafeDescription>(read_safe(input));
+    register_safe_(id, std::move(source));
+    return "put " + id + " ok";
+  }
+  if (command == "load") {
+    std::string path;
+    if (!(input >> path)) {
+      throw std::invalid_argument{"Incorrect request: " + request};
+    }
+    SafeSource source{};
+    if (is_snapshot_file(path)) {
+      source.snapshot_path = path;
+    } else {
+      std::ifstream file{path};
+      if (!file) {
+        throw std::invalid_argument{"Can not open the file: " + path};
+      }
+      source.description = std::make_shared<const SafeDescription>(read_safe(file));
+    }
+    register_safe_(id, std::move(source));
+    return "load " + id + " ok";
+  }
+  if (command == "check") {
+    return format_check_result(id, get_checker_(id)->check_safe());
+  }
+  if (command == "insertions") {
+    return format_insertion_result(id, get_checker_(id)->find_minimal_insertions());
+  }
+  if (command == "changes") {
+    return format_changes_result(id, get_checker_(id)->find_single_mirror_changes());
+  }
+  if (command == "evict") {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (sources_.erase(id) == 0U) {
+      throw std::invalid_argument{"Unknown safe: " + id};
+    }
+    const auto cache_iter = cache_.find(id);
+    if (cache_iter != cache_.end()) {
+      cached_bytes_ -= cache_iter->second.bytes;
+      lru_.erase(cache_iter->second.lru_position);
+      cache_.erase(cache_iter);
+    }
+    return "evict " + id + " ok";
+  }
+  throw std::invalid_argument{"Unknown command: " + command};
+}
+
+void QueryServer::register_safe_(const std::string& id, SafeSource source)
+{
+  std::shared_ptr<const SafeChecker> checker = build_checker_(source);
+  const std::size_t bytes = checker->memory_footprint().total_bytes();
+  std::uint64_t generation{0U};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    generation = ++last_generation_;
+    source.generation = generation;
+    sources_[id] = std::move(source);
+  }
+  cache_checker_(id, std::move(checker), bytes, generation);
+}
+
+std::shared_ptr<const SafeChecker> QueryServer::get_checker_(const std::string& id)
+{
+  SafeSource source{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    const auto cache_iter = cache_.find(id);
+    if (cache_iter != cache_.end()) {
+      cache_hits_.fetch_add(1U, std::memory_order_relaxed);
+      lru_.splice(lru_.begin(), lru_, cache_iter->second.lru_position);
+      return cache_iter->second.checker;
+    }
+    const auto source_iter = sources_.find(id);
+    if (source_iter == sources_.end()) {
+      throw std::invalid_argument{"Unknown safe: " + id};
+    }
+    source = source_iter->second;
+  }
+  // The checker is built without holding the lock, so that other requests are not blocked
+  cache_misses_.fetch_add(1U, std::memory_order_relaxed);
+  std::shared_ptr<const SafeChecker> checker = build_checker_(source);
+  cache_checker_(id, checker, checker->memory_footprint().total_bytes(), source.generation);
+  return checker;
+}
+
+void QueryServer::cache_checker_(const std::string& id, std::shared_ptr<const SafeChecker> checker, std::size_t bytes,
+                                 std::uint64_t generation)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  const auto source_iter = sources_.find(id);
+  if (source_iter == sources_.end() || source_iter->second.generation != generation) {
+    return;  // The safe was evicted or registered again while the checker was being built
+  }
+  const auto cache_iter = cache_.find(id);
+  if (cache_iter != cache_.end()) {
+    cached_bytes_ -= cache_iter->second.bytes;
+    lru_.erase(cache_iter->second.lru_position);
+    cache_.erase(cache_iter);
+  }
+  // A checker exceeding the whole budget is used for the current request only
+  if (bytes > cache_budget_bytes_) {
+    return;
+  }
+  while (cached_bytes_ + bytes > cache_budget_bytes_ && !lru_.empty()) {
+    const auto evicted_iter = cache_.find(lru_.back());
+    cached_bytes_ -= evicted_iter->second.bytes;
+    cache_.erase(evicted_iter);
+    lru_.pop_back();
+  }
+  lru_.push_front(id);
+  CacheEntry entry{};
+  entry.checker = std::move(checker);
+  entry.bytes = bytes;
+  entry.lru_position = lru_.begin();
+  cache_.emplace(id, std::move(entry));
+  cached_bytes_ += bytes;
+}
+
+std::size_t QueryServer::registered_mirrors_count_(const std::string& id) const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  const auto source_iter = sources_.find(id);
+  if (source_iter == sources_.end() || !source_iter->second.description) {
+    return 0U;
+  }
+  const SafeDescription& safe = *source_iter->second.description;
+  return safe.left_to_up_mirrors.size() + safe.left_to_down_mirrors.size();
+}
+
+std::shared_ptr<const SafeChecker> QueryServer::build_checker_(const SafeSource& source)
+{
+  if (source.description) {
+    const SafeDescription& safe = *source.description;
+    return std::make_shared<const SafeChecker>(safe.rows, safe.columns,
+                                               safe.left_to_up_mirrors, safe.left_to_down_mirrors);
+  }
+  return std::make_shared<const SafeChecker>(SafeChecker::load_snapshot(source.snapshot_path));
+}
+
+QueryServerStats QueryServer::stats() const
+{
+  QueryServerStats result{};
+  result.requests = latencies_.count();
+  result.p50_latency = latencies_.percentile(0.5);
+  result.p90_latency = latencies_.percentile(0.9);
+  result.p99_latency = latencies_.percentile(0.99);
+  result.max_latency =
+      std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(max_latency_ns_.load())};
+  result.cache_hits = cache_hits_.load();
+  result.cache_misses = cache_misses_.load();
+  std::lock_guard<std::mutex> lock{mutex_};
+  result.registered_safes = sources_.size();
+  result.cached_checkers = cache_.size();
+  result.cached_bytes = cached_bytes_;
+  return result;
+}
+
+void QueryServer::serve_stream(std::istream& input, std::ostream& output, std::size_t threads_count)
+{
+  std::mutex queue_mutex;
+  std::condition_variable queue_condition;
+  std::deque<std::string> requests;
+  bool is_finished{false};
+  std::mutex output_mutex;
+
+  auto worker = [&] () {
+    while (true) {
+      std::string request;
+      {
+        std::unique_lock<std::mutex> lock{queue_mutex};
+        queue_condition.wait(lock, [&requests, &is_finished] () {
+          return !requests.empty() || is_finished;
+        });
+        if (requests.empty()) {
+          return;
+        }
+        request = std::move(requests.front());
+        requests.pop_front();
+      }
+      queue_condition.notify_all();
+      const std::string response = handle_request(request);
+      std::lock_guard<std::mutex> lock{output_mutex};
+      output << response << '\n' << std::flush;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (std::size_t index = 0U; index < std::max<std::size_t>(threads_count, 1U); ++index) {
+    threads.emplace_back(worker);
+  }
+  // The queue is bounded, so that a fast producer doesn't accumulate all the requests in memory
+  const std::size_t max_queued_requests = std::max<std::size_t>(threads_count, 1U) * 4U;
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{queue_mutex};
+    queue_condition.wait(lock, [&requests, max_queued_requests] () {
+      return requests.size() < max_queued_requests;
+    });
+    requests.push_back(std::move(line));
+    lock.unlock();
+    queue_condition.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock{queue_mutex};
+    is_finished = true;
+  }
+  queue_condition.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void QueryServer::serve_unix_socket(const std::string& path)
+{
+#if MIRRORS_LASERS_HAS_UNIX_SOCKETS
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error{"Socket path is too long: " + path};
+  }
+  address.sun_family = AF_UNIX;
+  std::copy(path.begin(), path.end(), address.sun_path);
+
+  const int listen_descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_descriptor < 0) {
+    throw std::runtime_error{"Can not create a socket"};
+  }
+  // Only a stale socket is replaced, any other file at the path is kept
+  struct stat existing_file{};
+  bool is_path_free{false};
+  if (::lstat(path.c_str(), &existing_file) == 0) {
+    is_path_free = S_ISSOCK(existing_file.st_mode) && ::unlink(path.c_str()) == 0;
+  } else {
+    is_path_free = errno == ENOENT;
+  }
+  if (!is_path_free ||
+      ::bind(listen_descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(listen_descriptor, SOMAXCONN) != 0) {
+    ::close(listen_descriptor);
+    throw std::runtime_error{"Can not listen to the socket: " + path};
+  }
+
+  // Connections are tracked, so that they can be closed on shutdown
+  std::mutex connections_mutex;
+  std::condition_variable connections_condition;
+  std::unordered_set<int> open_connections;
+  bool is_stopped{false};
+  // The threads use the local state above, so they are joined before returning
+  std::vector<std::thread> connection_threads;
+  std::vector<std::thread::id> finished_threads;
+
+  // Joins the threads of the closed connections, must be called under the lock
+  auto join_finished_threads = [&] () {
+    for (const std::thread::id finished_id : finished_threads) {
+      const auto thread_iter = std::find_if(connection_threads.begin(), connection_threads.end(),
+                                            [finished_id] (const std::thread& thread) {
+                                              return thread.get_id() == finished_id;
+                                            });
+      thread_iter->join();
+      connection_threads.erase(thread_iter);
+    }
+    finished_threads.clear();
+  };
+
+  auto stop = [&] () {
+    std::lock_guard<std::mutex> lock{connections_mutex};
+    is_stopped = true;
+    ::shutdown(listen_descriptor, SHUT_RDWR);
+    for (const int connection : open_connections) {
+      ::shutdown(connection, SHUT_RDWR);
+    }
+  };
+
+  auto serve_connection = [&] (int descriptor) {
+    std::string buffer;
+    char chunk[4096];
+    bool is_open{true};
+    while (is_open) {
+      const ssize_t received = ::recv(descriptor, chunk, sizeof(chunk), 0);
+      if (received <= 0) {
+        break;
+      }
+      buffer.append(chunk, static_cast<std::size_t>(received));
+      std::size_t line_end = buffer.find('\n');
+      while (is_open && line_end != std::string::npos) {
+        const std::string request = buffer.substr(0U, line_end);
+        buffer.erase(0U, line_end + 1U);
+        if (request == "shutdown") {
+          stop();
+          is_open = false;
+        } else if (!request.empty() && !send_all(descriptor, handle_request(request) + "\n")) {
+          is_open = false;
+        }
+        line_end = buffer.find('\n');
+      }
+    }
+    // The descriptor is forgotten before closing, since accept() can reuse its number right after close()
+    std::lock_guard<std::mutex> lock{connections_mutex};
+    open_connections.erase(descriptor);
+    ::close(descriptor);
+    finished_threads.push_back(std::this_thread::get_id());
+    connections_condition.notify_all();
+  };
+
+  while (true) {
+    const int descriptor = ::accept(listen_descriptor, nullptr, nullptr);
+    std::lock_guard<std::mutex> lock{connections_mutex};
+    if (is_stopped || descriptor < 0) {
+      if (descriptor >= 0) {
+        ::close(descriptor);
+      }
+      break;
+    }
+    join_finished_threads();
+    open_connections.insert(descriptor);
+    try {
+      connection_threads.emplace_back(serve_connection, descriptor);
+    } catch (const std::system_error&) {
+      // The started connections are still served and joined below
+      open_connections.erase(descriptor);
+      ::close(descriptor);
+      break;
+    }
+  }
+
+  std::unique_lock<std::mutex> lock{connections_mutex};
+  if (!is_stopped) {
+    lock.unlock();
+    stop();
+    lock.lock();
+  }
+  connections_condition.wait(lock, [&open_connections] () { return open_connections.empty(); });
+  lock.unlock();
+  for (auto& thread : connection_threads) {
+    thread.join();
+  }
+  ::close(listen_descriptor);
+  ::unlink(path.c_str());
+#else
+  (void)path;
+  throw std::runtime_error{"Unix domain sockets are not supported"};
+#endif
+}
+
+}  // namespace mirrors_lasers
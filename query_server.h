@@ -0,0 +1,179 @@
+#ifndef QUERY_SERVER
+#define QUERY_SERVER
+
+#include "safe_checker.h"
+#include "safe_reader.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace mirrors_lasers {
+
+/// @brief Histogram of latencies with logarithmic buckets. Recording is lock-free
+///
+/// @details Each power of two range is split into 8 buckets, so the relative error of the percentiles is below 12.5%
+class LatencyHistogram final {
+public:
+  LatencyHistogram();
+
+  /// @brief Adds a latency to the histogram
+  ///
+  /// @param latency Latency of a request
+  void record(std::chrono::nanoseconds latency);
+
+  /// @brief Returns the number of the recorded latencies
+  std::uint64_t count() const;
+
+  /// @brief Returns the approximate latency percentile
+  ///
+  /// @param fraction Fraction of the latencies not exceeding the result, from 0 to 1
+  ///
+  /// @return Upper bound of the bucket containing the percentile, 0 if nothing was recorded
+  std::chrono::nanoseconds percentile(double fraction) const;
+
+private:
+  static constexpr std::size_t SUB_BUCKETS_BITS{3U};
+  static constexpr std::size_t SUB_BUCKETS_COUNT{1U << SUB_BUCKETS_BITS};
+  static constexpr std::size_t BUCKETS_COUNT{(64U - SUB_BUCKETS_BITS + 1U) * SUB_BUCKETS_COUNT};
+
+  static std::size_t bucket_index_(std::uint64_t value);
+  static std::uint64_t bucket_upper_bound_(std::size_t index);
+
+  std::array<std::atomic<std::uint64_t>, BUCKETS_COUNT> buckets_;
+};
+
+/// @brief Statistics of the query server
+struct QueryServerStats final {
+  std::uint64_t requests{0U};
+  std::chrono::nanoseconds p50_latency{0};
+  std::chrono::nanoseconds p90_latency{0};
+  std::chrono::nanoseconds p99_latency{0};
+  std::chrono::nanoseconds max_latency{0};
+  std::size_t registered_safes{0U};
+  std::size_t cached_checkers{0U};
+  std::size_t cached_bytes{0U};
+  std::uint64_t cache_hits{0U};
+  std::uint64_t cache_misses{0U};
+};
+
+/// @brief Long-lived server answering requests about safes registered by ID
+///
+/// @details Built checkers are kept in an LRU cache limited by a memory budget. A checker evicted from the cache
+/// is built again from its source on the next request. Requests are single text lines:
+/// - "put <id> <r> <c> <m> <n> <coordinates>" registers a safe described in the same format as the standard input;
+/// - "load <id> <path>" registers a safe from a file in the text format or from a snapshot;
+/// - "check <id>" responds "check <id> 0", "check <id> -1" or "check <id> <k> <r> <c>";
+/// - "insertions <id>" responds "insertions <id> -1" or "insertions <id> <k>" followed by the inserted mirrors;
+/// - "changes <id>" responds "changes <id> open" or "changes <id> <removals> <flips>" followed by the mirrors,
+///   removal or flip of which opens the safe;
+/// - "evict <id>" removes the safe;
+/// - "stats" responds with the number of requests, latency percentiles and cache statistics.
+/// Errors are reported as "error <message>"
+class QueryServer final {
+public:
+  /// @brief Constructs the server
+  ///
+  /// @param cache_budget_bytes Memory budget of the cached checkers. A checker is charged with the memory held by
+  /// its index, see SafeChecker::memory_footprint(). The index of a snapshot is mapped from the file and not charged
+  explicit QueryServer(std::size_t cache_budget_bytes);
+
+  /// @brief Handles a single request. Can be called from multiple threads
+  ///
+  /// @param request Request line
+  ///
+  /// @return Response line without the line end
+  std::string handle_request(const std::string& request);
+
+  /// @brief Reads requests from the input until its end and writes the responses to the output
+  ///
+  /// @details Requests are handled by a pool of threads, so the responses may come in another order
+  ///
+  /// @param input Stream of the requests
+  /// @param output Stream of the responses
+  /// @param threads_count Number of the threads handling the requests
+  void serve_stream(std::istream& input, std::ostream& output, std::size_t threads_count);
+
+  /// @brief Listens to the Unix domain socket until a "shutdown" request. Each connection is handled by its own thread
+  ///
+  /// @param path Path of the socket
+  ///
+  /// @throw std::runtime_error if the socket can't be created or Unix domain sockets are not supported
+  void serve_unix_socket(const std::string& path);
+
+  /// @brief Returns the current statistics of the server
+  QueryServerStats stats() const;
+
+private:
+  /// @brief Source of a registered safe, from which its checker can be built
+  struct SafeSource final {
+    /// @brief Description of the safe, nullptr if the safe is loaded from a snapshot
+    std::shared_ptr<const SafeDescription> description;
+    /// @brief Path of the snapshot file, empty if the safe is described directly
+    std::string snapshot_path;
+    /// @brief Number of the registration, a checker built from an older source of the same ID is not cached
+    std::uint64_t generation{0U};
+  };
+
+  /// @brief Cached checker
+  struct CacheEntry final {
+    std::shared_ptr<const SafeChecker> checker;
+    /// @brief Memory held by the index of the checker
+    std::size_t bytes{0U};
+    std::list<std::string>::iterator lru_position;
+  };
+
+  std::string handle_request_(const std::string& request);
+
+  /// @brief Registers the safe and puts its checker into the cache
+  void register_safe_(const std::string& id, SafeSource source);
+
+  /// @brief Returns the checker of a registered safe, building it if it is not cached
+  ///
+  /// @throw std::invalid_argument if the safe is not registered
+  std::shared_ptr<const SafeChecker> get_checker_(const std::string& id);
+
+  /// @brief Puts the checker into the cache, evicting the least recently used checkers if the budget is exceeded.
+  /// The checker is dropped if the safe was evicted or registered again while the checker was being built
+  ///
+  /// @param id Identifier of the safe
+  /// @param checker Built checker
+  /// @param bytes Memory held by the checker
+  /// @param generation Generation of the source, from which the checker was built
+  void cache_checker_(const std::string& id, std::shared_ptr<const SafeChecker> checker, std::size_t bytes,
+                      std::uint64_t generation);
+
+  /// @brief Returns the number of mirrors of the registered safe, 0 if it is unknown or loaded from a snapshot
+  std::size_t registered_mirrors_count_(const std::string& id) const;
+
+  static std::shared_ptr<const SafeChecker> build_checker_(const SafeSource& source);
+
+  const std::size_t cache_budget_bytes_;
+  LatencyHistogram latencies_;
+  std::atomic<std::uint64_t> max_latency_ns_{0U};
+  std::atomic<std::uint64_t> cache_hits_{0U};
+  std::atomic<std::uint64_t> cache_misses_{0U};
+
+  /// @brief Protects the registered safes and the cache
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, SafeSource> sources_;
+  /// @brief Generation of the last registered source
+  std::uint64_t last_generation_{0U};
+  std::unordered_map<std::string, CacheEntry> cache_;
+  /// @brief Identifiers of the cached checkers, the most recently used first
+  std::list<std::string> lru_;
+  std::size_t cached_bytes_{0U};
+};
+
+}  // namespace mirrors_lasers
+
+#endif  // QUERY_SERVER
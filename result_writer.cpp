@@ -0,0 +1,247 @@
+#include "result_writer.h"
+
+#include <cstring>
+
+namespace mirrors_lasers {
+
+namespace {
+
+const char* status_name(CheckStatus status)
+{
+  if (status == CheckStatus::DeadlineExceeded) {
+    return "timeout";
+  }
+  if (status == CheckStatus::Cancelled) {
+    return "cancelled";
+  }
+  if (status == CheckStatus::MemoryBudgetExceeded) {
+    return "memory_budget_exceeded";
+  }
+  return "completed";
+}
+
+const char* result_type_name(SafeCheckResultType result_type)
+{
+  if (result_type == SafeCheckResultType::OpensWithoutInserting) {
+    return "opens_without_inserting";
+  }
+  if (result_type == SafeCheckResultType::CanNotBeOpened) {
+    return "can_not_be_opened";
+  }
+  return "requires_mirror_insertion";
+}
+
+}  // namespace
+
+constexpr std::size_t ResultWriter::DEFAULT_BLOCK_SIZE;
+
+ResultWriter::ResultWriter(std::ostream& output, const OutputOptions& options, std::size_t block_size)
+  : output_{output}
+  , options_{options}
+  , block_size_{block_size}
+{
+  buffer_.reserve(block_size_);
+  if (options_.format == OutputFormat::Csv) {
+    if (options_.with_case_id) {
+      append_("case_id,");
+    }
+    append_("status,result,positions,row,col");
+    if (options_.with_timing) {
+      append_(",time_ns");
+    }
+    append_('\n');
+  }
+}
+
+ResultWriter::~ResultWriter()
+{
+  try {
+    output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  } catch (...) {
+    // The destructor must not throw, the error can be detected by calling flush() before the destruction
+  }
+}
+
+void ResultWriter::write(const std::string& case_id, const LimitedCheckResult& result)
+{
+  if (options_.format == OutputFormat::Plain) {
+    if (options_.with_case_id) {
+      append_(case_id.data(), case_id.size());
+      append_(' ');
+    }
+    write_plain_(result);
+    if (options_.with_timing) {
+      append_(' ');
+      append_unsigned_(static_cast<std::uint64_t>(result.elapsed.count()));
+    }
+  } else if (options_.format == OutputFormat::Csv) {
+    if (options_.with_case_id) {
+      append_case_id_(case_id);
+      append_(',');
+    }
+    write_fields_(result);
+    if (options_.with_timing) {
+      append_(',');
+      append_unsigned_(static_cast<std::uint64_t>(result.elapsed.count()));
+    }
+  } else {
+    append_('{');
+    if (options_.with_case_id) {
+      append_("\"case_id\":");
+      append_case_id_(case_id);
+      append_(',');
+    }
+    write_fields_(result);
+    if (options_.with_timing) {
+      append_(",\"time_ns\":");
+      append_unsigned_(static_cast<std::uint64_t>(result.elapsed.count()));
+    }
+    append_('}');
+  }
+  append_('\n');
+  write_block_if_full_();
+}
+
+void ResultWriter::flush()
+{
+  output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  buffer_.clear();
+  output_.flush();
+}
+
+void ResultWriter::append_(const char* text, std::size_t size)
+{
+  buffer_.insert(buffer_.end(), text, text + size);
+}
+
+void ResultWriter::append_(const char* text)
+{
+  append_(text, std::strlen(text));
+}
+
+void ResultWriter::append_(char symbol)
+{
+  buffer_.push_back(symbol);
+}
+
+void ResultWriter::append_unsigned_(std::uint64_t value)
+{
+  // The digits are formatted from the end, 20 digits are enough for any 64-bit value
+  char digits[20];
+  char* digits_begin = digits + sizeof(digits);
+  do {
+    *--digits_begin = static_cast<char>('0' + value % 10U);
+    value /= 10U;
+  } while (value != 0U);
+  append_(digits_begin, static_cast<std::size_t>(digits + sizeof(digits) - digits_begin));
+}
+
+void ResultWriter::append_case_id_(const std::string& case_id)
+{
+  if (options_.format == OutputFormat::JsonLines) {
+    append_('"');
+    for (const char symbol : case_id) {
+      if (symbol == '"' || symbol == '\\') {
+        append_('\\');
+        append_(symbol);
+      } else if (static_cast<unsigned char>(symbol) < 0x20U) {
+        constexpr char HEX_DIGITS[] = "0123456789abcdef";
+        append_("\\u00");
+        append_(HEX_DIGITS[static_cast<unsigned char>(symbol) >> 4U]);
+        append_(HEX_DIGITS[static_cast<unsigned char>(symbol) & 0xFU]);
+      } else {
+        append_(symbol);
+      }
+    }
+    append_('"');
+    return;
+  }
+
+  // A CSV field is quoted only if it contains a separator, a quote or a line break
+  if (case_id.find_first_of(",\"\r\n") == std::string::npos) {
+    append_(case_id.data(), case_id.size());
+    return;
+  }
+  append_('"');
+  for (const char symbol : case_id) {
+    if (symbol == '"') {
+      append_('"');
+    }
+    append_(symbol);
+  }
+  append_('"');
+}
+
+void ResultWriter::write_plain_(const LimitedCheckResult& limited_result)
+{
+  const SafeCheckResult& result = limited_result.result;
+  if (limited_result.status != CheckStatus::Completed) {
+    append_(status_name(limited_result.status));
+  } else if (result.result_type == SafeCheckResultType::OpensWithoutInserting) {
+    append_('0');
+  } else if (result.result_type == SafeCheckResultType::CanNotBeOpened) {
+    append_("-1");
+  } else {
+    append_unsigned_(result.positions);
+    append_(' ');
+    append_unsigned_(result.mirror_row);
+    append_(' ');
+    append_unsigned_(result.mirror_col);
+  }
+}
+
+void ResultWriter::write_fields_(const LimitedCheckResult& limited_result)
+{
+  const bool is_json = options_.format == OutputFormat::JsonLines;
+  const char* const missing = is_json ? "null" : "";
+  auto append_name = [this, is_json] (const char* name) {
+    if (is_json) {
+      append_('"');
+      append_(name);
+      append_("\":");
+    }
+  };
+  auto append_string = [this, is_json] (const char* value) {
+    if (is_json) {
+      append_('"');
+    }
+    append_(value);
+    if (is_json) {
+      append_('"');
+    }
+  };
+
+  const SafeCheckResult& result = limited_result.result;
+  const bool is_completed = limited_result.status == CheckStatus::Completed;
+  const bool has_position = is_completed && result.result_type == SafeCheckResultType::RequiresMirrorInsertion;
+  append_name("status");
+  append_string(status_name(limited_result.status));
+  append_(',');
+  append_name("result");
+  if (is_completed) {
+    append_string(result_type_name(result.result_type));
+  } else {
+    append_(missing);
+  }
+  const char* const names[] = {"positions", "row", "col"};
+  const std::uint64_t values[] = {result.positions, result.mirror_row, result.mirror_col};
+  for (std::size_t index = 0U; index < 3U; ++index) {
+    append_(',');
+    append_name(names[index]);
+    if (has_position) {
+      append_unsigned_(values[index]);
+    } else {
+      append_(missing);
+    }
+  }
+}
+
+void ResultWriter::write_block_if_full_()
+{
+  if (buffer_.size() >= block_size_) {
+    output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+  }
+}
+
+}  // namespace mirrors_lasers
@@ -0,0 +1,85 @@
+#ifndef RESULT_WRITER
+#define RESULT_WRITER
+
+#include "safe_checker.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mirrors_lasers {
+
+/// @brief Format of the written results
+enum class OutputFormat {
+  /// @brief "0", "-1" or "k r c" per line, "timeout" or "cancelled" for the stopped checks,
+  /// "memory_budget_exceeded" for the safes exceeding the memory budget
+  Plain,
+  /// @brief Comma-separated values with a header line. The fields not applicable to the result are empty
+  Csv,
+  /// @brief A JSON object per line. The fields not applicable to the result are null
+  JsonLines
+};
+
+/// @brief Parameters of writing the results
+struct OutputOptions final {
+  OutputFormat format{OutputFormat::Plain};
+  /// @brief Each result starts with the ID of its case
+  bool with_case_id{false};
+  /// @brief Each result ends with the wall time of its check in nanoseconds
+  bool with_timing{false};
+};
+
+/// @brief Formats the results into a memory block and writes the block to the stream when it is full
+///
+/// @details The numbers are formatted without the locale of the stream and the stream is not flushed
+/// after each result. The CSV header is written on construction. The case IDs are escaped as required by
+/// the format. The plain format with the case ID and the timing is "<case_id> <result> <time_ns>"
+class ResultWriter final {
+public:
+  /// @brief Default size of the memory block
+  static constexpr std::size_t DEFAULT_BLOCK_SIZE{1U << 16U};
+
+  /// @brief Constructs the writer
+  ///
+  /// @param output Stream of the results
+  /// @param options Format of the results
+  /// @param block_size Size of the memory block, after which the formatted results are written to the stream
+  ResultWriter(std::ostream& output, const OutputOptions& options, std::size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  ResultWriter(const ResultWriter&) = delete;
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  /// @brief Writes the remaining results to the stream. The errors of the stream are ignored
+  ~ResultWriter();
+
+  /// @brief Formats the result of a check
+  ///
+  /// @param case_id ID of the case, written only if it is requested by the options
+  /// @param result Result of the check
+  void write(const std::string& case_id, const LimitedCheckResult& result);
+
+  /// @brief Writes the formatted results to the stream and flushes it
+  void flush();
+
+private:
+  void append_(const char* text, std::size_t size);
+  void append_(const char* text);
+  void append_(char symbol);
+  void append_unsigned_(std::uint64_t value);
+  void append_case_id_(const std::string& case_id);
+  void write_plain_(const LimitedCheckResult& result);
+  void write_fields_(const LimitedCheckResult& result);
+  /// @brief Writes the block to the stream if it is full
+  void write_block_if_full_();
+
+  std::ostream& output_;
+  const OutputOptions options_;
+  const std::size_t block_size_;
+  std::vector<char> buffer_;
+};
+
+}  // namespace mirrors_lasers
+
+#endif  // RESULT_WRITER
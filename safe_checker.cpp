@@ -1,297 +1,1402 @@
 #include "safe_checker.h"
+#include "checker_snapshot.h"
 #include "intersection_search_helper.h"
+#include "minimal_insertion_search.h"
+#include "mirrors_index.h"
+#include "thread_pool.h"
+#include "trace_recorder.h"
 
 #include <algorithm>
 #include <cstddef>
 #include <limits>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace mirrors_lasers {
 
-constexpr std::uint32_t START_POSITION{1U};
+template <typename Coordinate>
+constexpr Coordinate START_POSITION{1U};
 
-static IntersectionSearchHelperMap beam_segments_to_map(const BeamSegments& beam_segments)
+/// @brief Minimal number of mirrors, for which the index is built by multiple threads
+constexpr std::size_t MIN_PARALLEL_INDEX_MIRRORS{1U << 14U};
+
+/// @brief Minimal estimated work of the intersection search for a single thread
+constexpr std::uint64_t MIN_PARALLEL_INTERSECTIONS_WORK{1U << 14U};
+
+/// @brief Splits a sequence of items into consecutive parts of approximately equal work
+///
+/// @param items_work Estimated work of each item
+/// @param max_parts_count Maximal number of the parts
+/// @param min_part_work Minimal work of a part, so that small inputs are not split
+///
+/// @return Bounds of the parts: the part i contains the items from bounds[i] to bounds[i + 1] exclusively
+static std::vector<std::size_t> split_by_work(const std::vector<std::uint64_t>& items_work,
+                                              std::size_t max_parts_count, std::uint64_t min_part_work)
 {
-  IntersectionSearchHelperMap result;
-  for (const auto& segment : beam_segments) {
-    result[segment.first_coordinate]
-        .add_segment(segment.second_coordinate_start, segment.second_coordinate_end);
+  std::uint64_t total_work{0U};
+  for (const std::uint64_t work : items_work) {
+    total_work += work;
   }
-  return result;
+  const std::uint64_t affordable_parts_count = total_work / std::max<std::uint64_t>(min_part_work, 1U);
+  const std::uint64_t parts_count =
+      std::max<std::uint64_t>(1U, std::min<std::uint64_t>(max_parts_count, affordable_parts_count));
+
+  std::vector<std::size_t> bounds{0U};
+  std::uint64_t accumulated_work{0U};
+  for (std::size_t index = 0U; index < items_work.size() && bounds.size() < parts_count; ++index) {
+    accumulated_work += items_work[index];
+    // The part ends when its share of the total work is reached
+    if (accumulated_work * parts_count >= total_work * bounds.size()) {
+      bounds.push_back(index + 1U);
+    }
+  }
+  bounds.push_back(items_work.size());
+  return bounds;
 }
 
-SafeChecker::SafeChecker(std::uint32_t rows, std::uint32_t columns,
-                         const std::vector<Point>& left_to_up_mirrors,
-                         const std::vector<Point>& left_to_down_mirrors)
-  : rows_{rows}
-  , cols_{columns}
+/// @brief Rounds the size of a node up to the alignment of the pointers, which the node contains
+static constexpr std::size_t node_size(std::size_t size)
+{
+  return (size + sizeof(void*) - 1U) / sizeof(void*) * sizeof(void*);
+}
+
+MemoryBudgetError::MemoryBudgetError(std::size_t required_bytes, std::size_t budget_bytes)
+  : std::runtime_error{"The safe requires up to " + std::to_string(required_bytes) +
+                       " bytes of memory, which exceeds the memory budget of " + std::to_string(budget_bytes) +
+                       " bytes"}
+  , required_bytes_{required_bytes}
+  , budget_bytes_{budget_bytes}
+{
+}
+
+CancellationToken::CancellationToken()
+  : is_cancelled_{std::make_shared<std::atomic<bool>>(false)}
+{
+}
+
+void CancellationToken::cancel() const
+{
+  is_cancelled_->store(true, std::memory_order_relaxed);
+}
+
+bool CancellationToken::is_cancelled() const
+{
+  return is_cancelled_->load(std::memory_order_relaxed);
+}
+
+class CheckLimitsPoller final {
+public:
+  explicit CheckLimitsPoller(const CheckLimits& limits)
+    : limits_{limits}
+  {
+  }
+
+  /// @brief Returns true if the check should stop. The limits themselves are checked once per POLL_INTERVAL calls
+  /// in each thread, other calls cost an increment and a relaxed load
+  bool should_stop()
+  {
+    thread_local std::uint32_t calls_count{0U};
+    if (status_.load(std::memory_order_relaxed) != CheckStatus::Completed) {
+      return true;
+    }
+    if ((++calls_count & (POLL_INTERVAL - 1U)) != 0U) {
+      return false;
+    }
+    return check_limits();
+  }
+
+  /// @brief Checks the limits immediately. Returns true if the check should stop
+  bool check_limits()
+  {
+    if (limits_.cancellation.is_cancelled()) {
+      stop(CheckStatus::Cancelled);
+    } else if (std::chrono::steady_clock::now() >= limits_.deadline) {
+      stop(CheckStatus::DeadlineExceeded);
+    }
+    return is_stopped();
+  }
+
+  bool is_stopped() const
+  {
+    return status_.load(std::memory_order_relaxed) != CheckStatus::Completed;
+  }
+
+  CheckStatus status() const
+  {
+    return status_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /// @brief Power of two, so that the clock is read rarely compared to the cost of a step
+  static constexpr std::uint32_t POLL_INTERVAL{1U << 10U};
+
+  /// @brief The first reason of the stop is kept
+  void stop(CheckStatus status)
+  {
+    CheckStatus expected{CheckStatus::Completed};
+    status_.compare_exchange_strong(expected, status, std::memory_order_relaxed);
+  }
+
+  const CheckLimits& limits_;
+  std::atomic<CheckStatus> status_{CheckStatus::Completed};
+};
+
+constexpr std::uint32_t CheckLimitsPoller::POLL_INTERVAL;
+
+/// @brief Returns true if the limited check is stopped
+static bool is_stopped(const CheckLimitsPoller* poller)
+{
+  return poller != nullptr && poller->is_stopped();
+}
+
+template <typename Coordinate>
+static BasicIntersectionSearchHelperMap<Coordinate>
+beam_segments_to_map(const BasicBeamSegments<Coordinate>& beam_segments)
+{
+  TraceScope trace_scope{"beam_segments_to_map"};
+  trace_scope.set_segments(beam_segments.size());
+  return BasicIntersectionSearchHelperMap<Coordinate>{beam_segments};
+}
+
+template <typename Coordinate>
+BasicSafeChecker<Coordinate>::BasicSafeChecker(ExternalCoordinateType rows, ExternalCoordinateType columns,
+                                               const std::vector<ExternalPoint>& left_to_up_mirrors,
+                                               const std::vector<ExternalPoint>& left_to_down_mirrors,
+                                               std::size_t threads_count,
+                                               MirrorsIndexLayout layout,
+                                               std::size_t memory_budget)
+  : BasicSafeChecker{rows, columns, ExternalPointsView{left_to_up_mirrors}, ExternalPointsView{left_to_down_mirrors},
+                     threads_count, layout, memory_budget}
+{
+}
+
+template <typename Coordinate>
+BasicSafeChecker<Coordinate>::BasicSafeChecker(ExternalCoordinateType rows, ExternalCoordinateType columns,
+                                               ExternalPointsView left_to_up_mirrors,
+                                               ExternalPointsView left_to_down_mirrors,
+                                               std::size_t threads_count,
+                                               MirrorsIndexLayout layout,
+                                               std::size_t memory_budget)
+  : rows_{static_cast<Coordinate>(rows)}
+  , cols_{static_cast<Coordinate>(columns)}
+  , threads_count_{std::max<std::size_t>(threads_count, 1U)}
+  , layout_{layout}
 {
-  if (rows_ < START_POSITION) {
-    throw std::invalid_argument{"Incorrect rows count: " + std::to_string(rows_)};
+  if (rows < START_POSITION<ExternalCoordinateType> || rows > std::numeric_limits<Coordinate>::max()) {
+    throw std::invalid_argument{"Incorrect rows count: " + std::to_string(rows)};
   }
-  if (cols_ < START_POSITION) {
-    throw std::invalid_argument{"Incorrect columns count: " + std::to_string(rows_)};
+  if (columns < START_POSITION<ExternalCoordinateType> || columns > std::numeric_limits<Coordinate>::max()) {
+    throw std::invalid_argument{"Incorrect columns count: " + std::to_string(columns)};
   }
 
   const std::size_t mirrors_count = left_to_up_mirrors.size() + left_to_down_mirrors.size();
-  row_wise_mirrors_.reserve(mirrors_count);
-  col_wise_mirrors_.reserve(mirrors_count);
+  const MemoryPolicy policy = memory_policy();
+  if (memory_budget != 0U) {
+    if (layout_ == MirrorsIndexLayout::Hashed &&
+        estimate_peak_memory(mirrors_count, MirrorsIndexLayout::Hashed, threads_count_, policy) > memory_budget) {
+      layout_ = MirrorsIndexLayout::Flat;
+    }
+    const std::size_t required_bytes = estimate_peak_memory(mirrors_count, layout_, threads_count_, policy);
+    if (required_bytes > memory_budget) {
+      throw MemoryBudgetError{required_bytes, memory_budget};
+    }
+  }
 
-  // Fill the data
-  for (const auto& left_to_up_mirror : left_to_up_mirrors) {
-    throw_if_out_of_bounds_(left_to_up_mirror);
-    row_wise_mirrors_[left_to_up_mirror.row][left_to_up_mirror.col] = MirrorOrientation::LeftToUp;
-    col_wise_mirrors_[left_to_up_mirror.col][left_to_up_mirror.row] = MirrorOrientation::LeftToUp;
+  TraceScope trace_scope{"build_index"};
+  trace_scope.set_mirrors(mirrors_count);
+  if (layout_ == MirrorsIndexLayout::Hashed) {
+    build_hashed_index_(left_to_up_mirrors, left_to_down_mirrors, policy);
   }
-  for (const auto& left_to_down_mirror : left_to_down_mirrors) {
-    throw_if_out_of_bounds_(left_to_down_mirror);
-    row_wise_mirrors_[left_to_down_mirror.row][left_to_down_mirror.col] = MirrorOrientation::LeftToDown;
-    col_wise_mirrors_[left_to_down_mirror.col][left_to_down_mirror.row] = MirrorOrientation::LeftToDown;
+  if (layout_ == MirrorsIndexLayout::Flat) {
+    build_flat_index_(left_to_up_mirrors, left_to_down_mirrors);
   }
 }
 
-SafeCheckResult SafeChecker::check_safe() const
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::build_hashed_index_(ExternalPointsView left_to_up_mirrors,
+                                                       ExternalPointsView left_to_down_mirrors,
+                                                       const MemoryPolicy& policy)
+{
+  const std::size_t mirrors_count = left_to_up_mirrors.size() + left_to_down_mirrors.size();
+  if (threads_count_ > 1U && mirrors_count >= MIN_PARALLEL_INDEX_MIRRORS) {
+    build_index_in_parallel_(left_to_up_mirrors, left_to_down_mirrors, policy);
+    return;
+  }
+  row_wise_mirrors_ = make_field_(policy);
+  col_wise_mirrors_ = make_field_(policy);
+
+  // The indexes are filled one after another, so that the allocations of each of them are counted separately.
+  // The bounds are checked in the first pass
+  auto fill_field = [&] (BasicMirrorsField<Coordinate>& field, bool is_row_wise) {
+    const AllocationCounter allocation_counter{};
+    field.reserve(mirrors_count);
+    auto fill_mirrors = [&] (ExternalPointsView mirrors, MirrorOrientation orientation) {
+      for (std::size_t index = 0U; index < mirrors.size(); ++index) {
+        const ExternalPoint mirror = mirrors[index];
+        if (is_row_wise) {
+          throw_if_out_of_bounds_(mirror);
+        }
+        const auto row = static_cast<Coordinate>(mirror.row);
+        const auto col = static_cast<Coordinate>(mirror.col);
+        if (is_row_wise) {
+          field[row][col] = orientation;
+        } else {
+          field[col][row] = orientation;
+        }
+      }
+    };
+    fill_mirrors(left_to_up_mirrors, MirrorOrientation::LeftToUp);
+    fill_mirrors(left_to_down_mirrors, MirrorOrientation::LeftToDown);
+    return static_cast<std::size_t>(allocation_counter.bytes());
+  };
+  row_wise_index_bytes_ = fill_field(row_wise_mirrors_, true);
+  col_wise_index_bytes_ = fill_field(col_wise_mirrors_, false);
+}
+
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::build_flat_index_(ExternalPointsView left_to_up_mirrors,
+                                                     ExternalPointsView left_to_down_mirrors)
+{
+  const std::size_t mirrors_count = left_to_up_mirrors.size() + left_to_down_mirrors.size();
+  std::vector<Coordinate> rows;
+  std::vector<Coordinate> cols;
+  std::vector<MirrorOrientation> orientations;
+  rows.reserve(mirrors_count);
+  cols.reserve(mirrors_count);
+  orientations.reserve(mirrors_count);
+  auto add_mirrors = [this, &rows, &cols, &orientations] (ExternalPointsView mirrors, MirrorOrientation orientation) {
+    for (std::size_t index = 0U; index < mirrors.size(); ++index) {
+      const ExternalPoint mirror = mirrors[index];
+      throw_if_out_of_bounds_(mirror);
+      rows.push_back(static_cast<Coordinate>(mirror.row));
+      cols.push_back(static_cast<Coordinate>(mirror.col));
+      orientations.push_back(orientation);
+    }
+  };
+  // The "\\" mirrors are added last, so they win in the shared positions, as in the hashed index
+  add_mirrors(left_to_up_mirrors, MirrorOrientation::LeftToUp);
+  add_mirrors(left_to_down_mirrors, MirrorOrientation::LeftToDown);
+  row_wise_flat_mirrors_ = std::make_shared<const BasicFlatMirrors<Coordinate>>(
+      build_flat_mirrors(rows, cols, orientations));
+  col_wise_flat_mirrors_ = std::make_shared<const BasicFlatMirrors<Coordinate>>(
+      build_flat_mirrors(cols, rows, orientations));
+}
+
+template <typename Coordinate>
+BasicSafeChecker<Coordinate>::BasicSafeChecker(std::shared_ptr<const BasicMappedSnapshot<Coordinate>> snapshot)
+  : rows_{snapshot->rows()}
+  , cols_{snapshot->columns()}
+  , snapshot_{std::move(snapshot)}
+  , layout_{MirrorsIndexLayout::Flat}
+{
+}
+
+template <typename Coordinate>
+BasicSafeChecker<Coordinate>::BasicSafeChecker(std::shared_ptr<const BasicSafeChecker> variant_base)
+  : rows_{variant_base->rows_}
+  , cols_{variant_base->cols_}
+  , variant_base_{std::move(variant_base)}
+  , threads_count_{variant_base_->threads_count_}
+  , tracing_mode_{variant_base_->tracing_mode_}
+  , layout_{variant_base_->layout_}
 {
-  SafeCheckResult result{};
+}
 
-  // Find beam segments of direct direction
-  BeamState forward_start_state{};
-  forward_start_state.position = Point{START_POSITION, START_POSITION};
+template <typename Coordinate>
+template <typename Function>
+auto BasicSafeChecker<Coordinate>::with_own_index_(Function&& function) const
+    -> decltype(function(std::declval<const BasicMirrorsField<Coordinate>&>(),
+                         std::declval<const BasicMirrorsField<Coordinate>&>()))
+{
+  if (snapshot_) {
+    return function(snapshot_->row_wise_mirrors(), snapshot_->col_wise_mirrors());
+  }
+  if (row_wise_flat_mirrors_) {
+    return function(row_wise_flat_mirrors_->view(), col_wise_flat_mirrors_->view());
+  }
+  return function(row_wise_mirrors_, col_wise_mirrors_);
+}
+
+template <typename Coordinate>
+template <typename Function>
+auto BasicSafeChecker<Coordinate>::with_index_(Function&& function) const
+    -> decltype(function(std::declval<const BasicMirrorsField<Coordinate>&>(),
+                         std::declval<const BasicMirrorsField<Coordinate>&>()))
+{
+  if (variant_base_) {
+    return variant_base_->with_own_index_([this, &function] (const auto& base_row_wise_mirrors,
+                                                             const auto& base_col_wise_mirrors) {
+      return function(BasicMirrorsOverlay<Coordinate>{base_row_wise_mirrors, row_wise_changes_},
+                      BasicMirrorsOverlay<Coordinate>{base_col_wise_mirrors, col_wise_changes_});
+    });
+  }
+  return with_own_index_(function);
+}
+
+template <typename Coordinate>
+BasicMirrorsField<Coordinate> BasicSafeChecker<Coordinate>::make_field_(const MemoryPolicy& policy)
+{
+  if (!policy.uses_arena()) {
+    return BasicMirrorsField<Coordinate>{};
+  }
+  arenas_.push_back(std::make_shared<MemoryArena>(policy));
+  using FieldAllocator = typename BasicMirrorsField<Coordinate>::allocator_type;
+  using ValueAllocator = ArenaAllocator<typename BasicMirrorsField<Coordinate>::value_type>;
+  return BasicMirrorsField<Coordinate>{FieldAllocator{ValueAllocator{arenas_.back().get()}}};
+}
+
+template <typename Coordinate>
+auto BasicSafeChecker<Coordinate>::check_safe() const -> Result
+{
+  SafeCheckStatistics statistics{};
+  return check_safe(statistics);
+}
+
+template <typename Coordinate>
+auto BasicSafeChecker<Coordinate>::check_safe(SafeCheckStatistics& statistics) const -> Result
+{
+  const TraceScope trace_scope{"check_safe"};
+  statistics = SafeCheckStatistics{};
+  return with_index_([this, &statistics] (const auto& row_wise_mirrors, const auto& col_wise_mirrors) {
+    return check_safe_(row_wise_mirrors, col_wise_mirrors, statistics, nullptr);
+  });
+}
+
+template <typename Coordinate>
+auto BasicSafeChecker<Coordinate>::check_safe(const CheckLimits& limits) const -> LimitedResult
+{
+  const TraceScope trace_scope{"check_safe"};
+  const auto start_time = std::chrono::steady_clock::now();
+  LimitedResult result{};
+  CheckLimitsPoller poller{limits};
+  // A check which is already late or cancelled doesn't start
+  if (!poller.check_limits()) {
+    result.result = with_index_([this, &result, &poller] (const auto& row_wise_mirrors,
+                                                          const auto& col_wise_mirrors) {
+      return check_safe_(row_wise_mirrors, col_wise_mirrors, result.statistics, &poller);
+    });
+  }
+  result.status = poller.status();
+  if (result.status != CheckStatus::Completed) {
+    result.result = Result{};
+  }
+  result.elapsed = std::chrono::steady_clock::now() - start_time;
+  return result;
+}
+
+template <typename Coordinate>
+auto BasicSafeChecker<Coordinate>::check_safe_async(const CheckLimits& limits) const -> std::future<LimitedResult>
+{
+  return ThreadPool::shared().submit(bind_trace_case([this, limits] () { return check_safe(limits); }));
+}
+
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::set_threads_count(std::size_t threads_count)
+{
+  threads_count_ = std::max<std::size_t>(threads_count, 1U);
+}
+
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::set_tracing_mode(BeamTracingMode mode)
+{
+  tracing_mode_ = mode;
+}
+
+template <typename Coordinate>
+bool BasicSafeChecker<Coordinate>::reaches_detector_(const InternalBeamState& end_state) const
+{
+  return end_state.position.row == rows_ &&
+         end_state.position.col == cols_ &&
+         end_state.is_positive &&
+         end_state.is_horizontal;
+}
+
+template <typename Coordinate>
+template <typename MirrorsIndex>
+auto BasicSafeChecker<Coordinate>::check_safe_(const MirrorsIndex& row_wise_mirrors,
+                                               const MirrorsIndex& col_wise_mirrors,
+                                               SafeCheckStatistics& statistics,
+                                               CheckLimitsPoller* poller) const -> Result
+{
+  Result result{};
+  const bool has_stored_trajectories = snapshot_ && snapshot_->has_trajectories();
+  const bool is_interleaved = tracing_mode_ == BeamTracingMode::Interleaved && !has_stored_trajectories;
+
+  // Find beam segments of direct direction, and of reverse direction if the beams are traced in lockstep
+  InternalBeamState forward_start_state{};
+  forward_start_state.position = InternalPoint{START_POSITION<Coordinate>, START_POSITION<Coordinate>};
   forward_start_state.is_positive = true;
   forward_start_state.is_horizontal = true;
-  BeamState forward_end_state{};
-  BeamSegments forward_horizontal_segments{};
-  BeamSegments forward_vertical_segments{};
-  trace_the_beam_(forward_start_state,
-                  forward_end_state,
-                  forward_horizontal_segments,
-                  forward_vertical_segments);
+  InternalBeamState forward_end_state{};
+  InternalBeamSegments forward_horizontal_segments{};
+  InternalBeamSegments forward_vertical_segments{};
+  InternalBeamState backward_start_state;
+  backward_start_state.position = InternalPoint{rows_, cols_};
+  backward_start_state.is_positive = false;
+  backward_start_state.is_horizontal = true;
+  InternalBeamState backward_end_state{};
+  InternalBeamSegments backward_horizontal_segments{};
+  InternalBeamSegments backward_vertical_segments{};
+  auto count_trajectories_bytes = [&] (std::uint64_t other_bytes) {
+    const std::uint64_t trajectories_bytes =
+        sizeof(BasicBeamSegment<Coordinate>) *
+        (forward_horizontal_segments.capacity() + forward_vertical_segments.capacity() +
+         backward_horizontal_segments.capacity() + backward_vertical_segments.capacity());
+    statistics.peak_scratch_bytes = std::max(statistics.peak_scratch_bytes, trajectories_bytes + other_bytes);
+  };
+  if (has_stored_trajectories) {
+    snapshot_->read_forward_trajectory(forward_end_state, forward_horizontal_segments, forward_vertical_segments);
+  } else if (is_interleaved) {
+    trace_beams_interleaved_(row_wise_mirrors,
+                             col_wise_mirrors,
+                             forward_start_state,
+                             forward_end_state,
+                             forward_horizontal_segments,
+                             forward_vertical_segments,
+                             backward_start_state,
+                             backward_end_state,
+                             backward_horizontal_segments,
+                             backward_vertical_segments,
+                             poller);
+    statistics.mirror_lookups += 2U + forward_horizontal_segments.size() + forward_vertical_segments.size() +
+                                 backward_horizontal_segments.size() + backward_vertical_segments.size();
+  } else {
+    trace_the_beam_(row_wise_mirrors,
+                    col_wise_mirrors,
+                    forward_start_state,
+                    forward_end_state,
+                    forward_horizontal_segments,
+                    forward_vertical_segments,
+                    nullptr,
+                    poller);
+    // The mirror at the start position and the next mirror for each segment
+    statistics.mirror_lookups += 1U + forward_horizontal_segments.size() + forward_vertical_segments.size();
+  }
+  statistics.traced_segments += forward_horizontal_segments.size() + forward_vertical_segments.size();
+  count_trajectories_bytes(0U);
+  if (is_stopped(poller)) {
+    return result;
+  }
 
   // Check if the safe can be opened without any mirror insertion
-  if (forward_end_state.position.row == rows_ &&
-      forward_end_state.position.col == cols_ &&
-      forward_end_state.is_positive &&
-      forward_end_state.is_horizontal) {
+  if (reaches_detector_(forward_end_state)) {
     result.result_type = SafeCheckResultType::OpensWithoutInserting;
     return result;
   }
 
-  // Find beam segments of reverse direction
-  BeamState backward_start_state;
-  backward_start_state.position = Point{rows_, cols_};
-  backward_start_state.is_positive = false;
-  backward_start_state.is_horizontal = true;
-  BeamState backward_end_state{};
-  BeamSegments backward_horizontal_segments{};
-  BeamSegments backward_vertical_segments{};
-  trace_the_beam_(backward_start_state,
-                  backward_end_state,
-                  backward_horizontal_segments,
-                  backward_vertical_segments);
+  // Find beam segments of reverse direction, unless they are found together with the direct ones
+  if (has_stored_trajectories) {
+    snapshot_->read_backward_trajectory(backward_horizontal_segments, backward_vertical_segments);
+  } else if (!is_interleaved) {
+    trace_the_beam_(row_wise_mirrors,
+                    col_wise_mirrors,
+                    backward_start_state,
+                    backward_end_state,
+                    backward_horizontal_segments,
+                    backward_vertical_segments,
+                    nullptr,
+                    poller);
+    statistics.mirror_lookups += 1U + backward_horizontal_segments.size() + backward_vertical_segments.size();
+  }
+  statistics.traced_segments += backward_horizontal_segments.size() + backward_vertical_segments.size();
+  count_trajectories_bytes(0U);
+  if (is_stopped(poller)) {
+    return result;
+  }
 
   // Find intersections
-  const std::vector<Point> intersections = find_intersections_(forward_horizontal_segments,
-                                                               forward_vertical_segments,
-                                                               backward_horizontal_segments,
-                                                               backward_vertical_segments);
+  const IntersectionsSummary intersections = find_intersections_(row_wise_mirrors,
+                                                                 forward_horizontal_segments,
+                                                                 forward_vertical_segments,
+                                                                 backward_horizontal_segments,
+                                                                 backward_vertical_segments,
+                                                                 poller);
+  statistics.intersection_candidates += intersections.candidates;
+  statistics.mirror_lookups += intersections.lookups;
+  count_trajectories_bytes(intersections.scratch_bytes);
+  if (is_stopped(poller)) {
+    return result;
+  }
 
   // Can not be opened if no intersections
-  if (intersections.empty()) {
+  if (intersections.count == 0U) {
     result.result_type = SafeCheckResultType::CanNotBeOpened;
     return result;
   }
 
-  // Find the lexicographically smallest mirror position
+  // The lexicographically smallest mirror position
   result.result_type = SafeCheckResultType::RequiresMirrorInsertion;
-  if (intersections.size() <= std::numeric_limits<std::uint32_t>::max()) {
-    result.positions = static_cast<std::uint32_t>(intersections.size());
+  if (intersections.count <= std::numeric_limits<std::uint32_t>::max()) {
+    result.positions = static_cast<std::uint32_t>(intersections.count);
   } else {  // Should not happen
     throw std::logic_error{"Internal logic error: intersections count is greater than maximum uint32"};
   }
-  auto points_comparer = [] (const Point& first, const Point& second) -> bool {
-    return first.row != second.row ? first.row < second.row : first.col < second.col;
+  result.mirror_row = intersections.smallest.row;
+  result.mirror_col = intersections.smallest.col;
+
+  return result;
+}
+
+template <typename Coordinate>
+auto BasicSafeChecker<Coordinate>::find_minimal_insertions() const -> InsertionResult
+{
+  const TraceScope trace_scope{"find_minimal_insertions"};
+  const BasicMinimalInsertionResult<Coordinate> internal_result =
+      with_index_([this] (const auto& row_wise_mirrors, const auto& col_wise_mirrors) {
+        return mirrors_lasers::find_minimal_insertions(rows_, cols_, row_wise_mirrors, col_wise_mirrors);
+      });
+
+  InsertionResult result{};
+  result.result_type = internal_result.result_type;
+  result.insertions = internal_result.insertions;
+  result.placements.reserve(internal_result.placements.size());
+  for (const auto& placement : internal_result.placements) {
+    BasicMirrorPlacement<ExternalCoordinateType> external_placement{};
+    external_placement.position.row = placement.position.row;
+    external_placement.position.col = placement.position.col;
+    external_placement.orientation = placement.orientation;
+    result.placements.push_back(external_placement);
+  }
+  return result;
+}
+
+template <typename Coordinate>
+auto BasicSafeChecker<Coordinate>::find_single_mirror_changes() const -> ChangesResult
+{
+  const TraceScope trace_scope{"find_single_mirror_changes"};
+  return with_index_([this] (const auto& row_wise_mirrors, const auto& col_wise_mirrors) {
+    return find_single_mirror_changes_(row_wise_mirrors, col_wise_mirrors);
+  });
+}
+
+template <typename Coordinate>
+template <typename MirrorsIndex>
+auto BasicSafeChecker<Coordinate>::find_single_mirror_changes_(const MirrorsIndex& row_wise_mirrors,
+                                                               const MirrorsIndex& col_wise_mirrors) const
+    -> ChangesResult
+{
+  ChangesResult result{};
+  InternalBeamSegments horizontal_segments{};
+  InternalBeamSegments vertical_segments{};
+
+  InternalBeamState forward_start_state{};
+  forward_start_state.position = InternalPoint{START_POSITION<Coordinate>, START_POSITION<Coordinate>};
+  forward_start_state.is_positive = true;
+  forward_start_state.is_horizontal = true;
+  InternalBeamState forward_end_state{};
+  std::vector<Reflection> forward_reflections{};
+  trace_the_beam_(row_wise_mirrors, col_wise_mirrors, forward_start_state, forward_end_state,
+                  horizontal_segments, vertical_segments, &forward_reflections);
+  if (reaches_detector_(forward_end_state)) {
+    result.opens_without_changes = true;
+    return result;
+  }
+
+  InternalBeamState backward_start_state{};
+  backward_start_state.position = InternalPoint{rows_, cols_};
+  backward_start_state.is_positive = false;
+  backward_start_state.is_horizontal = true;
+  InternalBeamState backward_end_state{};
+  std::vector<Reflection> backward_reflections{};
+  trace_the_beam_(row_wise_mirrors, col_wise_mirrors, backward_start_state, backward_end_state,
+                  horizontal_segments, vertical_segments, &backward_reflections);
+
+  auto is_less = [] (const Reflection& first, const Reflection& second) {
+    return IntersectionsSummary::is_less(first.arrival.position, second.arrival.position);
   };
-  const auto min_element_iter =
-      std::min_element(intersections.begin(), intersections.end(), points_comparer);
-  result.mirror_row = min_element_iter->row;
-  result.mirror_col = min_element_iter->col;
+  std::sort(forward_reflections.begin(), forward_reflections.end(), is_less);
 
+  // The beams are different and don't reverse each other, so a common mirror is passed by each of them once,
+  // from the different sides. Without the mirror the beam from the laser would go straight, so it leaves
+  // along the reverse beam if they arrive from the opposite directions. Otherwise the reverse beam arrives
+  // along the reflected direct beam, and the flipped mirror turns the direct beam back towards it
+  std::vector<BasicMirrorChange<ExternalCoordinateType>> changes;
+  for (const Reflection& backward_reflection : backward_reflections) {
+    const auto forward_iter = std::lower_bound(forward_reflections.begin(), forward_reflections.end(),
+                                               backward_reflection, is_less);
+    if (forward_iter == forward_reflections.end() || is_less(backward_reflection, *forward_iter)) {
+      continue;
+    }
+    BasicMirrorChange<ExternalCoordinateType> change{};
+    change.position.row = backward_reflection.arrival.position.row;
+    change.position.col = backward_reflection.arrival.position.col;
+    change.orientation = backward_reflection.mirror;
+    if (backward_reflection.arrival.is_horizontal == forward_iter->arrival.is_horizontal) {
+      change.change_type = MirrorChangeType::Removal;
+      ++result.removals;
+    } else {
+      change.change_type = MirrorChangeType::Flip;
+      ++result.flips;
+    }
+    changes.push_back(change);
+  }
+  std::sort(changes.begin(), changes.end(), [] (const auto& first, const auto& second) {
+    return first.position.row < second.position.row ||
+           (first.position.row == second.position.row && first.position.col < second.position.col);
+  });
+  result.changes = std::move(changes);
+  return result;
+}
+
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::save_snapshot(const std::string& path, bool with_trajectories) const
+{
+  BasicSnapshotTrajectories<Coordinate> trajectories{};
+  auto write = [this, &path, with_trajectories, &trajectories] (const auto& row_wise_mirrors,
+                                                               const auto& col_wise_mirrors) {
+    if (with_trajectories) {
+      InternalBeamState forward_start_state{};
+      forward_start_state.position = InternalPoint{START_POSITION<Coordinate>, START_POSITION<Coordinate>};
+      forward_start_state.is_positive = true;
+      forward_start_state.is_horizontal = true;
+      trace_the_beam_(row_wise_mirrors, col_wise_mirrors, forward_start_state, trajectories.forward_end_state,
+                      trajectories.forward_horizontal_segments, trajectories.forward_vertical_segments);
+      InternalBeamState backward_start_state{};
+      backward_start_state.position = InternalPoint{rows_, cols_};
+      backward_start_state.is_positive = false;
+      backward_start_state.is_horizontal = true;
+      InternalBeamState backward_end_state{};
+      trace_the_beam_(row_wise_mirrors, col_wise_mirrors, backward_start_state, backward_end_state,
+                      trajectories.backward_horizontal_segments, trajectories.backward_vertical_segments);
+    }
+    write_snapshot(path, rows_, cols_, row_wise_mirrors, col_wise_mirrors,
+                   with_trajectories ? &trajectories : nullptr);
+  };
+
+  if (snapshot_) {
+    write(snapshot_->row_wise_mirrors(), snapshot_->col_wise_mirrors());
+  } else if (row_wise_flat_mirrors_) {
+    write(row_wise_flat_mirrors_->view(), col_wise_flat_mirrors_->view());
+  } else {
+    with_index_([&write] (const auto& row_wise_index, const auto& col_wise_index) {
+      const BasicFlatMirrors<Coordinate> row_wise_mirrors = flatten_mirrors<Coordinate>(row_wise_index);
+      const BasicFlatMirrors<Coordinate> col_wise_mirrors = flatten_mirrors<Coordinate>(col_wise_index);
+      write(row_wise_mirrors.view(), col_wise_mirrors.view());
+    });
+  }
+}
+
+template <typename Coordinate>
+BasicSafeChecker<Coordinate> BasicSafeChecker<Coordinate>::load_snapshot(const std::string& path)
+{
+  return BasicSafeChecker{std::make_shared<const BasicMappedSnapshot<Coordinate>>(path)};
+}
+
+template <typename Coordinate>
+BasicSafeChecker<Coordinate> BasicSafeChecker<Coordinate>::make_variant(
+    std::shared_ptr<const BasicSafeChecker> base, const std::vector<ExternalPoint>& removed_mirrors,
+    const std::vector<ExternalPoint>& left_to_up_mirrors, const std::vector<ExternalPoint>& left_to_down_mirrors)
+{
+  if (!base) {
+    throw std::invalid_argument{"Base checker of the variant is not set"};
+  }
+  BasicSafeChecker result{base->variant_base_ ? base->variant_base_ : base};
+  result.row_wise_changes_ = base->row_wise_changes_;
+  result.col_wise_changes_ = base->col_wise_changes_;
+
+  for (const auto& removed_mirror : removed_mirrors) {
+    result.throw_if_out_of_bounds_(removed_mirror);
+    const InternalPoint point{static_cast<Coordinate>(removed_mirror.row), static_cast<Coordinate>(removed_mirror.col)};
+    const bool has_mirror = result.with_index_([&result, &point] (const auto& row_wise_mirrors, const auto&) {
+      return result.has_mirror_(row_wise_mirrors, point);
+    });
+    if (!has_mirror) {
+      throw std::invalid_argument{"No mirror to remove: " + std::to_string(removed_mirror.row) + " " +
+                                  std::to_string(removed_mirror.col)};
+    }
+    result.set_variant_position_(point, false, MirrorOrientation::LeftToUp);
+  }
+  for (const auto& left_to_up_mirror : left_to_up_mirrors) {
+    result.throw_if_out_of_bounds_(left_to_up_mirror);
+    result.set_variant_position_(InternalPoint{static_cast<Coordinate>(left_to_up_mirror.row),
+                                               static_cast<Coordinate>(left_to_up_mirror.col)},
+                                 true, MirrorOrientation::LeftToUp);
+  }
+  for (const auto& left_to_down_mirror : left_to_down_mirrors) {
+    result.throw_if_out_of_bounds_(left_to_down_mirror);
+    result.set_variant_position_(InternalPoint{static_cast<Coordinate>(left_to_down_mirror.row),
+                                               static_cast<Coordinate>(left_to_down_mirror.col)},
+                                 true, MirrorOrientation::LeftToDown);
+  }
+  return result;
+}
+
+template <typename Coordinate>
+std::size_t BasicSafeChecker<Coordinate>::variant_changes_count() const
+{
+  std::size_t result{0U};
+  for (const auto& changes_line : row_wise_changes_) {
+    result += changes_line.second.size();
+  }
   return result;
 }
 
-void SafeChecker::throw_if_out_of_bounds_(const Point& point) const
+template <typename Coordinate>
+MirrorsIndexLayout BasicSafeChecker<Coordinate>::index_layout() const
 {
-  if (point.row < START_POSITION || point.row > rows_) {
+  return layout_;
+}
+
+template <typename Coordinate>
+MemoryFootprint BasicSafeChecker<Coordinate>::memory_footprint() const
+{
+  MemoryFootprint footprint{};
+  if (row_wise_flat_mirrors_) {
+    footprint.row_wise_index_bytes = row_wise_flat_mirrors_->memory_bytes();
+    footprint.col_wise_index_bytes = col_wise_flat_mirrors_->memory_bytes();
+  } else {
+    footprint.row_wise_index_bytes = row_wise_index_bytes_;
+    footprint.col_wise_index_bytes = col_wise_index_bytes_;
+  }
+  for (const auto& arena : arenas_) {
+    footprint.arena_reserved_bytes += arena->reserved_bytes();
+  }
+  return footprint;
+}
+
+template <typename Coordinate>
+std::size_t BasicSafeChecker<Coordinate>::estimate_check_memory_(std::size_t mirrors_count)
+{
+  const std::size_t count = mirrors_count;
+  const std::size_t coordinate_size = sizeof(Coordinate);
+
+  // The reflections of both beams don't exceed four per mirror. The arrays growing by push_back can have
+  // up to twice the capacity of their size
+  const std::size_t segments_count = 4U * count + 2U;
+  const std::size_t trajectories_bytes = 2U * (segments_count + 2U) * sizeof(BasicBeamSegment<Coordinate>);
+  // The intersection search holds a sorted copy of the segments while it builds its arrays
+  // and the work estimates of the segments if it is split between threads
+  const std::size_t intersection_search_bytes = segments_count * sizeof(BasicBeamSegment<Coordinate>) +
+                                                segments_count * 4U * coordinate_size +
+                                                2U * (segments_count + 2U) * sizeof(std::size_t) +
+                                                segments_count * sizeof(std::uint64_t);
+  return trajectories_bytes + intersection_search_bytes;
+}
+
+template <typename Coordinate>
+std::size_t BasicSafeChecker<Coordinate>::estimate_peak_memory(std::size_t mirrors_count,
+                                                               MirrorsIndexLayout layout,
+                                                               std::size_t threads_count,
+                                                               const MemoryPolicy& policy)
+{
+  const std::size_t count = mirrors_count;
+  const std::size_t coordinate_size = sizeof(Coordinate);
+  const std::size_t check_bytes = estimate_check_memory_(count);
+
+  if (layout == MirrorsIndexLayout::Flat) {
+    const std::size_t index_bytes = count * (3U * coordinate_size + sizeof(MirrorOrientation)) +
+                                    2U * (count + 1U) * sizeof(std::uint64_t);
+    // The input is copied into the arrays of the rows, the columns and the orientations,
+    // which are sorted through two arrays of indexes
+    const std::size_t build_bytes = count * (2U * coordinate_size + sizeof(MirrorOrientation)) +
+                                    2U * count * sizeof(std::size_t);
+    return 2U * index_bytes + std::max(build_bytes, check_bytes);
+  }
+
+  // Each part of the parallel construction reserves its table for its mirrors, and the first part reserves
+  // the merged table, so the mirrors may be spread between the parts in any way. A bucket of a hash table
+  // is a pointer, and a reserved table has at most twice as many buckets as the elements plus two
+  const std::size_t parts_count =
+      threads_count > 1U && count >= MIN_PARALLEL_INDEX_MIRRORS ? std::max<std::size_t>(threads_count / 2U, 1U) : 1U;
+  const std::size_t buckets_count = parts_count == 1U ? 2U * count + 2U : 4U * count + 2U * parts_count + 2U;
+  const std::size_t line_node_bytes =
+      node_size(sizeof(void*) + sizeof(typename BasicMirrorsField<Coordinate>::value_type));
+  // A node of the red-black tree holds the color and three links
+  const std::size_t mirror_node_bytes =
+      4U * sizeof(void*) + node_size(sizeof(typename BasicMirrorsLine<Coordinate>::value_type));
+  const std::size_t index_bytes = buckets_count * sizeof(void*) + count * (line_node_bytes + mirror_node_bytes);
+  if (!policy.uses_arena()) {
+    return 2U * index_bytes + check_bytes;
+  }
+  // Each part of an index has its own arena, and the released tables stay in the arenas
+  return 2U * MemoryArena::max_reserved_bytes(index_bytes, parts_count) + check_bytes;
+}
+
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::set_variant_position_(const InternalPoint& point, bool is_present,
+                                                         MirrorOrientation orientation)
+{
+  MirrorOrientation base_orientation{};
+  const bool is_in_base = variant_base_->with_own_index_(
+      [&point, &base_orientation] (const auto& row_wise_mirrors, const auto&) {
+        return find_mirror(row_wise_mirrors, point.row, point.col, base_orientation);
+      });
+  if (is_in_base == is_present && (!is_present || base_orientation == orientation)) {
+    // The position returns to the state of the base
+    auto erase_change = [] (BasicMirrorsDelta<Coordinate>& changes, Coordinate line, Coordinate position) {
+      const auto changes_iter = changes.find(line);
+      if (changes_iter != changes.end()) {
+        changes_iter->second.erase(position);
+        if (changes_iter->second.empty()) {
+          changes.erase(changes_iter);
+        }
+      }
+    };
+    erase_change(row_wise_changes_, point.row, point.col);
+    erase_change(col_wise_changes_, point.col, point.row);
+    return;
+  }
+  row_wise_changes_[point.row][point.col] = MirrorOverride{is_present, orientation};
+  col_wise_changes_[point.col][point.row] = MirrorOverride{is_present, orientation};
+}
+
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::throw_if_out_of_bounds_(const ExternalPoint& point) const
+{
+  if (point.row < START_POSITION<ExternalCoordinateType> || point.row > rows_) {
     throw std::invalid_argument{"Incorrect row value: " + std::to_string(point.row)};
   }
-  if (point.col < START_POSITION || point.col > cols_) {
+  if (point.col < START_POSITION<ExternalCoordinateType> || point.col > cols_) {
     throw std::invalid_argument{"Incorrect column value: " + std::to_string(point.col)};
   }
 }
 
-void SafeChecker::trace_the_beam_(const BeamState& start_state,
-                                  BeamState& end_state,
-                                  BeamSegments& horizontal_segments,
-                                  BeamSegments& vertical_segments) const
+template <typename Coordinate>
+void BasicSafeChecker<Coordinate>::build_index_in_parallel_(ExternalPointsView left_to_up_mirrors,
+                                                            ExternalPointsView left_to_down_mirrors,
+                                                            const MemoryPolicy& policy)
 {
-  horizontal_segments.clear();
-  vertical_segments.clear();
+  // The row-wise and the column-wise indexes are built by the halves of the threads,
+  // each thread fills a range of lines into its own partial index
+  const std::size_t parts_count = std::max<std::size_t>(threads_count_ / 2U, 1U);
+  const std::size_t mirrors_count = left_to_up_mirrors.size() + left_to_down_mirrors.size();
+  // The arenas allocate their memory on the first use, so each part is placed on the NUMA node of its thread
+  std::vector<BasicMirrorsField<Coordinate>> row_wise_parts;
+  std::vector<BasicMirrorsField<Coordinate>> col_wise_parts;
+  row_wise_parts.reserve(parts_count);
+  col_wise_parts.reserve(parts_count);
+  for (std::size_t part = 0U; part < parts_count; ++part) {
+    row_wise_parts.push_back(make_field_(policy));
+    col_wise_parts.push_back(make_field_(policy));
+  }
+  // Index of the first mirror out of bounds in each range of rows. Mirrors are numbered "/" first, then "\\"
+  std::vector<std::size_t> first_invalid_indexes(parts_count, mirrors_count);
+  // Bytes allocated by each thread for its part
+  std::vector<std::ptrdiff_t> row_wise_part_bytes(parts_count, 0);
+  std::vector<std::ptrdiff_t> col_wise_part_bytes(parts_count, 0);
 
-  BeamState current_state = start_state;
-
-  // Check the initial position
-  const auto first_row_iter = row_wise_mirrors_.find(current_state.position.row);
-  if (first_row_iter != row_wise_mirrors_.end()) {
-    const auto& mirrors_line = first_row_iter->second;
-    const auto first_col_iter = mirrors_line.find(current_state.position.col);
-    if (first_col_iter != mirrors_line.end()) {
-      const MirrorOrientation mirror = first_col_iter->second;
-      current_state.is_horizontal = !current_state.is_horizontal;
-      if (mirror == MirrorOrientation::LeftToUp) {
-        current_state.is_positive = !current_state.is_positive;
+  auto fill_part = [&] (bool is_row_wise, std::size_t part) {
+    const AllocationCounter allocation_counter{};
+    BasicMirrorsField<Coordinate>& field = is_row_wise ? row_wise_parts[part] : col_wise_parts[part];
+    const ExternalCoordinateType lines_count = is_row_wise ? rows_ : cols_;
+    const ExternalCoordinateType part_width = lines_count / parts_count + 1U;
+    auto is_in_part = [&] (const ExternalPoint& mirror) {
+      const ExternalCoordinateType line = is_row_wise ? mirror.row : mirror.col;
+      return std::min<ExternalCoordinateType>(line / part_width, parts_count - 1U) == part;
+    };
+    // The table is reserved for the mirrors of the part, so it is not rehashed however the mirrors are spread
+    std::size_t part_mirrors_count{0U};
+    for (const ExternalPointsView mirrors : {left_to_up_mirrors, left_to_down_mirrors}) {
+      for (std::size_t index = 0U; index < mirrors.size(); ++index) {
+        part_mirrors_count += is_in_part(mirrors[index]) ? 1U : 0U;
       }
     }
-  }
-
-  bool should_continue{true};
-  while(should_continue) {
-    if (current_state.is_horizontal) {
-      Point next_position{};
-      next_position.row = current_state.position.row;
-      const auto row_iter = row_wise_mirrors_.find(current_state.position.row);
-      if (row_iter == row_wise_mirrors_.end()) {
-        next_position.col = current_state.is_positive ? cols_ : START_POSITION;
-        should_continue = false;
-      } else {
-        const auto& mirrors_line = row_iter->second;
-        auto closest_mirror_iter = mirrors_line.lower_bound(current_state.position.col);
-        if (current_state.is_positive) {
-          if (closest_mirror_iter != mirrors_line.end() &&
-              closest_mirror_iter->first == current_state.position.col) {
-            ++closest_mirror_iter;
-          }
-        } else {
-          if (closest_mirror_iter != mirrors_line.begin()) {
-            --closest_mirror_iter;
-          } else {
-            closest_mirror_iter = mirrors_line.end();
-          }
+    field.reserve(part_mirrors_count);
+    auto fill_mirrors = [&] (ExternalPointsView mirrors, MirrorOrientation orientation, std::size_t first_index) {
+      for (std::size_t index = 0U; index < mirrors.size(); ++index) {
+        const ExternalPoint mirror = mirrors[index];
+        if (!is_in_part(mirror)) {
+          continue;
         }
-        if (closest_mirror_iter == mirrors_line.end()) {
-          next_position.col = current_state.is_positive ? cols_ : START_POSITION;
-          should_continue = false;
-        } else {
-          next_position.col = closest_mirror_iter->first;
-          // Change direction
-          current_state.is_horizontal = false;
-          const MirrorOrientation mirror = closest_mirror_iter->second;
-          if (mirror == MirrorOrientation::LeftToUp) {
-            current_state.is_positive = !current_state.is_positive;
+        const ExternalCoordinateType line = is_row_wise ? mirror.row : mirror.col;
+        const bool is_on_grid = mirror.row >= START_POSITION<ExternalCoordinateType> && mirror.row <= rows_ &&
+                                mirror.col >= START_POSITION<ExternalCoordinateType> && mirror.col <= cols_;
+        if (!is_on_grid) {
+          if (is_row_wise) {
+            first_invalid_indexes[part] = std::min(first_invalid_indexes[part], first_index + index);
           }
+          continue;
         }
+        const auto position = static_cast<Coordinate>(is_row_wise ? mirror.col : mirror.row);
+        field[static_cast<Coordinate>(line)][position] = orientation;
       }
-      // Add a segment
-      const auto min_max_cols_pair = std::minmax(current_state.position.col, next_position.col);
-      BeamSegment segment{current_state.position.row, min_max_cols_pair.first, min_max_cols_pair.second};
-      horizontal_segments.push_back(segment);
-      // Go to the next position
-      current_state.position = next_position;
-    } else {
-      Point next_position{};
-      next_position.col = current_state.position.col;
-      const auto col_iter = col_wise_mirrors_.find(current_state.position.col);
-      if (col_iter == col_wise_mirrors_.end()) {
-        next_position.row = current_state.is_positive ? rows_ : START_POSITION;
-        should_continue = false;
-      } else {
-        const auto& mirrors_line = col_iter->second;
-        auto closest_mirror_iter = mirrors_line.lower_bound(current_state.position.row);
-        if (current_state.is_positive) {
-          if (closest_mirror_iter != mirrors_line.end() &&
-              closest_mirror_iter->first == current_state.position.row) {
-            ++closest_mirror_iter;
-          }
-        } else {
-          if (closest_mirror_iter != mirrors_line.begin()) {
-            --closest_mirror_iter;
-          } else {
-            closest_mirror_iter = mirrors_line.end();
-          }
-        }
-        if (closest_mirror_iter == mirrors_line.end()) {
-          next_position.row = current_state.is_positive ? rows_ : START_POSITION;
-          should_continue = false;
-        } else {
-          next_position.row = closest_mirror_iter->first;
-          // Change direction
-          current_state.is_horizontal = true;
-          const MirrorOrientation mirror = closest_mirror_iter->second;
-          if (mirror == MirrorOrientation::LeftToUp) {
-            current_state.is_positive = !current_state.is_positive;
-          }
-        }
+    };
+    fill_mirrors(left_to_up_mirrors, MirrorOrientation::LeftToUp, 0U);
+    fill_mirrors(left_to_down_mirrors, MirrorOrientation::LeftToDown, left_to_up_mirrors.size());
+    (is_row_wise ? row_wise_part_bytes : col_wise_part_bytes)[part] = allocation_counter.bytes();
+  };
+
+  // Even jobs fill the row-wise parts, odd ones the column-wise parts
+  ThreadPool::shared().run_parts(2U * parts_count, [&fill_part] (std::size_t job) {
+    fill_part(job % 2U == 0U, job / 2U);
+  });
+
+  const std::size_t first_invalid_index =
+      *std::min_element(first_invalid_indexes.begin(), first_invalid_indexes.end());
+  if (first_invalid_index < left_to_up_mirrors.size()) {
+    throw_if_out_of_bounds_(left_to_up_mirrors[first_invalid_index]);
+  } else if (first_invalid_index < mirrors_count) {
+    throw_if_out_of_bounds_(left_to_down_mirrors[first_invalid_index - left_to_up_mirrors.size()]);
+  }
+
+  // The ranges of lines don't overlap, so the lines are moved without merging.
+  // Allocators of all arenas compare equal, so the nodes of the lines are not copied
+  // The parts are destroyed in the scope of the counter, so the released nodes and tables are subtracted
+  auto merge_parts = [] (std::vector<BasicMirrorsField<Coordinate>>& parts, BasicMirrorsField<Coordinate>& field,
+                         const std::vector<std::ptrdiff_t>& parts_bytes) {
+    const AllocationCounter allocation_counter{};
+    std::size_t lines_count{0U};
+    for (const BasicMirrorsField<Coordinate>& part_field : parts) {
+      lines_count += part_field.size();
+    }
+    field = std::move(parts.front());
+    field.reserve(lines_count);
+    for (std::size_t part = 1U; part < parts.size(); ++part) {
+      for (auto& line : parts[part]) {
+        field.emplace(line.first, std::move(line.second));
       }
-      // Add a segment
-      const auto min_max_rows_pair = std::minmax(current_state.position.row, next_position.row);
-      BeamSegment segment{current_state.position.col, min_max_rows_pair.first, min_max_rows_pair.second};
-      vertical_segments.push_back(segment);
-      // Go to the next position
-      current_state.position = next_position;
     }
+    parts.clear();
+    std::ptrdiff_t bytes = allocation_counter.bytes();
+    for (const std::ptrdiff_t part_bytes : parts_bytes) {
+      bytes += part_bytes;
+    }
+    return static_cast<std::size_t>(bytes);
+  };
+  row_wise_index_bytes_ = merge_parts(row_wise_parts, row_wise_mirrors_, row_wise_part_bytes);
+  col_wise_index_bytes_ = merge_parts(col_wise_parts, col_wise_mirrors_, col_wise_part_bytes);
+}
+
+template <typename Coordinate>
+template <typename MirrorsIndex>
+void BasicSafeChecker<Coordinate>::trace_the_beam_(const MirrorsIndex& row_wise_mirrors,
+                                                   const MirrorsIndex& col_wise_mirrors,
+                                                   const InternalBeamState& start_state,
+                                                   InternalBeamState& end_state,
+                                                   InternalBeamSegments& horizontal_segments,
+                                                   InternalBeamSegments& vertical_segments,
+                                                   std::vector<Reflection>* reflections,
+                                                   CheckLimitsPoller* poller) const
+{
+  TraceScope trace_scope{"trace_the_beam"};
+  horizontal_segments.clear();
+  vertical_segments.clear();
+
+  InternalBeamState current_state = start_state;
+  start_the_beam_(row_wise_mirrors, current_state, reflections);
+  bool should_continue{true};
+  while(should_continue) {
+    if (poller != nullptr && poller->should_stop()) {
+      break;
+    }
+    should_continue = trace_step_(row_wise_mirrors, col_wise_mirrors, current_state,
+                                  horizontal_segments, vertical_segments, reflections);
   }
   end_state = current_state;
+  trace_scope.set_segments(horizontal_segments.size() + vertical_segments.size());
 }
 
-bool SafeChecker::has_mirror_(const Point& point) const
+template <typename Coordinate>
+template <typename MirrorsIndex>
+void BasicSafeChecker<Coordinate>::trace_beams_interleaved_(const MirrorsIndex& row_wise_mirrors,
+                                                            const MirrorsIndex& col_wise_mirrors,
+                                                            const InternalBeamState& forward_start_state,
+                                                            InternalBeamState& forward_end_state,
+                                                            InternalBeamSegments& forward_horizontal_segments,
+                                                            InternalBeamSegments& forward_vertical_segments,
+                                                            const InternalBeamState& backward_start_state,
+                                                            InternalBeamState& backward_end_state,
+                                                            InternalBeamSegments& backward_horizontal_segments,
+                                                            InternalBeamSegments& backward_vertical_segments,
+                                                            CheckLimitsPoller* poller) const
 {
-  const auto mirror_row_iter = row_wise_mirrors_.find(point.row);
-  if (mirror_row_iter == row_wise_mirrors_.end()) {
-    return false;
+  TraceScope trace_scope{"trace_beams_interleaved"};
+  forward_horizontal_segments.clear();
+  forward_vertical_segments.clear();
+  backward_horizontal_segments.clear();
+  backward_vertical_segments.clear();
+
+  // The next lookup of a beam is in the row of its position if it goes horizontally, otherwise in the column
+  auto prefetch_next_line = [&row_wise_mirrors, &col_wise_mirrors] (const InternalBeamState& state) {
+    if (state.is_horizontal) {
+      prefetch_line(row_wise_mirrors, state.position.row);
+    } else {
+      prefetch_line(col_wise_mirrors, state.position.col);
+    }
+  };
+
+  forward_end_state = forward_start_state;
+  backward_end_state = backward_start_state;
+  start_the_beam_(row_wise_mirrors, forward_end_state, nullptr);
+  start_the_beam_(row_wise_mirrors, backward_end_state, nullptr);
+  bool forward_continues{true};
+  bool backward_continues{true};
+  while (forward_continues || backward_continues) {
+    if (poller != nullptr && poller->should_stop()) {
+      break;
+    }
+    if (forward_continues) {
+      if (backward_continues) {
+        prefetch_next_line(backward_end_state);
+      }
+      forward_continues = trace_step_(row_wise_mirrors, col_wise_mirrors, forward_end_state,
+                                      forward_horizontal_segments, forward_vertical_segments, nullptr);
+      // The reverse trajectory is not needed if the safe opens without insertions
+      if (!forward_continues && reaches_detector_(forward_end_state)) {
+        break;
+      }
+    }
+    if (backward_continues) {
+      if (forward_continues) {
+        prefetch_next_line(forward_end_state);
+      }
+      backward_continues = trace_step_(row_wise_mirrors, col_wise_mirrors, backward_end_state,
+                                       backward_horizontal_segments, backward_vertical_segments, nullptr);
+    }
   }
-  const auto& mirror_row = mirror_row_iter->second;
-  const auto mirror_col_iter = mirror_row.find(point.col);
-  return mirror_col_iter != mirror_row.end();
+  trace_scope.set_segments(forward_horizontal_segments.size() + forward_vertical_segments.size() +
+                           backward_horizontal_segments.size() + backward_vertical_segments.size());
 }
 
-std::vector<Point> SafeChecker::find_intersections_(const BeamSegments& forward_horizontal_segments,
-                                                    const BeamSegments& forward_vertical_segments,
-                                                    const BeamSegments& backward_horizontal_segments,
-                                                    const BeamSegments& backward_vertical_segments) const
+template <typename Coordinate>
+template <typename MirrorsIndex>
+void BasicSafeChecker<Coordinate>::start_the_beam_(const MirrorsIndex& row_wise_mirrors, InternalBeamState& state,
+                                                   std::vector<Reflection>* reflections) const
 {
-  std::vector<Point> intersections;
-  const IntersectionSearchHelperMap forward_horizontal_segments_map = beam_segments_to_map(forward_horizontal_segments);
-  const IntersectionSearchHelperMap forward_vertical_segments_map = beam_segments_to_map(forward_vertical_segments);
+  MirrorOrientation mirror{};
+  if (find_mirror(row_wise_mirrors, state.position.row, state.position.col, mirror)) {
+    if (reflections != nullptr) {
+      reflections->push_back(Reflection{state, mirror});
+    }
+    state.is_horizontal = !state.is_horizontal;
+    if (mirror == MirrorOrientation::LeftToUp) {
+      state.is_positive = !state.is_positive;
+    }
+  }
+}
 
-  for (const auto& segment : backward_horizontal_segments) {
-    const std::uint32_t row = segment.first_coordinate;
-    auto col_iter = forward_vertical_segments_map.lower_bound(segment.second_coordinate_start);
-    while (col_iter != forward_vertical_segments_map.end() && col_iter->first <= segment.second_coordinate_end) {
-      const std::uint32_t col = col_iter->first;
-      if (col_iter->second.has_intersection(row)) {
-        const Point intersection{row, col};
-        if (!has_mirror_(intersection)) {
-          intersections.push_back(intersection);
-        }
-      }
-      ++col_iter;
-    }
-  }
-  for (const auto& segment : backward_vertical_segments) {
-    const std::uint32_t col = segment.first_coordinate;
-    auto row_iter = forward_horizontal_segments_map.lower_bound(segment.second_coordinate_start);
-    while (row_iter != forward_horizontal_segments_map.end() && row_iter->first <= segment.second_coordinate_end) {
-      const std::uint32_t row = row_iter->first;
-      if (row_iter->second.has_intersection(col)) {
-        const Point intersection{row, col};
-        if (!has_mirror_(intersection)) {
-          intersections.push_back(intersection);
-        }
+template <typename Coordinate>
+template <typename MirrorsIndex>
+bool BasicSafeChecker<Coordinate>::trace_step_(const MirrorsIndex& row_wise_mirrors,
+                                               const MirrorsIndex& col_wise_mirrors,
+                                               InternalBeamState& state,
+                                               InternalBeamSegments& horizontal_segments,
+                                               InternalBeamSegments& vertical_segments,
+                                               std::vector<Reflection>* reflections) const
+{
+  MirrorOrientation mirror{};
+  auto reflect = [reflections, &state, &mirror] (const InternalPoint& position) {
+    if (reflections != nullptr) {
+      Reflection reflection{};
+      reflection.arrival = state;
+      reflection.arrival.position = position;
+      reflection.mirror = mirror;
+      reflections->push_back(reflection);
+    }
+    // Change direction
+    state.is_horizontal = !state.is_horizontal;
+    if (mirror == MirrorOrientation::LeftToUp) {
+      state.is_positive = !state.is_positive;
+    }
+  };
+
+  bool has_mirror{false};
+  if (state.is_horizontal) {
+    InternalPoint next_position{};
+    next_position.row = state.position.row;
+    has_mirror = find_next_mirror(row_wise_mirrors, state.position.row, state.position.col,
+                                  state.is_positive, next_position.col, mirror);
+    if (!has_mirror) {
+      next_position.col = state.is_positive ? cols_ : START_POSITION<Coordinate>;
+    }
+    // Add a segment
+    const auto min_max_cols_pair = std::minmax(state.position.col, next_position.col);
+    horizontal_segments.push_back(BasicBeamSegment<Coordinate>{state.position.row,
+                                                               min_max_cols_pair.first,
+                                                               min_max_cols_pair.second});
+    if (has_mirror) {
+      reflect(next_position);
+    }
+    // Go to the next position
+    state.position = next_position;
+  } else {
+    InternalPoint next_position{};
+    next_position.col = state.position.col;
+    has_mirror = find_next_mirror(col_wise_mirrors, state.position.col, state.position.row,
+                                  state.is_positive, next_position.row, mirror);
+    if (!has_mirror) {
+      next_position.row = state.is_positive ? rows_ : START_POSITION<Coordinate>;
+    }
+    // Add a segment
+    const auto min_max_rows_pair = std::minmax(state.position.row, next_position.row);
+    vertical_segments.push_back(BasicBeamSegment<Coordinate>{state.position.col,
+                                                             min_max_rows_pair.first,
+                                                             min_max_rows_pair.second});
+    if (has_mirror) {
+      reflect(next_position);
+    }
+    // Go to the next position
+    state.position = next_position;
+  }
+  return has_mirror;
+}
+
+template <typename Coordinate>
+template <typename MirrorsIndex>
+bool BasicSafeChecker<Coordinate>::has_mirror_(const MirrorsIndex& row_wise_mirrors, const InternalPoint& point) const
+{
+  MirrorOrientation mirror{};
+  return find_mirror(row_wise_mirrors, point.row, point.col, mirror);
+}
+
+template <typename Coordinate>
+template <typename MirrorsIndex>
+auto BasicSafeChecker<Coordinate>::find_intersections_(const MirrorsIndex& row_wise_mirrors,
+                                                       const InternalBeamSegments& forward_horizontal_segments,
+                                                       const InternalBeamSegments& forward_vertical_segments,
+                                                       const InternalBeamSegments& backward_horizontal_segments,
+                                                       const InternalBeamSegments& backward_vertical_segments,
+                                                       CheckLimitsPoller* poller) const
+    -> IntersectionsSummary
+{
+  const BasicIntersectionSearchHelperMap<Coordinate> forward_horizontal_segments_map =
+      beam_segments_to_map(forward_horizontal_segments);
+  const BasicIntersectionSearchHelperMap<Coordinate> forward_vertical_segments_map =
+      beam_segments_to_map(forward_vertical_segments);
+  // A map holds a sorted copy of its segments while it is built
+  const std::size_t segment_size = sizeof(BasicBeamSegment<Coordinate>);
+  const std::uint64_t maps_scratch_bytes =
+      std::max({forward_horizontal_segments.size() * segment_size,
+                forward_horizontal_segments_map.memory_bytes() + forward_vertical_segments.size() * segment_size,
+                forward_horizontal_segments_map.memory_bytes() + forward_vertical_segments_map.memory_bytes()});
+
+  // The backward horizontal segments are numbered first, then the vertical ones
+  const std::size_t horizontal_count = backward_horizontal_segments.size();
+  const std::size_t segments_count = horizontal_count + backward_vertical_segments.size();
+  auto search_in_range = [&] (std::size_t begin, std::size_t end, IntersectionsSummary& summary) {
+    TraceScope trace_scope{"intersect_backward_segments"};
+    trace_scope.set_segments(end - begin);
+    for (std::size_t index = begin; index < std::min(end, horizontal_count) && !is_stopped(poller); ++index) {
+      find_segment_intersections_(row_wise_mirrors, forward_vertical_segments_map,
+                                  backward_horizontal_segments[index], true, summary, poller);
+    }
+    for (std::size_t index = std::max(begin, horizontal_count); index < end && !is_stopped(poller); ++index) {
+      find_segment_intersections_(row_wise_mirrors, forward_horizontal_segments_map,
+                                  backward_vertical_segments[index - horizontal_count], false, summary, poller);
+    }
+  };
+
+  IntersectionsSummary result{};
+  result.scratch_bytes = maps_scratch_bytes;
+  if (threads_count_ <= 1U || segments_count <= 1U) {
+    search_in_range(0U, segments_count, result);
+    return result;
+  }
+
+  // A segment can't cross more lines of the forward trajectory than its length or the number of the lines
+  std::vector<std::uint64_t> segments_work(segments_count);
+  for (std::size_t index = 0U; index < segments_count; ++index) {
+    const bool is_horizontal = index < horizontal_count;
+    const auto& segment = is_horizontal ? backward_horizontal_segments[index]
+                                        : backward_vertical_segments[index - horizontal_count];
+    const std::size_t lines_count = is_horizontal ? forward_vertical_segments_map.size()
+                                                  : forward_horizontal_segments_map.size();
+    const std::uint64_t length = static_cast<std::uint64_t>(segment.second_coordinate_end) -
+                                 segment.second_coordinate_start + 1U;
+    segments_work[index] = 1U + std::min<std::uint64_t>(length, lines_count);
+  }
+  const std::vector<std::size_t> bounds =
+      split_by_work(segments_work, threads_count_, MIN_PARALLEL_INTERSECTIONS_WORK);
+  result.scratch_bytes += segments_work.capacity() * sizeof(std::uint64_t);
+  const std::size_t parts_count = bounds.size() - 1U;
+  if (parts_count == 1U) {
+    search_in_range(0U, segments_count, result);
+    return result;
+  }
+
+  // Each thread searches in its own part with its own summary, the summaries are merged in the order of the parts
+  std::vector<IntersectionsSummary> summaries(parts_count);
+  ThreadPool::shared().run_parts(parts_count, bind_trace_case([&] (std::size_t part) {
+    search_in_range(bounds[part], bounds[part + 1U], summaries[part]);
+  }));
+  for (const auto& summary : summaries) {
+    result.merge(summary);
+  }
+  return result;
+}
+
+template <typename Coordinate>
+template <typename MirrorsIndex, typename LinesMap>
+void BasicSafeChecker<Coordinate>::find_segment_intersections_(const MirrorsIndex& row_wise_mirrors,
+                                                               const LinesMap& forward_lines,
+                                                               const BasicBeamSegment<Coordinate>& segment,
+                                                               bool is_horizontal,
+                                                               IntersectionsSummary& summary,
+                                                               CheckLimitsPoller* poller) const
+{
+  std::size_t line_index = forward_lines.lower_bound(segment.second_coordinate_start);
+  while (line_index < forward_lines.size() && forward_lines.line(line_index) <= segment.second_coordinate_end) {
+    if (poller != nullptr && poller->should_stop()) {
+      return;
+    }
+    ++summary.candidates;
+    if (forward_lines.helper(line_index).has_intersection(segment.first_coordinate)) {
+      const Coordinate line = forward_lines.line(line_index);
+      const InternalPoint intersection = is_horizontal ? InternalPoint{segment.first_coordinate, line}
+                                                       : InternalPoint{line, segment.first_coordinate};
+      ++summary.lookups;
+      if (!has_mirror_(row_wise_mirrors, intersection)) {
+        summary.add(intersection);
       }
-      ++row_iter;
     }
+    ++line_index;
   }
-  return intersections;
+}
+
+template class BasicSafeChecker<std::uint16_t>;
+template class BasicSafeChecker<std::uint32_t>;
+template class BasicSafeChecker<std::uint64_t>;
+
+SafeChecker::SafeChecker(std::uint32_t rows, std::uint32_t columns,
+                         const std::vector<Point>& left_to_up_mirrors,
+                         const std::vector<Point>& left_to_down_mirrors,
+                         std::size_t threads_count,
+                         MirrorsIndexLayout layout,
+                         std::size_t memory_budget)
+  : SafeChecker{rows, columns, PointsView{left_to_up_mirrors}, PointsView{left_to_down_mirrors}, threads_count, layout,
+                memory_budget}
+{
+}
+
+SafeChecker::SafeChecker(std::uint32_t rows, std::uint32_t columns,
+                         PointsView left_to_up_mirrors,
+                         PointsView left_to_down_mirrors,
+                         std::size_t threads_count,
+                         MirrorsIndexLayout layout,
+                         std::size_t memory_budget)
+{
+  if (rows <= std::numeric_limits<std::uint16_t>::max() && columns <= std::numeric_limits<std::uint16_t>::max()) {
+    narrow_checker_.reset(new BasicSafeChecker<std::uint16_t>{rows, columns, left_to_up_mirrors,
+                                                              left_to_down_mirrors, threads_count, layout,
+                                                              memory_budget});
+  } else {
+    wide_checker_.reset(new BasicSafeChecker<std::uint32_t>{rows, columns, left_to_up_mirrors,
+                                                            left_to_down_mirrors, threads_count, layout,
+                                                            memory_budget});
+  }
+}
+
+template <typename Function>
+auto SafeChecker::visit_(Function&& function) const
+    -> decltype(function(std::declval<const BasicSafeChecker<std::uint32_t>&>()))
+{
+  if (narrow_checker_) {
+    return function(*narrow_checker_);
+  }
+  return function(*wide_checker_);
+}
+
+SafeCheckResult SafeChecker::check_safe() const
+{
+  SafeCheckStatistics statistics{};
+  return check_safe(statistics);
+}
+
+SafeCheckResult SafeChecker::check_safe(SafeCheckStatistics& statistics) const
+{
+  return visit_([&statistics] (const auto& checker) { return checker.check_safe(statistics); });
+}
+
+LimitedCheckResult SafeChecker::check_safe(const CheckLimits& limits) const
+{
+  return visit_([&limits] (const auto& checker) { return checker.check_safe(limits); });
+}
+
+std::future<LimitedCheckResult> SafeChecker::check_safe_async(const CheckLimits& limits) const
+{
+  return ThreadPool::shared().submit(bind_trace_case([this, limits] () { return check_safe(limits); }));
+}
+
+void SafeChecker::set_threads_count(std::size_t threads_count)
+{
+  if (narrow_checker_) {
+    narrow_checker_->set_threads_count(threads_count);
+  } else {
+    wide_checker_->set_threads_count(threads_count);
+  }
+}
+
+void SafeChecker::set_tracing_mode(BeamTracingMode mode)
+{
+  if (narrow_checker_) {
+    narrow_checker_->set_tracing_mode(mode);
+  } else {
+    wide_checker_->set_tracing_mode(mode);
+  }
+}
+
+MinimalInsertionResult SafeChecker::find_minimal_insertions() const
+{
+  return visit_([] (const auto& checker) { return checker.find_minimal_insertions(); });
+}
+
+MirrorChangesResult SafeChecker::find_single_mirror_changes() const
+{
+  return visit_([] (const auto& checker) { return checker.find_single_mirror_changes(); });
+}
+
+SafeChecker SafeChecker::make_variant(std::shared_ptr<const SafeChecker> base,
+                                      const std::vector<Point>& removed_mirrors,
+                                      const std::vector<Point>& left_to_up_mirrors,
+                                      const std::vector<Point>& left_to_down_mirrors)
+{
+  if (!base) {
+    throw std::invalid_argument{"Base checker of the variant is not set"};
+  }
+  // The variant refers to the implementation of the base, which is kept alive by the shared ownership of the base
+  SafeChecker result{};
+  if (base->narrow_checker_) {
+    const std::shared_ptr<const BasicSafeChecker<std::uint16_t>> base_checker{base, base->narrow_checker_.get()};
+    result.narrow_checker_.reset(new BasicSafeChecker<std::uint16_t>{BasicSafeChecker<std::uint16_t>::make_variant(
+        base_checker, removed_mirrors, left_to_up_mirrors, left_to_down_mirrors)});
+  } else {
+    const std::shared_ptr<const BasicSafeChecker<std::uint32_t>> base_checker{base, base->wide_checker_.get()};
+    result.wide_checker_.reset(new BasicSafeChecker<std::uint32_t>{BasicSafeChecker<std::uint32_t>::make_variant(
+        base_checker, removed_mirrors, left_to_up_mirrors, left_to_down_mirrors)});
+  }
+  return result;
+}
+
+std::size_t SafeChecker::variant_changes_count() const
+{
+  return visit_([] (const auto& checker) { return checker.variant_changes_count(); });
+}
+
+MirrorsIndexLayout SafeChecker::index_layout() const
+{
+  return visit_([] (const auto& checker) { return checker.index_layout(); });
+}
+
+MemoryFootprint SafeChecker::memory_footprint() const
+{
+  return visit_([] (const auto& checker) { return checker.memory_footprint(); });
+}
+
+std::size_t SafeChecker::coordinate_width() const
+{
+  return narrow_checker_ ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+}
+
+void SafeChecker::save_snapshot(const std::string& path, bool with_trajectories) const
+{
+  visit_([&path, with_trajectories] (const auto& checker) { checker.save_snapshot(path, with_trajectories); });
+}
+
+SafeChecker SafeChecker::load_snapshot(const std::string& path)
+{
+  SafeChecker result{};
+  const std::size_t coordinate_width = read_snapshot_coordinate_width(path);
+  if (coordinate_width == sizeof(std::uint16_t)) {
+    result.narrow_checker_.reset(new BasicSafeChecker<std::uint16_t>{
+        BasicSafeChecker<std::uint16_t>::load_snapshot(path)});
+  } else if (coordinate_width == sizeof(std::uint32_t)) {
+    result.wide_checker_.reset(new BasicSafeChecker<std::uint32_t>{
+        BasicSafeChecker<std::uint32_t>::load_snapshot(path)});
+  } else {
+    throw std::runtime_error{"Snapshot coordinate width is not supported: " + path};
+  }
+  return result;
 }
 
 }  // namespace mirrors_lasers
@@ -1,8 +1,22 @@
 #ifndef SAFE_CHECKER
 #define SAFE_CHECKER
 
+#include "memory_arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <scoped_allocator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
@@ -17,41 +31,147 @@ enum class MirrorOrientation : std::int8_t
   LeftToDown
 };
 
+/// @brief Coordinate type used in the interface of a checker with the given internal coordinate type
+///
+/// @details Coordinates narrower than 32 bits are used only inside the checker,
+/// the input and the result are always at least 32-bit wide
+template <typename Coordinate>
+using ExternalCoordinate =
+    typename std::conditional<(sizeof(Coordinate) < sizeof(std::uint32_t)), std::uint32_t, Coordinate>::type;
+
 /// @brief Data structure to store positions of mirrors in each row and column
-using MirrorsLine = std::map<std::uint32_t, MirrorOrientation>;
+template <typename Coordinate>
+using BasicMirrorsLine = std::map<Coordinate, MirrorOrientation, std::less<Coordinate>,
+                                  ArenaAllocator<std::pair<const Coordinate, MirrorOrientation>>>;
 
 /// @brief Data structure to store positions of all mirrors in the grid
-using MirrorsField = std::unordered_map<std::uint32_t, MirrorsLine>;
+///
+/// @details The scoped allocator passes the arena of the field to the lines created in it
+template <typename Coordinate>
+using BasicMirrorsField =
+    std::unordered_map<Coordinate, BasicMirrorsLine<Coordinate>, std::hash<Coordinate>, std::equal_to<Coordinate>,
+                       std::scoped_allocator_adaptor<
+                           ArenaAllocator<std::pair<const Coordinate, BasicMirrorsLine<Coordinate>>>>>;
+
+/// @brief Representation of the index of the mirrors built by a checker
+enum class MirrorsIndexLayout {
+  /// @brief Hash table of the lines, each line is an ordered dictionary of the mirrors. Lookups take constant time
+  /// to find the line and logarithmic time in the line
+  Hashed,
+  /// @brief Mirrors sorted by the lines and positions in flat arrays, built by a linear-time radix sort.
+  /// No structure is built for a line, the arrays are searched only in the lines the beams visit
+  Flat
+};
+
+/// @brief Order in which the beams from the laser and from the detector are traced
+enum class BeamTracingMode {
+  /// @brief The beam from the detector is traced after the beam from the laser, only if the latter doesn't open
+  /// the safe
+  Sequential,
+  /// @brief Both beams are traced by a single thread in lockstep, one reflection of each in turn. The line
+  /// of the next lookup of a beam is prefetched before the lookup of the other beam, so the cache misses
+  /// of the beams overlap
+  Interleaved
+};
+
+/// @brief State of a position of the mirrors changed in a variant of a safe relative to its base
+struct MirrorOverride final {
+  /// @brief True if the variant has a mirror in the position, false if the mirror of the base is removed
+  bool is_present{false};
+  /// @brief Orientation of the mirror of the variant
+  MirrorOrientation orientation{MirrorOrientation::LeftToUp};
+};
+
+/// @brief Changes of the mirrors of a variant relative to its base, grouped by lines as in BasicMirrorsField
+template <typename Coordinate>
+using BasicMirrorsDelta = std::unordered_map<Coordinate, std::map<Coordinate, MirrorOverride>>;
 
 /// @brief Structure containing base information about beam segment
-struct BeamSegment final {
+template <typename Coordinate>
+struct BasicBeamSegment final {
   /// @brief Row number if the segment is horizontal or column number if the segment is vertical
-  std::uint32_t first_coordinate{0U};
+  Coordinate first_coordinate{0U};
   /// @brief Coordinate of a start position of the beam segment.
   ///
   /// @details Is a column number if the segment is horizontal or row number if the segment is vertical
-  std::uint32_t second_coordinate_start{0U};
+  Coordinate second_coordinate_start{0U};
   /// @brief Coordinate of an end position of the beam segment.
   ///
   /// @details Is a column number if the segment is horizontal or row number if the segment is vertical
-  std::uint32_t second_coordinate_end{0U};
+  Coordinate second_coordinate_end{0U};
 };
 
 /// @brief Array containing beam segments
-using BeamSegments = std::vector<BeamSegment>;
+template <typename Coordinate>
+using BasicBeamSegments = std::vector<BasicBeamSegment<Coordinate>>;
 
 /// @brief Structure containing coordinates of a point on the mechanism grid
-struct Point final {
+template <typename Coordinate>
+struct BasicPoint final {
   /// @brief Row number
-  std::uint32_t row{0U};
+  Coordinate row{0U};
   /// @brief Column number
-  std::uint32_t col{0U};
+  Coordinate col{0U};
+};
+
+/// @brief Read-only view of a list of points owned by the caller, which is not copied
+///
+/// @details Refers either to an array of points or to an array of coordinates, where the row and the column
+/// of each point follow each other. The array must stay alive while the view is used
+template <typename Coordinate>
+class BasicPointsView final {
+public:
+  /// @brief Constructs the view over a vector of points
+  explicit BasicPointsView(const std::vector<BasicPoint<Coordinate>>& points)
+    : points_{points.data()}
+    , size_{points.size()}
+  {
+  }
+
+  /// @brief Constructs the view over an array of points
+  ///
+  /// @param points The points, may be nullptr if the size is zero
+  /// @param size Number of the points
+  BasicPointsView(const BasicPoint<Coordinate>* points, std::size_t size)
+    : points_{points}
+    , size_{size}
+  {
+  }
+
+  /// @brief Constructs the view over an array of coordinates
+  ///
+  /// @param coordinates The row and the column of each point, 2 * size values. May be nullptr if the size is zero
+  /// @param size Number of the points
+  static BasicPointsView from_coordinates(const Coordinate* coordinates, std::size_t size)
+  {
+    BasicPointsView result{nullptr, size};
+    result.coordinates_ = coordinates;
+    return result;
+  }
+
+  /// @brief Returns the number of the points
+  std::size_t size() const { return size_; }
+
+  /// @brief Returns the point by its index
+  BasicPoint<Coordinate> operator[](std::size_t index) const
+  {
+    if (points_ != nullptr) {
+      return points_[index];
+    }
+    return BasicPoint<Coordinate>{coordinates_[2U * index], coordinates_[2U * index + 1U]};
+  }
+
+private:
+  const BasicPoint<Coordinate>* points_{nullptr};
+  const Coordinate* coordinates_{nullptr};
+  std::size_t size_{0U};
 };
 
 /// @brief Structure containing information about state of the beam in a certain position
-struct BeamState final {
+template <typename Coordinate>
+struct BasicBeamState final {
   /// @brief Position on the mechanism grid for which information about the beam is provided
-  Point position{0U, 0U};
+  BasicPoint<Coordinate> position{0U, 0U};
   /// @brief Direction of the beam. Left to right or up to down directions are considered positive
   bool is_positive{false};
   /// @brief True if the beam direction is horizontal, false - if vertical
@@ -70,7 +190,8 @@ enum class SafeCheckResultType : std::int8_t {
 };
 
 /// @brief Structure containing complete information describing the check result
-struct SafeCheckResult final {
+template <typename Coordinate>
+struct BasicSafeCheckResult final {
   /// @brief Type of the check result
   SafeCheckResultType result_type{SafeCheckResultType::OpensWithoutInserting};
   /// @brief Number of positions where inserting a mirror opens the safe
@@ -80,82 +201,860 @@ struct SafeCheckResult final {
   /// @brief Row of the lexicographically smallest position, where a mirror, opening the safe can be inserted
   ///
   /// @details The field value is valid only if the result_type is SafeCheckResultType::RequiresMirrorInsertion
-  std::uint32_t mirror_row{0U};
+  Coordinate mirror_row{0U};
   /// @brief Column of the lexicographically smallest position, where a mirror, opening the safe can be inserted
   ///
   /// @details The field value is valid only if the result_type is SafeCheckResultType::RequiresMirrorInsertion
-  std::uint32_t mirror_col{0U};
+  Coordinate mirror_col{0U};
+};
+
+/// @brief Structure describing a mirror which should be inserted into the grid
+template <typename Coordinate>
+struct BasicMirrorPlacement final {
+  /// @brief Position of the inserted mirror
+  BasicPoint<Coordinate> position{0U, 0U};
+  /// @brief Orientation of the inserted mirror
+  MirrorOrientation orientation{MirrorOrientation::LeftToUp};
+};
+
+/// @brief Structure containing the minimal number of mirrors which should be inserted to open the safe
+template <typename Coordinate>
+struct BasicMinimalInsertionResult final {
+  /// @brief Type of the result. SafeCheckResultType::CanNotBeOpened means that the safe can't be opened
+  /// with any number of inserted mirrors
+  SafeCheckResultType result_type{SafeCheckResultType::OpensWithoutInserting};
+  /// @brief Minimal number of mirrors which should be inserted to open the safe
+  ///
+  /// @details The field value is valid only if the result_type is not SafeCheckResultType::CanNotBeOpened
+  std::uint32_t insertions{0U};
+  /// @brief One of the placements of the inserted mirrors opening the safe, in order of the beam passing them
+  std::vector<BasicMirrorPlacement<Coordinate>> placements;
+};
+
+/// @brief Change of an existing mirror
+enum class MirrorChangeType : std::int8_t {
+  /// @brief The mirror is removed
+  Removal,
+  /// @brief The mirror is replaced by a mirror of the other orientation
+  Flip
+};
+
+/// @brief Structure describing a change of an existing mirror, which opens the safe
+template <typename Coordinate>
+struct BasicMirrorChange final {
+  /// @brief Position of the mirror
+  BasicPoint<Coordinate> position{0U, 0U};
+  /// @brief Orientation of the mirror before the change
+  MirrorOrientation orientation{MirrorOrientation::LeftToUp};
+  /// @brief The change opening the safe
+  MirrorChangeType change_type{MirrorChangeType::Removal};
+};
+
+/// @brief Structure containing all the existing mirrors, a single change of which opens the safe
+template <typename Coordinate>
+struct BasicMirrorChangesResult final {
+  /// @brief True if the safe opens without any change. The changes are not searched then
+  bool opens_without_changes{false};
+  /// @brief Number of the mirrors, removal of which opens the safe
+  std::uint32_t removals{0U};
+  /// @brief Number of the mirrors, flip of which opens the safe
+  std::uint32_t flips{0U};
+  /// @brief The changes opening the safe in the lexicographical order of the positions
+  std::vector<BasicMirrorChange<Coordinate>> changes;
+};
+
+/// @brief Counters of the work done by a single check
+struct SafeCheckStatistics final {
+  /// @brief Number of the beam segments traced from the laser and from the detector
+  std::uint64_t traced_segments{0U};
+  /// @brief Number of the lines of the direct trajectory tested for an intersection with a reverse beam segment
+  std::uint64_t intersection_candidates{0U};
+  /// @brief Number of the searches in the index of the mirrors made by the beam tracing and the intersection search
+  std::uint64_t mirror_lookups{0U};
+  /// @brief Maximal number of bytes held at once by the beam trajectories and the structures of the intersection
+  /// search
+  std::uint64_t peak_scratch_bytes{0U};
+};
+
+/// @brief Memory held by a checker between the checks, in bytes requested from the allocators
+///
+/// @details The index of a variant is held by its base and the index of a checker loaded from a snapshot
+/// is mapped from the file, both are not counted
+struct MemoryFootprint final {
+  /// @brief Bytes of the row-wise index: the nodes and the buckets of the hashed index or the arrays of the flat one
+  std::size_t row_wise_index_bytes{0U};
+  /// @brief Bytes of the column-wise index
+  std::size_t col_wise_index_bytes{0U};
+  /// @brief Bytes of the chunks reserved by the arenas of the hashed index, the nodes are allocated from them
+  std::size_t arena_reserved_bytes{0U};
+
+  /// @brief Returns the memory held by the index: the index bytes or the reserved chunks if they are larger
+  std::size_t total_bytes() const
+  {
+    return std::max(row_wise_index_bytes + col_wise_index_bytes, arena_reserved_bytes);
+  }
+};
+
+/// @brief Exception thrown if a checker can't be constructed within the memory budget with any index layout
+class MemoryBudgetError final : public std::runtime_error {
+public:
+  /// @brief Constructs the exception
+  ///
+  /// @param required_bytes Estimated peak memory of the checker with the most compact index
+  /// @param budget_bytes The memory budget
+  MemoryBudgetError(std::size_t required_bytes, std::size_t budget_bytes);
+
+  /// @brief Returns the estimated peak memory of the checker with the most compact index
+  std::size_t required_bytes() const { return required_bytes_; }
+
+  /// @brief Returns the memory budget
+  std::size_t budget_bytes() const { return budget_bytes_; }
+
+private:
+  std::size_t required_bytes_;
+  std::size_t budget_bytes_;
+};
+
+/// @brief Token, by which a running check can be cancelled from another thread
+///
+/// @details Copies of the token share the cancellation state
+class CancellationToken final {
+public:
+  CancellationToken();
+
+  /// @brief Requests cancellation of the checks using the token
+  void cancel() const;
+
+  /// @brief Returns true if the cancellation is requested
+  bool is_cancelled() const;
+
+private:
+  std::shared_ptr<std::atomic<bool>> is_cancelled_;
+};
+
+/// @brief Limits of the duration of a check
+struct CheckLimits final {
+  /// @brief The check is stopped at this time
+  std::chrono::steady_clock::time_point deadline{std::chrono::steady_clock::time_point::max()};
+  /// @brief The check is stopped when the token is cancelled
+  CancellationToken cancellation{};
+};
+
+/// @brief Enumeration describing how a check with limits has ended
+enum class CheckStatus : std::int8_t {
+  /// @brief The check is completed, the result is valid
+  Completed,
+  /// @brief The check is stopped by the cancellation token
+  Cancelled,
+  /// @brief The check is stopped because the deadline is reached
+  DeadlineExceeded,
+  /// @brief The check is not started, because the checker doesn't fit into the memory budget
+  MemoryBudgetExceeded
 };
 
+/// @brief Structure containing the result of a check with limits
+template <typename Coordinate>
+struct BasicLimitedCheckResult final {
+  /// @brief How the check has ended
+  CheckStatus status{CheckStatus::Completed};
+  /// @brief Result of the check
+  ///
+  /// @details The field value is valid only if the status is CheckStatus::Completed
+  BasicSafeCheckResult<Coordinate> result{};
+  /// @brief Work done by the check, up to the stop if it was stopped
+  SafeCheckStatistics statistics{};
+  /// @brief Wall time of the check
+  std::chrono::nanoseconds elapsed{0};
+};
+
+/// @brief Periodically checks the limits of a running check, shared by the threads of the check
+class CheckLimitsPoller;
+
+/// @brief Data structure to store positions of mirrors in each row and column (32-bit coordinates)
+using MirrorsLine = BasicMirrorsLine<std::uint32_t>;
+/// @brief Data structure to store positions of all mirrors in the grid (32-bit coordinates)
+using MirrorsField = BasicMirrorsField<std::uint32_t>;
+/// @brief Beam segment with 32-bit coordinates
+using BeamSegment = BasicBeamSegment<std::uint32_t>;
+/// @brief Array containing beam segments with 32-bit coordinates
+using BeamSegments = BasicBeamSegments<std::uint32_t>;
+/// @brief Point on the mechanism grid with 32-bit coordinates
+using Point = BasicPoint<std::uint32_t>;
+/// @brief View of a list of points with 32-bit coordinates
+using PointsView = BasicPointsView<std::uint32_t>;
+/// @brief Beam state with 32-bit coordinates
+using BeamState = BasicBeamState<std::uint32_t>;
+/// @brief Check result with 32-bit coordinates
+using SafeCheckResult = BasicSafeCheckResult<std::uint32_t>;
+/// @brief Placement of an inserted mirror with 32-bit coordinates
+using MirrorPlacement = BasicMirrorPlacement<std::uint32_t>;
+/// @brief Minimal insertions search result with 32-bit coordinates
+using MinimalInsertionResult = BasicMinimalInsertionResult<std::uint32_t>;
+/// @brief Change of an existing mirror with 32-bit coordinates
+using MirrorChange = BasicMirrorChange<std::uint32_t>;
+/// @brief Result of the search of the mirror changes with 32-bit coordinates
+using MirrorChangesResult = BasicMirrorChangesResult<std::uint32_t>;
+/// @brief Result of a check with limits with 32-bit coordinates
+using LimitedCheckResult = BasicLimitedCheckResult<std::uint32_t>;
+
+template <typename Coordinate>
+class BasicMappedSnapshot;
+
+template <typename Coordinate>
+struct BasicFlatMirrors;
+
 /// @brief Class implementing the logic of checking how the safe can be opened
-class SafeChecker final {
+///
+/// @tparam Coordinate Unsigned integer type used to store coordinates in the internal data structures.
+/// The grid sides must not exceed its maximum value
+template <typename Coordinate>
+class BasicSafeChecker final {
 public:
+  /// @brief Coordinate type of the input and the result
+  using ExternalCoordinateType = ExternalCoordinate<Coordinate>;
+  /// @brief Point type of the input
+  using ExternalPoint = BasicPoint<ExternalCoordinateType>;
+  /// @brief Type of the check result
+  using Result = BasicSafeCheckResult<ExternalCoordinateType>;
+  /// @brief Type of the minimal insertions search result
+  using InsertionResult = BasicMinimalInsertionResult<ExternalCoordinateType>;
+  /// @brief Type of the mirror changes search result
+  using ChangesResult = BasicMirrorChangesResult<ExternalCoordinateType>;
+  /// @brief Type of the result of a check with limits
+  using LimitedResult = BasicLimitedCheckResult<ExternalCoordinateType>;
+  /// @brief Type of the view of the input points
+  using ExternalPointsView = BasicPointsView<ExternalCoordinateType>;
+
   /// @brief Constructs the safe checker object from the input information about the mechanism grid
   ///
   /// @param rows Number of rows in the mechanism grid
   /// @param columns Number of columns in the mechanism grid
   /// @param left_to_up_mirrors List of positions where the "/" mirrors are placed
   /// @param left_to_down_mirrors List of positions where the "\\" mirrors are placed
-  /// @throw std::invalid_argument if the input is incorrect
-  SafeChecker(std::uint32_t rows, std::uint32_t columns,
-              const std::vector<Point>& left_to_up_mirrors,
-              const std::vector<Point>& left_to_down_mirrors);
+  /// @param threads_count Number of threads building the index of the mirrors and searching the intersections.
+  /// The row-wise and column-wise indexes are built concurrently, each by a half of the threads
+  /// @param layout Representation of the index of the mirrors
+  /// @param memory_budget Maximal peak memory of the construction and of a check in bytes, 0 means unlimited.
+  /// The memory is estimated by estimate_peak_memory() before any index is allocated. If the hashed index exceeds
+  /// the budget, the flat one is built
+  /// @details The hashed index is allocated according to memory_policy(). With a non-default policy it is placed
+  /// into arenas owned by the checker, a separate arena for each thread building the index. The flat index is built
+  /// by a single thread in time linear in the number of the mirrors
+  /// @throw std::invalid_argument if the input is incorrect or the grid does not fit into the Coordinate type
+  /// @throw MemoryBudgetError if the flat index exceeds the memory budget too
+  BasicSafeChecker(ExternalCoordinateType rows, ExternalCoordinateType columns,
+                   const std::vector<ExternalPoint>& left_to_up_mirrors,
+                   const std::vector<ExternalPoint>& left_to_down_mirrors,
+                   std::size_t threads_count = 1U,
+                   MirrorsIndexLayout layout = MirrorsIndexLayout::Hashed,
+                   std::size_t memory_budget = 0U);
+
+  /// @brief Constructs the safe checker from the views of the lists of the mirrors. The lists are read
+  /// during the construction only and are not copied
+  ///
+  /// @param rows Number of rows in the mechanism grid
+  /// @param columns Number of columns in the mechanism grid
+  /// @param left_to_up_mirrors Positions where the "/" mirrors are placed
+  /// @param left_to_down_mirrors Positions where the "\\" mirrors are placed
+  /// @param threads_count Number of threads building the index of the mirrors and searching the intersections
+  /// @param layout Representation of the index of the mirrors
+  /// @param memory_budget Maximal peak memory of the construction and of a check in bytes, 0 means unlimited
+  /// @throw std::invalid_argument if the input is incorrect or the grid does not fit into the Coordinate type
+  /// @throw MemoryBudgetError if the checker doesn't fit into the memory budget with any index layout
+  BasicSafeChecker(ExternalCoordinateType rows, ExternalCoordinateType columns,
+                   ExternalPointsView left_to_up_mirrors,
+                   ExternalPointsView left_to_down_mirrors,
+                   std::size_t threads_count = 1U,
+                   MirrorsIndexLayout layout = MirrorsIndexLayout::Hashed,
+                   std::size_t memory_budget = 0U);
 
   /// @brief Performs the check how the safe can be opened
   ///
-  /// @return A SafeCheckResult object, containing complete information describing the check result
-  SafeCheckResult check_safe() const;
+  /// @return A check result object, containing complete information describing the check result
+  Result check_safe() const;
+
+  /// @brief Performs the check how the safe can be opened and counts the work done
+  ///
+  /// @param statistics Output parameter. Counters of the work done by the check
+  ///
+  /// @return A check result object, containing complete information describing the check result
+  Result check_safe(SafeCheckStatistics& statistics) const;
+
+  /// @brief Performs the check how the safe can be opened, stopping it at the deadline or on cancellation
+  ///
+  /// @details The beam tracing and the intersection search check the limits every few thousand steps
+  ///
+  /// @param limits The deadline and the cancellation token
+  ///
+  /// @return Status of the check, its result if it is completed and the work done
+  LimitedResult check_safe(const CheckLimits& limits) const;
+
+  /// @brief Starts check_safe(limits) on the shared thread pool
+  ///
+  /// @details The checker must not be destroyed until the check is finished
+  ///
+  /// @param limits The deadline and the cancellation token
+  ///
+  /// @return Future of the result
+  std::future<LimitedResult> check_safe_async(const CheckLimits& limits) const;
+
+  /// @brief Sets the maximal number of threads used by check_safe() to search the intersections of the beams
+  ///
+  /// @details The threads are used only if the beams are long enough. The result doesn't depend on the number
+  ///
+  /// @param threads_count Number of threads, 0 is treated as 1
+  void set_threads_count(std::size_t threads_count);
+
+  /// @brief Sets the order of tracing the beams by check_safe(). The result doesn't depend on it
+  ///
+  /// @details The beams are traced in lockstep only if the trajectories are not stored in the snapshot
+  ///
+  /// @param mode Order of tracing the beams
+  void set_tracing_mode(BeamTracingMode mode);
+
+  /// @brief Finds the minimal number of mirrors which should be inserted to open the safe
+  ///
+  /// @return The minimal number of insertions and one of the placements of the inserted mirrors
+  InsertionResult find_minimal_insertions() const;
+
+  /// @brief Finds all the existing mirrors, removal or flip of which opens the safe
+  ///
+  /// @details Only the mirrors reflecting both the beam from the laser and the beam from the detector matter.
+  /// The beams are reflected by different sides of such a mirror. If they arrive at it from the opposite directions,
+  /// the removal opens the safe, otherwise the flip does. So each mirror is reported at most once,
+  /// and the search takes a single pass over both trajectories
+  ///
+  /// @return The mirrors, a single change of which opens the safe
+  ChangesResult find_single_mirror_changes() const;
+
+  /// @brief Saves the built index of the mirrors into a snapshot file, which can be loaded by load_snapshot()
+  ///
+  /// @param path Path of the snapshot file
+  /// @param with_trajectories If true, the beam trajectories from the laser and from the detector are traced
+  /// and saved too, so that check_safe() of the loaded checker doesn't trace them again
+  /// @throw std::runtime_error if the file can't be written
+  void save_snapshot(const std::string& path, bool with_trajectories) const;
+
+  /// @brief Constructs the safe checker from a snapshot file. The file is mapped into memory
+  /// and the index of the mirrors is used without reconstruction
+  ///
+  /// @param path Path of the snapshot file
+  /// @return The safe checker
+  /// @throw std::runtime_error if the file can't be read, was created by an incompatible version,
+  /// for another coordinate width or is corrupted
+  static BasicSafeChecker load_snapshot(const std::string& path);
+
+  /// @brief Constructs the checker of a variant of a safe, which differs from the safe by a few mirrors
+  ///
+  /// @details The variant shares the index of the mirrors of the base checker and stores only the changed positions.
+  /// The lookups consult the changes first and then the base index. A variant of a variant refers to the base
+  /// of the latter, so the lookups never pass more than one level of changes. The removals are applied before
+  /// the additions, so a mirror can be replaced by removing it and adding it with another orientation
+  ///
+  /// @param base Checker of the base safe. The variant keeps it alive
+  /// @param removed_mirrors Positions of the mirrors removed in the variant
+  /// @param left_to_up_mirrors List of positions where the "/" mirrors are added or replace the existing ones
+  /// @param left_to_down_mirrors List of positions where the "\\" mirrors are added or replace the existing ones
+  /// @return The checker of the variant
+  /// @throw std::invalid_argument if the base is nullptr, a position is out of the grid bounds
+  /// or there is no mirror in a removed position
+  static BasicSafeChecker make_variant(std::shared_ptr<const BasicSafeChecker> base,
+                                       const std::vector<ExternalPoint>& removed_mirrors,
+                                       const std::vector<ExternalPoint>& left_to_up_mirrors,
+                                       const std::vector<ExternalPoint>& left_to_down_mirrors);
+
+  /// @brief Returns the number of the positions changed relative to the shared base index,
+  /// 0 if the checker is not a variant
+  std::size_t variant_changes_count() const;
+
+  /// @brief Returns the representation of the index of the mirrors. It is flat if the hashed one would exceed
+  /// the memory budget or the checker was loaded from a snapshot. A variant has the index of its base
+  MirrorsIndexLayout index_layout() const;
+
+  /// @brief Returns the memory held by the index of the mirrors
+  MemoryFootprint memory_footprint() const;
+
+  /// @brief Estimates the peak memory of the construction of a checker and of a check
+  ///
+  /// @details The estimate is an upper bound of the bytes requested from the allocators. The trajectories are
+  /// bounded by the mirrors count: each of the two reflecting corners of a mirror is passed by the beams at most twice
+  ///
+  /// The hashed index placed into arenas takes whole chunks: one arena for each index built sequentially
+  /// and one for each part of the parallel build. The bound holds however the mirrors are spread between the parts
+  ///
+  /// @param mirrors_count Number of the mirrors
+  /// @param layout Representation of the index of the mirrors
+  /// @param threads_count Number of threads building the index
+  /// @param policy Memory policy of the hashed index
+  ///
+  /// @return The estimated bytes
+  static std::size_t estimate_peak_memory(std::size_t mirrors_count, MirrorsIndexLayout layout,
+                                          std::size_t threads_count = 1U, const MemoryPolicy& policy = {});
 
 private:
+  using InternalPoint = BasicPoint<Coordinate>;
+  using InternalBeamState = BasicBeamState<Coordinate>;
+  using InternalBeamSegments = BasicBeamSegments<Coordinate>;
+
   /// @brief Checks that the point lies on the working grid
   ///
   /// @param point Coordinates of the point
   ///
   /// @throw std::invalid_argument if the point is out of grid bounds
-  void throw_if_out_of_bounds_(const Point& point) const;
+  void throw_if_out_of_bounds_(const ExternalPoint& point) const;
+
+  /// @brief Fills row_wise_mirrors_ and col_wise_mirrors_ concurrently. Each index is split into ranges of lines
+  /// filled by separate threads, the ranges are merged at the end. The bounds are checked in the same pass
+  ///
+  /// @param left_to_up_mirrors List of positions where the "/" mirrors are placed
+  /// @param left_to_down_mirrors List of positions where the "\\" mirrors are placed
+  /// @param policy Memory policy of the index
+  ///
+  /// @throw std::invalid_argument if a mirror is out of the grid bounds. The first such mirror is reported,
+  /// as in the sequential construction
+  void build_index_in_parallel_(ExternalPointsView left_to_up_mirrors,
+                                ExternalPointsView left_to_down_mirrors,
+                                const MemoryPolicy& policy);
+
+  /// @brief Constructs the safe checker over a mapped snapshot
+  ///
+  /// @param snapshot The mapped snapshot
+  explicit BasicSafeChecker(std::shared_ptr<const BasicMappedSnapshot<Coordinate>> snapshot);
+
+  /// @brief Constructs a variant of the base checker without changes
+  ///
+  /// @param variant_base Checker owning the index of the mirrors, which is not a variant itself
+  explicit BasicSafeChecker(std::shared_ptr<const BasicSafeChecker> variant_base);
+
+  /// @brief Calls the function with the row-wise and column-wise indexes owned by the checker:
+  /// the fields, the flat arrays or the views of the snapshot
+  template <typename Function>
+  auto with_own_index_(Function&& function) const
+      -> decltype(function(std::declval<const BasicMirrorsField<Coordinate>&>(),
+                           std::declval<const BasicMirrorsField<Coordinate>&>()));
+
+  /// @brief Calls the function with the row-wise and column-wise indexes of the mirrors. A variant passes
+  /// its changes over the index of the base
+  template <typename Function>
+  auto with_index_(Function&& function) const
+      -> decltype(function(std::declval<const BasicMirrorsField<Coordinate>&>(),
+                           std::declval<const BasicMirrorsField<Coordinate>&>()));
+
+  /// @brief Sets the state of a position in a variant. The change is not stored if the base has the same state
+  ///
+  /// @param point Coordinates of the position
+  /// @param is_present True if the variant has a mirror in the position
+  /// @param orientation Orientation of the mirror
+  void set_variant_position_(const InternalPoint& point, bool is_present, MirrorOrientation orientation);
+
+  /// @brief Fills row_wise_mirrors_ and col_wise_mirrors_, in parallel if there are enough threads and mirrors.
+  /// The bounds are checked in the input order
+  ///
+  /// @param left_to_up_mirrors List of positions where the "/" mirrors are placed
+  /// @param left_to_down_mirrors List of positions where the "\\" mirrors are placed
+  /// @param policy Memory policy of the index
+  ///
+  /// @throw std::invalid_argument if a mirror is out of the grid bounds
+  void build_hashed_index_(ExternalPointsView left_to_up_mirrors, ExternalPointsView left_to_down_mirrors,
+                           const MemoryPolicy& policy);
+
+  /// @brief Fills row_wise_flat_mirrors_ and col_wise_flat_mirrors_. The bounds are checked in the input order
+  ///
+  /// @param left_to_up_mirrors List of positions where the "/" mirrors are placed
+  /// @param left_to_down_mirrors List of positions where the "\\" mirrors are placed
+  ///
+  /// @throw std::invalid_argument if a mirror is out of the grid bounds
+  void build_flat_index_(ExternalPointsView left_to_up_mirrors, ExternalPointsView left_to_down_mirrors);
+
+  /// @brief Estimates the peak memory of a check: the longest possible trajectories and the intersection search
+  ///
+  /// @param mirrors_count Number of the mirrors
+  ///
+  /// @return The estimated bytes
+  static std::size_t estimate_check_memory_(std::size_t mirrors_count);
+
+  /// @brief Creates an empty field allocating from a new arena of the checker if the memory policy requires it
+  ///
+  /// @param policy The memory policy
+  /// @return The empty field
+  BasicMirrorsField<Coordinate> make_field_(const MemoryPolicy& policy);
+
+  /// @brief Performs the check over the given index of the mirrors
+  ///
+  /// @param poller Checks the limits of the check, nullptr if it is not limited.
+  /// If the check is stopped, the returned result is not valid
+  template <typename MirrorsIndex>
+  Result check_safe_(const MirrorsIndex& row_wise_mirrors, const MirrorsIndex& col_wise_mirrors,
+                     SafeCheckStatistics& statistics, CheckLimitsPoller* poller) const;
+
+  /// @brief Reflection of the beam from a mirror
+  struct Reflection final {
+    /// @brief Position of the mirror and direction of the beam before the reflection
+    InternalBeamState arrival{};
+    MirrorOrientation mirror{MirrorOrientation::LeftToUp};
+  };
 
   /// @brief Constructs all the beam segments on the grid, starting from a certain beam state
   ///
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
+  /// @param col_wise_mirrors Index of the mirrors, the lines are columns
   /// @param start_state Beam state from which the beam starts
   /// @param end_state Output parameter. Final beam state, after which it exits the grid
   /// @param horizontal_segments Output parameter. List of all horizontal beam segments
   /// @param vertical_segments Output parameter. List of all vertical beam segments
-  void trace_the_beam_(const BeamState& start_state,
-                       BeamState& end_state,
-                       BeamSegments& horizontal_segments,
-                       BeamSegments& vertical_segments) const;
+  /// @param reflections Optional output parameter. Reflections of the beam in the order of the beam passing them
+  /// @param poller Checks the limits of the check, nullptr if it is not limited.
+  /// If the check is stopped, the segments are incomplete
+  template <typename MirrorsIndex>
+  void trace_the_beam_(const MirrorsIndex& row_wise_mirrors,
+                       const MirrorsIndex& col_wise_mirrors,
+                       const InternalBeamState& start_state,
+                       InternalBeamState& end_state,
+                       InternalBeamSegments& horizontal_segments,
+                       InternalBeamSegments& vertical_segments,
+                       std::vector<Reflection>* reflections = nullptr,
+                       CheckLimitsPoller* poller = nullptr) const;
+
+  /// @brief Traces the beams from the laser and from the detector in lockstep, one reflection of each in turn.
+  /// Before a lookup of one beam the line of the next lookup of the other beam is prefetched
+  ///
+  /// @details The beam from the detector is stopped once the beam from the laser reaches the detector,
+  /// its segments are incomplete then
+  ///
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
+  /// @param col_wise_mirrors Index of the mirrors, the lines are columns
+  /// @param forward_start_state State in which the beam from the laser starts
+  /// @param forward_end_state Output parameter. Final state of the beam from the laser
+  /// @param forward_horizontal_segments Output parameter. Horizontal segments of the beam from the laser
+  /// @param forward_vertical_segments Output parameter. Vertical segments of the beam from the laser
+  /// @param backward_start_state State in which the beam from the detector starts
+  /// @param backward_end_state Output parameter. Final state of the beam from the detector
+  /// @param backward_horizontal_segments Output parameter. Horizontal segments of the beam from the detector
+  /// @param backward_vertical_segments Output parameter. Vertical segments of the beam from the detector
+  /// @param poller Checks the limits of the check, nullptr if it is not limited.
+  /// If the check is stopped, the segments are incomplete
+  template <typename MirrorsIndex>
+  void trace_beams_interleaved_(const MirrorsIndex& row_wise_mirrors,
+                                const MirrorsIndex& col_wise_mirrors,
+                                const InternalBeamState& forward_start_state,
+                                InternalBeamState& forward_end_state,
+                                InternalBeamSegments& forward_horizontal_segments,
+                                InternalBeamSegments& forward_vertical_segments,
+                                const InternalBeamState& backward_start_state,
+                                InternalBeamState& backward_end_state,
+                                InternalBeamSegments& backward_horizontal_segments,
+                                InternalBeamSegments& backward_vertical_segments,
+                                CheckLimitsPoller* poller) const;
+
+  /// @brief Reflects the beam by the mirror in its start position, if there is one
+  ///
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
+  /// @param state The beam state, updated in place
+  /// @param reflections Optional output parameter. The reflection is added to it
+  template <typename MirrorsIndex>
+  void start_the_beam_(const MirrorsIndex& row_wise_mirrors, InternalBeamState& state,
+                       std::vector<Reflection>* reflections) const;
+
+  /// @brief Moves the beam to the next mirror in its direction or to the border of the grid
+  ///
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
+  /// @param col_wise_mirrors Index of the mirrors, the lines are columns
+  /// @param state The beam state, updated in place. The state after the reflection if a mirror is reached
+  /// @param horizontal_segments Output parameter. The passed segment is added to it if it is horizontal
+  /// @param vertical_segments Output parameter. The passed segment is added to it if it is vertical
+  /// @param reflections Optional output parameter. The reflection is added to it
+  ///
+  /// @return false if the beam has reached the border of the grid, so it exits the grid
+  template <typename MirrorsIndex>
+  bool trace_step_(const MirrorsIndex& row_wise_mirrors,
+                   const MirrorsIndex& col_wise_mirrors,
+                   InternalBeamState& state,
+                   InternalBeamSegments& horizontal_segments,
+                   InternalBeamSegments& vertical_segments,
+                   std::vector<Reflection>* reflections) const;
+
+  /// @brief Returns true if the beam from the laser in the final state reaches the detector
+  bool reaches_detector_(const InternalBeamState& end_state) const;
+
+  /// @brief Implementation of find_single_mirror_changes() for a certain index of the mirrors
+  ///
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
+  /// @param col_wise_mirrors Index of the mirrors, the lines are columns
+  ///
+  /// @return The mirrors, a single change of which opens the safe
+  template <typename MirrorsIndex>
+  ChangesResult find_single_mirror_changes_(const MirrorsIndex& row_wise_mirrors,
+                                            const MirrorsIndex& col_wise_mirrors) const;
 
   /// @brief Checks that there is a mirror in a certain point of the grid
   ///
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
   /// @param point Coordinates of the point
   ///
   /// @return true if there is a mirror in the given point, false otherwise
-  bool has_mirror_(const Point& point) const;
+  template <typename MirrorsIndex>
+  bool has_mirror_(const MirrorsIndex& row_wise_mirrors, const InternalPoint& point) const;
+
+  /// @brief Number of the valid intersections of the direct and reverse trajectories
+  /// and the lexicographically smallest of them
+  struct IntersectionsSummary final {
+    std::uint64_t count{0U};
+    InternalPoint smallest{};
+    /// @brief Number of the lines of the direct trajectory tested for an intersection
+    std::uint64_t candidates{0U};
+    /// @brief Number of the intersections checked for a mirror
+    std::uint64_t lookups{0U};
+    /// @brief Maximal number of bytes held at once by the structures of the search. Not merged
+    std::uint64_t scratch_bytes{0U};
+
+    void add(const InternalPoint& point)
+    {
+      if (count == 0U || is_less(point, smallest)) {
+        smallest = point;
+      }
+      ++count;
+    }
+
+    void merge(const IntersectionsSummary& other)
+    {
+      if (other.count != 0U && (count == 0U || is_less(other.smallest, smallest))) {
+        smallest = other.smallest;
+      }
+      count += other.count;
+      candidates += other.candidates;
+      lookups += other.lookups;
+    }
+
+    static bool is_less(const InternalPoint& first, const InternalPoint& second)
+    {
+      return first.row != second.row ? first.row < second.row : first.col < second.col;
+    }
+  };
 
   /// @brief Finds all valid intersections of the direct and reverse trajectories
   ///
+  /// @details The reverse segments are split between threads_count_ threads by the estimated work
+  ///
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
   /// @param forward_horizontal_segments List of all horizontal segments of the direct beam trajectory
   /// @param forward_vertical_segments List of all vertical segments of the direct beam trajectory
   /// @param backward_horizontal_segments List of all horizontal segments of the reverse beam trajectory
   /// @param backward_vertical_segments List of all vertical segments of the reverse beam trajectory
+  /// @param poller Checks the limits of the check, nullptr if it is not limited
+  ///
+  /// @return Number of the intersections of the direct and reverse trajectories on the grid
+  /// and the lexicographically smallest of them. Positions already containing mirrors are not counted.
+  /// If the check is stopped, the summary is incomplete
+  template <typename MirrorsIndex>
+  IntersectionsSummary find_intersections_(const MirrorsIndex& row_wise_mirrors,
+                                           const InternalBeamSegments& forward_horizontal_segments,
+                                           const InternalBeamSegments& forward_vertical_segments,
+                                           const InternalBeamSegments& backward_horizontal_segments,
+                                           const InternalBeamSegments& backward_vertical_segments,
+                                           CheckLimitsPoller* poller) const;
+
+  /// @brief Finds the valid intersections of a reverse segment with the lines of the direct trajectory
   ///
-  /// @return List of coordinates of all intersections of the direct and reverse trajectories on the grid.
-  /// The result doesn't include positions already containing mirrors.
-  std::vector<Point> find_intersections_(const BeamSegments& forward_horizontal_segments,
-                                         const BeamSegments& forward_vertical_segments,
-                                         const BeamSegments& backward_horizontal_segments,
-                                         const BeamSegments& backward_vertical_segments) const;
+  /// @param row_wise_mirrors Index of the mirrors, the lines are rows
+  /// @param forward_lines Segments of the direct trajectory orthogonal to the segment, grouped by lines
+  /// @param segment Segment of the reverse trajectory
+  /// @param is_horizontal True if the segment is horizontal
+  /// @param summary Output parameter. The found intersections are added to it
+  /// @param poller Checks the limits of the check, nullptr if it is not limited
+  template <typename MirrorsIndex, typename LinesMap>
+  void find_segment_intersections_(const MirrorsIndex& row_wise_mirrors,
+                                   const LinesMap& forward_lines,
+                                   const BasicBeamSegment<Coordinate>& segment,
+                                   bool is_horizontal,
+                                   IntersectionsSummary& summary,
+                                   CheckLimitsPoller* poller) const;
 
   /// @brief Number of rows in the mechanism grid
-  std::uint32_t rows_;
+  Coordinate rows_;
   /// @brief Number of columns in the mechanism grid
-  std::uint32_t cols_;
+  Coordinate cols_;
+  /// @brief Arenas holding the index of the mirrors. Declared before the index, so they are destroyed after it
+  std::vector<std::shared_ptr<MemoryArena>> arenas_;
   /// @brief Key-value data structure, containing information about all coordinates of the mirrors.
   /// First coordinate is the row number
-  MirrorsField row_wise_mirrors_;
+  BasicMirrorsField<Coordinate> row_wise_mirrors_;
   /// @brief Key-value data structure, containing information about all coordinates of the mirrors.
   /// First coordinate is the column number
-  MirrorsField col_wise_mirrors_;
+  BasicMirrorsField<Coordinate> col_wise_mirrors_;
+  /// @brief Bytes allocated by row_wise_mirrors_, counted during the construction
+  std::size_t row_wise_index_bytes_{0U};
+  /// @brief Bytes allocated by col_wise_mirrors_, counted during the construction
+  std::size_t col_wise_index_bytes_{0U};
+  /// @brief Flat index used instead of row_wise_mirrors_ if the checker was built with MirrorsIndexLayout::Flat
+  std::shared_ptr<const BasicFlatMirrors<Coordinate>> row_wise_flat_mirrors_;
+  /// @brief Flat index used instead of col_wise_mirrors_ if the checker was built with MirrorsIndexLayout::Flat
+  std::shared_ptr<const BasicFlatMirrors<Coordinate>> col_wise_flat_mirrors_;
+  /// @brief Snapshot used instead of row_wise_mirrors_ and col_wise_mirrors_ if the checker was loaded from it
+  std::shared_ptr<const BasicMappedSnapshot<Coordinate>> snapshot_;
+  /// @brief Checker owning the index of the mirrors if this checker is a variant, nullptr otherwise
+  std::shared_ptr<const BasicSafeChecker> variant_base_;
+  /// @brief Changes of the variant relative to the base, the lines are rows
+  BasicMirrorsDelta<Coordinate> row_wise_changes_;
+  /// @brief Changes of the variant relative to the base, the lines are columns
+  BasicMirrorsDelta<Coordinate> col_wise_changes_;
+  /// @brief Maximal number of threads searching the intersections
+  std::size_t threads_count_{1U};
+  /// @brief Order of tracing the beams by check_safe()
+  BeamTracingMode tracing_mode_{BeamTracingMode::Sequential};
+  /// @brief Representation of the index of the mirrors
+  MirrorsIndexLayout layout_{MirrorsIndexLayout::Hashed};
+};
+
+extern template class BasicSafeChecker<std::uint16_t>;
+extern template class BasicSafeChecker<std::uint32_t>;
+extern template class BasicSafeChecker<std::uint64_t>;
+
+/// @brief Safe checker for grids with sides exceeding the 32-bit range
+using LargeGridSafeChecker = BasicSafeChecker<std::uint64_t>;
+
+/// @brief Class implementing the logic of checking how the safe can be opened
+///
+/// @details Selects the narrowest coordinate type the grid fits into during construction.
+/// Grids with both sides not greater than 65535 are processed with 16-bit coordinates,
+/// which makes the internal data structures denser. Other grids are processed with 32-bit coordinates
+class SafeChecker final {
+public:
+  /// @brief Constructs the safe checker object from the input information about the mechanism grid
+  ///
+  /// @param rows Number of rows in the mechanism grid
+  /// @param columns Number of columns in the mechanism grid
+  /// @param left_to_up_mirrors List of positions where the "/" mirrors are placed
+  /// @param left_to_down_mirrors List of positions where the "\\" mirrors are placed
+  /// @param threads_count Number of threads building the index of the mirrors and searching the intersections
+  /// @param layout Representation of the index of the mirrors
+  /// @param memory_budget Maximal peak memory of the construction and of a check in bytes, 0 means unlimited.
+  /// If the hashed index exceeds the budget, the flat one is built
+  /// @throw std::invalid_argument if the input is incorrect
+  /// @throw MemoryBudgetError if the checker doesn't fit into the memory budget with any index layout
+  SafeChecker(std::uint32_t rows, std::uint32_t columns,
+              const std::vector<Point>& left_to_up_mirrors,
+              const std::vector<Point>& left_to_down_mirrors,
+              std::size_t threads_count = 1U,
+              MirrorsIndexLayout layout = MirrorsIndexLayout::Hashed,
+              std::size_t memory_budget = 0U);
+
+  /// @brief Constructs the safe checker from the views of the lists of the mirrors, which are not copied
+  ///
+  /// @param rows Number of rows in the mechanism grid
+  /// @param columns Number of columns in the mechanism grid
+  /// @param left_to_up_mirrors Positions where the "/" mirrors are placed
+  /// @param left_to_down_mirrors Positions where the "\\" mirrors are placed
+  /// @param threads_count Number of threads building the index of the mirrors and searching the intersections
+  /// @param layout Representation of the index of the mirrors
+  /// @param memory_budget Maximal peak memory of the construction and of a check in bytes, 0 means unlimited
+  /// @throw std::invalid_argument if the input is incorrect
+  /// @throw MemoryBudgetError if the checker doesn't fit into the memory budget with any index layout
+  SafeChecker(std::uint32_t rows, std::uint32_t columns,
+              PointsView left_to_up_mirrors,
+              PointsView left_to_down_mirrors,
+              std::size_t threads_count = 1U,
+              MirrorsIndexLayout layout = MirrorsIndexLayout::Hashed,
+              std::size_t memory_budget = 0U);
+
+  /// @brief Performs the check how the safe can be opened
+  ///
+  /// @return A SafeCheckResult object, containing complete information describing the check result
+  SafeCheckResult check_safe() const;
+
+  /// @brief Performs the check how the safe can be opened and counts the work done
+  ///
+  /// @param statistics Output parameter. Counters of the work done by the check
+  ///
+  /// @return A SafeCheckResult object, containing complete information describing the check result
+  SafeCheckResult check_safe(SafeCheckStatistics& statistics) const;
+
+  /// @brief Performs the check how the safe can be opened, stopping it at the deadline or on cancellation
+  ///
+  /// @param limits The deadline and the cancellation token
+  ///
+  /// @return Status of the check, its result if it is completed and the work done
+  LimitedCheckResult check_safe(const CheckLimits& limits) const;
+
+  /// @brief Starts check_safe(limits) on the shared thread pool. The checker must not be destroyed until it is finished
+  ///
+  /// @param limits The deadline and the cancellation token
+  ///
+  /// @return Future of the result
+  std::future<LimitedCheckResult> check_safe_async(const CheckLimits& limits) const;
+
+  /// @brief Sets the maximal number of threads used by check_safe() to search the intersections of the beams
+  ///
+  /// @param threads_count Number of threads, 0 is treated as 1
+  void set_threads_count(std::size_t threads_count);
+
+  /// @brief Sets the order of tracing the beams by check_safe(). The result doesn't depend on it
+  ///
+  /// @param mode Order of tracing the beams
+  void set_tracing_mode(BeamTracingMode mode);
+
+  /// @brief Finds the minimal number of mirrors which should be inserted to open the safe
+  ///
+  /// @return The minimal number of insertions and one of the placements of the inserted mirrors
+  MinimalInsertionResult find_minimal_insertions() const;
+
+  /// @brief Finds all the existing mirrors, removal or flip of which opens the safe
+  ///
+  /// @return The mirrors, a single change of which opens the safe
+  MirrorChangesResult find_single_mirror_changes() const;
+
+  /// @brief Returns the size in bytes of the coordinates used in the internal data structures
+  std::size_t coordinate_width() const;
+
+  /// @brief Saves the built index of the mirrors into a snapshot file, which can be loaded by load_snapshot()
+  ///
+  /// @param path Path of the snapshot file
+  /// @param with_trajectories If true, the beam trajectories are saved too
+  /// @throw std::runtime_error if the file can't be written
+  void save_snapshot(const std::string& path, bool with_trajectories) const;
+
+  /// @brief Constructs the safe checker from a snapshot file without rebuilding the index of the mirrors
+  ///
+  /// @param path Path of the snapshot file
+  /// @return The safe checker
+  /// @throw std::runtime_error if the file can't be read, was created by an incompatible version or is corrupted
+  static SafeChecker load_snapshot(const std::string& path);
+
+  /// @brief Constructs the checker of a variant of a safe, which differs from the safe by a few mirrors.
+  /// The variant shares the index of the mirrors of the base checker and stores only the changed positions
+  ///
+  /// @param base Checker of the base safe. The variant keeps it alive
+  /// @param removed_mirrors Positions of the mirrors removed in the variant
+  /// @param left_to_up_mirrors List of positions where the "/" mirrors are added or replace the existing ones
+  /// @param left_to_down_mirrors List of positions where the "\\" mirrors are added or replace the existing ones
+  /// @return The checker of the variant
+  /// @throw std::invalid_argument if the base is nullptr, a position is out of the grid bounds
+  /// or there is no mirror in a removed position
+  static SafeChecker make_variant(std::shared_ptr<const SafeChecker> base, const std::vector<Point>& removed_mirrors,
+                                  const std::vector<Point>& left_to_up_mirrors,
+                                  const std::vector<Point>& left_to_down_mirrors);
+
+  /// @brief Returns the number of the positions changed relative to the shared base index,
+  /// 0 if the checker is not a variant
+  std::size_t variant_changes_count() const;
+
+  /// @brief Returns the representation of the index of the mirrors, which is flat if the hashed one exceeded
+  /// the memory budget
+  MirrorsIndexLayout index_layout() const;
+
+  /// @brief Returns the memory held by the index of the mirrors
+  MemoryFootprint memory_footprint() const;
+
+private:
+  SafeChecker() = default;
+
+  /// @brief Calls the function with the selected checker implementation
+  template <typename Function>
+  auto visit_(Function&& function) const -> decltype(function(std::declval<const BasicSafeChecker<std::uint32_t>&>()));
+
+  /// @brief Checker used if the grid fits into 16-bit coordinates
+  std::unique_ptr<BasicSafeChecker<std::uint16_t>> narrow_checker_;
+  /// @brief Checker used if the grid does not fit into 16-bit coordinates
+  std::unique_ptr<BasicSafeChecker<std::uint32_t>> wide_checker_;
 };
 
 }  // namespace mirrors_lasers
@@ -0,0 +1,171 @@
+#include "safe_laser_c.h"
+#include "safe_checker.h"
+
+#include <chrono>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+struct safe_laser_checker {
+  mirrors_lasers::SafeChecker checker;
+};
+
+namespace {
+
+/// @brief Message of the last failed call of the thread
+thread_local std::string last_error;
+
+safe_laser_status fail(safe_laser_status status, const char* message)
+{
+  last_error = message;
+  return status;
+}
+
+/// @brief Calls the function and converts its exceptions into the statuses
+template <typename Function>
+safe_laser_status call_safely(Function&& function)
+{
+  try {
+    last_error.clear();
+    return function();
+  } catch (const std::invalid_argument& exception) {
+    return fail(SAFE_LASER_INVALID_ARGUMENT, exception.what());
+  } catch (const std::bad_alloc& exception) {
+    return fail(SAFE_LASER_OUT_OF_MEMORY, exception.what());
+  } catch (const std::exception& exception) {
+    return fail(SAFE_LASER_ERROR, exception.what());
+  } catch (...) {
+    return fail(SAFE_LASER_ERROR, "Unknown error");
+  }
+}
+
+std::int32_t to_result_type(mirrors_lasers::SafeCheckResultType result_type)
+{
+  if (result_type == mirrors_lasers::SafeCheckResultType::OpensWithoutInserting) {
+    return SAFE_LASER_OPENS_WITHOUT_INSERTING;
+  }
+  if (result_type == mirrors_lasers::SafeCheckResultType::CanNotBeOpened) {
+    return SAFE_LASER_CAN_NOT_BE_OPENED;
+  }
+  return SAFE_LASER_REQUIRES_MIRROR_INSERTION;
+}
+
+std::int32_t to_orientation(mirrors_lasers::MirrorOrientation orientation)
+{
+  return orientation == mirrors_lasers::MirrorOrientation::LeftToUp ? SAFE_LASER_LEFT_TO_UP : SAFE_LASER_LEFT_TO_DOWN;
+}
+
+}  // namespace
+
+uint32_t safe_laser_abi_version(void)
+{
+  return SAFE_LASER_ABI_VERSION;
+}
+
+const char* safe_laser_last_error(void)
+{
+  return last_error.c_str();
+}
+
+safe_laser_status safe_laser_create(uint32_t rows, uint32_t columns,
+                                    const uint32_t* left_to_up_coordinates, size_t left_to_up_count,
+                                    const uint32_t* left_to_down_coordinates, size_t left_to_down_count,
+                                    size_t threads_count, int32_t index_layout, safe_laser_checker** checker)
+{
+  return call_safely([&] () {
+    if (checker == nullptr || (left_to_up_coordinates == nullptr && left_to_up_count != 0U) ||
+        (left_to_down_coordinates == nullptr && left_to_down_count != 0U)) {
+      return fail(SAFE_LASER_INVALID_ARGUMENT, "Null pointer argument");
+    }
+    if (index_layout != SAFE_LASER_INDEX_HASHED && index_layout != SAFE_LASER_INDEX_FLAT) {
+      return fail(SAFE_LASER_INVALID_ARGUMENT, "Unknown index layout");
+    }
+    const auto left_to_up_mirrors =
+        mirrors_lasers::PointsView::from_coordinates(left_to_up_coordinates, left_to_up_count);
+    const auto left_to_down_mirrors =
+        mirrors_lasers::PointsView::from_coordinates(left_to_down_coordinates, left_to_down_count);
+    const auto layout = index_layout == SAFE_LASER_INDEX_FLAT ? mirrors_lasers::MirrorsIndexLayout::Flat
+                                                              : mirrors_lasers::MirrorsIndexLayout::Hashed;
+    *checker = new safe_laser_checker{mirrors_lasers::SafeChecker{rows, columns, left_to_up_mirrors,
+                                                                  left_to_down_mirrors, threads_count, layout}};
+    return SAFE_LASER_OK;
+  });
+}
+
+void safe_laser_destroy(safe_laser_checker* checker)
+{
+  delete checker;
+}
+
+safe_laser_status safe_laser_check(const safe_laser_checker* checker, uint64_t timeout_ms,
+                                   safe_laser_result* result)
+{
+  return call_safely([&] () {
+    if (checker == nullptr || result == nullptr) {
+      return fail(SAFE_LASER_INVALID_ARGUMENT, "Null pointer argument");
+    }
+    mirrors_lasers::CheckLimits limits{};
+    if (timeout_ms != 0U) {
+      limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{timeout_ms};
+    }
+    const mirrors_lasers::LimitedCheckResult limited_result = checker->checker.check_safe(limits);
+    if (limited_result.status != mirrors_lasers::CheckStatus::Completed) {
+      return fail(SAFE_LASER_TIMEOUT, "The check is not completed in time");
+    }
+    result->result_type = to_result_type(limited_result.result.result_type);
+    result->positions = limited_result.result.positions;
+    result->mirror_row = limited_result.result.mirror_row;
+    result->mirror_col = limited_result.result.mirror_col;
+    return SAFE_LASER_OK;
+  });
+}
+
+safe_laser_status safe_laser_find_minimal_insertions(const safe_laser_checker* checker, int32_t* result_type,
+                                                     safe_laser_mirror* placements, size_t capacity, size_t* count)
+{
+  return call_safely([&] () {
+    if (checker == nullptr || result_type == nullptr || count == nullptr ||
+        (placements == nullptr && capacity != 0U)) {
+      return fail(SAFE_LASER_INVALID_ARGUMENT, "Null pointer argument");
+    }
+    const mirrors_lasers::MinimalInsertionResult insertions = checker->checker.find_minimal_insertions();
+    *result_type = to_result_type(insertions.result_type);
+    *count = insertions.placements.size();
+    if (insertions.placements.size() > capacity) {
+      return fail(SAFE_LASER_BUFFER_TOO_SMALL, "The buffer of the placements is too small");
+    }
+    for (std::size_t index = 0U; index < insertions.placements.size(); ++index) {
+      const mirrors_lasers::MirrorPlacement& placement = insertions.placements[index];
+      placements[index] = safe_laser_mirror{placement.position.row, placement.position.col,
+                                            to_orientation(placement.orientation), 0};
+    }
+    return SAFE_LASER_OK;
+  });
+}
+
+safe_laser_status safe_laser_find_single_mirror_changes(const safe_laser_checker* checker,
+                                                        int32_t* opens_without_changes, safe_laser_mirror* changes,
+                                                        size_t capacity, size_t* count)
+{
+  return call_safely([&] () {
+    if (checker == nullptr || opens_without_changes == nullptr || count == nullptr ||
+        (changes == nullptr && capacity != 0U)) {
+      return fail(SAFE_LASER_INVALID_ARGUMENT, "Null pointer argument");
+    }
+    const mirrors_lasers::MirrorChangesResult result = checker->checker.find_single_mirror_changes();
+    *opens_without_changes = result.opens_without_changes ? 1 : 0;
+    *count = result.changes.size();
+    if (result.changes.size() > capacity) {
+      return fail(SAFE_LASER_BUFFER_TOO_SMALL, "The buffer of the changes is too small");
+    }
+    for (std::size_t index = 0U; index < result.changes.size(); ++index) {
+      const mirrors_lasers::MirrorChange& change = result.changes[index];
+      const std::int32_t change_type = change.change_type == mirrors_lasers::MirrorChangeType::Removal
+          ? SAFE_LASER_REMOVAL : SAFE_LASER_FLIP;
+      changes[index] = safe_laser_mirror{change.position.row, change.position.col,
+                                         to_orientation(change.orientation), change_type};
+    }
+    return SAFE_LASER_OK;
+  });
+}
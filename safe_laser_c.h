@@ -0,0 +1,171 @@
+#ifndef SAFE_LASER_C
+#define SAFE_LASER_C
+
+/// @file
+/// @brief C interface of the safe checker, exported by the shared library
+///
+/// @details The functions don't throw and report errors by the returned status, the message of the last error
+/// of the calling thread is returned by safe_laser_last_error(). The results are written into buffers owned
+/// by the caller. A checker can be used by several threads concurrently, except for its destruction
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(SAFE_LASER_BUILDING_LIBRARY)
+#define SAFE_LASER_API __declspec(dllexport)
+#else
+#define SAFE_LASER_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__) || defined(__clang__)
+#define SAFE_LASER_API __attribute__((visibility("default")))
+#else
+#define SAFE_LASER_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Version of the interface, incremented on incompatible changes
+#define SAFE_LASER_ABI_VERSION 1
+
+/// @brief Status of a call
+typedef enum safe_laser_status {
+  SAFE_LASER_OK = 0,
+  /// @brief A required pointer is NULL or the safe description is incorrect
+  SAFE_LASER_INVALID_ARGUMENT = 1,
+  /// @brief The buffer can't hold the result. The required number of elements is written anyway
+  SAFE_LASER_BUFFER_TOO_SMALL = 2,
+  /// @brief The check is not completed in the given time
+  SAFE_LASER_TIMEOUT = 3,
+  SAFE_LASER_OUT_OF_MEMORY = 4,
+  /// @brief Other failure, see safe_laser_last_error()
+  SAFE_LASER_ERROR = 5
+} safe_laser_status;
+
+/// @brief Type of the result of a check
+typedef enum safe_laser_result_type {
+  SAFE_LASER_OPENS_WITHOUT_INSERTING = 0,
+  SAFE_LASER_CAN_NOT_BE_OPENED = 1,
+  SAFE_LASER_REQUIRES_MIRROR_INSERTION = 2
+} safe_laser_result_type;
+
+/// @brief Orientation of a mirror
+typedef enum safe_laser_orientation {
+  /// @brief Mirror "/"
+  SAFE_LASER_LEFT_TO_UP = 0,
+  /// @brief Mirror "\"
+  SAFE_LASER_LEFT_TO_DOWN = 1
+} safe_laser_orientation;
+
+/// @brief Change of an existing mirror
+typedef enum safe_laser_change_type {
+  SAFE_LASER_REMOVAL = 0,
+  SAFE_LASER_FLIP = 1
+} safe_laser_change_type;
+
+/// @brief Representation of the index of the mirrors, see MirrorsIndexLayout
+typedef enum safe_laser_index_layout {
+  SAFE_LASER_INDEX_HASHED = 0,
+  SAFE_LASER_INDEX_FLAT = 1
+} safe_laser_index_layout;
+
+/// @brief Result of a check
+typedef struct safe_laser_result {
+  /// @brief One of safe_laser_result_type
+  int32_t result_type;
+  /// @brief Number of positions where inserting a mirror opens the safe
+  uint32_t positions;
+  /// @brief Lexicographically smallest position where inserting a mirror opens the safe
+  uint32_t mirror_row;
+  uint32_t mirror_col;
+} safe_laser_result;
+
+/// @brief A mirror with its position and orientation
+typedef struct safe_laser_mirror {
+  uint32_t row;
+  uint32_t col;
+  /// @brief One of safe_laser_orientation
+  int32_t orientation;
+  /// @brief One of safe_laser_change_type for the changes of the existing mirrors, 0 otherwise
+  int32_t change_type;
+} safe_laser_mirror;
+
+/// @brief Opaque safe checker
+typedef struct safe_laser_checker safe_laser_checker;
+
+/// @brief Returns SAFE_LASER_ABI_VERSION of the library
+SAFE_LASER_API uint32_t safe_laser_abi_version(void);
+
+/// @brief Returns the message of the last failed call of the calling thread, an empty string if there was none.
+/// The pointer is valid until the next call of the thread
+SAFE_LASER_API const char* safe_laser_last_error(void);
+
+/// @brief Constructs a checker. The arrays are read during the call only and are not copied
+///
+/// @param rows Number of rows in the mechanism grid
+/// @param columns Number of columns in the mechanism grid
+/// @param left_to_up_coordinates Row and column of each "/" mirror, 2 * left_to_up_count values.
+/// May be NULL if the count is zero
+/// @param left_to_up_count Number of the "/" mirrors
+/// @param left_to_down_coordinates Row and column of each "\" mirror, 2 * left_to_down_count values.
+/// May be NULL if the count is zero
+/// @param left_to_down_count Number of the "\" mirrors
+/// @param threads_count Number of threads building the index and searching the intersections, 0 is treated as 1
+/// @param index_layout One of safe_laser_index_layout
+/// @param checker Output parameter. The constructed checker, destroyed by safe_laser_destroy()
+SAFE_LASER_API safe_laser_status safe_laser_create(uint32_t rows, uint32_t columns,
+                                                   const uint32_t* left_to_up_coordinates, size_t left_to_up_count,
+                                                   const uint32_t* left_to_down_coordinates,
+                                                   size_t left_to_down_count, size_t threads_count,
+                                                   int32_t index_layout, safe_laser_checker** checker);
+
+/// @brief Destroys the checker. Does nothing if it is NULL
+SAFE_LASER_API void safe_laser_destroy(safe_laser_checker* checker);
+
+/// @brief Performs the check how the safe can be opened
+///
+/// @param checker The checker
+/// @param timeout_ms Time limit of the check in milliseconds, 0 means unlimited
+/// @param result Output parameter. Result of the check
+///
+/// @return SAFE_LASER_TIMEOUT if the check is not completed in time, the result is not written then
+SAFE_LASER_API safe_laser_status safe_laser_check(const safe_laser_checker* checker, uint64_t timeout_ms,
+                                                  safe_laser_result* result);
+
+/// @brief Finds the minimal number of mirrors which should be inserted to open the safe and their placement
+///
+/// @param checker The checker
+/// @param result_type Output parameter. SAFE_LASER_CAN_NOT_BE_OPENED if no insertions open the safe
+/// @param placements Output parameter. The inserted mirrors in order of the beam passing them.
+/// May be NULL if the capacity is zero
+/// @param capacity Number of the elements of the placements buffer
+/// @param count Output parameter. Number of the inserted mirrors
+///
+/// @return SAFE_LASER_BUFFER_TOO_SMALL if the count exceeds the capacity, the placements are not written then
+SAFE_LASER_API safe_laser_status safe_laser_find_minimal_insertions(const safe_laser_checker* checker,
+                                                                    int32_t* result_type,
+                                                                    safe_laser_mirror* placements, size_t capacity,
+                                                                    size_t* count);
+
+/// @brief Finds all the existing mirrors, removal or flip of which opens the safe
+///
+/// @param checker The checker
+/// @param opens_without_changes Output parameter. 1 if the safe opens without changes, the changes are not searched
+/// @param changes Output parameter. The changes in the lexicographical order of the positions.
+/// May be NULL if the capacity is zero
+/// @param capacity Number of the elements of the changes buffer
+/// @param count Output parameter. Number of the changes
+///
+/// @return SAFE_LASER_BUFFER_TOO_SMALL if the count exceeds the capacity, the changes are not written then
+SAFE_LASER_API safe_laser_status safe_laser_find_single_mirror_changes(const safe_laser_checker* checker,
+                                                                       int32_t* opens_without_changes,
+                                                                       safe_laser_mirror* changes, size_t capacity,
+                                                                       size_t* count);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // SAFE_LASER_C
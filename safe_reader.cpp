@@ -0,0 +1,61 @@
+#include "safe_reader.h"
+#include "trace_recorder.h"
+
+#include <stdexcept>
+
+namespace mirrors_lasers {
+
+namespace {
+
+std::vector<Point> read_mirrors(std::istream& input, std::int32_t count, std::int32_t r, std::int32_t c)
+{
+  std::vector<Point> mirrors;
+  mirrors.reserve(static_cast<std::size_t>(count));
+  for (std::int32_t i = 0; i < count; ++i) {
+    std::int32_t ri{};
+    std::int32_t ci{};
+    input >> ri >> ci;
+    if (ri < 1 || ri > r) {
+      throw std::invalid_argument("Incorrect ri value");
+    }
+    if (ci < 1 || ci > c) {
+      throw std::invalid_argument("Incorrect ci value");
+    }
+    mirrors.push_back(Point{static_cast<std::uint32_t>(ri), static_cast<std::uint32_t>(ci)});
+  }
+  return mirrors;
+}
+
+}  // namespace
+
+SafeDescription read_safe(std::istream& input)
+{
+  TraceScope trace_scope{"read_safe"};
+  std::int32_t r{};
+  std::int32_t c{};
+  std::int32_t m{};
+  std::int32_t n{};
+  input >> r >> c >> m >> n;
+  if (r < 1 || r > MAX_SIDE) {
+    throw std::invalid_argument("Incorrect r value");
+  }
+  if (c < 1 || c > MAX_SIDE) {
+    throw std::invalid_argument("Incorrect c value");
+  }
+  if (m < 0 || m > MAX_MIRRORS) {
+    throw std::invalid_argument("Incorrect m value");
+  }
+  if (n < 0 || n > MAX_MIRRORS) {
+    throw std::invalid_argument("Incorrect n value");
+  }
+
+  SafeDescription safe{};
+  safe.rows = static_cast<std::uint32_t>(r);
+  safe.columns = static_cast<std::uint32_t>(c);
+  safe.left_to_up_mirrors = read_mirrors(input, m, r, c);
+  safe.left_to_down_mirrors = read_mirrors(input, n, r, c);
+  trace_scope.set_mirrors(safe.left_to_up_mirrors.size() + safe.left_to_down_mirrors.size());
+  return safe;
+}
+
+}  // namespace mirrors_lasers
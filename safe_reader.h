@@ -0,0 +1,41 @@
+#ifndef SAFE_READER
+#define SAFE_READER
+
+#include "safe_checker.h"
+
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+namespace mirrors_lasers {
+
+/// @brief Maximal number of rows or columns accepted by read_safe()
+constexpr std::int32_t MAX_SIDE{1000000};
+/// @brief Maximal number of mirrors of each type accepted by read_safe()
+constexpr std::int32_t MAX_MIRRORS{200000};
+
+/// @brief Input information about the mechanism grid
+struct SafeDescription final {
+  /// @brief Number of rows in the mechanism grid
+  std::uint32_t rows{0U};
+  /// @brief Number of columns in the mechanism grid
+  std::uint32_t columns{0U};
+  /// @brief List of positions where the "/" mirrors are placed
+  std::vector<Point> left_to_up_mirrors;
+  /// @brief List of positions where the "\\" mirrors are placed
+  std::vector<Point> left_to_down_mirrors;
+};
+
+/// @brief Reads the description of a safe in the text format: "r c m n", then m coordinates of "/" mirrors
+/// and n coordinates of "\\" mirrors
+///
+/// @param input Input stream
+///
+/// @return The safe description
+///
+/// @throw std::invalid_argument if the input is incorrect or incomplete
+SafeDescription read_safe(std::istream& input);
+
+}  // namespace mirrors_lasers
+
+#endif  // SAFE_READER
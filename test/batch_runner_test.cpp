@@ -0,0 +1,197 @@
+#include <batch_runner.h>
+#include <result_writer.h>
+
+#include "test_safes.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST(BatchRunnerTest, ResultsInInputOrder)
+{
+  std::istringstream input{"5 6 1 4\n2 3\n1 2\n2 5\n4 2\n5 5\n"
+                           "100 100 0 2 1 77 100 77\n"
+                           "100 100 0 0\n"
+                           "1 1 0 0\n"};
+  std::ostringstream output{};
+  mirrors_lasers::BatchOptions options{};
+  options.threads_count = 3U;
+
+  EXPECT_EQ(mirrors_lasers::run_batch(input, output, options), 4U);
+  EXPECT_EQ(output.str(), "2 4 3\n0\n-1\n0\n");
+}
+
+TEST(BatchRunnerTest, MemoryBudget)
+{
+  std::istringstream input{"5 6 1 4\n2 3\n1 2\n2 5\n4 2\n5 5\n"
+                           "1 1 0 0\n"};
+  std::ostringstream output{};
+  mirrors_lasers::BatchOptions options{};
+  // The safe without mirrors fits, the other one doesn't
+  options.checker_memory_budget = mirrors_lasers::BasicSafeChecker<std::uint16_t>::estimate_peak_memory(
+      0U, mirrors_lasers::MirrorsIndexLayout::Flat);
+
+  EXPECT_EQ(mirrors_lasers::run_batch(input, output, options), 2U);
+  EXPECT_EQ(output.str(), "memory_budget_exceeded\n0\n");
+}
+
+TEST(BatchRunnerTest, EmptyInput)
+{
+  std::istringstream input{" \n"};
+  std::ostringstream output{};
+
+  EXPECT_EQ(mirrors_lasers::run_batch(input, output, mirrors_lasers::BatchOptions{}), 0U);
+  EXPECT_TRUE(output.str().empty());
+}
+
+TEST(BatchRunnerTest, IncorrectSafe)
+{
+  std::istringstream input{"1 1 0 0\n5 6 1 0\n7 1\n"};
+  std::ostringstream output{};
+
+  try {
+    mirrors_lasers::run_batch(input, output, mirrors_lasers::BatchOptions{});
+    FAIL() << "Exception is expected";
+  } catch (const std::invalid_argument& exception) {
+    EXPECT_EQ(std::string{exception.what()}, "Safe 2: Incorrect ri value");
+  }
+}
+
+TEST(BatchRunnerTest, StoppedChecks)
+{
+  // The detector beam of the second safe crosses every column of the laser beam, about 9 million intersections
+  mirrors_lasers::SafeDescription comb_safe{3000U, 3000U, {}, {}};
+  mirrors_lasers::test::make_comb(comb_safe.rows, comb_safe.left_to_up_mirrors, comb_safe.left_to_down_mirrors);
+  const std::vector<mirrors_lasers::SafeDescription> safes{{100U, 100U, {}, {}}, comb_safe};
+
+  mirrors_lasers::BatchOptions options{};
+  options.check_timeout = std::chrono::milliseconds{1};
+  std::vector<mirrors_lasers::LimitedCheckResult> results = mirrors_lasers::check_safes(safes, options);
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results[1].status, mirrors_lasers::CheckStatus::DeadlineExceeded);
+
+  options.check_timeout = std::chrono::milliseconds{0};
+  options.cancellation.cancel();
+  results = mirrors_lasers::check_safes(safes, options);
+  EXPECT_EQ(results[0].status, mirrors_lasers::CheckStatus::Cancelled);
+  EXPECT_EQ(results[1].status, mirrors_lasers::CheckStatus::Cancelled);
+}
+
+TEST(BatchRunnerTest, FingerprintIgnoresOrderOfMirrors)
+{
+  const mirrors_lasers::SafeDescription safe{5U, 6U, {{2U, 3U}}, {{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}}};
+  const mirrors_lasers::SafeDescription reordered{5U, 6U, {{2U, 3U}}, {{5U, 5U}, {2U, 5U}, {1U, 2U}, {4U, 2U}}};
+  const mirrors_lasers::SafeDescription flipped{5U, 6U, {{2U, 3U}, {5U, 5U}}, {{1U, 2U}, {2U, 5U}, {4U, 2U}}};
+  const mirrors_lasers::SafeDescription transposed{6U, 5U, {{2U, 3U}}, {{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}}};
+
+  EXPECT_TRUE(mirrors_lasers::fingerprint_safe(safe) == mirrors_lasers::fingerprint_safe(reordered));
+  EXPECT_FALSE(mirrors_lasers::fingerprint_safe(safe) == mirrors_lasers::fingerprint_safe(flipped));
+  EXPECT_FALSE(mirrors_lasers::fingerprint_safe(safe) == mirrors_lasers::fingerprint_safe(transposed));
+}
+
+TEST(BatchRunnerTest, DuplicatesAnsweredFromCache)
+{
+  const std::string safe{"5 6 1 4\n2 3\n1 2\n2 5\n4 2\n5 5\n"};
+  const std::string reordered_safe{"5 6 1 4\n2 3\n5 5\n4 2\n2 5\n1 2\n"};
+  mirrors_lasers::BatchOptions options{};
+  options.threads_count = 2U;
+  options.result_cache = std::make_shared<mirrors_lasers::ResultCache>(2U);
+
+  std::istringstream input{safe + "100 100 0 0\n" + reordered_safe + safe};
+  std::ostringstream output{};
+  EXPECT_EQ(mirrors_lasers::run_batch(input, output, options), 4U);
+  EXPECT_EQ(output.str(), "2 4 3\n-1\n2 4 3\n2 4 3\n");
+  mirrors_lasers::ResultCacheStats stats = options.result_cache->stats();
+  EXPECT_EQ(stats.hits, 2U);
+  EXPECT_EQ(stats.misses, 2U);
+  EXPECT_EQ(stats.entries, 2U);
+  EXPECT_DOUBLE_EQ(stats.hit_rate(), 0.5);
+
+  // The cache is shared between batches and keeps the most recently used results
+  std::istringstream next_input{"1 1 0 0\n" + safe};
+  output.str("");
+  mirrors_lasers::run_batch(next_input, output, options);
+  EXPECT_EQ(output.str(), "0\n2 4 3\n");
+  stats = options.result_cache->stats();
+  EXPECT_EQ(stats.hits, 3U);
+  EXPECT_EQ(stats.misses, 3U);
+  EXPECT_EQ(stats.entries, 2U);
+
+  std::istringstream evicted_input{"100 100 0 0\n"};
+  output.str("");
+  mirrors_lasers::run_batch(evicted_input, output, options);
+  EXPECT_EQ(output.str(), "-1\n");
+  EXPECT_EQ(options.result_cache->stats().misses, 4U);
+}
+
+TEST(BatchRunnerTest, OutputFormats)
+{
+  const std::string safes{"5 6 1 4\n2 3\n1 2\n2 5\n4 2\n5 5\n100 100 0 2 1 77 100 77\n100 100 0 0\n"};
+  mirrors_lasers::BatchOptions options{};
+  options.output.with_case_id = true;
+
+  std::istringstream plain_input{safes};
+  std::ostringstream output{};
+  mirrors_lasers::run_batch(plain_input, output, options);
+  EXPECT_EQ(output.str(), "1 2 4 3\n2 0\n3 -1\n");
+
+  options.output.format = mirrors_lasers::OutputFormat::Csv;
+  std::istringstream csv_input{safes};
+  output.str("");
+  mirrors_lasers::run_batch(csv_input, output, options);
+  EXPECT_EQ(output.str(), "case_id,status,result,positions,row,col\n"
+                          "1,completed,requires_mirror_insertion,2,4,3\n"
+                          "2,completed,opens_without_inserting,,,\n"
+                          "3,completed,can_not_be_opened,,,\n");
+
+  options.output.format = mirrors_lasers::OutputFormat::JsonLines;
+  options.output.with_case_id = false;
+  options.output.with_timing = true;
+  std::istringstream json_input{safes};
+  output.str("");
+  mirrors_lasers::run_batch(json_input, output, options);
+  std::istringstream lines{output.str()};
+  std::string line;
+  ASSERT_TRUE(std::getline(lines, line));
+  const std::string expected_prefix{"{\"status\":\"completed\",\"result\":\"requires_mirror_insertion\","
+                                    "\"positions\":2,\"row\":4,\"col\":3,\"time_ns\":"};
+  EXPECT_EQ(line.substr(0U, expected_prefix.size()), expected_prefix);
+  EXPECT_EQ(line.back(), '}');
+  ASSERT_TRUE(std::getline(lines, line));
+  EXPECT_NE(line.find("\"result\":\"opens_without_inserting\",\"positions\":null,\"row\":null,\"col\":null"),
+            std::string::npos);
+}
+
+TEST(BatchRunnerTest, ResultWriterEscapesCaseIds)
+{
+  mirrors_lasers::LimitedCheckResult result{};
+  result.status = mirrors_lasers::CheckStatus::DeadlineExceeded;
+  result.elapsed = std::chrono::nanoseconds{18446744073709551615ULL / 2U};
+
+  // The block of a single byte is written after each result
+  std::ostringstream output{};
+  mirrors_lasers::OutputOptions options{};
+  options.format = mirrors_lasers::OutputFormat::JsonLines;
+  options.with_case_id = true;
+  options.with_timing = true;
+  mirrors_lasers::ResultWriter json_writer{output, options, 1U};
+  json_writer.write("a\"b\\c\n", result);
+  EXPECT_EQ(output.str(), "{\"case_id\":\"a\\\"b\\\\c\\u000a\",\"status\":\"timeout\",\"result\":null,"
+                          "\"positions\":null,\"row\":null,\"col\":null,\"time_ns\":9223372036854775807}\n");
+
+  output.str("");
+  options.format = mirrors_lasers::OutputFormat::Csv;
+  options.with_timing = false;
+  {
+    mirrors_lasers::ResultWriter csv_writer{output, options};
+    csv_writer.write("x,\"y\"", result);
+    EXPECT_TRUE(output.str().empty());
+  }
+  EXPECT_EQ(output.str(), "case_id,status,result,positions,row,col\n\"x,\"\"y\"\"\",timeout,,,,\n");
+}
@@ -0,0 +1,200 @@
+#include <memory_arena.h>
+#include <safe_checker.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// @brief Sets the memory policy and restores the default one on destruction
+class ScopedMemoryPolicy final {
+public:
+  explicit ScopedMemoryPolicy(const mirrors_lasers::MemoryPolicy& policy)
+  {
+    mirrors_lasers::set_memory_policy(policy);
+  }
+
+  ~ScopedMemoryPolicy()
+  {
+    mirrors_lasers::set_memory_policy(mirrors_lasers::MemoryPolicy{});
+  }
+};
+
+std::string read_snapshot_bytes(const mirrors_lasers::SafeChecker& checker, const std::string& name)
+{
+  const std::string path = ::testing::TempDir() + name;
+  checker.save_snapshot(path, false);
+  std::ifstream file{path, std::ios::binary};
+  const std::string bytes{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+  std::remove(path.c_str());
+  return bytes;
+}
+
+}  // namespace
+
+TEST(MemoryArenaTest, AllocatesAlignedBlocks)
+{
+  mirrors_lasers::MemoryPolicy policy{};
+  policy.huge_pages = mirrors_lasers::HugePagesMode::Transparent;
+  mirrors_lasers::MemoryArena arena{policy};
+  EXPECT_EQ(arena.reserved_bytes(), 0U);
+
+  auto* first = static_cast<unsigned char*>(arena.allocate(3U, 1U));
+  auto* second = static_cast<unsigned char*>(arena.allocate(8U, 8U));
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(second) % 8U, 0U);
+  EXPECT_GE(second, first + 3U);
+  first[2] = 1U;
+  second[7] = 2U;
+
+  // A block larger than a chunk gets its own chunk
+  constexpr std::size_t LARGE_SIZE{std::size_t{5U} << 20U};
+  auto* large = static_cast<unsigned char*>(arena.allocate(LARGE_SIZE, 16U));
+  large[0] = 3U;
+  large[LARGE_SIZE - 1U] = 4U;
+  EXPECT_GE(arena.reserved_bytes(), LARGE_SIZE + (std::size_t{2U} << 20U));
+  EXPECT_LE(arena.huge_page_bytes(), arena.reserved_bytes());
+  EXPECT_EQ(first[2], 1U);
+  EXPECT_EQ(second[7], 2U);
+}
+
+TEST(MemoryArenaTest, AllocatorsOfArenasAreInterchangeable)
+{
+  mirrors_lasers::MemoryArena first_arena{mirrors_lasers::MemoryPolicy{}};
+  mirrors_lasers::MemoryArena second_arena{mirrors_lasers::MemoryPolicy{}};
+  const mirrors_lasers::ArenaAllocator<int> first{&first_arena};
+  const mirrors_lasers::ArenaAllocator<double> second{&second_arena};
+  const mirrors_lasers::ArenaAllocator<int> heap{};
+  EXPECT_TRUE(first == second);
+  EXPECT_TRUE(first != heap);
+  EXPECT_TRUE(mirrors_lasers::ArenaAllocator<double>{first}.arena() == &first_arena);
+}
+
+TEST(MemoryArenaTest, AllocationCounterCountsRequestedBytes)
+{
+  mirrors_lasers::MemoryArena arena{mirrors_lasers::MemoryPolicy{}};
+  std::vector<int, mirrors_lasers::ArenaAllocator<int>> heap_vector{};
+  std::vector<int, mirrors_lasers::ArenaAllocator<int>> arena_vector{mirrors_lasers::ArenaAllocator<int>{&arena}};
+  const mirrors_lasers::AllocationCounter outer_counter{};
+  heap_vector.reserve(10U);
+  {
+    // The bytes of the inner scope are not added to the outer counter
+    const mirrors_lasers::AllocationCounter inner_counter{};
+    arena_vector.reserve(3U);
+    EXPECT_EQ(inner_counter.bytes(), static_cast<std::ptrdiff_t>(3U * sizeof(int)));
+  }
+  EXPECT_EQ(outer_counter.bytes(), static_cast<std::ptrdiff_t>(10U * sizeof(int)));
+  heap_vector.shrink_to_fit();
+  heap_vector = std::vector<int, mirrors_lasers::ArenaAllocator<int>>{};
+  EXPECT_EQ(outer_counter.bytes(), 0);
+}
+
+TEST(MemoryArenaTest, CheckersMatchWithAllPolicies)
+{
+  constexpr std::uint32_t R{700U};
+  constexpr std::uint32_t C{900U};
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+  std::uint64_t state{777U};
+  for (std::size_t index = 0U; index < 20000U; ++index) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    const mirrors_lasers::Point mirror{static_cast<std::uint32_t>((state >> 33U) % R) + 1U,
+                                       static_cast<std::uint32_t>((state >> 13U) % C) + 1U};
+    (((state >> 5U) & 1U) != 0U ? left_to_up_mirrors : left_to_down_mirrors).push_back(mirror);
+  }
+
+  const mirrors_lasers::SafeChecker reference_checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  const mirrors_lasers::SafeCheckResult reference_result = reference_checker.check_safe();
+  const std::string reference_bytes = read_snapshot_bytes(reference_checker, "reference_index.bin");
+
+  std::vector<mirrors_lasers::MemoryPolicy> policies(3U);
+  policies[0].huge_pages = mirrors_lasers::HugePagesMode::Transparent;
+  policies[1].huge_pages = mirrors_lasers::HugePagesMode::Explicit;
+  policies[2].is_numa_local = true;
+  for (const mirrors_lasers::MemoryPolicy& policy : policies) {
+    const ScopedMemoryPolicy scoped_policy{policy};
+    for (const std::size_t threads_count : {1U, 4U}) {
+      const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors, threads_count};
+      const mirrors_lasers::SafeCheckResult result = checker.check_safe();
+      EXPECT_EQ(result.result_type, reference_result.result_type);
+      EXPECT_EQ(result.positions, reference_result.positions);
+      EXPECT_EQ(result.mirror_row, reference_result.mirror_row);
+      EXPECT_EQ(result.mirror_col, reference_result.mirror_col);
+      EXPECT_TRUE(read_snapshot_bytes(checker, "arena_index.bin") == reference_bytes);
+      // The nodes are allocated from the arenas, which are never shrunk
+      const mirrors_lasers::MemoryFootprint footprint = checker.memory_footprint();
+      EXPECT_GT(footprint.row_wise_index_bytes, 0U);
+      EXPECT_GE(footprint.arena_reserved_bytes, footprint.row_wise_index_bytes + footprint.col_wise_index_bytes);
+    }
+  }
+}
+
+TEST(MemoryArenaTest, MemoryBudgetCountsChunks)
+{
+  constexpr std::size_t MIB{std::size_t{1U} << 20U};
+  EXPECT_EQ(mirrors_lasers::MemoryArena::max_reserved_bytes(0U, 4U), 0U);
+  {
+    // The allocation just over the first three chunks takes the whole fourth one, and the large block
+    // leaves the tail of the fourth chunk unused
+    mirrors_lasers::MemoryArena arena{mirrors_lasers::MemoryPolicy{}};
+    std::size_t allocated_bytes{0U};
+    for (std::size_t block = 0U; block <= 14U * 16U; ++block) {
+      arena.allocate(MIB / 16U, 8U);
+      allocated_bytes += MIB / 16U;
+    }
+    arena.allocate(20U * MIB, 8U);
+    allocated_bytes += 20U * MIB;
+    EXPECT_GE(arena.reserved_bytes(), 36U * MIB);
+    EXPECT_LE(arena.reserved_bytes(), mirrors_lasers::MemoryArena::max_reserved_bytes(allocated_bytes, 1U));
+  }
+
+  mirrors_lasers::MemoryPolicy policy{};
+  policy.huge_pages = mirrors_lasers::HugePagesMode::Transparent;
+  const ScopedMemoryPolicy scoped_policy{policy};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {4U, 2U}};
+
+  // Each of the indexes would take a whole chunk of its arena
+  const mirrors_lasers::SafeChecker checker{10U, 10U, left_to_up_mirrors, left_to_down_mirrors, 1U,
+                                            mirrors_lasers::MirrorsIndexLayout::Hashed, MIB};
+  EXPECT_EQ(checker.index_layout(), mirrors_lasers::MirrorsIndexLayout::Flat);
+  EXPECT_EQ(checker.memory_footprint().arena_reserved_bytes, 0U);
+  EXPECT_LE(checker.memory_footprint().total_bytes(), MIB);
+
+  const mirrors_lasers::SafeChecker hashed{10U, 10U, left_to_up_mirrors, left_to_down_mirrors, 1U,
+                                           mirrors_lasers::MirrorsIndexLayout::Hashed, 10U * MIB};
+  EXPECT_EQ(hashed.index_layout(), mirrors_lasers::MirrorsIndexLayout::Hashed);
+  EXPECT_LE(hashed.memory_footprint().total_bytes(), 10U * MIB);
+}
+
+TEST(MemoryArenaTest, MemoryBudgetCoversUnevenParts)
+{
+  using Checker = mirrors_lasers::BasicSafeChecker<std::uint16_t>;
+  constexpr std::uint32_t SIDE{1000U};
+  constexpr std::size_t THREADS_COUNT{8U};
+  mirrors_lasers::MemoryPolicy policy{};
+  policy.huge_pages = mirrors_lasers::HugePagesMode::Transparent;
+  const ScopedMemoryPolicy scoped_policy{policy};
+  // All the mirrors are in the rows of the first part of the row-wise index
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+  for (std::uint32_t row = 1U; row <= 40U; ++row) {
+    for (std::uint32_t col = 1U; col <= SIDE; ++col) {
+      ((row + col) % 2U == 0U ? left_to_up_mirrors : left_to_down_mirrors).push_back({row, col});
+    }
+  }
+  const std::size_t mirrors_count = left_to_up_mirrors.size() + left_to_down_mirrors.size();
+  const std::size_t estimate =
+      Checker::estimate_peak_memory(mirrors_count, mirrors_lasers::MirrorsIndexLayout::Hashed, THREADS_COUNT, policy);
+  const Checker checker{SIDE, SIDE, left_to_up_mirrors, left_to_down_mirrors, THREADS_COUNT,
+                        mirrors_lasers::MirrorsIndexLayout::Hashed, estimate};
+  EXPECT_EQ(checker.index_layout(), mirrors_lasers::MirrorsIndexLayout::Hashed);
+  mirrors_lasers::SafeCheckStatistics statistics{};
+  checker.check_safe(statistics);
+  EXPECT_LE(checker.memory_footprint().total_bytes() + statistics.peak_scratch_bytes, estimate);
+}
@@ -0,0 +1,218 @@
+#include <query_server.h>
+#include <safe_reader.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+TEST(SafeReaderTest, ReadsSafe)
+{
+  std::istringstream input{"5 6 1 4\n2 3\n1 2\n2 5\n4 2\n5 5\n"};
+
+  const mirrors_lasers::SafeDescription safe = mirrors_lasers::read_safe(input);
+  EXPECT_EQ(safe.rows, 5U);
+  EXPECT_EQ(safe.columns, 6U);
+  ASSERT_EQ(safe.left_to_up_mirrors.size(), 1U);
+  EXPECT_EQ(safe.left_to_up_mirrors[0].row, 2U);
+  EXPECT_EQ(safe.left_to_up_mirrors[0].col, 3U);
+  ASSERT_EQ(safe.left_to_down_mirrors.size(), 4U);
+  EXPECT_EQ(safe.left_to_down_mirrors[3].row, 5U);
+  EXPECT_EQ(safe.left_to_down_mirrors[3].col, 5U);
+}
+
+TEST(SafeReaderTest, IncorrectInput)
+{
+  std::istringstream zero_rows{"0 6 0 0"};
+  EXPECT_THROW(mirrors_lasers::read_safe(zero_rows), std::invalid_argument);
+  std::istringstream mirror_outside{"5 6 1 0\n6 1"};
+  EXPECT_THROW(mirrors_lasers::read_safe(mirror_outside), std::invalid_argument);
+  std::istringstream incomplete{"5 6 2 0\n1 1"};
+  EXPECT_THROW(mirrors_lasers::read_safe(incomplete), std::invalid_argument);
+}
+
+TEST(LatencyHistogramTest, Percentiles)
+{
+  mirrors_lasers::LatencyHistogram histogram{};
+  EXPECT_EQ(histogram.percentile(0.5).count(), 0);
+
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.record(std::chrono::microseconds{i});
+  }
+  EXPECT_EQ(histogram.count(), 1000U);
+
+  // The relative error of a percentile is below 12.5%
+  const double p50 = static_cast<double>(histogram.percentile(0.5).count());
+  const double p99 = static_cast<double>(histogram.percentile(0.99).count());
+  EXPECT_GE(p50, 500000.0);
+  EXPECT_LE(p50, 500000.0 * 1.125);
+  EXPECT_GE(p99, 990000.0);
+  EXPECT_LE(p99, 990000.0 * 1.125);
+}
+
+TEST(QueryServerTest, CheckAndInsertions)
+{
+  mirrors_lasers::QueryServer server{1024U * 1024U};
+
+  EXPECT_EQ(server.handle_request("put a 5 6 1 4 2 3 1 2 2 5 4 2 5 5"), "put a ok");
+  EXPECT_EQ(server.handle_request("put b 100 100 0 0"), "put b ok");
+  EXPECT_EQ(server.handle_request("check a"), "check a 2 4 3");
+  EXPECT_EQ(server.handle_request("check b"), "check b -1");
+  EXPECT_EQ(server.handle_request("insertions b"), "insertions b 2 1 1 \\ 100 1 \\");
+
+  EXPECT_EQ(server.handle_request("evict a"), "evict a ok");
+  EXPECT_EQ(server.handle_request("check a"), "error Unknown safe: a");
+  EXPECT_EQ(server.handle_request("frobnicate a"), "error Unknown command: frobnicate");
+  EXPECT_EQ(server.handle_request("put c 0 1 0 0"), "error Incorrect r value");
+
+  const mirrors_lasers::QueryServerStats stats = server.stats();
+  EXPECT_EQ(stats.requests, 9U);
+  EXPECT_EQ(stats.registered_safes, 1U);
+  EXPECT_EQ(stats.cached_checkers, 1U);
+  EXPECT_EQ(stats.cache_hits, 3U);
+  EXPECT_EQ(stats.cache_misses, 0U);
+  EXPECT_LE(stats.p50_latency.count(), stats.p99_latency.count());
+}
+
+TEST(QueryServerTest, Changes)
+{
+  mirrors_lasers::QueryServer server{1024U * 1024U};
+
+  EXPECT_EQ(server.handle_request("put a 5 6 1 4 2 3 1 2 2 5 4 2 5 5"), "put a ok");
+  EXPECT_EQ(server.handle_request("changes a"), "changes a 0 0");
+  EXPECT_EQ(server.handle_request("put c 2 2 1 1 1 2 2 2"), "put c ok");
+  EXPECT_EQ(server.handle_request("changes c"), "changes c 0 1 1 2 flip");
+  EXPECT_EQ(server.handle_request("changes d"), "error Unknown safe: d");
+
+  const mirrors_lasers::QueryServerStats stats = server.stats();
+  EXPECT_EQ(stats.requests, 5U);
+  EXPECT_EQ(stats.cache_hits, 2U);
+}
+
+TEST(QueryServerTest, EvictsLeastRecentlyUsed)
+{
+  // The budget is enough for a single checker only
+  const std::size_t a_bytes =
+      mirrors_lasers::SafeChecker{5U, 6U, {{2U, 3U}}, {{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}}}
+          .memory_footprint().total_bytes();
+  const std::size_t b_bytes =
+      mirrors_lasers::SafeChecker{100U, 100U, {}, {{1U, 77U}, {100U, 77U}}}.memory_footprint().total_bytes();
+  const std::size_t budget = a_bytes + b_bytes - 1U;
+  mirrors_lasers::QueryServer server{budget};
+
+  EXPECT_EQ(server.handle_request("put a 5 6 1 4 2 3 1 2 2 5 4 2 5 5"), "put a ok");
+  EXPECT_EQ(server.handle_request("put b 100 100 0 2 1 77 100 77"), "put b ok");
+  EXPECT_EQ(server.stats().cached_checkers, 1U);
+
+  // The checker of "a" is built again from its description
+  EXPECT_EQ(server.handle_request("check a"), "check a 2 4 3");
+  EXPECT_EQ(server.handle_request("check b"), "check b 0");
+  EXPECT_EQ(server.handle_request("check b"), "check b 0");
+
+  const mirrors_lasers::QueryServerStats stats = server.stats();
+  EXPECT_EQ(stats.registered_safes, 2U);
+  EXPECT_EQ(stats.cached_checkers, 1U);
+  EXPECT_EQ(stats.cached_bytes, b_bytes);
+  EXPECT_LE(stats.cached_bytes, budget);
+  EXPECT_EQ(stats.cache_misses, 2U);
+  EXPECT_EQ(stats.cache_hits, 1U);
+}
+
+TEST(QueryServerTest, ReregisteredWhileBuilding)
+{
+  // The large safe is built long enough for the small one to be registered under the same ID meanwhile
+  constexpr std::uint32_t SIDE{100000U};
+  constexpr std::size_t MIRRORS_COUNT{200000U};
+  std::ostringstream large_safe{};
+  large_safe << SIDE << " " << SIDE << " " << MIRRORS_COUNT << " 0";
+  std::uint64_t state{4242U};
+  for (std::size_t index = 0U; index < MIRRORS_COUNT; ++index) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    large_safe << " " << (state >> 33U) % SIDE + 1U << " " << (state >> 13U) % SIDE + 1U;
+  }
+  const std::string large_description = large_safe.str();
+  std::istringstream large_input{large_description};
+  const mirrors_lasers::SafeDescription large = mirrors_lasers::read_safe(large_input);
+  const std::size_t large_bytes =
+      mirrors_lasers::SafeChecker{large.rows, large.columns, large.left_to_up_mirrors, large.left_to_down_mirrors}
+          .memory_footprint().total_bytes();
+
+  // A single large checker fits into the cache
+  mirrors_lasers::QueryServer server{large_bytes + large_bytes / 2U};
+  EXPECT_EQ(server.handle_request("put a " + large_description), "put a ok");
+  EXPECT_EQ(server.handle_request("put b " + large_description), "put b ok");
+  ASSERT_EQ(server.stats().cached_checkers, 1U);
+
+  std::thread rebuilding_thread{[&server] () { server.handle_request("check a"); }};
+  while (server.stats().cache_misses == 0U) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(server.handle_request("put a 5 6 1 4 2 3 1 2 2 5 4 2 5 5"), "put a ok");
+  rebuilding_thread.join();
+
+  // The checker of the replaced safe is not cached
+  EXPECT_EQ(server.handle_request("check a"), "check a 2 4 3");
+  EXPECT_EQ(server.stats().cache_misses, 1U);
+}
+
+TEST(QueryServerTest, ServeStream)
+{
+  mirrors_lasers::QueryServer server{1024U * 1024U};
+  server.handle_request("put a 5 6 1 4 2 3 1 2 2 5 4 2 5 5");
+
+  std::istringstream input{"check a\ncheck a\n\ncheck a\n"};
+  std::ostringstream output{};
+  server.serve_stream(input, output, 3U);
+
+  EXPECT_EQ(output.str(), "check a 2 4 3\ncheck a 2 4 3\ncheck a 2 4 3\n");
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST(QueryServerTest, ServeUnixSocket)
+{
+  mirrors_lasers::QueryServer server{1024U * 1024U};
+  server.handle_request("put a 5 6 1 4 2 3 1 2 2 5 4 2 5 5");
+  const std::string path = "query_server_test.sock";
+
+  // A file which is not a socket is not replaced
+  std::ofstream{path} << "data";
+  EXPECT_THROW(server.serve_unix_socket(path), std::runtime_error);
+  EXPECT_EQ(::access(path.c_str(), F_OK), 0);
+  ::unlink(path.c_str());
+
+  std::thread serving_thread{[&server, &path] () { server.serve_unix_socket(path); }};
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::copy(path.begin(), path.end(), address.sun_path);
+  const int descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(descriptor, 0);
+  while (::connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+
+  const std::string requests{"check a\nshutdown\n"};
+  ASSERT_EQ(::send(descriptor, requests.data(), requests.size(), 0), static_cast<ssize_t>(requests.size()));
+  std::string response;
+  char chunk[256];
+  ssize_t received = 0;
+  while ((received = ::recv(descriptor, chunk, sizeof(chunk), 0)) > 0) {
+    response.append(chunk, static_cast<std::size_t>(received));
+  }
+  ::close(descriptor);
+  serving_thread.join();
+
+  EXPECT_EQ(response, "check a 2 4 3\n");
+  EXPECT_NE(::access(path.c_str(), F_OK), 0);
+}
+#endif
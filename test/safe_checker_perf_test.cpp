@@ -0,0 +1,254 @@
+#include <safe_checker.h>
+
+#include "test_safes.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+// The global allocation functions are replaced in this test executable only, so that every allocation
+// of the standard containers is counted
+namespace {
+
+std::atomic<std::uint64_t> allocations_count{0U};
+
+void* counted_allocate(std::size_t size)
+{
+  allocations_count.fetch_add(1U, std::memory_order_relaxed);
+  void* pointer = std::malloc(size == 0U ? 1U : size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc{};
+  }
+  return pointer;
+}
+
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+  return counted_allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+  return counted_allocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+namespace {
+
+/// @brief Generated safe
+struct GeneratedSafe final {
+  std::uint32_t rows{0U};
+  std::uint32_t columns{0U};
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors;
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors;
+
+  std::size_t mirrors_count() const
+  {
+    return left_to_up_mirrors.size() + left_to_down_mirrors.size();
+  }
+};
+
+/// @brief Measurements of a single safe
+struct SafeMeasurement final {
+  std::size_t mirrors{0U};
+  mirrors_lasers::SafeCheckResult result{};
+  mirrors_lasers::SafeCheckStatistics statistics{};
+  std::uint64_t build_allocations{0U};
+  std::uint64_t check_allocations{0U};
+  /// @brief Minimal time of the construction and the check over the repetitions
+  double seconds{0.0};
+};
+
+/// @brief The beam from the laser is turned along every row, so it passes all the mirrors
+GeneratedSafe generate_serpentine_safe(std::uint32_t side)
+{
+  GeneratedSafe safe{side, side, {}, {}};
+  for (std::uint32_t row = 1U; row < side; ++row) {
+    const bool is_right_to_left = row % 2U == 0U;
+    const mirrors_lasers::Point turn_down{row, is_right_to_left ? 1U : side};
+    const mirrors_lasers::Point turn_along{row + 1U, is_right_to_left ? 1U : side};
+    (is_right_to_left ? safe.left_to_up_mirrors : safe.left_to_down_mirrors).push_back(turn_down);
+    (is_right_to_left ? safe.left_to_down_mirrors : safe.left_to_up_mirrors).push_back(turn_along);
+  }
+  return safe;
+}
+
+/// @brief The beams zigzag over the columns and over the rows, so every inner cell is an intersection
+GeneratedSafe generate_comb_safe(std::uint32_t side)
+{
+  GeneratedSafe safe{side, side, {}, {}};
+  mirrors_lasers::test::make_comb(side, safe.left_to_up_mirrors, safe.left_to_down_mirrors);
+  return safe;
+}
+
+/// @brief Mirrors are placed randomly into a quarter of the cells
+GeneratedSafe generate_random_safe(std::size_t mirrors_count, std::uint64_t seed)
+{
+  const auto side = static_cast<std::uint32_t>(std::ceil(std::sqrt(static_cast<double>(mirrors_count) * 4.0)));
+  GeneratedSafe safe{side, side, {}, {}};
+  std::uint64_t state{seed};
+  std::unordered_set<std::uint64_t> occupied{};
+  while (safe.mirrors_count() < mirrors_count) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    const mirrors_lasers::Point mirror{static_cast<std::uint32_t>((state >> 33U) % side) + 1U,
+                                       static_cast<std::uint32_t>((state >> 13U) % side) + 1U};
+    if (occupied.insert((static_cast<std::uint64_t>(mirror.row) << 32U) | mirror.col).second) {
+      (((state >> 5U) & 1U) != 0U ? safe.left_to_up_mirrors : safe.left_to_down_mirrors).push_back(mirror);
+    }
+  }
+  return safe;
+}
+
+SafeMeasurement measure(const GeneratedSafe& safe, std::size_t repetitions)
+{
+  SafeMeasurement measurement{};
+  measurement.mirrors = safe.mirrors_count();
+  measurement.seconds = std::numeric_limits<double>::max();
+  for (std::size_t repetition = 0U; repetition < repetitions; ++repetition) {
+    const auto start_time = std::chrono::steady_clock::now();
+    std::uint64_t allocations = allocations_count.load();
+    const mirrors_lasers::SafeChecker checker{safe.rows, safe.columns, safe.left_to_up_mirrors,
+                                              safe.left_to_down_mirrors};
+    measurement.build_allocations = allocations_count.load() - allocations;
+    allocations = allocations_count.load();
+    measurement.result = checker.check_safe(measurement.statistics);
+    measurement.check_allocations = allocations_count.load() - allocations;
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start_time;
+    measurement.seconds = std::min(measurement.seconds, time.count());
+  }
+  return measurement;
+}
+
+/// @brief Returns the exponent k of the fit y = a * x^k by the least squares in the log-log scale
+double scaling_exponent(const std::vector<double>& x, const std::vector<double>& y)
+{
+  double mean_x{0.0};
+  double mean_y{0.0};
+  for (std::size_t index = 0U; index < x.size(); ++index) {
+    mean_x += std::log(x[index]) / static_cast<double>(x.size());
+    mean_y += std::log(y[index]) / static_cast<double>(y.size());
+  }
+  double covariance{0.0};
+  double variance{0.0};
+  for (std::size_t index = 0U; index < x.size(); ++index) {
+    covariance += (std::log(x[index]) - mean_x) * (std::log(y[index]) - mean_y);
+    variance += (std::log(x[index]) - mean_x) * (std::log(x[index]) - mean_x);
+  }
+  return covariance / variance;
+}
+
+}  // namespace
+
+TEST(SafeCheckerPerfTest, TracingWorkIsLinear)
+{
+  std::vector<double> mirrors{};
+  std::vector<double> segments{};
+  std::vector<double> lookups{};
+  std::vector<double> check_allocations{};
+  for (std::uint32_t side = 1024U; side <= 16384U; side *= 2U) {
+    const SafeMeasurement measurement = measure(generate_serpentine_safe(side), 1U);
+    mirrors.push_back(static_cast<double>(measurement.mirrors));
+    segments.push_back(static_cast<double>(measurement.statistics.traced_segments));
+    lookups.push_back(static_cast<double>(measurement.statistics.mirror_lookups));
+    check_allocations.push_back(static_cast<double>(measurement.check_allocations));
+    // The beam from the laser passes every mirror
+    EXPECT_GE(measurement.statistics.traced_segments, measurement.mirrors);
+  }
+  EXPECT_NEAR(scaling_exponent(mirrors, segments), 1.0, 0.05);
+  EXPECT_LT(scaling_exponent(segments, lookups), 1.05);
+  // Segments are stored in growing arrays, so the allocations of the check grow only logarithmically. A single
+  // allocation per traced step would make them linear in the segments
+  EXPECT_LT(scaling_exponent(segments, check_allocations), 0.3);
+  EXPECT_LT(check_allocations.back(), segments.back() / 16.0);
+}
+
+TEST(SafeCheckerPerfTest, IntersectionSearchIsOutputSensitive)
+{
+  std::vector<double> sides{};
+  std::vector<double> candidates{};
+  for (std::uint32_t side = 64U; side <= 1024U; side *= 2U) {
+    const SafeMeasurement measurement = measure(generate_comb_safe(side), 1U);
+    ASSERT_EQ(measurement.result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+    const std::uint64_t segments = measurement.statistics.traced_segments;
+    const std::uint64_t positions = measurement.result.positions;
+    // Every tested line is either an intersection or the end of a segment
+    EXPECT_LE(measurement.statistics.intersection_candidates, positions + 2U * segments);
+    EXPECT_LE(measurement.statistics.mirror_lookups, measurement.statistics.intersection_candidates + segments + 2U);
+    sides.push_back(static_cast<double>(side));
+    candidates.push_back(static_cast<double>(measurement.statistics.intersection_candidates));
+  }
+  // The number of the intersections is quadratic by construction, the candidates must not grow faster
+  EXPECT_LT(scaling_exponent(sides, candidates), 2.1);
+}
+
+TEST(SafeCheckerPerfTest, ConstructionAllocationsAreLinear)
+{
+  std::vector<double> mirrors{};
+  std::vector<double> build_allocations{};
+  for (std::size_t mirrors_count = 1U << 12U; mirrors_count <= (1U << 16U); mirrors_count *= 2U) {
+    const SafeMeasurement measurement = measure(generate_random_safe(mirrors_count, mirrors_count), 1U);
+    mirrors.push_back(static_cast<double>(measurement.mirrors));
+    build_allocations.push_back(static_cast<double>(measurement.build_allocations));
+  }
+  EXPECT_LT(scaling_exponent(mirrors, build_allocations), 1.05);
+  // A node in the row-wise and in the column-wise index, and a few per line
+  EXPECT_LT(build_allocations.back() / mirrors.back(), 2.75);
+}
+
+TEST(SafeCheckerPerfTest, FlatConstructionAllocationsAreConstant)
+{
+  for (std::size_t mirrors_count = 1U << 12U; mirrors_count <= (1U << 16U); mirrors_count *= 4U) {
+    const GeneratedSafe safe = generate_random_safe(mirrors_count, mirrors_count);
+    const std::uint64_t allocations = allocations_count.load();
+    const mirrors_lasers::SafeChecker checker{safe.rows, safe.columns, safe.left_to_up_mirrors,
+                                              safe.left_to_down_mirrors, 1U,
+                                              mirrors_lasers::MirrorsIndexLayout::Flat};
+    // A fixed number of arrays, reserved or grown geometrically, and no allocations per line
+    EXPECT_LT(allocations_count.load() - allocations, 96U);
+  }
+}
+
+TEST(SafeCheckerPerfTest, TimeScalesNearLinearly)
+{
+  std::vector<double> mirrors{};
+  std::vector<double> seconds{};
+  for (std::size_t mirrors_count = 1U << 13U; mirrors_count <= (1U << 17U); mirrors_count *= 2U) {
+    const SafeMeasurement measurement = measure(generate_random_safe(mirrors_count, mirrors_count), 5U);
+    mirrors.push_back(static_cast<double>(measurement.mirrors));
+    seconds.push_back(measurement.seconds);
+  }
+  // The expected complexity is O(n log n), the bound is loose to tolerate noise of shared machines
+  // and still catch a quadratic regression
+  EXPECT_LT(scaling_exponent(mirrors, seconds), 1.5);
+}
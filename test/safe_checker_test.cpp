@@ -1,9 +1,22 @@
+#include <checker_snapshot.h>
+#include <intersection_search_helper.h>
 #include <safe_checker.h>
 
+#include "test_safes.h"
+
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 TEST(SafeCheckerTest, TwoPossibleSolutions)
@@ -35,6 +48,145 @@ TEST(SafeCheckerTest, OpenWithoutInserting)
   ASSERT_EQ(check_result.result_type, mirrors_lasers::SafeCheckResultType::OpensWithoutInserting);
 }
 
+TEST(SafeCheckerTest, CheckStatistics)
+{
+  constexpr std::uint32_t R{5U};
+  constexpr std::uint32_t C{6U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}};
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  mirrors_lasers::SafeCheckStatistics statistics{};
+  const mirrors_lasers::SafeCheckResult check_result = checker.check_safe(statistics);
+  ASSERT_EQ(check_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(check_result.positions, 2U);
+  // Laser: (1,1)-(1,2), (1,2)-(4,2), (4,2)-(4,6); detector: (5,6)-(5,5), (5,5)-(2,5), (2,5)-(2,3), (2,3)-(5,3)
+  EXPECT_EQ(statistics.traced_segments, 7U);
+  EXPECT_GE(statistics.intersection_candidates, check_result.positions);
+  // A lookup at the start and one per segment for each beam, a lookup per intersection
+  EXPECT_GE(statistics.mirror_lookups, 9U + check_result.positions);
+}
+
+TEST(SafeCheckerTest, ParallelIntersectionsMatchSerial)
+{
+  constexpr std::uint32_t R{300U};
+  constexpr std::uint32_t C{R};
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+  mirrors_lasers::test::make_comb(R, left_to_up_mirrors, left_to_down_mirrors);
+
+  mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  mirrors_lasers::SafeCheckStatistics serial_statistics{};
+  const mirrors_lasers::SafeCheckResult serial_result = checker.check_safe(serial_statistics);
+  checker.set_threads_count(4U);
+  mirrors_lasers::SafeCheckStatistics parallel_statistics{};
+  const mirrors_lasers::SafeCheckResult parallel_result = checker.check_safe(parallel_statistics);
+
+  ASSERT_EQ(serial_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  // All the inner cells and the top right corner, where both beams leave the grid
+  EXPECT_EQ(serial_result.positions, (R - 2U) * (C - 2U) + 1U);
+  EXPECT_EQ(serial_result.mirror_row, 1U);
+  EXPECT_EQ(serial_result.mirror_col, C);
+  EXPECT_EQ(parallel_result.result_type, serial_result.result_type);
+  EXPECT_EQ(parallel_result.positions, serial_result.positions);
+  EXPECT_EQ(parallel_result.mirror_row, serial_result.mirror_row);
+  EXPECT_EQ(parallel_result.mirror_col, serial_result.mirror_col);
+  EXPECT_EQ(parallel_statistics.traced_segments, serial_statistics.traced_segments);
+  EXPECT_EQ(parallel_statistics.intersection_candidates, serial_statistics.intersection_candidates);
+  EXPECT_EQ(parallel_statistics.mirror_lookups, serial_statistics.mirror_lookups);
+}
+
+TEST(SafeCheckerTest, LimitedCheckCompletes)
+{
+  constexpr std::uint32_t R{5U};
+  constexpr std::uint32_t C{6U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}};
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  mirrors_lasers::CheckLimits limits{};
+  limits.deadline = std::chrono::steady_clock::now() + std::chrono::hours{1};
+  const mirrors_lasers::LimitedCheckResult limited_result = checker.check_safe_async(limits).get();
+  EXPECT_EQ(limited_result.status, mirrors_lasers::CheckStatus::Completed);
+  EXPECT_EQ(limited_result.result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(limited_result.result.positions, 2U);
+  EXPECT_EQ(limited_result.result.mirror_row, 4U);
+  EXPECT_EQ(limited_result.result.mirror_col, 3U);
+  EXPECT_EQ(limited_result.statistics.traced_segments, 7U);
+
+  limits.deadline = std::chrono::steady_clock::now() - std::chrono::seconds{1};
+  const mirrors_lasers::LimitedCheckResult late_result = checker.check_safe(limits);
+  EXPECT_EQ(late_result.status, mirrors_lasers::CheckStatus::DeadlineExceeded);
+  EXPECT_EQ(late_result.statistics.traced_segments, 0U);
+}
+
+TEST(SafeCheckerTest, LimitedCheckCancelled)
+{
+  constexpr std::uint32_t SIDE{4000U};
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+  mirrors_lasers::test::make_comb(SIDE, left_to_up_mirrors, left_to_down_mirrors);
+  const mirrors_lasers::SafeChecker checker{SIDE, SIDE, left_to_up_mirrors, left_to_down_mirrors};
+
+  // The search of about 16 million intersections is stopped soon after the cancellation
+  const mirrors_lasers::CheckLimits limits{};
+  std::future<mirrors_lasers::LimitedCheckResult> future = checker.check_safe_async(limits);
+  limits.cancellation.cancel();
+  const mirrors_lasers::LimitedCheckResult limited_result = future.get();
+  EXPECT_EQ(limited_result.status, mirrors_lasers::CheckStatus::Cancelled);
+  EXPECT_LT(limited_result.statistics.intersection_candidates, std::uint64_t{SIDE - 2U} * (SIDE - 2U));
+
+  // The parallel search is stopped too
+  mirrors_lasers::SafeChecker parallel_checker{SIDE, SIDE, left_to_up_mirrors, left_to_down_mirrors};
+  parallel_checker.set_threads_count(4U);
+  mirrors_lasers::CheckLimits parallel_limits{};
+  parallel_limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{1};
+  EXPECT_EQ(parallel_checker.check_safe(parallel_limits).status, mirrors_lasers::CheckStatus::DeadlineExceeded);
+}
+
+TEST(SafeCheckerTest, ParallelIndexMatchesSerial)
+{
+  constexpr std::uint32_t R{1000U};
+  constexpr std::uint32_t C{800U};
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+  std::uint64_t state{12345U};
+  for (std::size_t index = 0U; index < 40000U; ++index) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    const mirrors_lasers::Point mirror{static_cast<std::uint32_t>((state >> 33U) % R) + 1U,
+                                       static_cast<std::uint32_t>((state >> 13U) % C) + 1U};
+    // Some positions get both types of mirrors, the last one wins
+    (((state >> 5U) & 1U) != 0U ? left_to_up_mirrors : left_to_down_mirrors).push_back(mirror);
+  }
+  const std::string serial_path = ::testing::TempDir() + "serial_index.bin";
+  const std::string parallel_path = ::testing::TempDir() + "parallel_index.bin";
+
+  const mirrors_lasers::SafeChecker serial_checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  const mirrors_lasers::SafeChecker parallel_checker{R, C, left_to_up_mirrors, left_to_down_mirrors, 8U};
+  serial_checker.save_snapshot(serial_path, false);
+  parallel_checker.save_snapshot(parallel_path, false);
+  std::ifstream serial_file{serial_path, std::ios::binary};
+  std::ifstream parallel_file{parallel_path, std::ios::binary};
+  const std::string serial_bytes{std::istreambuf_iterator<char>{serial_file}, std::istreambuf_iterator<char>{}};
+  const std::string parallel_bytes{std::istreambuf_iterator<char>{parallel_file}, std::istreambuf_iterator<char>{}};
+  std::remove(serial_path.c_str());
+  std::remove(parallel_path.c_str());
+  EXPECT_FALSE(serial_bytes.empty());
+  EXPECT_TRUE(serial_bytes == parallel_bytes);
+
+  // The first incorrect mirror in the input order is reported
+  left_to_down_mirrors[10U].col = C + 1U;
+  left_to_up_mirrors[15000U].row = 0U;
+  left_to_down_mirrors[30U].row = R + 2U;
+  try {
+    mirrors_lasers::SafeChecker{R, C, left_to_up_mirrors, left_to_down_mirrors, 8U};
+    FAIL() << "Exception is expected";
+  } catch (const std::invalid_argument& exception) {
+    EXPECT_EQ(std::string{exception.what()}, "Incorrect row value: 0");
+  }
+}
+
 TEST(SafeCheckerTest, CanNotBeOpened)
 {
   constexpr std::uint32_t R{100U};
@@ -521,3 +673,818 @@ TEST(SafeCheckerTest, IncorrectMirrorsPositions)
                std::invalid_argument);
   left_to_down_mirrors.clear();
 }
+
+TEST(SafeCheckerTest, CoordinateWidthSelection)
+{
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 5U}, {65535U, 5U}};
+
+  const mirrors_lasers::SafeChecker narrow_checker{65535U, 5U, left_to_up_mirrors, left_to_down_mirrors};
+  EXPECT_EQ(narrow_checker.coordinate_width(), sizeof(std::uint16_t));
+  EXPECT_EQ(narrow_checker.check_safe().result_type, mirrors_lasers::SafeCheckResultType::OpensWithoutInserting);
+
+  const std::vector<mirrors_lasers::Point> first_row_mirrors{{1U, 5U}};
+  const mirrors_lasers::SafeChecker wide_checker{65536U, 5U, left_to_up_mirrors, first_row_mirrors};
+  EXPECT_EQ(wide_checker.coordinate_width(), sizeof(std::uint32_t));
+  const mirrors_lasers::SafeCheckResult check_result = wide_checker.check_safe();
+  ASSERT_EQ(check_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(check_result.positions, 1U);
+  EXPECT_EQ(check_result.mirror_row, 65536U);
+  EXPECT_EQ(check_result.mirror_col, 5U);
+}
+
+TEST(SafeCheckerTest, LargeGridBeyond32Bits)
+{
+  constexpr std::uint64_t R{6000000000ULL};
+  constexpr std::uint64_t C{7000000000ULL};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_up_mirrors{};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_down_mirrors{{1U, 5000000000ULL}};
+
+  const mirrors_lasers::LargeGridSafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  const auto check_result = checker.check_safe();
+  ASSERT_EQ(check_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(check_result.positions, 1U);
+  EXPECT_EQ(check_result.mirror_row, R);
+  EXPECT_EQ(check_result.mirror_col, 5000000000ULL);
+}
+
+TEST(SafeCheckerTest, GridDoesNotFitIntoCoordinate)
+{
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+
+  EXPECT_THROW((mirrors_lasers::BasicSafeChecker<std::uint16_t>{65536U, 1U, left_to_up_mirrors, left_to_down_mirrors}),
+               std::invalid_argument);
+}
+
+namespace {
+
+/// @brief Checks that the safe opens without insertions after inserting the mirrors of the placement
+void expect_placements_open_the_safe(std::uint32_t rows, std::uint32_t columns,
+                                     std::vector<mirrors_lasers::Point> left_to_up_mirrors,
+                                     std::vector<mirrors_lasers::Point> left_to_down_mirrors,
+                                     const mirrors_lasers::MinimalInsertionResult& insertion_result)
+{
+  ASSERT_EQ(insertion_result.placements.size(), insertion_result.insertions);
+  for (const auto& placement : insertion_result.placements) {
+    if (placement.orientation == mirrors_lasers::MirrorOrientation::LeftToUp) {
+      left_to_up_mirrors.push_back(placement.position);
+    } else {
+      left_to_down_mirrors.push_back(placement.position);
+    }
+  }
+  const mirrors_lasers::SafeChecker checker{rows, columns, left_to_up_mirrors, left_to_down_mirrors};
+  EXPECT_EQ(checker.check_safe().result_type, mirrors_lasers::SafeCheckResultType::OpensWithoutInserting);
+}
+
+}  // namespace
+
+TEST(SafeCheckerTest, MinimalInsertionsOpenWithoutInserting)
+{
+  constexpr std::uint32_t R{100U};
+  constexpr std::uint32_t C{100U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 77U}, {100U, 77U}};
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  const mirrors_lasers::MinimalInsertionResult insertion_result = checker.find_minimal_insertions();
+  ASSERT_EQ(insertion_result.result_type, mirrors_lasers::SafeCheckResultType::OpensWithoutInserting);
+  EXPECT_EQ(insertion_result.insertions, 0U);
+  EXPECT_TRUE(insertion_result.placements.empty());
+}
+
+TEST(SafeCheckerTest, MinimalInsertionsSingleMirror)
+{
+  constexpr std::uint32_t R{5U};
+  constexpr std::uint32_t C{6U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}};
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  const mirrors_lasers::MinimalInsertionResult insertion_result = checker.find_minimal_insertions();
+  ASSERT_EQ(insertion_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(insertion_result.insertions, 1U);
+  expect_placements_open_the_safe(R, C, left_to_up_mirrors, left_to_down_mirrors, insertion_result);
+}
+
+TEST(SafeCheckerTest, MinimalInsertionsNoMirrors)
+{
+  constexpr std::uint32_t R{10U};
+  constexpr std::uint32_t C{10U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  const mirrors_lasers::MinimalInsertionResult insertion_result = checker.find_minimal_insertions();
+  ASSERT_EQ(insertion_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(insertion_result.insertions, 2U);
+  expect_placements_open_the_safe(R, C, left_to_up_mirrors, left_to_down_mirrors, insertion_result);
+}
+
+TEST(SafeCheckerTest, MinimalInsertionsThroughMirrors)
+{
+  constexpr std::uint32_t R{6U};
+  constexpr std::uint32_t C{6U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{3U, 4U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {5U, 2U}, {6U, 3U}};
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  const mirrors_lasers::MinimalInsertionResult insertion_result = checker.find_minimal_insertions();
+  ASSERT_NE(insertion_result.result_type, mirrors_lasers::SafeCheckResultType::CanNotBeOpened);
+  expect_placements_open_the_safe(R, C, left_to_up_mirrors, left_to_down_mirrors, insertion_result);
+}
+
+TEST(SafeCheckerTest, MinimalInsertionsCanNotBeOpened)
+{
+  constexpr std::uint32_t R{1U};
+  constexpr std::uint32_t C{1U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{1U, 1U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  const mirrors_lasers::MinimalInsertionResult insertion_result = checker.find_minimal_insertions();
+  EXPECT_EQ(insertion_result.result_type, mirrors_lasers::SafeCheckResultType::CanNotBeOpened);
+}
+
+TEST(SafeCheckerTest, MinimalInsertionsLargeGrid)
+{
+  constexpr std::uint64_t R{6000000000ULL};
+  constexpr std::uint64_t C{7000000000ULL};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_up_mirrors{};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_down_mirrors{};
+
+  const mirrors_lasers::LargeGridSafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+
+  const auto insertion_result = checker.find_minimal_insertions();
+  ASSERT_EQ(insertion_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(insertion_result.insertions, 2U);
+  ASSERT_EQ(insertion_result.placements.size(), 2U);
+  EXPECT_EQ(insertion_result.placements.back().position.row, R);
+}
+
+TEST(SafeCheckerTest, SingleMirrorChanges)
+{
+  // Both beams are reflected out of the single row by the mirror, they arrive at it from the opposite directions
+  const mirrors_lasers::SafeChecker row_checker{1U, 3U, {}, {{1U, 2U}}};
+  const mirrors_lasers::MirrorChangesResult row_result = row_checker.find_single_mirror_changes();
+  EXPECT_FALSE(row_result.opens_without_changes);
+  EXPECT_EQ(row_result.removals, 1U);
+  EXPECT_EQ(row_result.flips, 0U);
+  ASSERT_EQ(row_result.changes.size(), 1U);
+  EXPECT_EQ(row_result.changes[0].position.row, 1U);
+  EXPECT_EQ(row_result.changes[0].position.col, 2U);
+  EXPECT_EQ(row_result.changes[0].orientation, mirrors_lasers::MirrorOrientation::LeftToDown);
+  EXPECT_EQ(row_result.changes[0].change_type, mirrors_lasers::MirrorChangeType::Removal);
+
+  // The beam from the laser is reflected up at (1, 2), the beam from the detector arrives there going up
+  const mirrors_lasers::SafeChecker square_checker{2U, 2U, {{1U, 2U}}, {{2U, 2U}}};
+  const mirrors_lasers::MirrorChangesResult square_result = square_checker.find_single_mirror_changes();
+  EXPECT_EQ(square_result.removals, 0U);
+  EXPECT_EQ(square_result.flips, 1U);
+  ASSERT_EQ(square_result.changes.size(), 1U);
+  EXPECT_EQ(square_result.changes[0].position.row, 1U);
+  EXPECT_EQ(square_result.changes[0].position.col, 2U);
+  EXPECT_EQ(square_result.changes[0].change_type, mirrors_lasers::MirrorChangeType::Flip);
+
+  const mirrors_lasers::SafeChecker open_checker{100U, 100U, {}, {{1U, 77U}, {100U, 77U}}};
+  const mirrors_lasers::MirrorChangesResult open_result = open_checker.find_single_mirror_changes();
+  EXPECT_TRUE(open_result.opens_without_changes);
+  EXPECT_TRUE(open_result.changes.empty());
+}
+
+TEST(SafeCheckerTest, SingleMirrorChangesMatchRebuilding)
+{
+  constexpr std::uint32_t R{7U};
+  constexpr std::uint32_t C{8U};
+  std::uint64_t state{2024U};
+  auto next_random = [&state] (std::uint32_t bound) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<std::uint32_t>((state >> 33U) % bound);
+  };
+  auto opens = [] (const std::vector<mirrors_lasers::Point>& left_to_up_mirrors,
+                   const std::vector<mirrors_lasers::Point>& left_to_down_mirrors) {
+    const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+    return checker.check_safe().result_type == mirrors_lasers::SafeCheckResultType::OpensWithoutInserting;
+  };
+
+  std::size_t found_removals{0U};
+  std::size_t found_flips{0U};
+  for (std::size_t safe_index = 0U; safe_index < 300U; ++safe_index) {
+    // Each cell gets a mirror of a random orientation with the probability 1/3
+    std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+    std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+    for (std::uint32_t row = 1U; row <= R; ++row) {
+      for (std::uint32_t col = 1U; col <= C; ++col) {
+        const std::uint32_t kind = next_random(6U);
+        if (kind == 0U) {
+          left_to_up_mirrors.push_back({row, col});
+        } else if (kind == 1U) {
+          left_to_down_mirrors.push_back({row, col});
+        }
+      }
+    }
+    const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+    const mirrors_lasers::MirrorChangesResult changes_result = checker.find_single_mirror_changes();
+    ASSERT_EQ(changes_result.opens_without_changes, opens(left_to_up_mirrors, left_to_down_mirrors));
+    if (changes_result.opens_without_changes) {
+      EXPECT_TRUE(changes_result.changes.empty());
+      continue;
+    }
+
+    // Every mirror is removed and flipped, the safe is checked from scratch
+    std::vector<mirrors_lasers::MirrorChange> expected_changes{};
+    for (std::size_t index = 0U; index < left_to_up_mirrors.size() + left_to_down_mirrors.size(); ++index) {
+      const bool is_left_to_up = index < left_to_up_mirrors.size();
+      std::vector<mirrors_lasers::Point> same_mirrors = is_left_to_up ? left_to_up_mirrors : left_to_down_mirrors;
+      std::vector<mirrors_lasers::Point> other_mirrors = is_left_to_up ? left_to_down_mirrors : left_to_up_mirrors;
+      const std::size_t same_index = is_left_to_up ? index : index - left_to_up_mirrors.size();
+      mirrors_lasers::MirrorChange change{};
+      change.position = same_mirrors[same_index];
+      change.orientation = is_left_to_up ? mirrors_lasers::MirrorOrientation::LeftToUp
+                                         : mirrors_lasers::MirrorOrientation::LeftToDown;
+      same_mirrors.erase(same_mirrors.begin() + static_cast<std::ptrdiff_t>(same_index));
+      const bool opens_after_removal = is_left_to_up ? opens(same_mirrors, other_mirrors)
+                                                     : opens(other_mirrors, same_mirrors);
+      other_mirrors.push_back(change.position);
+      const bool opens_after_flip = is_left_to_up ? opens(same_mirrors, other_mirrors)
+                                                  : opens(other_mirrors, same_mirrors);
+      ASSERT_FALSE(opens_after_removal && opens_after_flip);
+      if (opens_after_removal || opens_after_flip) {
+        change.change_type = opens_after_removal ? mirrors_lasers::MirrorChangeType::Removal
+                                                 : mirrors_lasers::MirrorChangeType::Flip;
+        expected_changes.push_back(change);
+      }
+    }
+    std::sort(expected_changes.begin(), expected_changes.end(), [] (const auto& first, const auto& second) {
+      return first.position.row < second.position.row ||
+             (first.position.row == second.position.row && first.position.col < second.position.col);
+    });
+
+    ASSERT_EQ(changes_result.changes.size(), expected_changes.size());
+    std::size_t removals{0U};
+    for (std::size_t index = 0U; index < expected_changes.size(); ++index) {
+      const mirrors_lasers::MirrorChange& change = changes_result.changes[index];
+      EXPECT_EQ(change.position.row, expected_changes[index].position.row);
+      EXPECT_EQ(change.position.col, expected_changes[index].position.col);
+      EXPECT_EQ(change.orientation, expected_changes[index].orientation);
+      EXPECT_EQ(change.change_type, expected_changes[index].change_type);
+      removals += change.change_type == mirrors_lasers::MirrorChangeType::Removal ? 1U : 0U;
+    }
+    EXPECT_EQ(changes_result.removals, removals);
+    EXPECT_EQ(changes_result.flips, expected_changes.size() - removals);
+    found_removals += removals;
+    found_flips += expected_changes.size() - removals;
+  }
+  // Both kinds of the changes are covered
+  EXPECT_GT(found_removals, 0U);
+  EXPECT_GT(found_flips, 0U);
+}
+
+TEST(SafeCheckerTest, SnapshotWithTrajectories)
+{
+  constexpr std::uint32_t R{5U};
+  constexpr std::uint32_t C{6U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}};
+  const std::string path = ::testing::TempDir() + "snapshot_with_trajectories.bin";
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  checker.save_snapshot(path, true);
+  const mirrors_lasers::SafeChecker loaded_checker = mirrors_lasers::SafeChecker::load_snapshot(path);
+  std::remove(path.c_str());
+
+  EXPECT_EQ(loaded_checker.coordinate_width(), sizeof(std::uint16_t));
+  const mirrors_lasers::SafeCheckResult check_result = loaded_checker.check_safe();
+  ASSERT_EQ(check_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(check_result.positions, 2U);
+  EXPECT_EQ(check_result.mirror_row, 4U);
+  EXPECT_EQ(check_result.mirror_col, 3U);
+  EXPECT_EQ(loaded_checker.find_minimal_insertions().insertions, 1U);
+}
+
+TEST(SafeCheckerTest, SnapshotWithoutTrajectories)
+{
+  constexpr std::uint32_t R{100000U};
+  constexpr std::uint32_t C{100000U};
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 1U}, {2U, 100000U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 1U}, {1U, 100000U}, {100000U, 1U}};
+  const std::string path = ::testing::TempDir() + "snapshot_without_trajectories.bin";
+
+  const mirrors_lasers::SafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  checker.save_snapshot(path, false);
+  const mirrors_lasers::SafeChecker loaded_checker = mirrors_lasers::SafeChecker::load_snapshot(path);
+  std::remove(path.c_str());
+
+  EXPECT_EQ(loaded_checker.coordinate_width(), sizeof(std::uint32_t));
+  const mirrors_lasers::SafeCheckResult expected_result = checker.check_safe();
+  const mirrors_lasers::SafeCheckResult check_result = loaded_checker.check_safe();
+  ASSERT_EQ(check_result.result_type, expected_result.result_type);
+  EXPECT_EQ(check_result.positions, expected_result.positions);
+  EXPECT_EQ(check_result.mirror_row, expected_result.mirror_row);
+  EXPECT_EQ(check_result.mirror_col, expected_result.mirror_col);
+  EXPECT_EQ(loaded_checker.find_minimal_insertions().insertions, checker.find_minimal_insertions().insertions);
+}
+
+TEST(SafeCheckerTest, LargeGridSnapshot)
+{
+  constexpr std::uint64_t R{6000000000ULL};
+  constexpr std::uint64_t C{7000000000ULL};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_up_mirrors{};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_down_mirrors{{1U, 5000000000ULL}};
+  const std::string path = ::testing::TempDir() + "large_grid_snapshot.bin";
+
+  const mirrors_lasers::LargeGridSafeChecker checker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  checker.save_snapshot(path, true);
+  const auto loaded_checker = mirrors_lasers::LargeGridSafeChecker::load_snapshot(path);
+  std::remove(path.c_str());
+
+  const auto check_result = loaded_checker.check_safe();
+  ASSERT_EQ(check_result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(check_result.positions, 1U);
+  EXPECT_EQ(check_result.mirror_row, R);
+  EXPECT_EQ(check_result.mirror_col, 5000000000ULL);
+}
+
+TEST(SafeCheckerTest, CorruptedSnapshot)
+{
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}};
+  const std::string path = ::testing::TempDir() + "corrupted_snapshot.bin";
+
+  const mirrors_lasers::SafeChecker checker{5U, 6U, left_to_up_mirrors, left_to_down_mirrors};
+  checker.save_snapshot(path, false);
+  {
+    std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+    file.seekp(-1, std::ios::end);
+    file.put('\x7f');
+  }
+  EXPECT_THROW(mirrors_lasers::SafeChecker::load_snapshot(path), std::runtime_error);
+  EXPECT_THROW((mirrors_lasers::BasicSafeChecker<std::uint32_t>::load_snapshot(path)), std::runtime_error);
+  std::remove(path.c_str());
+  EXPECT_THROW(mirrors_lasers::SafeChecker::load_snapshot(path), std::runtime_error);
+}
+
+TEST(SafeCheckerTest, SnapshotWithIncorrectIndex)
+{
+  using Index = mirrors_lasers::BasicMirrorsIndexView<std::uint32_t>;
+  const std::string path = ::testing::TempDir() + "incorrect_index_snapshot.bin";
+  const std::vector<mirrors_lasers::MirrorOrientation> orientations(2U, mirrors_lasers::MirrorOrientation::LeftToUp);
+  const std::vector<std::uint64_t> one_line_offsets{0U, 2U};
+  const std::vector<std::uint64_t> two_lines_offsets{0U, 1U, 2U};
+  // A correct index of the mirrors (2, 3) and (2, 5) of the grid 5x6
+  const std::vector<std::uint32_t> rows{2U};
+  const std::vector<std::uint32_t> row_positions{3U, 5U};
+  const std::vector<std::uint32_t> columns{3U, 5U};
+  const std::vector<std::uint32_t> column_positions{2U, 2U};
+  const Index row_wise{rows.data(), one_line_offsets.data(), 1U, row_positions.data(), orientations.data()};
+  const Index col_wise{columns.data(), two_lines_offsets.data(), 2U, column_positions.data(), orientations.data()};
+  mirrors_lasers::write_snapshot<std::uint32_t>(path, 5U, 6U, row_wise, col_wise, nullptr);
+  EXPECT_EQ(mirrors_lasers::SafeChecker::load_snapshot(path).check_safe().result_type,
+            mirrors_lasers::SafeCheckResultType::CanNotBeOpened);
+
+  const std::vector<std::uint32_t> unsorted_positions{5U, 3U};
+  const std::vector<std::uint32_t> outside_positions{3U, 7U};
+  const std::vector<std::uint32_t> repeated_columns{3U, 3U};
+  const std::vector<std::uint32_t> zero_columns{0U, 5U};
+  const std::vector<Index> incorrect_row_wise{
+      Index{rows.data(), one_line_offsets.data(), 1U, unsorted_positions.data(), orientations.data()},
+      Index{rows.data(), one_line_offsets.data(), 1U, outside_positions.data(), orientations.data()}};
+  for (const Index& index : incorrect_row_wise) {
+    mirrors_lasers::write_snapshot<std::uint32_t>(path, 5U, 6U, index, col_wise, nullptr);
+    EXPECT_THROW(mirrors_lasers::SafeChecker::load_snapshot(path), std::runtime_error);
+  }
+  const std::vector<Index> incorrect_col_wise{
+      Index{repeated_columns.data(), two_lines_offsets.data(), 2U, column_positions.data(), orientations.data()},
+      Index{zero_columns.data(), two_lines_offsets.data(), 2U, column_positions.data(), orientations.data()}};
+  for (const Index& index : incorrect_col_wise) {
+    mirrors_lasers::write_snapshot<std::uint32_t>(path, 5U, 6U, row_wise, index, nullptr);
+    EXPECT_THROW(mirrors_lasers::SafeChecker::load_snapshot(path), std::runtime_error);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(SafeCheckerTest, SnapshotWithIncorrectTrajectories)
+{
+  using Index = mirrors_lasers::BasicMirrorsIndexView<std::uint32_t>;
+  using Trajectories = mirrors_lasers::BasicSnapshotTrajectories<std::uint32_t>;
+  const std::string path = ::testing::TempDir() + "incorrect_trajectories_snapshot.bin";
+  // The grid 5x6 without mirrors: the beams pass the first and the last rows
+  const std::vector<std::uint64_t> empty_offsets{0U};
+  const Index empty_index{nullptr, empty_offsets.data(), 0U, nullptr, nullptr};
+  Trajectories correct{};
+  correct.forward_end_state.position = mirrors_lasers::BasicPoint<std::uint32_t>{1U, 6U};
+  correct.forward_end_state.is_positive = true;
+  correct.forward_end_state.is_horizontal = true;
+  correct.forward_horizontal_segments = {{1U, 1U, 6U}};
+  correct.backward_horizontal_segments = {{5U, 1U, 6U}};
+  mirrors_lasers::write_snapshot<std::uint32_t>(path, 5U, 6U, empty_index, empty_index, &correct);
+  EXPECT_EQ(mirrors_lasers::SafeChecker::load_snapshot(path).check_safe().result_type,
+            mirrors_lasers::SafeCheckResultType::CanNotBeOpened);
+
+  std::vector<Trajectories> incorrect(4U, correct);
+  // A segment outside of the grid
+  incorrect[0].backward_horizontal_segments = {{6U, 1U, 6U}};
+  // A segment with the reversed ends
+  incorrect[1].backward_horizontal_segments = {{5U, 6U, 1U}};
+  // The forward beam ends inside the grid
+  incorrect[2].forward_end_state.position.col = 4U;
+  incorrect[2].forward_horizontal_segments = {{1U, 1U, 4U}};
+  // The forward beam ends away from its last segment
+  incorrect[3].forward_end_state.position.row = 2U;
+  for (const Trajectories& trajectories : incorrect) {
+    mirrors_lasers::write_snapshot<std::uint32_t>(path, 5U, 6U, empty_index, empty_index, &trajectories);
+    EXPECT_THROW(mirrors_lasers::SafeChecker::load_snapshot(path), std::runtime_error);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(SafeCheckerTest, VariantsMatchRebuilding)
+{
+  constexpr std::uint32_t R{9U};
+  constexpr std::uint32_t C{11U};
+  std::uint64_t state{31337U};
+  auto next_random = [&state] (std::uint32_t bound) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<std::uint32_t>((state >> 33U) % bound);
+  };
+  using Cells = std::vector<std::vector<int>>;
+  auto make_checker = [] (const Cells& cells) {
+    std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+    std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+    for (std::uint32_t row = 1U; row <= R; ++row) {
+      for (std::uint32_t col = 1U; col <= C; ++col) {
+        if (cells[row][col] == 1) {
+          left_to_up_mirrors.push_back({row, col});
+        } else if (cells[row][col] == 2) {
+          left_to_down_mirrors.push_back({row, col});
+        }
+      }
+    }
+    return mirrors_lasers::SafeChecker{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  };
+  auto read_bytes = [] (const mirrors_lasers::SafeChecker& checker) {
+    const std::string path = ::testing::TempDir() + "variant_index.bin";
+    checker.save_snapshot(path, false);
+    std::ifstream file{path, std::ios::binary};
+    const std::string bytes{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    std::remove(path.c_str());
+    return bytes;
+  };
+
+  for (std::size_t base_index = 0U; base_index < 20U; ++base_index) {
+    // 0 is an empty cell, 1 is "/", 2 is "\\"
+    Cells base_cells(R + 1U, std::vector<int>(C + 1U, 0));
+    for (std::uint32_t row = 1U; row <= R; ++row) {
+      for (std::uint32_t col = 1U; col <= C; ++col) {
+        const std::uint32_t kind = next_random(8U);
+        base_cells[row][col] = kind < 3U ? static_cast<int>(kind) : 0;
+      }
+    }
+    auto base = std::make_shared<const mirrors_lasers::SafeChecker>(make_checker(base_cells));
+    // Variants of the checker loaded from a snapshot use the mapped index as the base
+    const std::string snapshot_path = ::testing::TempDir() + "variant_base.bin";
+    base->save_snapshot(snapshot_path, base_index % 2U == 0U);
+    auto mapped_base = std::make_shared<const mirrors_lasers::SafeChecker>(
+        mirrors_lasers::SafeChecker::load_snapshot(snapshot_path));
+    std::remove(snapshot_path.c_str());
+
+    for (std::size_t variant_index = 0U; variant_index < 30U; ++variant_index) {
+      Cells cells = base_cells;
+      std::shared_ptr<const mirrors_lasers::SafeChecker> variant = variant_index % 3U == 0U ? mapped_base : base;
+      // A chain of variants, each one changes a few cells of the previous one
+      for (std::size_t generation = 0U; generation < 3U; ++generation) {
+        std::vector<mirrors_lasers::Point> removed_mirrors{};
+        std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+        std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+        for (std::size_t change = 0U; change < 3U; ++change) {
+          // The changed cells of a generation are distinct, the replaced mirror is removed and added again
+          const mirrors_lasers::Point point{next_random(R) + 1U, next_random(C) + 1U};
+          const auto is_changed = [&point] (const mirrors_lasers::Point& other) {
+            return other.row == point.row && other.col == point.col;
+          };
+          if (std::any_of(removed_mirrors.begin(), removed_mirrors.end(), is_changed) ||
+              std::any_of(left_to_up_mirrors.begin(), left_to_up_mirrors.end(), is_changed) ||
+              std::any_of(left_to_down_mirrors.begin(), left_to_down_mirrors.end(), is_changed)) {
+            continue;
+          }
+          int& cell = cells[point.row][point.col];
+          if (cell != 0) {
+            removed_mirrors.push_back(point);
+          }
+          cell = static_cast<int>(next_random(3U));
+          if (cell != 0) {
+            (cell == 1 ? left_to_up_mirrors : left_to_down_mirrors).push_back(point);
+          }
+        }
+        variant = std::make_shared<const mirrors_lasers::SafeChecker>(mirrors_lasers::SafeChecker::make_variant(
+            variant, removed_mirrors, left_to_up_mirrors, left_to_down_mirrors));
+      }
+
+      const mirrors_lasers::SafeChecker rebuilt = make_checker(cells);
+      const mirrors_lasers::SafeCheckResult expected = rebuilt.check_safe();
+      const mirrors_lasers::SafeCheckResult result = variant->check_safe();
+      ASSERT_EQ(result.result_type, expected.result_type);
+      EXPECT_EQ(result.positions, expected.positions);
+      EXPECT_EQ(result.mirror_row, expected.mirror_row);
+      EXPECT_EQ(result.mirror_col, expected.mirror_col);
+      EXPECT_EQ(variant->find_minimal_insertions().insertions, rebuilt.find_minimal_insertions().insertions);
+      EXPECT_EQ(variant->find_single_mirror_changes().changes.size(),
+                rebuilt.find_single_mirror_changes().changes.size());
+      EXPECT_TRUE(read_bytes(*variant) == read_bytes(rebuilt));
+    }
+  }
+}
+
+TEST(SafeCheckerTest, VariantChanges)
+{
+  auto base = std::make_shared<const mirrors_lasers::SafeChecker>(
+      mirrors_lasers::SafeChecker{1U, 3U, {}, {{1U, 2U}}});
+  EXPECT_EQ(base->variant_changes_count(), 0U);
+  EXPECT_EQ(base->check_safe().result_type, mirrors_lasers::SafeCheckResultType::CanNotBeOpened);
+
+  auto variant = std::make_shared<const mirrors_lasers::SafeChecker>(
+      mirrors_lasers::SafeChecker::make_variant(base, {{1U, 2U}}, {}, {}));
+  EXPECT_EQ(variant->variant_changes_count(), 1U);
+  EXPECT_EQ(variant->check_safe().result_type, mirrors_lasers::SafeCheckResultType::OpensWithoutInserting);
+
+  // Restoring the mirror of the base drops the change
+  const mirrors_lasers::SafeChecker restored = mirrors_lasers::SafeChecker::make_variant(variant, {}, {}, {{1U, 2U}});
+  EXPECT_EQ(restored.variant_changes_count(), 0U);
+  EXPECT_EQ(restored.check_safe().result_type, mirrors_lasers::SafeCheckResultType::CanNotBeOpened);
+
+  EXPECT_THROW(mirrors_lasers::SafeChecker::make_variant(variant, {{1U, 2U}}, {}, {}), std::invalid_argument);
+  EXPECT_THROW(mirrors_lasers::SafeChecker::make_variant(base, {}, {{2U, 1U}}, {}), std::invalid_argument);
+  EXPECT_THROW(mirrors_lasers::SafeChecker::make_variant(nullptr, {}, {}, {}), std::invalid_argument);
+}
+
+TEST(SafeCheckerTest, FlatIndexMatchesHashed)
+{
+  std::uint64_t state{4242U};
+  auto next_random = [&state] (std::uint32_t bound) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<std::uint32_t>((state >> 33U) % bound);
+  };
+  auto read_bytes = [] (const mirrors_lasers::SafeChecker& checker) {
+    const std::string path = ::testing::TempDir() + "flat_index.bin";
+    checker.save_snapshot(path, false);
+    std::ifstream file{path, std::ios::binary};
+    const std::string bytes{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    std::remove(path.c_str());
+    return bytes;
+  };
+
+  // Small grids give long beams, the grids wider than 16 bits use more passes of the radix sort
+  for (const std::uint32_t side : {6U, 40U, 300U, 70000U}) {
+    for (std::size_t safe_index = 0U; safe_index < 20U; ++safe_index) {
+      std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+      std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+      const std::size_t mirrors_count = std::min<std::size_t>(std::size_t{side} * side / 3U, 3000U);
+      for (std::size_t index = 0U; index < mirrors_count; ++index) {
+        // Some positions get several mirrors, the last one wins
+        const mirrors_lasers::Point mirror{next_random(side) + 1U, next_random(side) + 1U};
+        (next_random(2U) == 0U ? left_to_up_mirrors : left_to_down_mirrors).push_back(mirror);
+      }
+      const mirrors_lasers::SafeChecker hashed{side, side, left_to_up_mirrors, left_to_down_mirrors};
+      const mirrors_lasers::SafeChecker flat{side, side, left_to_up_mirrors, left_to_down_mirrors, 1U,
+                                             mirrors_lasers::MirrorsIndexLayout::Flat};
+      mirrors_lasers::SafeCheckStatistics hashed_statistics{};
+      mirrors_lasers::SafeCheckStatistics flat_statistics{};
+      const mirrors_lasers::SafeCheckResult expected = hashed.check_safe(hashed_statistics);
+      const mirrors_lasers::SafeCheckResult result = flat.check_safe(flat_statistics);
+      ASSERT_EQ(result.result_type, expected.result_type);
+      EXPECT_EQ(result.positions, expected.positions);
+      EXPECT_EQ(result.mirror_row, expected.mirror_row);
+      EXPECT_EQ(result.mirror_col, expected.mirror_col);
+      EXPECT_EQ(flat_statistics.traced_segments, hashed_statistics.traced_segments);
+      EXPECT_EQ(flat.find_minimal_insertions().insertions, hashed.find_minimal_insertions().insertions);
+      EXPECT_EQ(flat.find_single_mirror_changes().changes.size(), hashed.find_single_mirror_changes().changes.size());
+      EXPECT_TRUE(read_bytes(flat) == read_bytes(hashed));
+    }
+  }
+
+  const std::vector<mirrors_lasers::Point> incorrect_mirrors{{1U, 2U}, {3U, 1U}};
+  EXPECT_THROW((mirrors_lasers::SafeChecker{2U, 2U, {}, incorrect_mirrors, 1U,
+                                            mirrors_lasers::MirrorsIndexLayout::Flat}),
+               std::invalid_argument);
+}
+
+TEST(SafeCheckerTest, LargeGridFlatIndex)
+{
+  constexpr std::uint64_t R{6000000000ULL};
+  constexpr std::uint64_t C{7000000000ULL};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_up_mirrors{{R, 5000000000ULL}};
+  const std::vector<mirrors_lasers::BasicPoint<std::uint64_t>> left_to_down_mirrors{{1U, 5000000000ULL}};
+
+  const mirrors_lasers::LargeGridSafeChecker hashed{R, C, left_to_up_mirrors, left_to_down_mirrors};
+  const mirrors_lasers::LargeGridSafeChecker flat{R, C, left_to_up_mirrors, left_to_down_mirrors, 1U,
+                                                  mirrors_lasers::MirrorsIndexLayout::Flat};
+  mirrors_lasers::SafeCheckStatistics hashed_statistics{};
+  mirrors_lasers::SafeCheckStatistics flat_statistics{};
+  EXPECT_EQ(flat.check_safe(flat_statistics).result_type, hashed.check_safe(hashed_statistics).result_type);
+  EXPECT_EQ(flat_statistics.traced_segments, hashed_statistics.traced_segments);
+  EXPECT_EQ(flat_statistics.traced_segments, 5U);
+}
+
+TEST(SafeCheckerTest, InterleavedTracingMatchesSequential)
+{
+  std::uint64_t state{777U};
+  auto next_random = [&state] (std::uint32_t bound) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<std::uint32_t>((state >> 33U) % bound);
+  };
+
+  // Small grids give long beams, some of the safes open without insertions
+  for (const std::uint32_t side : {3U, 8U, 50U, 400U}) {
+    for (std::size_t safe_index = 0U; safe_index < 30U; ++safe_index) {
+      std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+      std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+      const std::size_t mirrors_count = std::min<std::size_t>(std::size_t{side} * side / 4U, 2000U);
+      for (std::size_t index = 0U; index < mirrors_count; ++index) {
+        const mirrors_lasers::Point mirror{next_random(side) + 1U, next_random(side) + 1U};
+        (next_random(2U) == 0U ? left_to_up_mirrors : left_to_down_mirrors).push_back(mirror);
+      }
+      for (const auto layout : {mirrors_lasers::MirrorsIndexLayout::Hashed, mirrors_lasers::MirrorsIndexLayout::Flat}) {
+        const mirrors_lasers::SafeChecker sequential{side, side, left_to_up_mirrors, left_to_down_mirrors, 1U, layout};
+        auto interleaved = std::make_shared<mirrors_lasers::SafeChecker>(side, side, left_to_up_mirrors,
+                                                                         left_to_down_mirrors, 1U, layout);
+        interleaved->set_tracing_mode(mirrors_lasers::BeamTracingMode::Interleaved);
+        const mirrors_lasers::SafeCheckResult expected = sequential.check_safe();
+        const mirrors_lasers::SafeCheckResult result = interleaved->check_safe();
+        ASSERT_EQ(result.result_type, expected.result_type);
+        EXPECT_EQ(result.positions, expected.positions);
+        EXPECT_EQ(result.mirror_row, expected.mirror_row);
+        EXPECT_EQ(result.mirror_col, expected.mirror_col);
+
+        // A variant takes the mode of its base and traces over the changes
+        const mirrors_lasers::Point added{next_random(side) + 1U, next_random(side) + 1U};
+        const mirrors_lasers::SafeChecker variant = mirrors_lasers::SafeChecker::make_variant(interleaved, {},
+                                                                                              {added}, {});
+        std::vector<mirrors_lasers::Point> variant_left_to_up_mirrors = left_to_up_mirrors;
+        std::vector<mirrors_lasers::Point> variant_left_to_down_mirrors = left_to_down_mirrors;
+        variant_left_to_up_mirrors.push_back(added);
+        variant_left_to_down_mirrors.erase(std::remove_if(variant_left_to_down_mirrors.begin(),
+                                                          variant_left_to_down_mirrors.end(),
+                                                          [&added] (const mirrors_lasers::Point& mirror) {
+                                                            return mirror.row == added.row && mirror.col == added.col;
+                                                          }),
+                                           variant_left_to_down_mirrors.end());
+        const mirrors_lasers::SafeChecker rebuilt{side, side, variant_left_to_up_mirrors,
+                                                  variant_left_to_down_mirrors};
+        const mirrors_lasers::SafeCheckResult variant_expected = rebuilt.check_safe();
+        const mirrors_lasers::SafeCheckResult variant_result = variant.check_safe();
+        ASSERT_EQ(variant_result.result_type, variant_expected.result_type);
+        EXPECT_EQ(variant_result.positions, variant_expected.positions);
+        EXPECT_EQ(variant_result.mirror_row, variant_expected.mirror_row);
+        EXPECT_EQ(variant_result.mirror_col, variant_expected.mirror_col);
+      }
+    }
+  }
+
+  // The lockstep tracing is stopped by the limits too
+  constexpr std::uint32_t SIDE{4000U};
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+  mirrors_lasers::test::make_comb(SIDE, left_to_up_mirrors, left_to_down_mirrors);
+  mirrors_lasers::SafeChecker checker{SIDE, SIDE, left_to_up_mirrors, left_to_down_mirrors};
+  checker.set_tracing_mode(mirrors_lasers::BeamTracingMode::Interleaved);
+  mirrors_lasers::CheckLimits limits{};
+  limits.cancellation.cancel();
+  const mirrors_lasers::LimitedCheckResult limited_result = checker.check_safe(limits);
+  EXPECT_EQ(limited_result.status, mirrors_lasers::CheckStatus::Cancelled);
+  EXPECT_LT(limited_result.statistics.traced_segments, 4U * (SIDE - 2U));
+}
+
+TEST(IntersectionSearchHelperTest, MatchesSegments)
+{
+  // Disjoint segments in the lines 2, 5 and 9, the line 5 has two segments sharing a mirror
+  const mirrors_lasers::BeamSegments segments{{5U, 7U, 9U}, {2U, 1U, 4U}, {9U, 3U, 3U}, {5U, 1U, 7U}, {2U, 6U, 10U}};
+  const mirrors_lasers::IntersectionSearchHelperMap lines{segments};
+  ASSERT_EQ(lines.size(), 3U);
+  EXPECT_EQ(lines.lower_bound(0U), 0U);
+  EXPECT_EQ(lines.lower_bound(3U), 1U);
+  EXPECT_EQ(lines.lower_bound(5U), 1U);
+  EXPECT_EQ(lines.lower_bound(10U), 3U);
+  EXPECT_EQ(lines.line(2U), 9U);
+
+  for (std::size_t line_index = 0U; line_index < lines.size(); ++line_index) {
+    const std::uint32_t line = lines.line(line_index);
+    for (std::uint32_t position = 0U; position <= 11U; ++position) {
+      const bool expected = std::any_of(segments.begin(), segments.end(), [line, position] (const auto& segment) {
+        return segment.first_coordinate == line &&
+               segment.second_coordinate_start <= position && position <= segment.second_coordinate_end;
+      });
+      EXPECT_EQ(lines.helper(line_index).has_intersection(position), expected) << line << " " << position;
+    }
+  }
+
+  const mirrors_lasers::IntersectionSearchHelperMap empty_lines{mirrors_lasers::BeamSegments{}};
+  EXPECT_EQ(empty_lines.size(), 0U);
+  EXPECT_EQ(empty_lines.lower_bound(1U), 0U);
+}
+
+TEST(SafeCheckerTest, PointsViewMatchesVectors)
+{
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}};
+  const std::uint32_t left_to_down_coordinates[] = {1U, 2U, 2U, 5U, 4U, 2U, 5U, 5U};
+  const auto left_to_down_view =
+      mirrors_lasers::PointsView::from_coordinates(left_to_down_coordinates, left_to_down_mirrors.size());
+  ASSERT_EQ(left_to_down_view.size(), left_to_down_mirrors.size());
+  for (std::size_t index = 0U; index < left_to_down_view.size(); ++index) {
+    EXPECT_EQ(left_to_down_view[index].row, left_to_down_mirrors[index].row);
+    EXPECT_EQ(left_to_down_view[index].col, left_to_down_mirrors[index].col);
+  }
+
+  for (const auto layout : {mirrors_lasers::MirrorsIndexLayout::Hashed, mirrors_lasers::MirrorsIndexLayout::Flat}) {
+    const mirrors_lasers::SafeChecker checker{5U, 6U, mirrors_lasers::PointsView{left_to_up_mirrors},
+                                              left_to_down_view, 2U, layout};
+    const mirrors_lasers::SafeCheckResult result = checker.check_safe();
+    EXPECT_EQ(result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+    EXPECT_EQ(result.positions, 2U);
+    EXPECT_EQ(result.mirror_row, 4U);
+    EXPECT_EQ(result.mirror_col, 3U);
+  }
+}
+
+TEST(SafeCheckerTest, MemoryFootprint)
+{
+  using Checker = mirrors_lasers::BasicSafeChecker<std::uint16_t>;
+  constexpr std::uint32_t SIDE{400U};
+  std::uint64_t state{99U};
+  auto next_random = [&state] (std::uint32_t bound) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<std::uint32_t>((state >> 33U) % bound);
+  };
+  std::vector<mirrors_lasers::Point> left_to_up_mirrors{};
+  std::vector<mirrors_lasers::Point> left_to_down_mirrors{};
+  for (std::size_t index = 0U; index < 20000U; ++index) {
+    const mirrors_lasers::Point mirror{next_random(SIDE) + 1U, next_random(SIDE) + 1U};
+    (next_random(2U) == 0U ? left_to_up_mirrors : left_to_down_mirrors).push_back(mirror);
+  }
+  const std::size_t mirrors_count = left_to_up_mirrors.size() + left_to_down_mirrors.size();
+
+  std::vector<mirrors_lasers::MemoryFootprint> footprints{};
+  for (const auto layout : {mirrors_lasers::MirrorsIndexLayout::Hashed, mirrors_lasers::MirrorsIndexLayout::Flat}) {
+    // The index is built by a single thread and by several threads
+    for (const std::size_t threads_count : {1U, 4U}) {
+      const std::size_t estimate = Checker::estimate_peak_memory(mirrors_count, layout, threads_count);
+      const Checker checker{SIDE, SIDE, left_to_up_mirrors, left_to_down_mirrors, threads_count, layout};
+      const mirrors_lasers::MemoryFootprint footprint = checker.memory_footprint();
+      EXPECT_EQ(checker.index_layout(), layout);
+      EXPECT_GT(footprint.row_wise_index_bytes, 0U);
+      EXPECT_GT(footprint.col_wise_index_bytes, 0U);
+      EXPECT_EQ(footprint.arena_reserved_bytes, 0U);
+      mirrors_lasers::SafeCheckStatistics statistics{};
+      checker.check_safe(statistics);
+      EXPECT_GT(statistics.peak_scratch_bytes, 0U);
+      EXPECT_LE(footprint.row_wise_index_bytes + footprint.col_wise_index_bytes + statistics.peak_scratch_bytes,
+                estimate);
+      footprints.push_back(footprint);
+    }
+  }
+  // The flat index holds a few bytes per mirror
+  EXPECT_LT(footprints[2].row_wise_index_bytes, footprints[0].row_wise_index_bytes);
+  EXPECT_LE(footprints[2].row_wise_index_bytes, mirrors_count * 16U);
+
+  // The variant shares the index of the base
+  const auto base = std::make_shared<const Checker>(SIDE, SIDE, left_to_up_mirrors, left_to_down_mirrors);
+  const Checker variant = Checker::make_variant(base, {}, {{1U, 1U}}, {});
+  EXPECT_EQ(variant.memory_footprint().row_wise_index_bytes, 0U);
+}
+
+TEST(SafeCheckerTest, MemoryBudget)
+{
+  const std::vector<mirrors_lasers::Point> left_to_up_mirrors{{2U, 3U}};
+  const std::vector<mirrors_lasers::Point> left_to_down_mirrors{{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}};
+  using Checker = mirrors_lasers::BasicSafeChecker<std::uint16_t>;
+  const std::size_t hashed_bytes = Checker::estimate_peak_memory(5U, mirrors_lasers::MirrorsIndexLayout::Hashed);
+  const std::size_t flat_bytes = Checker::estimate_peak_memory(5U, mirrors_lasers::MirrorsIndexLayout::Flat);
+  ASSERT_LT(flat_bytes, hashed_bytes);
+
+  const mirrors_lasers::SafeChecker hashed{5U, 6U, left_to_up_mirrors, left_to_down_mirrors, 1U,
+                                           mirrors_lasers::MirrorsIndexLayout::Hashed, hashed_bytes};
+  EXPECT_EQ(hashed.index_layout(), mirrors_lasers::MirrorsIndexLayout::Hashed);
+
+  // The flat index is built if the hashed one doesn't fit
+  const mirrors_lasers::SafeChecker flat{5U, 6U, left_to_up_mirrors, left_to_down_mirrors, 1U,
+                                         mirrors_lasers::MirrorsIndexLayout::Hashed, hashed_bytes - 1U};
+  EXPECT_EQ(flat.index_layout(), mirrors_lasers::MirrorsIndexLayout::Flat);
+  const mirrors_lasers::SafeCheckResult result = flat.check_safe();
+  EXPECT_EQ(result.result_type, mirrors_lasers::SafeCheckResultType::RequiresMirrorInsertion);
+  EXPECT_EQ(result.positions, 2U);
+
+  try {
+    const mirrors_lasers::SafeChecker rejected{5U, 6U, left_to_up_mirrors, left_to_down_mirrors, 1U,
+                                               mirrors_lasers::MirrorsIndexLayout::Hashed, flat_bytes - 1U};
+    FAIL() << "The budget is exceeded";
+  } catch (const mirrors_lasers::MemoryBudgetError& error) {
+    EXPECT_EQ(error.required_bytes(), flat_bytes);
+    EXPECT_EQ(error.budget_bytes(), flat_bytes - 1U);
+  }
+}
@@ -0,0 +1,127 @@
+#include <safe_laser_c.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// @brief The safe from the description of the task
+safe_laser_checker* create_example_checker(std::int32_t index_layout)
+{
+  const std::uint32_t left_to_up[] = {2U, 3U};
+  const std::uint32_t left_to_down[] = {1U, 2U, 2U, 5U, 4U, 2U, 5U, 5U};
+  safe_laser_checker* checker = nullptr;
+  EXPECT_EQ(safe_laser_create(5U, 6U, left_to_up, 1U, left_to_down, 4U, 2U, index_layout, &checker), SAFE_LASER_OK);
+  return checker;
+}
+
+}  // namespace
+
+TEST(SafeLaserCTest, AbiVersion)
+{
+  EXPECT_EQ(safe_laser_abi_version(), static_cast<std::uint32_t>(SAFE_LASER_ABI_VERSION));
+}
+
+TEST(SafeLaserCTest, Check)
+{
+  for (const std::int32_t index_layout : {SAFE_LASER_INDEX_HASHED, SAFE_LASER_INDEX_FLAT}) {
+    safe_laser_checker* checker = create_example_checker(index_layout);
+    ASSERT_NE(checker, nullptr);
+    safe_laser_result result{};
+    EXPECT_EQ(safe_laser_check(checker, 0U, &result), SAFE_LASER_OK);
+    EXPECT_EQ(result.result_type, SAFE_LASER_REQUIRES_MIRROR_INSERTION);
+    EXPECT_EQ(result.positions, 2U);
+    EXPECT_EQ(result.mirror_row, 4U);
+    EXPECT_EQ(result.mirror_col, 3U);
+    EXPECT_EQ(safe_laser_check(checker, 1000U, &result), SAFE_LASER_OK);
+    EXPECT_EQ(result.positions, 2U);
+    safe_laser_destroy(checker);
+  }
+}
+
+TEST(SafeLaserCTest, WithoutMirrors)
+{
+  safe_laser_checker* checker = nullptr;
+  ASSERT_EQ(safe_laser_create(1U, 1U, nullptr, 0U, nullptr, 0U, 1U, SAFE_LASER_INDEX_HASHED, &checker),
+            SAFE_LASER_OK);
+  safe_laser_result result{};
+  EXPECT_EQ(safe_laser_check(checker, 0U, &result), SAFE_LASER_OK);
+  EXPECT_EQ(result.result_type, SAFE_LASER_OPENS_WITHOUT_INSERTING);
+  safe_laser_destroy(checker);
+}
+
+TEST(SafeLaserCTest, MinimalInsertions)
+{
+  safe_laser_checker* checker = create_example_checker(SAFE_LASER_INDEX_HASHED);
+  ASSERT_NE(checker, nullptr);
+  std::int32_t result_type{-1};
+  std::size_t count{0U};
+  EXPECT_EQ(safe_laser_find_minimal_insertions(checker, &result_type, nullptr, 0U, &count),
+            SAFE_LASER_BUFFER_TOO_SMALL);
+  EXPECT_EQ(result_type, SAFE_LASER_REQUIRES_MIRROR_INSERTION);
+  ASSERT_EQ(count, 1U);
+  EXPECT_FALSE(std::string{safe_laser_last_error()}.empty());
+
+  // The beam from the laser is turned down at (4, 5) and reaches the detector through the mirror (5, 5)
+  std::vector<safe_laser_mirror> placements(count);
+  EXPECT_EQ(safe_laser_find_minimal_insertions(checker, &result_type, placements.data(), placements.size(), &count),
+            SAFE_LASER_OK);
+  ASSERT_EQ(count, 1U);
+  EXPECT_EQ(placements[0].row, 4U);
+  EXPECT_EQ(placements[0].col, 5U);
+  EXPECT_EQ(placements[0].orientation, SAFE_LASER_LEFT_TO_DOWN);
+  EXPECT_EQ(placements[0].change_type, 0);
+  EXPECT_TRUE(std::string{safe_laser_last_error()}.empty());
+  safe_laser_destroy(checker);
+}
+
+TEST(SafeLaserCTest, SingleMirrorChanges)
+{
+  // The beam from the laser leaves upwards at the "/" mirror (1, 2), and reaches the detector if it is flipped
+  const std::uint32_t left_to_up[] = {1U, 2U};
+  const std::uint32_t left_to_down[] = {2U, 2U};
+  for (const std::int32_t index_layout : {SAFE_LASER_INDEX_HASHED, SAFE_LASER_INDEX_FLAT}) {
+    safe_laser_checker* checker = nullptr;
+    ASSERT_EQ(safe_laser_create(2U, 2U, left_to_up, 1U, left_to_down, 1U, 1U, index_layout, &checker),
+              SAFE_LASER_OK);
+    std::int32_t opens_without_changes{-1};
+    std::size_t count{0U};
+    EXPECT_EQ(safe_laser_find_single_mirror_changes(checker, &opens_without_changes, nullptr, 0U, &count),
+              SAFE_LASER_BUFFER_TOO_SMALL);
+    EXPECT_EQ(opens_without_changes, 0);
+    ASSERT_EQ(count, 1U);
+
+    std::vector<safe_laser_mirror> changes(count);
+    EXPECT_EQ(safe_laser_find_single_mirror_changes(checker, &opens_without_changes, changes.data(), changes.size(),
+                                                    &count),
+              SAFE_LASER_OK);
+    ASSERT_EQ(count, 1U);
+    EXPECT_EQ(changes[0].row, 1U);
+    EXPECT_EQ(changes[0].col, 2U);
+    EXPECT_EQ(changes[0].orientation, SAFE_LASER_LEFT_TO_UP);
+    EXPECT_EQ(changes[0].change_type, SAFE_LASER_FLIP);
+    safe_laser_destroy(checker);
+  }
+}
+
+TEST(SafeLaserCTest, Errors)
+{
+  const std::uint32_t outside[] = {7U, 1U};
+  safe_laser_checker* checker = nullptr;
+  EXPECT_EQ(safe_laser_create(5U, 6U, outside, 1U, nullptr, 0U, 1U, SAFE_LASER_INDEX_HASHED, &checker),
+            SAFE_LASER_INVALID_ARGUMENT);
+  EXPECT_EQ(checker, nullptr);
+  EXPECT_FALSE(std::string{safe_laser_last_error()}.empty());
+
+  EXPECT_EQ(safe_laser_create(5U, 6U, nullptr, 1U, nullptr, 0U, 1U, SAFE_LASER_INDEX_HASHED, &checker),
+            SAFE_LASER_INVALID_ARGUMENT);
+  EXPECT_EQ(safe_laser_create(5U, 6U, nullptr, 0U, nullptr, 0U, 1U, 7, &checker), SAFE_LASER_INVALID_ARGUMENT);
+  EXPECT_EQ(safe_laser_create(5U, 6U, nullptr, 0U, nullptr, 0U, 1U, SAFE_LASER_INDEX_HASHED, nullptr),
+            SAFE_LASER_INVALID_ARGUMENT);
+  safe_laser_result result{};
+  EXPECT_EQ(safe_laser_check(nullptr, 0U, &result), SAFE_LASER_INVALID_ARGUMENT);
+  safe_laser_destroy(nullptr);
+}
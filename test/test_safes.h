@@ -0,0 +1,40 @@
+#ifndef TEST_SAFES
+#define TEST_SAFES
+
+#include <safe_checker.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mirrors_lasers {
+namespace test {
+
+/// @brief Places the mirrors of a square comb safe
+///
+/// @details The laser beam zigzags over all the columns between the first and the last rows, the detector beam
+/// zigzags over all the rows between the first and the last columns. So every inner cell is an intersection,
+/// and their number is quadratic in the side
+///
+/// @param side Number of the rows and of the columns, at least 3
+/// @param left_to_up_mirrors List receiving the "/" mirrors
+/// @param left_to_down_mirrors List receiving the "\\" mirrors
+inline void make_comb(std::uint32_t side, std::vector<Point>& left_to_up_mirrors,
+                      std::vector<Point>& left_to_down_mirrors)
+{
+  left_to_down_mirrors.push_back({side, side});
+  for (std::uint32_t col = 2U; col < side; ++col) {
+    auto& mirrors = (col % 2U == 0U) ? left_to_down_mirrors : left_to_up_mirrors;
+    mirrors.push_back({1U, col});
+    mirrors.push_back({side, col});
+  }
+  for (std::uint32_t row = side - 1U; row > 1U; --row) {
+    auto& mirrors = ((side - 1U - row) % 2U == 0U) ? left_to_down_mirrors : left_to_up_mirrors;
+    mirrors.push_back({row, 1U});
+    mirrors.push_back({row, side});
+  }
+}
+
+}  // namespace test
+}  // namespace mirrors_lasers
+
+#endif  // TEST_SAFES
@@ -0,0 +1,112 @@
+#include <thread_pool.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(ThreadPoolTest, RunsAllParts)
+{
+  mirrors_lasers::ThreadPool pool{};
+  std::vector<std::size_t> runs(100U, 0U);
+  pool.run_parts(runs.size(), [&runs] (std::size_t part) { ++runs[part]; });
+  EXPECT_EQ(runs, std::vector<std::size_t>(100U, 1U));
+  pool.run_parts(0U, [] (std::size_t) { FAIL() << "No parts"; });
+}
+
+TEST(ThreadPoolTest, ReusesThreads)
+{
+  mirrors_lasers::ThreadPool pool{};
+  std::atomic<std::size_t> runs_count{0U};
+  pool.run_parts(4U, [&runs_count] (std::size_t) { runs_count.fetch_add(1U); });
+  const std::size_t threads_count = pool.threads_count();
+  EXPECT_LE(threads_count, 3U);
+  for (int repetition = 0; repetition < 50; ++repetition) {
+    pool.run_parts(4U, [&runs_count] (std::size_t) { runs_count.fetch_add(1U); });
+  }
+  EXPECT_EQ(runs_count.load(), 204U);
+  EXPECT_LE(pool.threads_count(), 3U);
+}
+
+TEST(ThreadPoolTest, LimitsThreads)
+{
+  mirrors_lasers::ThreadPool pool{2U};
+  EXPECT_EQ(pool.max_threads_count(), 2U);
+  // The jobs beyond the limit wait in the queue until a worker is free
+  std::promise<void> release{};
+  const std::shared_future<void> released = release.get_future().share();
+  std::vector<std::future<std::size_t>> futures;
+  for (std::size_t job = 0U; job < 8U; ++job) {
+    futures.push_back(pool.submit([released, job] () {
+      released.wait();
+      return job;
+    }));
+  }
+  EXPECT_LE(pool.threads_count(), 2U);
+  // The calling thread runs the parts while the workers are busy
+  std::atomic<std::size_t> runs_count{0U};
+  pool.run_parts(4U, [&runs_count] (std::size_t) { runs_count.fetch_add(1U); });
+  EXPECT_EQ(runs_count.load(), 4U);
+  release.set_value();
+  for (std::size_t job = 0U; job < futures.size(); ++job) {
+    EXPECT_EQ(futures[job].get(), job);
+  }
+  EXPECT_LE(pool.threads_count(), 2U);
+  EXPECT_EQ(mirrors_lasers::ThreadPool{0U}.max_threads_count(), 1U);
+}
+
+TEST(ThreadPoolTest, LimitsThreadsOfParts)
+{
+  mirrors_lasers::ThreadPool pool{4U};
+  // A single thread runs all the parts in the calling thread
+  const std::thread::id caller_id = std::this_thread::get_id();
+  std::atomic<std::size_t> other_threads_runs{0U};
+  pool.run_parts(100U, [&caller_id, &other_threads_runs] (std::size_t) {
+    if (std::this_thread::get_id() != caller_id) {
+      other_threads_runs.fetch_add(1U);
+    }
+  }, 1U);
+  EXPECT_EQ(other_threads_runs.load(), 0U);
+  EXPECT_EQ(pool.threads_count(), 0U);
+
+  std::atomic<std::size_t> runs_count{0U};
+  pool.run_parts(100U, [&runs_count] (std::size_t) { runs_count.fetch_add(1U); }, 2U);
+  EXPECT_EQ(runs_count.load(), 100U);
+  EXPECT_LE(pool.threads_count(), 1U);
+}
+
+TEST(ThreadPoolTest, NestedPartsAndSubmit)
+{
+  mirrors_lasers::ThreadPool pool{};
+  // The parts run inside the submitted jobs complete even when all the workers are busy
+  std::vector<std::future<std::size_t>> futures;
+  for (std::size_t job = 0U; job < 4U; ++job) {
+    futures.push_back(pool.submit([&pool, job] () {
+      std::atomic<std::size_t> sum{0U};
+      pool.run_parts(8U, [&sum] (std::size_t part) { sum.fetch_add(part); });
+      return sum.load() + job;
+    }));
+  }
+  for (std::size_t job = 0U; job < futures.size(); ++job) {
+    EXPECT_EQ(futures[job].get(), 28U + job);
+  }
+}
+
+TEST(ThreadPoolTest, RethrowsException)
+{
+  mirrors_lasers::ThreadPool pool{};
+  std::atomic<std::size_t> runs_count{0U};
+  EXPECT_THROW(pool.run_parts(5U, [&runs_count] (std::size_t part) {
+                 runs_count.fetch_add(1U);
+                 if (part == 3U) {
+                   throw std::runtime_error{"part"};
+                 }
+               }),
+               std::runtime_error);
+  EXPECT_EQ(runs_count.load(), 5U);
+  EXPECT_THROW(pool.submit([] () -> int { throw std::logic_error{"job"}; }).get(), std::logic_error);
+}
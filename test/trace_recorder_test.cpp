@@ -0,0 +1,116 @@
+#include <batch_runner.h>
+#include <trace_recorder.h>
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::size_t count_occurrences(const std::string& text, const std::string& pattern)
+{
+  std::size_t count{0U};
+  for (std::size_t position = text.find(pattern); position != std::string::npos;
+       position = text.find(pattern, position + pattern.size())) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(TraceRecorderTest, EventsOfCases)
+{
+  const std::vector<mirrors_lasers::SafeDescription> safes{
+      {5U, 6U, {{2U, 3U}}, {{1U, 2U}, {2U, 5U}, {4U, 2U}, {5U, 5U}}},
+      {100U, 100U, {}, {}}};
+  mirrors_lasers::BatchOptions options{};
+  options.threads_count = 2U;
+
+  mirrors_lasers::TraceRecorder::start(1024U);
+  const std::vector<mirrors_lasers::LimitedCheckResult> results = mirrors_lasers::check_safes(safes, options);
+  mirrors_lasers::TraceRecorder::stop();
+  std::ostringstream trace{};
+  mirrors_lasers::TraceRecorder::write_chrome_trace(trace);
+
+  ASSERT_EQ(results.size(), 2U);
+  const std::string json = trace.str();
+  EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0U);
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"check_safe\""), 2U);
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"build_index\""), 2U);
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"trace_the_beam\""), 4U);
+  EXPECT_NE(json.find("\"case\":\"1\",\"mirrors\":5,"), std::string::npos);
+  EXPECT_NE(json.find("\"case\":\"2\",\"mirrors\":0,"), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+}
+
+TEST(TraceRecorderTest, RingBufferKeepsLatestEvents)
+{
+  mirrors_lasers::TraceRecorder::start(2U);
+  {
+    const mirrors_lasers::TraceCase trace_case{"case \"quoted\"", 7U};
+    for (int i = 0; i < 5; ++i) {
+      mirrors_lasers::TraceScope scope{"event"};
+      scope.set_segments(static_cast<std::uint64_t>(i));
+    }
+  }
+  mirrors_lasers::TraceRecorder::stop();
+  {
+    // Not recorded, since the recording is stopped
+    const mirrors_lasers::TraceScope scope{"event"};
+  }
+  std::ostringstream trace{};
+  mirrors_lasers::TraceRecorder::write_chrome_trace(trace);
+
+  const std::string json = trace.str();
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"event\""), 2U);
+  EXPECT_NE(json.find("\"case\":\"case \\\"quoted\\\"\",\"mirrors\":7,\"segments\":3}"), std::string::npos);
+  EXPECT_NE(json.find("\"segments\":4}"), std::string::npos);
+}
+
+TEST(TraceRecorderTest, BoundCaseInAnotherThread)
+{
+  mirrors_lasers::TraceRecorder::start(16U);
+  std::thread thread{};
+  {
+    const mirrors_lasers::TraceCase trace_case{"bound", 3U};
+    thread = std::thread{mirrors_lasers::bind_trace_case([] () { mirrors_lasers::TraceScope scope{"worker"}; })};
+  }
+  thread.join();
+  mirrors_lasers::TraceRecorder::stop();
+  std::ostringstream trace{};
+  mirrors_lasers::TraceRecorder::write_chrome_trace(trace);
+
+  const std::string json = trace.str();
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"worker\""), 1U);
+  EXPECT_NE(json.find("\"case\":\"bound\",\"mirrors\":3,"), std::string::npos);
+}
+
+TEST(TraceRecorderTest, BuffersOfExitedThreadsAreReused)
+{
+  mirrors_lasers::TraceRecorder::start(16U);
+  auto record_in_new_thread = [] () {
+    std::thread thread{[] () { const mirrors_lasers::TraceScope scope{"reused"}; }};
+    thread.join();
+  };
+  auto threads_count = [] () {
+    std::ostringstream trace{};
+    mirrors_lasers::TraceRecorder::write_chrome_trace(trace);
+    return count_occurrences(trace.str(), "\"name\":\"thread_name\"");
+  };
+  record_in_new_thread();
+  const std::size_t first_count = threads_count();
+  for (int i = 0; i < 5; ++i) {
+    record_in_new_thread();
+  }
+  mirrors_lasers::TraceRecorder::stop();
+
+  EXPECT_EQ(threads_count(), first_count);
+  std::ostringstream trace{};
+  mirrors_lasers::TraceRecorder::write_chrome_trace(trace);
+  EXPECT_EQ(count_occurrences(trace.str(), "\"name\":\"reused\""), 6U);
+}
@@ -0,0 +1,161 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+
+namespace mirrors_lasers {
+
+namespace {
+
+/// @brief Parts of a single run_parts() call, shared with the workers which take them
+struct PartsBatch final {
+  const std::function<void(std::size_t)>* task{nullptr};
+  std::size_t parts_count{0U};
+  /// @brief Index of the next part to take
+  std::atomic<std::size_t> next_part{0U};
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::size_t finished_count{0U};
+  std::exception_ptr exception{};
+};
+
+/// @brief Takes the parts of the batch until none is left. The task is not used once all the parts are taken,
+/// so a worker coming late doesn't access it after run_parts() returned
+void run_batch_parts(PartsBatch& batch)
+{
+  for (std::size_t part = batch.next_part.fetch_add(1U); part < batch.parts_count;
+       part = batch.next_part.fetch_add(1U)) {
+    std::exception_ptr exception{};
+    try {
+      (*batch.task)(part);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock{batch.mutex};
+    if (exception && !batch.exception) {
+      batch.exception = exception;
+    }
+    if (++batch.finished_count == batch.parts_count) {
+      batch.condition.notify_all();
+    }
+  }
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t max_threads_count)
+    : max_threads_count_{std::max<std::size_t>(max_threads_count, 1U)}
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    is_stopped_ = true;
+  }
+  condition_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool& ThreadPool::shared()
+{
+  static ThreadPool instance{};
+  return instance;
+}
+
+void ThreadPool::run_parts(std::size_t parts_count, const std::function<void(std::size_t)>& task,
+                           std::size_t max_threads_count)
+{
+  if (parts_count == 0U) {
+    return;
+  }
+  auto batch = std::make_shared<PartsBatch>();
+  batch->task = &task;
+  batch->parts_count = parts_count;
+  // A job takes the parts until none is left, so more jobs than the workers would only wait in the queue
+  const std::size_t jobs_count =
+      std::min({parts_count - 1U, std::max<std::size_t>(max_threads_count, 1U) - 1U, max_threads_count_});
+  for (std::size_t job = 0U; job < jobs_count; ++job) {
+    try {
+      post_([batch] () { run_batch_parts(*batch); }, batch.get());
+    } catch (const std::system_error&) {
+      break;  // The remaining parts are run by the calling thread
+    }
+  }
+  run_batch_parts(*batch);
+  // All the parts are taken, so the jobs which are not started yet have nothing to do
+  cancel_(batch.get());
+  std::unique_lock<std::mutex> lock{batch->mutex};
+  batch->condition.wait(lock, [&batch] () { return batch->finished_count == batch->parts_count; });
+  if (batch->exception) {
+    std::rethrow_exception(batch->exception);
+  }
+}
+
+std::size_t ThreadPool::threads_count() const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  return workers_.size();
+}
+
+std::size_t ThreadPool::max_threads_count() const noexcept
+{
+  return max_threads_count_;
+}
+
+std::size_t ThreadPool::default_max_threads_count() noexcept
+{
+  return std::max<std::size_t>(std::thread::hardware_concurrency(), 1U);
+}
+
+void ThreadPool::post_(std::function<void()> function, const void* owner)
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (idle_count_ <= jobs_.size() && workers_.size() < max_threads_count_) {
+      try {
+        workers_.emplace_back([this] () { work_(); });
+        ++idle_count_;
+      } catch (const std::system_error&) {
+        if (workers_.empty()) {
+          throw;
+        }
+        // The job waits for a busy worker
+      }
+    }
+    jobs_.push_back(Job{std::move(function), owner});
+  }
+  condition_.notify_one();
+}
+
+void ThreadPool::cancel_(const void* owner)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(), [owner] (const Job& job) { return job.owner == owner; }),
+              jobs_.end());
+}
+
+void ThreadPool::work_()
+{
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    condition_.wait(lock, [this] () { return is_stopped_ || !jobs_.empty(); });
+    if (jobs_.empty()) {
+      return;
+    }
+    std::function<void()> function = std::move(jobs_.front().function);
+    jobs_.pop_front();
+    --idle_count_;
+    lock.unlock();
+    function();
+    lock.lock();
+    ++idle_count_;
+  }
+}
+
+}  // namespace mirrors_lasers
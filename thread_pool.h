@@ -0,0 +1,106 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mirrors_lasers {
+
+/// @brief Pool of persistent worker threads running the parallel parts of the construction and of the checks
+///
+/// @details A worker is started when a job is posted and no worker is idle, until the limit of the workers is
+/// reached. Then the jobs wait in the queue for a busy worker, so a job must not wait for another job of the queue.
+/// The threads are reused by the following jobs and joined on destruction after running the posted jobs
+class ThreadPool final {
+public:
+  /// @brief Creates the pool without workers
+  ///
+  /// @param max_threads_count Maximum number of the workers, at least one worker is allowed
+  explicit ThreadPool(std::size_t max_threads_count = default_max_threads_count());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// @brief Returns the pool shared by all the checkers of the process
+  static ThreadPool& shared();
+
+  /// @brief Runs the task for each of the parts and waits for all of them
+  ///
+  /// @details The calling thread runs the parts too, and it waits only for the parts already taken by the workers.
+  /// So the parts are completed even if all the workers are busy, and the task can run parts itself. Each thread
+  /// takes the next part when it finishes the previous one, so the parts of different lengths are balanced
+  ///
+  /// @param parts_count Number of the parts
+  /// @param task Function called with the index of a part
+  /// @param max_threads_count Maximum number of the threads running the parts at once, including the calling one
+  ///
+  /// @throw The first exception thrown by the task, after all the parts are finished
+  void run_parts(std::size_t parts_count, const std::function<void(std::size_t)>& task,
+                 std::size_t max_threads_count = std::numeric_limits<std::size_t>::max());
+
+  /// @brief Runs the function in a worker
+  ///
+  /// @param function Function without arguments
+  ///
+  /// @return The future of the result of the function
+  ///
+  /// @throw std::system_error if there are no workers and a new one can't be started
+  template <typename Function>
+  auto submit(Function function) -> std::future<decltype(function())>
+  {
+    using Result = decltype(function());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+    std::future<Result> future = task->get_future();
+    post_([task] () { (*task)(); });
+    return future;
+  }
+
+  /// @brief Returns the number of started workers
+  std::size_t threads_count() const;
+
+  /// @brief Returns the maximum number of the workers
+  std::size_t max_threads_count() const noexcept;
+
+  /// @brief Returns the number of the hardware threads, or one if it is unknown
+  static std::size_t default_max_threads_count() noexcept;
+
+private:
+  /// @brief Job of the queue
+  struct Job final {
+    std::function<void()> function;
+    /// @brief Identifies the jobs which can be removed from the queue by cancel_(), nullptr for the others
+    const void* owner{nullptr};
+  };
+
+  /// @brief Adds the job to the queue and starts a worker if no worker is idle and the limit is not reached
+  void post_(std::function<void()> function, const void* owner = nullptr);
+
+  /// @brief Removes the jobs of the owner, which are not started yet, from the queue
+  void cancel_(const void* owner);
+
+  /// @brief Runs the jobs of the queue until the pool is destroyed
+  void work_();
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Job> jobs_;
+  std::vector<std::thread> workers_;
+  const std::size_t max_threads_count_;
+  /// @brief Number of the workers not running a job, including the starting ones
+  std::size_t idle_count_{0U};
+  bool is_stopped_{false};
+};
+
+}  // namespace mirrors_lasers
+
+#endif  // THREAD_POOL
@@ -0,0 +1,254 @@
+#include "trace_recorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace mirrors_lasers {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using CaseId = std::array<char, TraceCase::MAX_CASE_ID_LENGTH + 1U>;
+
+/// @brief Complete event of the Chrome Trace Event format
+struct TraceEvent final {
+  const char* name{nullptr};
+  Clock::time_point start{};
+  Clock::duration duration{};
+  CaseId case_id{};
+  std::uint64_t mirrors{0U};
+  std::uint64_t segments{0U};
+};
+
+/// @brief Ring buffer of the events of a single thread
+struct ThreadTraceBuffer final {
+  /// @brief Taken by the owning thread on each event, so it is contended only while the trace is written
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+  /// @brief Index of the next event to write
+  std::size_t next_index{0U};
+  bool is_full{false};
+  std::size_t thread_index{0U};
+  /// @brief True while a thread writes into the buffer, guarded by the mutex of the registry
+  bool is_owned{true};
+};
+
+/// @brief Buffers of all threads, which have recorded events. Buffers outlive their threads
+/// and are reused by the new threads, so the number of buffers doesn't exceed the number of threads alive at once
+struct TraceRegistry final {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+  std::size_t events_per_thread{0U};
+  Clock::time_point start_time{};
+};
+
+TraceRegistry& registry()
+{
+  // Never destroyed, since the threads exiting during the static destruction release their buffers
+  static TraceRegistry* const instance = new TraceRegistry{};
+  return *instance;
+}
+
+/// @brief Case of the events recorded by the current thread
+struct CaseContext final {
+  CaseId case_id{};
+  std::uint64_t mirrors_count{0U};
+};
+
+thread_local CaseContext current_case{};
+/// @brief Buffer of the current thread, returned to the registry when the thread exits
+struct ThreadBufferOwner final {
+  ~ThreadBufferOwner()
+  {
+    if (buffer) {
+      TraceRegistry& trace_registry = registry();
+      std::lock_guard<std::mutex> lock{trace_registry.mutex};
+      buffer->is_owned = false;
+    }
+  }
+
+  std::shared_ptr<ThreadTraceBuffer> buffer;
+};
+
+thread_local ThreadBufferOwner current_buffer{};
+
+ThreadTraceBuffer& thread_buffer()
+{
+  if (!current_buffer.buffer) {
+    TraceRegistry& trace_registry = registry();
+    std::lock_guard<std::mutex> lock{trace_registry.mutex};
+    // The events of the exited thread are kept, the new thread continues its ring buffer
+    const auto free_iter = std::find_if(trace_registry.buffers.begin(), trace_registry.buffers.end(),
+                                        [] (const auto& buffer) { return !buffer->is_owned; });
+    if (free_iter != trace_registry.buffers.end()) {
+      (*free_iter)->is_owned = true;
+      current_buffer.buffer = *free_iter;
+    } else {
+      auto buffer = std::make_shared<ThreadTraceBuffer>();
+      buffer->events.resize(trace_registry.events_per_thread);
+      buffer->thread_index = trace_registry.buffers.size();
+      trace_registry.buffers.push_back(buffer);
+      current_buffer.buffer = std::move(buffer);
+    }
+  }
+  return *current_buffer.buffer;
+}
+
+void write_json_string(std::ostream& output, const char* value)
+{
+  output << '"';
+  for (; *value != '\0'; ++value) {
+    const char symbol = *value;
+    if (symbol == '"' || symbol == '\\') {
+      output << '\\' << symbol;
+    } else if (static_cast<unsigned char>(symbol) < 0x20U) {
+      output << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(symbol)
+             << std::dec << std::setfill(' ');
+    } else {
+      output << symbol;
+    }
+  }
+  output << '"';
+}
+
+/// @brief Writes the duration as microseconds with a fractional part, as expected by the format
+void write_microseconds(std::ostream& output, Clock::duration duration)
+{
+  const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  output << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000
+         << std::setfill(' ');
+}
+
+}  // namespace
+
+std::atomic<bool> TraceRecorder::is_enabled_{false};
+
+constexpr std::size_t TraceCase::MAX_CASE_ID_LENGTH;
+
+void TraceRecorder::start(std::size_t events_per_thread)
+{
+  if (events_per_thread == 0U) {
+    throw std::invalid_argument{"Trace buffer capacity must be positive"};
+  }
+  TraceRegistry& trace_registry = registry();
+  std::lock_guard<std::mutex> lock{trace_registry.mutex};
+  trace_registry.events_per_thread = events_per_thread;
+  trace_registry.start_time = Clock::now();
+  for (const auto& buffer : trace_registry.buffers) {
+    std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+    buffer->events.assign(events_per_thread, TraceEvent{});
+    buffer->next_index = 0U;
+    buffer->is_full = false;
+  }
+  is_enabled_.store(true, std::memory_order_relaxed);
+}
+
+void TraceRecorder::stop()
+{
+  is_enabled_.store(false, std::memory_order_relaxed);
+}
+
+void TraceRecorder::write_chrome_trace(std::ostream& output)
+{
+  TraceRegistry& trace_registry = registry();
+  std::lock_guard<std::mutex> lock{trace_registry.mutex};
+  output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool is_first{true};
+  for (const auto& buffer : trace_registry.buffers) {
+    std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+    output << (is_first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+           << buffer->thread_index << ",\"args\":{\"name\":\"thread " << buffer->thread_index << "\"}}";
+    is_first = false;
+
+    // The oldest event is the next one to be overwritten
+    const std::size_t events_count = buffer->is_full ? buffer->events.size() : buffer->next_index;
+    const std::size_t first_index = buffer->is_full ? buffer->next_index : 0U;
+    for (std::size_t offset = 0U; offset < events_count; ++offset) {
+      const TraceEvent& event = buffer->events[(first_index + offset) % buffer->events.size()];
+      output << ",\n{\"name\":";
+      write_json_string(output, event.name);
+      output << ",\"cat\":\"safe_laser\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_index << ",\"ts\":";
+      write_microseconds(output, event.start - trace_registry.start_time);
+      output << ",\"dur\":";
+      write_microseconds(output, event.duration);
+      output << ",\"args\":{\"case\":";
+      write_json_string(output, event.case_id.data());
+      output << ",\"mirrors\":" << event.mirrors << ",\"segments\":" << event.segments << "}}";
+    }
+  }
+  output << "\n]}\n";
+}
+
+void TraceRecorder::write_chrome_trace(const std::string& path)
+{
+  std::ofstream file{path};
+  if (!file) {
+    throw std::runtime_error{"Can not open the trace file: " + path};
+  }
+  write_chrome_trace(file);
+  file.flush();
+  if (!file) {
+    throw std::runtime_error{"Can not write the trace file: " + path};
+  }
+}
+
+void TraceRecorder::record_(const char* name, std::chrono::steady_clock::time_point start,
+                            std::chrono::steady_clock::time_point end, std::uint64_t mirrors, std::uint64_t segments)
+{
+  ThreadTraceBuffer& buffer = thread_buffer();
+  std::lock_guard<std::mutex> lock{buffer.mutex};
+  if (buffer.events.empty()) {
+    return;
+  }
+  TraceEvent& event = buffer.events[buffer.next_index];
+  event.name = name;
+  event.start = start;
+  event.duration = end - start;
+  event.case_id = current_case.case_id;
+  event.mirrors = mirrors;
+  event.segments = segments;
+  if (++buffer.next_index == buffer.events.size()) {
+    buffer.next_index = 0U;
+    buffer.is_full = true;
+  }
+}
+
+TraceCase::TraceCase(const std::string& case_id, std::uint64_t mirrors_count)
+  : is_active_{TraceRecorder::is_enabled()}
+{
+  if (!is_active_) {
+    return;
+  }
+  previous_case_id_ = current_case.case_id;
+  previous_mirrors_count_ = current_case.mirrors_count;
+  const std::size_t length = std::min(case_id.size(), MAX_CASE_ID_LENGTH);
+  std::memcpy(current_case.case_id.data(), case_id.data(), length);
+  current_case.case_id[length] = '\0';
+  current_case.mirrors_count = mirrors_count;
+}
+
+TraceCase::~TraceCase()
+{
+  if (is_active_) {
+    current_case.case_id = previous_case_id_;
+    current_case.mirrors_count = previous_mirrors_count_;
+  }
+}
+
+std::string TraceCase::current_case_id()
+{
+  return current_case.case_id.data();
+}
+
+std::uint64_t TraceCase::current_mirrors_count()
+{
+  return current_case.mirrors_count;
+}
+
+}  // namespace mirrors_lasers
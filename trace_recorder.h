@@ -0,0 +1,164 @@
+#ifndef TRACE_RECORDER
+#define TRACE_RECORDER
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+
+namespace mirrors_lasers {
+
+/// @brief Recorder of timeline events in the Chrome Trace Event format, viewable in Perfetto or chrome://tracing
+///
+/// @details Each thread writes its events into its own ring buffer, so recording doesn't contend between threads.
+/// When the buffer is full, the oldest events of the thread are overwritten. While the recording is not started,
+/// the events cost a single relaxed atomic load
+class TraceRecorder final {
+public:
+  TraceRecorder() = delete;
+
+  /// @brief Clears the recorded events and starts recording
+  ///
+  /// @param events_per_thread Capacity of the ring buffer of each thread
+  ///
+  /// @throw std::invalid_argument if the capacity is zero
+  static void start(std::size_t events_per_thread);
+
+  /// @brief Stops recording. The recorded events are kept until the next start
+  static void stop();
+
+  /// @brief Returns true if the events are being recorded
+  static bool is_enabled()
+  {
+    return is_enabled_.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Writes the recorded events of all threads as a Chrome Trace Event JSON object
+  ///
+  /// @param output Output stream
+  static void write_chrome_trace(std::ostream& output);
+
+  /// @brief Writes the recorded events of all threads into the file
+  ///
+  /// @param path Path of the file
+  ///
+  /// @throw std::runtime_error if the file can't be written
+  static void write_chrome_trace(const std::string& path);
+
+private:
+  friend class TraceScope;
+  friend class TraceCase;
+
+  /// @brief Adds the event to the ring buffer of the current thread
+  static void record_(const char* name, std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end, std::uint64_t mirrors, std::uint64_t segments);
+
+  static std::atomic<bool> is_enabled_;
+};
+
+/// @brief Sets the case, to which the events recorded by the current thread belong, until the end of the scope
+class TraceCase final {
+public:
+  /// @brief Constructs the scope of the case
+  ///
+  /// @param case_id Identifier of the case, truncated to MAX_CASE_ID_LENGTH characters
+  /// @param mirrors_count Number of mirrors in the case, attached to the events
+  TraceCase(const std::string& case_id, std::uint64_t mirrors_count);
+  ~TraceCase();
+
+  TraceCase(const TraceCase&) = delete;
+  TraceCase& operator=(const TraceCase&) = delete;
+
+  /// @brief Returns the identifier of the current case of the thread
+  static std::string current_case_id();
+
+  /// @brief Returns the number of mirrors of the current case of the thread
+  static std::uint64_t current_mirrors_count();
+
+  /// @brief Maximal stored length of the case identifier
+  static constexpr std::size_t MAX_CASE_ID_LENGTH{31U};
+
+private:
+  using CaseId = std::array<char, MAX_CASE_ID_LENGTH + 1U>;
+
+  bool is_active_;
+  CaseId previous_case_id_{};
+  std::uint64_t previous_mirrors_count_{0U};
+};
+
+/// @brief Wraps the function, so that the events it records in another thread belong to the current case
+///
+/// @details The case is captured on the calling thread and set for the duration of each call of the wrapper
+///
+/// @param function Function to wrap
+///
+/// @return The wrapper passing its arguments to the function and returning its result
+template <typename Function>
+auto bind_trace_case(Function function)
+{
+  std::string case_id = TraceRecorder::is_enabled() ? TraceCase::current_case_id() : std::string{};
+  const std::uint64_t mirrors_count = TraceCase::current_mirrors_count();
+  return [function = std::move(function), case_id = std::move(case_id), mirrors_count] (auto&&... arguments) mutable {
+    const TraceCase trace_case{case_id, mirrors_count};
+    return function(std::forward<decltype(arguments)>(arguments)...);
+  };
+}
+
+/// @brief Records the duration of the scope as a complete event of the current case
+class TraceScope final {
+public:
+  /// @brief Starts the event
+  ///
+  /// @param name Name of the event, must be a string literal
+  explicit TraceScope(const char* name)
+    : name_{TraceRecorder::is_enabled() ? name : nullptr}
+  {
+    if (name_ != nullptr) {
+      start_ = std::chrono::steady_clock::now();
+      mirrors_ = TraceCase::current_mirrors_count();
+    }
+  }
+
+  ~TraceScope()
+  {
+    finish();
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  /// @brief Sets the number of mirrors attached to the event instead of the mirrors count of the case
+  void set_mirrors(std::uint64_t mirrors)
+  {
+    mirrors_ = mirrors;
+  }
+
+  /// @brief Sets the number of beam segments attached to the event
+  void set_segments(std::uint64_t segments)
+  {
+    segments_ = segments;
+  }
+
+  /// @brief Ends the event before the end of the scope
+  void finish()
+  {
+    if (name_ != nullptr) {
+      TraceRecorder::record_(name_, start_, std::chrono::steady_clock::now(), mirrors_, segments_);
+      name_ = nullptr;
+    }
+  }
+
+private:
+  const char* name_;
+  std::chrono::steady_clock::time_point start_{};
+  std::uint64_t mirrors_{0U};
+  std::uint64_t segments_{0U};
+};
+
+}  // namespace mirrors_lasers
+
+#endif  // TRACE_RECORDER